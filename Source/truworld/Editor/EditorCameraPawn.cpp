@@ -2,6 +2,7 @@
 
 #include "EditorCameraPawn.h"
 
+#include "EditorChangeHub.h"
 #include "EditorPlayerController.h"
 #include "Camera/CameraComponent.h"
 #include "Components/SphereComponent.h"
@@ -16,6 +17,13 @@
 #include "Components/SceneCaptureComponent2D.h"
 #include "Engine/TextureRenderTarget2D.h"
 #include "Kismet/GameplayStatics.h"
+#include "Kismet/KismetRenderingLibrary.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<float> CVarTruGizmoCaptureScale(
+    TEXT("tru.GizmoCaptureScale"),
+    1.0f,
+    TEXT("Resolution of the gizmo overlay capture relative to the viewport (0.1 - 1)."));
 
 
 AEditorCameraPawn::AEditorCameraPawn()
@@ -39,6 +47,8 @@ AEditorCameraPawn::AEditorCameraPawn()
     SceneCaptureComponent->SetupAttachment(CameraComponent);
     SceneCaptureComponent->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_UseShowOnlyList;
     SceneCaptureComponent->CaptureSource = ESceneCaptureSource::SCS_FinalColorLDR;
+    SceneCaptureComponent->bCaptureEveryFrame = false;
+    SceneCaptureComponent->bCaptureOnMovement = false;
     
     AutoPossessPlayer = EAutoReceiveInput::Player0;
 
@@ -61,6 +71,13 @@ void AEditorCameraPawn::BeginPlay()
 
         SceneCaptureComponent->ShowOnlyActors.Add(PC->GetArrows());
 
+        // Compare against this frame's camera and gizmo, not last frame's
+        AddTickPrerequisiteActor(PC);
+        if (PC->GetArrows())
+        {
+            AddTickPrerequisiteActor(PC->GetArrows());
+        }
+
         // Set input mode to Game and UI
         FInputModeGameAndUI InputMode;
         InputMode.SetLockMouseToViewportBehavior(EMouseLockMode::DoNotLock);
@@ -77,14 +94,15 @@ void AEditorCameraPawn::BeginPlay()
     if (GEngine && GEngine->GameViewport)
     {
         // Calculate aspect ratio from camera's field of view
-        FIntPoint ViewportSize = GEngine->GameViewport->Viewport->GetSizeXY();
+        ViewportSize = GEngine->GameViewport->Viewport->GetSizeXY();
         int32 Width = ViewportSize.X;
         int32 Height = ViewportSize.Y;
         CameraComponent->AspectRatio = Width / (float)Height;
 
-        // Create render target with camera's aspect ratio
+        // Create render target with camera's aspect ratio; the post process samples it by screen UV, so it may be smaller
+        AppliedCaptureScale = FMath::Clamp(CVarTruGizmoCaptureScale.GetValueOnGameThread(), 0.1f, 1.f);
         RenderTarget = NewObject<UTextureRenderTarget2D>(this);
-        RenderTarget->InitAutoFormat(Width, Height);
+        RenderTarget->InitAutoFormat(FMath::Max(1, FMath::RoundToInt(Width * AppliedCaptureScale)), FMath::Max(1, FMath::RoundToInt(Height * AppliedCaptureScale)));
 
         // Assign render target to scene capture component
         SceneCaptureComponent->TextureTarget = RenderTarget;
@@ -112,6 +130,8 @@ void AEditorCameraPawn::EndPlay(const EEndPlayReason::Type EndPlayReason)
         GEngine->GameViewport->Viewport->ViewportResizedEvent.RemoveAll(this);
     }
 
+    UE_LOG(LogTemp, Log, TEXT("Gizmo capture: %lld issued, %lld skipped"), GizmoCapturesIssued, GizmoCapturesSkipped);
+
     Super::EndPlay(EndPlayReason);
 }
 
@@ -125,16 +145,84 @@ void AEditorCameraPawn::OnViewportResized(FViewport* Viewport, uint32 e)
         int32 NewHeight = NewSize.Y;
         CameraComponent->AspectRatio = NewWidth / (float)NewHeight;
 
-        if (NewWidth > 0 && NewHeight > 0)
-        {
-            RenderTarget->ResizeTarget(NewWidth, NewHeight);
-        }
+        ResizeRenderTarget(NewSize);
+    }
+}
+
+void AEditorCameraPawn::ResizeRenderTarget(const FIntPoint& NewViewportSize)
+{
+    ViewportSize = NewViewportSize;
+    if (RenderTarget && ViewportSize.X > 0 && ViewportSize.Y > 0)
+    {
+        RenderTarget->ResizeTarget(FMath::Max(1, FMath::RoundToInt(ViewportSize.X * AppliedCaptureScale)), FMath::Max(1, FMath::RoundToInt(ViewportSize.Y * AppliedCaptureScale)));
+        bGizmoCaptureDirty = true;
+        bGizmoCaptureCleared = false;
     }
 }
 
 void AEditorCameraPawn::Tick(float DeltaTime)
 {
     Super::Tick(DeltaTime);
+
+    UpdateGizmoCapture();
+}
+
+void AEditorCameraPawn::UpdateGizmoCapture()
+{
+    AEditorPlayerController* PC = Cast<AEditorPlayerController>(GetController());
+    AMoveArrows* Arrows = PC ? PC->GetArrows() : nullptr;
+    if (!RenderTarget || !Arrows)
+    {
+        return;
+    }
+
+    const float CaptureScale = FMath::Clamp(CVarTruGizmoCaptureScale.GetValueOnGameThread(), 0.1f, 1.f);
+    if (CaptureScale != AppliedCaptureScale)
+    {
+        AppliedCaptureScale = CaptureScale;
+        ResizeRenderTarget(ViewportSize);
+    }
+
+    // Gizmo visibility follows the selection through the change hub; deliver this frame's changes before looking at it
+    if (UEditorChangeHub* ChangeHub = UEditorChangeHub::Get(this))
+    {
+        ChangeHub->Flush();
+    }
+
+    if (!Arrows->IsVisible())
+    {
+        // Clear once, to zero alpha, so the overlay neither keeps showing the last gizmo image nor covers the view
+        if (!bGizmoCaptureCleared)
+        {
+            UKismetRenderingLibrary::ClearRenderTarget2D(this, RenderTarget, FLinearColor::Transparent);
+            bGizmoCaptureCleared = true;
+            bGizmoCaptureDirty = true;
+        }
+        ++GizmoCapturesSkipped;
+        return;
+    }
+
+    const FTransform CameraTransform = CameraComponent->GetComponentTransform();
+    const FTransform& GizmoTransform = Arrows->GetActorTransform();
+    const UPrimitiveComponent* Highlight = Arrows->GetHighlightedArrow();
+    if (!bGizmoCaptureDirty && Highlight == LastCaptureHighlight && CameraComponent->FieldOfView == LastCaptureFOV
+        && CameraTransform.Equals(LastCaptureCameraTransform) && GizmoTransform.Equals(LastCaptureGizmoTransform))
+    {
+        ++GizmoCapturesSkipped;
+        return;
+    }
+
+    bGizmoCaptureDirty = false;
+    bGizmoCaptureCleared = false;
+    LastCaptureCameraTransform = CameraTransform;
+    LastCaptureFOV = CameraComponent->FieldOfView;
+    LastCaptureGizmoTransform = GizmoTransform;
+    LastCaptureHighlight = Highlight;
+
+    // Still a separate scene render; deferring only moves it to the end of the frame so it is issued at most once per frame
+    SceneCaptureComponent->FOVAngle = CameraComponent->FieldOfView;
+    SceneCaptureComponent->CaptureSceneDeferred();
+    ++GizmoCapturesIssued;
 }
 
 void AEditorCameraPawn::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
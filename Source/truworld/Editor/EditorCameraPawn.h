@@ -73,6 +73,21 @@ protected:
 	class UTextureRenderTarget2D* RenderTarget;
 
 	void OnViewportResized(FViewport* Viewport, uint32 e);
+
+	// The gizmo capture only renders when the camera, the gizmo transform or its highlight changed since the last one
+	void UpdateGizmoCapture();
+	void ResizeRenderTarget(const FIntPoint& ViewportSize);
+
+	FIntPoint ViewportSize = FIntPoint::ZeroValue;
+	float AppliedCaptureScale = 1.f;
+	bool bGizmoCaptureDirty = true;
+	bool bGizmoCaptureCleared = false;
+	FTransform LastCaptureCameraTransform;
+	float LastCaptureFOV = 0.f;
+	FTransform LastCaptureGizmoTransform;
+	const UPrimitiveComponent* LastCaptureHighlight = nullptr;
+	int64 GizmoCapturesIssued = 0;
+	int64 GizmoCapturesSkipped = 0;
 public:
 	virtual void Tick(float DeltaTime) override;
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
@@ -92,4 +107,8 @@ public:
 	// Rotation speed
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Camera")
 	float RotationSpeed;
+
+	// Frames on which the gizmo overlay was re-rendered, and frames on which it was not needed
+	UFUNCTION(BlueprintCallable, Category = "Gizmo Capture") int64 GetGizmoCapturesIssued() const { return GizmoCapturesIssued; }
+	UFUNCTION(BlueprintCallable, Category = "Gizmo Capture") int64 GetGizmoCapturesSkipped() const { return GizmoCapturesSkipped; }
 };
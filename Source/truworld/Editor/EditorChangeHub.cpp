@@ -0,0 +1,208 @@
+#include "EditorChangeHub.h"
+
+#include "Engine/World.h"
+
+UEditorChangeHub* UEditorChangeHub::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UEditorChangeHub>() : nullptr;
+}
+
+void UEditorChangeHub::NotifyAdded(ATruGameObject* GameObject)
+{
+	AddPending(EEditorChangeFlags::Added);
+	Added.Add(GameObject);
+}
+
+void UEditorChangeHub::NotifyRemoved(ATruGameObject* GameObject)
+{
+	AddPending(EEditorChangeFlags::Removed);
+	Reparented.Remove(GameObject);
+	Renamed.Remove(GameObject);
+
+	// Subscribers never saw an object that came and went within the frame, and only saw the entity of one that was
+	// promoted in it
+	if (Added.Remove(GameObject) == 0 && !ForgetPromoted(GameObject))
+	{
+		Removed.Add(GameObject);
+	}
+}
+
+bool UEditorChangeHub::ForgetPromoted(ATruGameObject* GameObject)
+{
+	// Only a handful of promotions happen per frame
+	for (TPair<FTruObjectId, ATruGameObject*>& Pair : Promoted)
+	{
+		if (Pair.Value == GameObject)
+		{
+			Pair.Value = nullptr;
+			return true;
+		}
+	}
+	return false;
+}
+
+void UEditorChangeHub::NotifyReparented(ATruGameObject* GameObject)
+{
+	AddPending(EEditorChangeFlags::Reparented);
+	if (!Added.Contains(GameObject))
+	{
+		Reparented.Add(GameObject);
+	}
+}
+
+void UEditorChangeHub::NotifyRenamed(ATruGameObject* GameObject)
+{
+	AddPending(EEditorChangeFlags::Renamed);
+	if (!Added.Contains(GameObject))
+	{
+		Renamed.Add(GameObject);
+	}
+}
+
+void UEditorChangeHub::NotifySelectionChanged()
+{
+	AddPending(EEditorChangeFlags::Selection);
+}
+
+void UEditorChangeHub::NotifyDemoted(ATruGameObject* GameObject, FTruObjectId Id)
+{
+	AddPending(EEditorChangeFlags::Entities);
+	Removed.Remove(GameObject);
+
+	// Promoted and demoted again within the frame: subscribers still show the entity
+	if (Promoted.Remove(Id) == 0)
+	{
+		Demoted.Add(Id, GameObject);
+	}
+}
+
+void UEditorChangeHub::NotifyPromoted(ATruGameObject* GameObject, FTruObjectId Id)
+{
+	AddPending(EEditorChangeFlags::Entities);
+	Added.Remove(GameObject);
+
+	// Demoted and promoted again within the frame: subscribers still show the old object, which the pool may have
+	// handed straight back
+	ATruGameObject* DemotedObject = nullptr;
+	if (Demoted.RemoveAndCopyValue(Id, DemotedObject))
+	{
+		if (DemotedObject != GameObject)
+		{
+			AddPending(EEditorChangeFlags::Removed);
+			Removed.Add(DemotedObject);
+			if (GameObject)
+			{
+				AddPending(EEditorChangeFlags::Added);
+				Added.Add(GameObject);
+			}
+		}
+		return;
+	}
+	Promoted.Add(Id, GameObject);
+}
+
+int32 UEditorChangeHub::Subscribe(FName Name, EEditorChangeFlags Mask, FOnChanges&& Callback)
+{
+	FSubscriber& Subscriber = Subscribers.AddDefaulted_GetRef();
+	Subscriber.Id = NextSubscriberId++;
+	Subscriber.Mask = Mask;
+	Subscriber.Callback = MoveTemp(Callback);
+	Subscriber.Stats.Name = Name;
+	return Subscriber.Id;
+}
+
+void UEditorChangeHub::Unsubscribe(int32 SubscriberId)
+{
+	Subscribers.RemoveAll([SubscriberId](const FSubscriber& Subscriber) { return Subscriber.Id == SubscriberId; });
+}
+
+void UEditorChangeHub::Flush()
+{
+	if (PendingFlags == EEditorChangeFlags::None || bFlushing)
+	{
+		return;
+	}
+
+	// Take everything first: subscribers may cause new notifications, which then go to the next flush
+	FEditorChangeSet ChangeSet;
+	ChangeSet.Flags = PendingFlags;
+	ChangeSet.Added = Added.Array();
+	ChangeSet.Removed = Removed.Array();
+	ChangeSet.Reparented = Reparented.Array();
+	ChangeSet.Renamed = Renamed.Array();
+	ChangeSet.Demoted = Demoted.Array();
+	ChangeSet.Promoted = Promoted.Array();
+
+	int32 Counts[UE_ARRAY_COUNT(PendingCounts)];
+	FMemory::Memcpy(Counts, PendingCounts, sizeof(Counts));
+
+	PendingFlags = EEditorChangeFlags::None;
+	FMemory::Memzero(PendingCounts);
+	Added.Reset();
+	Removed.Reset();
+	Reparented.Reset();
+	Renamed.Reset();
+	Demoted.Reset();
+	Promoted.Reset();
+
+	TGuardValue<bool> FlushGuard(bFlushing, true);
+	for (int32 Index = 0; Index < Subscribers.Num(); ++Index)
+	{
+		FSubscriber& Subscriber = Subscribers[Index];
+		if (!EnumHasAnyFlags(ChangeSet.Flags, Subscriber.Mask))
+		{
+			continue;
+		}
+
+		for (int32 Bit = 0; Bit < UE_ARRAY_COUNT(Counts); ++Bit)
+		{
+			if (EnumHasAnyFlags(Subscriber.Mask, (EEditorChangeFlags)(1 << Bit)))
+			{
+				Subscriber.Stats.NotificationsReceived += Counts[Bit];
+			}
+		}
+		++Subscriber.Stats.Flushes;
+
+		Subscriber.Callback(ChangeSet);
+	}
+}
+
+void UEditorChangeHub::GetSubscriberStats(TArray<FSubscriberStats>& OutStats) const
+{
+	OutStats.Reset(Subscribers.Num());
+	for (const FSubscriber& Subscriber : Subscribers)
+	{
+		OutStats.Add(Subscriber.Stats);
+	}
+}
+
+void UEditorChangeHub::Tick(float DeltaTime)
+{
+	Flush();
+}
+
+TStatId UEditorChangeHub::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEditorChangeHub, STATGROUP_Tickables);
+}
+
+void UEditorChangeHub::Deinitialize()
+{
+	Subscribers.Reset();
+	Added.Reset();
+	Removed.Reset();
+	Reparented.Reset();
+	Renamed.Reset();
+	Demoted.Reset();
+	Promoted.Reset();
+	PendingFlags = EEditorChangeFlags::None;
+
+	Super::Deinitialize();
+}
+
+void UEditorChangeHub::AddPending(EEditorChangeFlags Flag)
+{
+	PendingFlags |= Flag;
+	++PendingCounts[FMath::FloorLog2((uint32)Flag)];
+}
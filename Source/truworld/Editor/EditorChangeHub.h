@@ -0,0 +1,110 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "truworld/GameObjects/TruObjectRegistry.h"
+#include "EditorChangeHub.generated.h"
+
+class ATruGameObject;
+
+enum class EEditorChangeFlags : uint8
+{
+	None		= 0,
+	Added		= 1 << 0,
+	Removed		= 1 << 1,
+	Reparented	= 1 << 2,
+	Renamed		= 1 << 3,
+	Selection	= 1 << 4,
+	Entities	= 1 << 5,	// Objects demoted to or promoted from the entity store
+	All			= Added | Removed | Reparented | Renamed | Selection | Entities
+};
+ENUM_CLASS_FLAGS(EEditorChangeFlags);
+
+/** Everything that changed since the last flush, with each object listed at most once per kind. */
+struct FEditorChangeSet
+{
+	EEditorChangeFlags Flags = EEditorChangeFlags::None;
+	TArray<ATruGameObject*> Added;
+	/** Already destroyed; only usable as keys. */
+	TArray<ATruGameObject*> Removed;
+	TArray<ATruGameObject*> Reparented;
+	TArray<ATruGameObject*> Renamed;
+	/** Entity id and the object it used to be, which is gone like the Removed ones. */
+	TArray<TPair<FTruObjectId, ATruGameObject*>> Demoted;
+	/** Entity id and the object it became, or null when that object was removed again within the frame. */
+	TArray<TPair<FTruObjectId, ATruGameObject*>> Promoted;
+};
+
+/**
+ * Collects editor change notifications during the frame and hands them to subscribers once, at the end of it.
+ *
+ * Objects added and removed in the same frame cancel out, and repeated notifications about the same object
+ * collapse into one entry, so a paste of hundreds of objects costs each subscriber a single update.
+ */
+UCLASS()
+class TRUWORLD_API UEditorChangeHub : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	typedef TFunction<void(const FEditorChangeSet&)> FOnChanges;
+
+	struct FSubscriberStats
+	{
+		FName Name;
+		int64 NotificationsReceived = 0;	// Raw notifications matching the subscriber's mask
+		int64 Flushes = 0;					// Times the subscriber was actually called
+		int64 GetMerged() const { return NotificationsReceived - Flushes; }
+	};
+
+	static UEditorChangeHub* Get(const UObject* WorldContextObject);
+
+	void NotifyAdded(ATruGameObject* GameObject);
+	void NotifyRemoved(ATruGameObject* GameObject);
+	void NotifyReparented(ATruGameObject* GameObject);
+	void NotifyRenamed(ATruGameObject* GameObject);
+	void NotifySelectionChanged();
+	/** The object's removal was a demotion to entity Id: subscribers swap the row instead of dropping it. */
+	void NotifyDemoted(ATruGameObject* GameObject, FTruObjectId Id);
+	/** The object's addition was entity Id coming back. A null object means the entity was discarded instead. */
+	void NotifyPromoted(ATruGameObject* GameObject, FTruObjectId Id);
+
+	/** Callback runs on flushes that contain any change in Mask. Returns an id for Unsubscribe. */
+	int32 Subscribe(FName Name, EEditorChangeFlags Mask, FOnChanges&& Callback);
+	void Unsubscribe(int32 SubscriberId);
+
+	/** Delivers pending changes now instead of at the end of the frame. */
+	void Flush();
+
+	void GetSubscriberStats(TArray<FSubscriberStats>& OutStats) const;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+private:
+	struct FSubscriber
+	{
+		int32 Id = INDEX_NONE;
+		EEditorChangeFlags Mask = EEditorChangeFlags::None;
+		FOnChanges Callback;
+		FSubscriberStats Stats;
+	};
+
+	void AddPending(EEditorChangeFlags Flag);
+	/** Marks GameObject's promotion as undone by its removal. */
+	bool ForgetPromoted(ATruGameObject* GameObject);
+
+	TArray<FSubscriber> Subscribers;
+	int32 NextSubscriberId = 0;
+
+	EEditorChangeFlags PendingFlags = EEditorChangeFlags::None;
+	int32 PendingCounts[6] = {};	// Raw notifications per flag bit
+	TSet<ATruGameObject*> Added;
+	TSet<ATruGameObject*> Removed;
+	TSet<ATruGameObject*> Reparented;
+	TSet<ATruGameObject*> Renamed;
+	TMap<FTruObjectId, ATruGameObject*> Demoted;
+	TMap<FTruObjectId, ATruGameObject*> Promoted;
+	bool bFlushing = false;
+};
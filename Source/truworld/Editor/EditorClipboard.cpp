@@ -0,0 +1,113 @@
+#include "EditorClipboard.h"
+
+#include "HAL/PlatformApplicationMisc.h"
+#include "Misc/Base64.h"
+#include "truworld/GameObjects/TruGameObject.h"
+#include "truworld/GameObjects/TruSpawnQueue.h"
+#include "truworld/Scene/TruSceneFile.h"
+
+namespace EditorClipboard
+{
+	// Keeps arbitrary clipboard text from being decoded and handed to the scene reader
+	static const TCHAR TextPrefix[] = TEXT("TruClipboard:");
+}
+
+int32 FEditorClipboard::Write(TConstArrayView<ATruGameObject*> GameObjects, TArray<uint8>& OutBytes)
+{
+	// Breadth first from the roots, so every parent is written before its children
+	TArray<ATruGameObject*> Objects;
+	TMap<const ATruGameObject*, int32> ObjectIndices;
+	for (ATruGameObject* GameObject : GameObjects)
+	{
+		if (GameObject && !ObjectIndices.Contains(GameObject))
+		{
+			ObjectIndices.Add(GameObject, Objects.Add(GameObject));
+		}
+	}
+
+	TArray<AActor*> AttachedActors;
+	for (int32 Index = 0; Index < Objects.Num(); ++Index)
+	{
+		Objects[Index]->GetAttachedActors(AttachedActors);
+		for (AActor* AttachedActor : AttachedActors)
+		{
+			ATruGameObject* Child = Cast<ATruGameObject>(AttachedActor);
+			if (Child && !ObjectIndices.Contains(Child))
+			{
+				ObjectIndices.Add(Child, Objects.Add(Child));
+			}
+		}
+	}
+
+	FTruSceneFileWriter Writer;
+	for (ATruGameObject* GameObject : Objects)
+	{
+		const ATruGameObject* Parent = GameObject->GetParentGameObject();
+		const int32* ParentIndex = ObjectIndices.Find(Parent);
+		const FTransform Transform = ParentIndex ? GameObject->GetActorTransform().GetRelativeTransform(Parent->GetActorTransform()) : GameObject->GetActorTransform();
+
+		Writer.AddObject(
+			GameObject->GetName(),
+			Writer.AddClass(GameObject->GetClass()->GetPathName()),
+			Transform,
+			ParentIndex ? *ParentIndex : INDEX_NONE,
+			GameObject->GetObjectId().Value);
+	}
+
+	Writer.WriteTo(OutBytes);
+	return Writer.GetNumObjects();
+}
+
+bool FEditorClipboard::MakeSpawnRequests(TArray<uint8>&& Bytes, TArray<FTruSpawnRequest>& OutRequests, FString* OutError)
+{
+	FTruSceneFileReader Reader;
+	if (!Reader.OpenFromMemory(MoveTemp(Bytes), OutError))
+	{
+		return false;
+	}
+
+	FTruSceneFile::MakeSpawnRequests(Reader, OutRequests);
+
+	// Parents precede their children, so one forward pass turns parent-relative transforms into world transforms.
+	// A parent that does not come first cannot have been written by Write(); such objects are pasted as roots.
+	for (int32 Index = 0; Index < OutRequests.Num(); ++Index)
+	{
+		FTruSpawnRequest& Request = OutRequests[Index];
+		if (Request.ParentIndex >= Index)
+		{
+			Request.ParentIndex = INDEX_NONE;
+		}
+		if (Request.ParentIndex != INDEX_NONE)
+		{
+			Request.Transform = Request.Transform * OutRequests[Request.ParentIndex].Transform;
+		}
+	}
+	return true;
+}
+
+FString FEditorClipboard::ToText(TConstArrayView<uint8> Bytes)
+{
+	return EditorClipboard::TextPrefix + FBase64::Encode(Bytes.GetData(), Bytes.Num());
+}
+
+bool FEditorClipboard::FromText(const FString& Text, TArray<uint8>& OutBytes)
+{
+	const FString TrimmedText = Text.TrimStartAndEnd();
+	if (!TrimmedText.StartsWith(EditorClipboard::TextPrefix, ESearchCase::CaseSensitive))
+	{
+		return false;
+	}
+	return FBase64::Decode(TrimmedText.RightChop(UE_ARRAY_COUNT(EditorClipboard::TextPrefix) - 1), OutBytes);
+}
+
+void FEditorClipboard::CopyToPlatform(TConstArrayView<uint8> Bytes)
+{
+	FPlatformApplicationMisc::ClipboardCopy(*ToText(Bytes));
+}
+
+bool FEditorClipboard::PasteFromPlatform(TArray<uint8>& OutBytes)
+{
+	FString Text;
+	FPlatformApplicationMisc::ClipboardPaste(Text);
+	return FromText(Text, OutBytes);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class ATruGameObject;
+struct FTruSpawnRequest;
+
+/**
+ * Copied objects as a .truscene buffer: class, name, transform and parent per object. Roots keep their world
+ * transform and children are stored relative to their parent, so a pasted hierarchy comes out intact.
+ *
+ * The buffer travels through the platform clipboard as base64 text. A paste only depends on what was copied,
+ * not on the copied actors still existing or keeping their names.
+ */
+class TRUWORLD_API FEditorClipboard
+{
+public:
+	/** Serializes GameObjects and everything attached to them, parents before children. Returns the number of objects written. */
+	static int32 Write(TConstArrayView<ATruGameObject*> GameObjects, TArray<uint8>& OutBytes);
+
+	/** Turns a buffer into spawn requests with world transforms. Fails if Bytes is not a valid buffer. */
+	static bool MakeSpawnRequests(TArray<uint8>&& Bytes, TArray<FTruSpawnRequest>& OutRequests, FString* OutError = nullptr);
+
+	static FString ToText(TConstArrayView<uint8> Bytes);
+	/** Returns false for text that was not produced by ToText. */
+	static bool FromText(const FString& Text, TArray<uint8>& OutBytes);
+
+	static void CopyToPlatform(TConstArrayView<uint8> Bytes);
+	static bool PasteFromPlatform(TArray<uint8>& OutBytes);
+};
@@ -0,0 +1,119 @@
+#include "EditorMarquee.h"
+
+#include "Async/ParallelFor.h"
+#include "Engine/LocalPlayer.h"
+#include "Engine/GameViewportClient.h"
+#include "ConvexVolume.h"
+#include "GameFramework/PlayerController.h"
+#include "SceneView.h"
+#include "truworld/GameObjects/TruEntityStore.h"
+#include "truworld/GameObjects/TruGameObject.h"
+#include "truworld/GameObjects/TruTransformMirror.h"
+
+void FEditorMarquee::Begin(const FVector2D& Position, EEditorMarqueeMode InMode)
+{
+	Start = Position;
+	End = Position;
+	Mode = InMode;
+	bActive = true;
+}
+
+FBox2D FEditorMarquee::GetRect() const
+{
+	return FBox2D(FVector2D::Min(Start, End), FVector2D::Max(Start, End));
+}
+
+void FEditorMarquee::FindObjectsInRect(const APlayerController* PlayerController, const FBox2D& Rect, TArray<ATruGameObject*>& OutObjects,
+	TArray<FTruObjectId>* OutEntities)
+{
+	check(IsInGameThread());
+	OutObjects.Reset();
+	if (OutEntities)
+	{
+		OutEntities->Reset();
+	}
+
+	ULocalPlayer* LocalPlayer = PlayerController ? PlayerController->GetLocalPlayer() : nullptr;
+	if (!LocalPlayer || !LocalPlayer->ViewportClient)
+	{
+		return;
+	}
+
+	FSceneViewProjectionData ProjectionData;
+	if (!LocalPlayer->GetProjectionData(LocalPlayer->ViewportClient->Viewport, ProjectionData))
+	{
+		return;
+	}
+	const FMatrix ViewProjection = ProjectionData.ComputeViewProjectionMatrix();
+	const FIntRect ViewRect = ProjectionData.GetConstrainedViewRect();
+
+	UTruTransformMirror* TransformMirror = UTruTransformMirror::Get(PlayerController);
+	if (!TransformMirror)
+	{
+		return;
+	}
+
+	// Only objects in the view frustum can overlap the rectangle; the bounds come from the mirror, not the actors
+	FConvexVolume ViewFrustum;
+	GetViewFrustumBounds(ViewFrustum, ViewProjection, /*bUseNearPlane*/ true);
+	TArray<int32> Rows;
+	TransformMirror->FindInFrustum(ViewFrustum, Rows);
+
+	// Entities in the frustum are projected in the same pass, after the objects
+	TArray<FTruObjectId> EntityIds;
+	TArray<FBox> EntityBounds;
+	UTruEntityStore* EntityStore = UTruEntityStore::Get(PlayerController);
+	if (OutEntities && EntityStore)
+	{
+		EntityStore->FindInFrustum(ViewFrustum, EntityIds, EntityBounds);
+	}
+
+	const int32 NumObjects = Rows.Num();
+	const int32 NumBoxes = NumObjects + EntityBounds.Num();
+	const EParallelForFlags Flags = NumBoxes < 1024 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None;
+
+	// Snapshot of every box to project, taken here on the game thread; the workers below only read this array
+	TArray<FBox> Bounds;
+	Bounds.SetNumUninitialized(NumObjects);
+	for (int32 Index = 0; Index < NumObjects; ++Index)
+	{
+		Bounds[Index] = TransformMirror->GetBounds(Rows[Index]);
+	}
+	Bounds.Append(EntityBounds);
+
+	TArray<bool> Overlaps;
+	Overlaps.SetNumZeroed(NumBoxes);
+	ParallelFor(NumBoxes, [&Bounds, &Overlaps, &ViewProjection, &ViewRect, &Rect](int32 Index)
+	{
+		const FBox& Box = Bounds[Index];
+
+		// Screen rectangle of the corners in front of the camera
+		FBox2D ScreenBox(ForceInit);
+		for (int32 Corner = 0; Corner < 8; ++Corner)
+		{
+			const FVector Point((Corner & 1) ? Box.Max.X : Box.Min.X, (Corner & 2) ? Box.Max.Y : Box.Min.Y, (Corner & 4) ? Box.Max.Z : Box.Min.Z);
+			FVector2D ScreenPoint;
+			if (FSceneView::ProjectWorldToScreen(Point, ViewRect, ViewProjection, ScreenPoint))
+			{
+				ScreenBox += ScreenPoint;
+			}
+		}
+
+		Overlaps[Index] = ScreenBox.bIsValid && ScreenBox.Intersect(Rect);
+	}, Flags);
+
+	for (int32 Index = 0; Index < NumObjects; ++Index)
+	{
+		if (Overlaps[Index])
+		{
+			OutObjects.Add(TransformMirror->GetGameObject(Rows[Index]));
+		}
+	}
+	for (int32 Index = NumObjects; Index < NumBoxes; ++Index)
+	{
+		if (Overlaps[Index])
+		{
+			OutEntities->Add(EntityIds[Index - NumObjects]);
+		}
+	}
+}
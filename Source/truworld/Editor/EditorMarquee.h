@@ -0,0 +1,39 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "truworld/GameObjects/TruObjectRegistry.h"
+
+class APlayerController;
+class ATruGameObject;
+
+enum class EEditorMarqueeMode : uint8
+{
+	Replace,
+	Add,		// Shift
+	Subtract	// Ctrl
+};
+
+/** Rectangle selection dragged out in the viewport. Positions are in viewport pixels. */
+struct TRUWORLD_API FEditorMarquee
+{
+	/** Drags shorter than this are treated as clicks. */
+	static constexpr double MinDragPixels = 4.0;
+
+	FVector2D Start = FVector2D::ZeroVector;
+	FVector2D End = FVector2D::ZeroVector;
+	EEditorMarqueeMode Mode = EEditorMarqueeMode::Replace;
+	bool bActive = false;
+
+	void Begin(const FVector2D& Position, EEditorMarqueeMode InMode);
+	void Reset() { bActive = false; }
+	bool IsDragged() const { return bActive && FVector2D::DistSquared(Start, End) >= FMath::Square(MinDragPixels); }
+	FBox2D GetRect() const;
+
+	/**
+	 * Collects the objects whose projected bounds overlap Rect. Game thread only: objects outside the view frustum are
+	 * dropped by the transform mirror, their bounds are copied out of it, and only that copy is projected with
+	 * ParallelFor, so no worker touches an actor. Entity store records in the rectangle go to OutEntities when it is given.
+	 */
+	static void FindObjectsInRect(const APlayerController* PlayerController, const FBox2D& Rect, TArray<ATruGameObject*>& OutObjects,
+		TArray<FTruObjectId>* OutEntities = nullptr);
+};
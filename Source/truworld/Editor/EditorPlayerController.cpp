@@ -1,12 +1,29 @@
 #include "EditorPlayerController.h"
 
-#include "EngineUtils.h"
+#include "EditorChangeHub.h"
+#include "EditorClipboard.h"
+#include "EditorSnapping.h"
 #include "MoveArrows.h"
+#include "Algo/StableSort.h"
 #include "Blueprint/UserWidget.h"
 #include "Engine/World.h"
 #include "Engine/Engine.h"
+#include "Components/DecalComponent.h"
 #include "Components/PrimitiveComponent.h"
+#include "Materials/Material.h"
+#include "truworld/GameObjects/TruEntityStore.h"
 #include "truworld/GameObjects/TruGameObject.h"
+#include "truworld/GameObjects/TruGameObjectPool.h"
+#include "truworld/GameObjects/TruInstancedRenderer.h"
+#include "truworld/GameObjects/TruNameRegistry.h"
+#include "truworld/GameObjects/TruObjectRegistry.h"
+#include "truworld/GameObjects/TruPrefab.h"
+#include "truworld/GameObjects/TruSceneBVH.h"
+#include "truworld/GameObjects/TruSpatialIndex.h"
+#include "truworld/GameObjects/TruSpawnQueue.h"
+#include "truworld/Scene/TruAutosave.h"
+#include "truworld/Scene/TruPlacementFile.h"
+#include "truworld/Scene/TruSceneFile.h"
 #include "Widgets/EditorUI.h"
 
 AEditorPlayerController::AEditorPlayerController()
@@ -20,220 +37,1117 @@ AEditorPlayerController::AEditorPlayerController()
     bIsMouseDown = false;
     bIsDraggingObject = false;
     DraggedObject = nullptr;
-    CopiedObject = nullptr;
+
+    // Placed in world space each frame; the controller's own transform does not matter
+    ScatterBrushDecal = CreateDefaultSubobject<UDecalComponent>(TEXT("ScatterBrushDecal"));
+    ScatterBrushDecal->SetupAttachment(RootComponent);
+    ScatterBrushDecal->SetUsingAbsoluteLocation(true);
+    ScatterBrushDecal->SetUsingAbsoluteRotation(true);
+    ScatterBrushDecal->SetUsingAbsoluteScale(true);
+    ScatterBrushDecal->SetVisibility(false);
+}
+
+void AEditorPlayerController::BeginPlay()
+{
+    Super::BeginPlay();
+
+    EditorUI = CreateWidget<UEditorUI>(this, EditorUIClass);
+    EditorUI->AddToViewport();
+    
+    Arrows = GetWorld()->SpawnActor<AMoveArrows>(MoveArrowsClass);
+
+    ScatterBrushDecal->SetDecalMaterial(ScatterBrushMaterial ? ScatterBrushMaterial : UMaterial::GetDefaultMaterial(MD_DeferredDecal));
+    ScatterBrushDecal->CreateDynamicMaterialInstance();
+
+    ATruGameObject* StartObject = GetWorld()->SpawnActor<ATruGameObject>();
+    StartObject->SetActorLocation(GetPawn()->GetActorLocation());
+    SetSelected(StartObject);
+
+    // Outliner and gizmo see at most one update per frame, however many objects changed
+    if (UEditorChangeHub* ChangeHub = UEditorChangeHub::Get(this))
+    {
+        TWeakObjectPtr<AEditorPlayerController> WeakThis(this);
+        ChangeSubscriberIds.Add(ChangeHub->Subscribe(TEXT("Outliner"), EEditorChangeFlags::All, [WeakThis](const FEditorChangeSet& Changes)
+        {
+            if (WeakThis.IsValid() && WeakThis->EditorUI)
+            {
+                WeakThis->EditorUI->ApplyChanges(Changes, WeakThis->GetSelectedObject());
+            }
+        }));
+        ChangeSubscriberIds.Add(ChangeHub->Subscribe(TEXT("Gizmo"), EEditorChangeFlags::Selection | EEditorChangeFlags::Removed, [WeakThis](const FEditorChangeSet& Changes)
+        {
+            if (WeakThis.IsValid() && WeakThis->Arrows)
+            {
+                WeakThis->Arrows->SetVisibility(!WeakThis->Selection.IsEmpty());
+            }
+        }));
+    }
+}
+
+void AEditorPlayerController::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (UEditorChangeHub* ChangeHub = UEditorChangeHub::Get(this))
+    {
+        for (const int32 SubscriberId : ChangeSubscriberIds)
+        {
+            ChangeHub->Unsubscribe(SubscriberId);
+        }
+    }
+    ChangeSubscriberIds.Reset();
+    ScatterBrush.EndStroke();
+
+    Super::EndPlay(EndPlayReason);
+}
+
+void AEditorPlayerController::OnGameObjectsRefreshed()
+{
+    if(EditorUI)
+        EditorUI->Refresh();
+}
+
+void AEditorPlayerController::OnGameObjectAdded(ATruGameObject* GameObject)
+{
+    if (UEditorChangeHub* ChangeHub = UEditorChangeHub::Get(this))
+    {
+        ChangeHub->NotifyAdded(GameObject);
+    }
+}
+
+void AEditorPlayerController::OnGameObjectRemoved(ATruGameObject* GameObject)
+{
+    // Selection and drag state refer to the object directly, so they are fixed up right away
+    if (Selection.Remove(GameObject))
+    {
+        if (Arrows)
+        {
+            Arrows->OnGameObjectRemoved(GameObject);
+        }
+        if (CurrentSelected == GameObject)
+        {
+            // No OnDeselected: the object is on its way out and must not go back into an instance batch
+            CurrentSelected = nullptr;
+            OnSelectionChanged(Selection.IsEmpty() ? nullptr : Selection.GetObjects().Last());
+        }
+    }
+    if (DraggedObject == GameObject)
+    {
+        // Gone before it was placed, so there is nothing to record
+        DraggedObject = nullptr;
+        bIsDraggingObject = false;
+    }
+
+    if (UEditorChangeHub* ChangeHub = UEditorChangeHub::Get(this))
+    {
+        ChangeHub->NotifyRemoved(GameObject);
+    }
+}
+
+void AEditorPlayerController::OnGameObjectRenamed(ATruGameObject* GameObject)
+{
+    if (UEditorChangeHub* ChangeHub = UEditorChangeHub::Get(this))
+    {
+        ChangeHub->NotifyRenamed(GameObject);
+    }
+}
+
+void AEditorPlayerController::OnGameObjectReparented(ATruGameObject* GameObject)
+{
+    if (UEditorChangeHub* ChangeHub = UEditorChangeHub::Get(this))
+    {
+        ChangeHub->NotifyReparented(GameObject);
+    }
+}
+
+void AEditorPlayerController::OnGameObjectDemoted(ATruGameObject* GameObject, FTruObjectId Id)
+{
+    if (UEditorChangeHub* ChangeHub = UEditorChangeHub::Get(this))
+    {
+        ChangeHub->NotifyDemoted(GameObject, Id);
+    }
+}
+
+void AEditorPlayerController::OnGameObjectPromoted(ATruGameObject* GameObject, FTruObjectId Id)
+{
+    if (UEditorChangeHub* ChangeHub = UEditorChangeHub::Get(this))
+    {
+        ChangeHub->NotifyPromoted(GameObject, Id);
+    }
+}
+
+ATruGameObject* AEditorPlayerController::PromoteEntity(FTruObjectId EntityId)
+{
+    UTruEntityStore* EntityStore = UTruEntityStore::Get(this);
+    return EntityStore && EntityId.IsValid() ? EntityStore->Promote(EntityId) : nullptr;
+}
+
+ATruGameObject* AEditorPlayerController::OpenPrefabInstance(int32 Instance, int32 PartIndex)
+{
+    UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this);
+    TArray<ATruGameObject*> Parts;
+    if (!PrefabLibrary || !PrefabLibrary->OpenInstance(Instance, Parts))
+    {
+        return nullptr;
+    }
+    return Parts.IsValidIndex(PartIndex) ? Parts[PartIndex] : nullptr;
+}
+
+bool AEditorPlayerController::CanDemoteObjects() const
+{
+    return !TransactionLog.IsTransactionOpen() && !bIsDraggingObject && !ScatterBrush.IsPainting() && !ScatterBrush.IsBusy();
+}
+
+void AEditorPlayerController::EditorChangeStats()
+{
+    UEditorChangeHub* ChangeHub = UEditorChangeHub::Get(this);
+    if (!ChangeHub)
+    {
+        return;
+    }
+
+    TArray<UEditorChangeHub::FSubscriberStats> Stats;
+    ChangeHub->GetSubscriberStats(Stats);
+    for (const UEditorChangeHub::FSubscriberStats& SubscriberStats : Stats)
+    {
+        const FString Message = FString::Printf(TEXT("%s: %lld notifications, %lld updates, %lld merged"),
+            *SubscriberStats.Name.ToString(), SubscriberStats.NotificationsReceived, SubscriberStats.Flushes, SubscriberStats.GetMerged());
+        UE_LOG(LogTemp, Log, TEXT("%s"), *Message);
+        GEngine->AddOnScreenDebugMessage(-1, 10.0f, FColor::Cyan, Message);
+    }
+}
+
+void AEditorPlayerController::SetSelected(ATruGameObject* GameObject)
+{
+    Selection.Empty();
+    Selection.Add(GameObject);
+    OnSelectionChanged(GameObject);
+}
+
+void AEditorPlayerController::SetSelection(TConstArrayView<ATruGameObject*> GameObjects)
+{
+    Selection.Empty();
+    ATruGameObject* NewPrimary = nullptr;
+    for (ATruGameObject* GameObject : GameObjects)
+    {
+        if (Selection.Add(GameObject))
+        {
+            NewPrimary = GameObject;
+        }
+    }
+    OnSelectionChanged(NewPrimary);
+}
+
+void AEditorPlayerController::AddToSelection(ATruGameObject* GameObject)
+{
+    if (Selection.Add(GameObject))
+    {
+        OnSelectionChanged(GameObject);
+    }
+}
+
+void AEditorPlayerController::RemoveFromSelection(ATruGameObject* GameObject)
+{
+    if (Selection.Remove(GameObject))
+    {
+        OnSelectionChanged(CurrentSelected != GameObject ? CurrentSelected : Selection.IsEmpty() ? nullptr : Selection.GetObjects().Last());
+    }
+}
+
+void AEditorPlayerController::AddToSelection(TConstArrayView<ATruGameObject*> GameObjects)
+{
+    ATruGameObject* NewPrimary = CurrentSelected;
+    for (ATruGameObject* GameObject : GameObjects)
+    {
+        if (Selection.Add(GameObject))
+        {
+            NewPrimary = GameObject;
+        }
+    }
+    OnSelectionChanged(NewPrimary);
+}
+
+void AEditorPlayerController::RemoveFromSelection(TConstArrayView<ATruGameObject*> GameObjects)
+{
+    for (ATruGameObject* GameObject : GameObjects)
+    {
+        Selection.Remove(GameObject);
+    }
+    OnSelectionChanged(IsSelected(CurrentSelected) ? CurrentSelected : Selection.IsEmpty() ? nullptr : Selection.GetObjects().Last());
+}
+
+void AEditorPlayerController::ToggleSelected(ATruGameObject* GameObject)
+{
+    if (IsSelected(GameObject))
+    {
+        RemoveFromSelection(GameObject);
+    }
+    else
+    {
+        AddToSelection(GameObject);
+    }
+}
+
+void AEditorPlayerController::OnSelectionChanged(ATruGameObject* NewPrimary)
+{
+    // Only the primary object leaves its instance batch; the rest of a large selection keeps rendering instanced
+    if (CurrentSelected && CurrentSelected != NewPrimary)
+    {
+        CurrentSelected->OnDeselected();
+    }
+
+    CurrentSelected = NewPrimary;
+    if (CurrentSelected)
+    {
+        CurrentSelected->OnSelected();
+    }
+
+    OnObjectSelected.Broadcast(CurrentSelected);
+    if (UEditorChangeHub* ChangeHub = UEditorChangeHub::Get(this))
+    {
+        ChangeHub->NotifySelectionChanged();
+    }
+    bCheckOpenPrefabs = true;
+}
+
+bool AEditorPlayerController::DragObject()
+{
+    if (bIsDraggingObject && DraggedObject)
+    {
+        FVector WorldOrigin;
+        FVector WorldDirection;
+        FVector2D MousePosition;
+
+        if (GetMousePosition(MousePosition.X, MousePosition.Y))
+        {
+            if (DeprojectScreenPositionToWorld(MousePosition.X, MousePosition.Y, WorldOrigin, WorldDirection))
+            {
+                FVector NewLocation = WorldOrigin + WorldDirection * 10000.0f;
+                FVector StartLocation = WorldOrigin;
+            
+                FTruSceneHit Hit;
+                if (TraceEditorScene(StartLocation, NewLocation, Hit, { DraggedObject, Arrows }))
+                {
+                    NewLocation = FEditorSnapping::SnapSurfaceLocationToGrid(Hit.Location, Hit.Normal);
+                }
+                
+                DraggedObject->SetActorLocation(NewLocation);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+void AEditorPlayerController::PlayerTick(float DeltaTime)
+{
+    Super::PlayerTick(DeltaTime);
+
+    if (UTruSpawnQueue* SpawnQueue = UTruSpawnQueue::Get(this); SpawnQueue && SpawnQueue->IsBusy())
+    {
+        // Keyed message so it is replaced every frame instead of stacking up
+        static const uint64 SpawnProgressMessageKey = GetTypeHash(TEXT("TruSpawnProgress"));
+        GEngine->AddOnScreenDebugMessage(SpawnProgressMessageKey, 0.f, FColor::Yellow,
+            FString::Printf(TEXT("Spawning... %d%% (%d left)"), FMath::RoundToInt(SpawnQueue->GetProgress() * 100.f), SpawnQueue->GetNumPending()));
+    }
+
+    // Not from OnSelectionChanged, which runs in the middle of edits that still hold on to the parts
+    if (bCheckOpenPrefabs && CanDemoteObjects() && !bIsDragging)
+    {
+        bCheckOpenPrefabs = false;
+        CloseUnselectedPrefabs();
+    }
+
+    if (UpdateScatterBrush())
+        return;
+
+    if (DragObject())
+        return;
+
+    UpdateMarquee();
+    
+    FVector2D MousePosition;
+    if (!GetMousePosition(MousePosition.X, MousePosition.Y))
+    {
+        return;
+    }
+
+    FVector WorldOrigin;
+    FVector WorldDirection;
+
+    if (!DeprojectScreenPositionToWorld(MousePosition.X, MousePosition.Y, WorldOrigin, WorldDirection))
+    {
+        return;
+    }
+
+    UPrimitiveComponent* HitComponent = nullptr;
+    if (Arrows)
+    {
+        HitComponent = Arrows->HitTestArrows(WorldOrigin, WorldDirection, 10000.0);
+    }
+
+    // Handle cursor over and end events
+    if (CurrentHoveredComponent != HitComponent)
+    {
+        if (CurrentHoveredComponent)
+        {
+            Arrows->OnCursorEnd(CurrentHoveredComponent);
+        }
+        if (HitComponent)
+        {
+            Arrows->OnCursorOver(HitComponent);
+        }
+        CurrentHoveredComponent = HitComponent;
+    }
+
+    // Handle dragging logic
+    if (bIsMouseDown)
+    {
+        if (HitComponent && !bIsDragging && !Marquee.bActive)
+        {
+            Arrows->OnArrowClicked(HitComponent, EKeys::LeftMouseButton);
+            bIsDragging = true;
+        }
+    }
+    else
+    {
+        if (bIsDragging)
+        {
+            Arrows->OnArrowReleased(CurrentHoveredComponent, EKeys::LeftMouseButton);
+            bIsDragging = false;
+        }
+    }
+}
+
+
+bool AEditorPlayerController::TraceEditorScene(const FVector& Start, const FVector& End, FTruSceneHit& OutHit, TConstArrayView<const AActor*> IgnoredActors) const
+{
+    const bool bHit = TraceObjects(Start, End, OutHit, IgnoredActors);
+
+    // Entities have no collision and are not in the scene BVH; the store answers for them
+    FTruSceneHit EntityHit;
+    UTruEntityStore* EntityStore = UTruEntityStore::Get(this);
+    if (EntityStore && EntityStore->Raycast(Start, End, EntityHit) && (!bHit || EntityHit.Distance < OutHit.Distance))
+    {
+        OutHit = EntityHit;
+        return true;
+    }
+
+    // So are closed prefab instances; the library picks their parts
+    FTruSceneHit PrefabHit;
+    UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this);
+    if (PrefabLibrary && PrefabLibrary->Raycast(Start, End, PrefabHit) && (!bHit || PrefabHit.Distance < OutHit.Distance))
+    {
+        OutHit = PrefabHit;
+        return true;
+    }
+    return bHit;
+}
+
+bool AEditorPlayerController::TraceObjects(const FVector& Start, const FVector& End, FTruSceneHit& OutHit, TConstArrayView<const AActor*> IgnoredActors) const
+{
+    if (UTruSceneBVH* SceneBVH = UTruSceneBVH::Get(this); SceneBVH && UTruSceneBVH::IsEnabled())
+    {
+        return SceneBVH->Raycast(Start, End, OutHit, IgnoredActors);
+    }
+
+    FHitResult HitResult;
+    FCollisionQueryParams CollisionParams;
+    for (const AActor* IgnoredActor : IgnoredActors)
+    {
+        CollisionParams.AddIgnoredActor(IgnoredActor);
+    }
+    if (!GetWorld()->LineTraceSingleByChannel(HitResult, Start, End, ECC_Visibility, CollisionParams))
+    {
+        return false;
+    }
+
+    // Idle objects are drawn through instance batches, so resolve the hit instance back to its object
+    UTruInstancedRenderer* InstancedRenderer = UTruInstancedRenderer::Get(this);
+    OutHit.GameObject = InstancedRenderer ? InstancedRenderer->GetGameObjectFromHit(HitResult) : Cast<ATruGameObject>(HitResult.GetActor());
+    OutHit.Component = HitResult.GetComponent();
+    OutHit.Distance = HitResult.Distance;
+    OutHit.Location = HitResult.Location;
+    OutHit.Normal = HitResult.ImpactNormal;
+    return true;
+}
+
+bool AEditorPlayerController::UpdateScatterBrush()
+{
+    if (!bCanScatter && !ScatterBrush.IsPainting() && !ScatterBrush.IsBusy())
+    {
+        ScatterBrushDecal->SetVisibility(false);
+        return false;
+    }
+
+    FVector2D MousePosition;
+    FVector WorldOrigin;
+    FVector WorldDirection;
+    FTruSceneHit Hit;
+    const bool bHit = GetMousePosition(MousePosition.X, MousePosition.Y)
+        && DeprojectScreenPositionToWorld(MousePosition.X, MousePosition.Y, WorldOrigin, WorldDirection)
+        && TraceEditorScene(WorldOrigin, WorldOrigin + WorldDirection * 10000.0f, Hit, { GetPawn(), Arrows });
+
+    const bool bShowBrush = bCanScatter || ScatterBrush.IsPainting();
+    if (!bShowBrush)
+    {
+        ScatterBrushDecal->SetVisibility(false);
+    }
+    ScatterBrush.Tick(this, bHit ? &Hit : nullptr, bShowBrush ? ScatterBrushDecal : nullptr);
+    return ScatterBrush.IsPainting();
+}
+
+void AEditorPlayerController::UpdateMarquee()
+{
+    if (!Marquee.bActive)
+    {
+        return;
+    }
+
+    GetMousePosition(Marquee.End.X, Marquee.End.Y);
+    if (EditorUI && Marquee.IsDragged())
+    {
+        EditorUI->SetMarquee(Marquee.GetRect());
+    }
+}
+
+void AEditorPlayerController::ApplyMarquee()
+{
+    UpdateMarquee();
+    const bool bDragged = Marquee.IsDragged();
+    Marquee.Reset();
+    if (EditorUI)
+    {
+        EditorUI->ClearMarquee();
+    }
+
+    // A plain click has already been handled on mouse down
+    if (!bDragged)
+    {
+        return;
+    }
+
+    const double StartTime = FPlatformTime::Seconds();
+    TArray<ATruGameObject*> FoundObjects;
+    TArray<FTruObjectId> FoundEntities;
+    FEditorMarquee::FindObjectsInRect(this, Marquee.GetRect(), FoundObjects, &FoundEntities);
+
+    // Entities are never selected, so only selecting needs them as objects
+    if (Marquee.Mode != EEditorMarqueeMode::Subtract)
+    {
+        for (const FTruObjectId EntityId : FoundEntities)
+        {
+            if (ATruGameObject* Promoted = PromoteEntity(EntityId))
+            {
+                FoundObjects.Add(Promoted);
+            }
+        }
+    }
+
+    switch (Marquee.Mode)
+    {
+    case EEditorMarqueeMode::Replace:
+        SetSelection(FoundObjects);
+        break;
+    case EEditorMarqueeMode::Add:
+        AddToSelection(FoundObjects);
+        break;
+    case EEditorMarqueeMode::Subtract:
+        RemoveFromSelection(FoundObjects);
+        break;
+    }
+
+    UE_LOG(LogTemp, Verbose, TEXT("Marquee matched %d objects in %.2f ms"), FoundObjects.Num(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+void AEditorPlayerController::DeleteSelected()
+{
+    if (Selection.IsEmpty() || bIsDraggingObject || IsWaitingForSpawns())
+    {
+        return;
+    }
+
+    // Attached objects go with their parent. Children come first so undo, which runs backwards, recreates parents first.
+    TArray<ATruGameObject*> TopLevelObjects;
+    Selection.GetTopLevelObjects(TopLevelObjects);
+
+    TArray<TPair<int32, ATruGameObject*>> ObjectsByDepth;
+    TArray<AActor*> Descendants;
+    for (ATruGameObject* TopLevelObject : TopLevelObjects)
+    {
+        ObjectsByDepth.Emplace(0, TopLevelObject);
+
+        TopLevelObject->GetAttachedActors(Descendants, /*bResetArray*/ true, /*bRecursivelyIncludeAttachedActors*/ true);
+        for (AActor* Descendant : Descendants)
+        {
+            if (ATruGameObject* DescendantObject = Cast<ATruGameObject>(Descendant))
+            {
+                int32 Depth = 0;
+                for (ATruGameObject* Parent = DescendantObject->GetParentGameObject(); Parent && Parent != TopLevelObject; Parent = Parent->GetParentGameObject())
+                {
+                    ++Depth;
+                }
+                ObjectsByDepth.Emplace(Depth + 1, DescendantObject);
+            }
+        }
+    }
+    Algo::StableSortBy(ObjectsByDepth, [](const TPair<int32, ATruGameObject*>& Entry) { return -Entry.Key; });
+
+    const double StartTime = FPlatformTime::Seconds();
+
+    TransactionLog.BeginTransaction(TEXT("Delete"));
+    for (const TPair<int32, ATruGameObject*>& Entry : ObjectsByDepth)
+    {
+        TransactionLog.RecordDestroyed(Entry.Value);
+    }
+    TransactionLog.EndTransaction();
+
+    // Cleared up front so removing the objects one by one does not promote (and un-instance) each next primary
+    SetSelected(nullptr);
+    for (const TPair<int32, ATruGameObject*>& Entry : ObjectsByDepth)
+    {
+        UTruGameObjectPool::DestroyGameObject(Entry.Value);
+    }
+
+    UE_LOG(LogTemp, Log, TEXT("Deleted %d objects in %.2f ms"), ObjectsByDepth.Num(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+void AEditorPlayerController::BenchmarkObjectPool(int32 NumObjects)
+{
+    UTruGameObjectPool* Pool = UTruGameObjectPool::Get(this);
+    if (!Pool || NumObjects <= 0)
+    {
+        return;
+    }
+
+    FTruPoolBenchmark Result;
+    Pool->RunBenchmark(NumObjects, Result);
+
+    const FString Message = FString::Printf(TEXT("%d objects: SpawnActor %.1f ms, Destroy %.1f ms | pool spawn %.1f ms, pool delete %.1f ms"),
+        Result.NumObjects, Result.SpawnActorMs, Result.DestroyMs, Result.PoolSpawnMs, Result.PoolReleaseMs);
+    UE_LOG(LogTemp, Log, TEXT("%s"), *Message);
+    GEngine->AddOnScreenDebugMessage(-1, 15.0f, FColor::Cyan, Message);
+}
+
+void AEditorPlayerController::BenchmarkSpatialIndex(int32 NumQueries)
+{
+    UTruSpatialIndex* SpatialIndex = UTruSpatialIndex::Get(this);
+    if (!SpatialIndex || NumQueries <= 0)
+    {
+        return;
+    }
+
+    for (const int32 NumObjects : { 1000, 10000, 100000 })
+    {
+        FTruSpatialBenchmark Result;
+        SpatialIndex->RunBenchmark(NumObjects, NumQueries, Result);
+
+        const FString Message = FString::Printf(TEXT("%d objects, %d queries each: octree box %.1f / sphere %.1f / nearest %.1f ms | actor scan box %.1f / sphere %.1f / nearest %.1f ms"),
+            Result.NumObjects, Result.NumQueries, Result.OctreeBoxMs, Result.OctreeSphereMs, Result.OctreeNearestMs,
+            Result.ActorScanBoxMs, Result.ActorScanSphereMs, Result.ActorScanNearestMs);
+        UE_LOG(LogTemp, Log, TEXT("%s"), *Message);
+        GEngine->AddOnScreenDebugMessage(-1, 30.0f, FColor::Cyan, Message);
+    }
+}
+
+void AEditorPlayerController::BenchmarkAutosave(int32 NumDirty)
+{
+    UTruAutosave* TruAutosave = UTruAutosave::Get(this);
+    UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(this);
+    if (!TruAutosave || !ObjectRegistry || NumDirty <= 0)
+    {
+        return;
+    }
+
+    // Live objects and entity store records alike; pooled actors have no id and are never listed
+    TArray<FTruObjectId> Ids;
+    ObjectRegistry->GetIds(Ids, NumDirty);
+    for (const FTruObjectId Id : Ids)
+    {
+        TruAutosave->MarkDirty(Id);
+    }
+
+    // The objects dirty before the benchmark are included, so the count can exceed NumDirty
+    if (!TruAutosave->AutosaveNow())
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 10.0f, FColor::Yellow, TEXT("No objects to autosave; spawn some first"));
+        return;
+    }
+
+    const FString Message = FString::Printf(TEXT("Autosave of %d dirty objects: %.3f ms on the game thread"), TruAutosave->GetLastNumObjects(), TruAutosave->GetLastSnapshotMs());
+    UE_LOG(LogTemp, Log, TEXT("%s"), *Message);
+    GEngine->AddOnScreenDebugMessage(-1, 30.0f, FColor::Cyan, Message);
+}
+
+void AEditorPlayerController::BenchmarkEntityStore(int32 MaxActors)
+{
+    UTruEntityStore* EntityStore = UTruEntityStore::Get(this);
+    if (!EntityStore)
+    {
+        return;
+    }
+
+    for (const int32 NumEntities : { 10000, 100000, 1000000 })
+    {
+        FTruEntityBenchmark Result;
+        EntityStore->RunBenchmark(NumEntities, MaxActors, Result);
+
+        FString Message = FString::Printf(TEXT("%d entities (%d demoted in %.1f ms): GC %.1f ms, resident +%.1f MB (store %.1f MB)"),
+            Result.NumEntities, Result.NumDemoted, Result.DemoteMs, Result.EntityGCMs, Result.EntityResidentBytes / (1024.0 * 1024.0),
+            Result.EntityStoreBytes / (1024.0 * 1024.0));
+        if (Result.ActorGCMs >= 0.0)
+        {
+            Message += FString::Printf(TEXT(" | as actors: GC %.1f ms, resident +%.1f MB"), Result.ActorGCMs, Result.ActorResidentBytes / (1024.0 * 1024.0));
+        }
+        else
+        {
+            Message += TEXT(" | as actors: skipped");
+        }
+        UE_LOG(LogTemp, Log, TEXT("%s"), *Message);
+        GEngine->AddOnScreenDebugMessage(-1, 30.0f, FColor::Cyan, Message);
+    }
+}
+
+void AEditorPlayerController::CopyObject()
+{
+    if (Selection.IsEmpty())
+    {
+        return;
+    }
+
+    TArray<ATruGameObject*> TopLevelObjects;
+    Selection.GetTopLevelObjects(TopLevelObjects);
+
+    const int32 NumCopied = FEditorClipboard::Write(TopLevelObjects, ClipboardBytes);
+    FEditorClipboard::CopyToPlatform(ClipboardBytes);
+    GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Green, FString::Printf(TEXT("Copied %d objects"), NumCopied));
+}
+
+void AEditorPlayerController::PasteObject()
+{
+    // The platform clipboard may hold objects copied in another session; the local buffer covers platforms without one
+    TArray<uint8> Bytes;
+    if (!FEditorClipboard::PasteFromPlatform(Bytes))
+    {
+        Bytes = ClipboardBytes;
+    }
+
+    TArray<FTruSpawnRequest> Requests;
+    UTruSpawnQueue* SpawnQueue = UTruSpawnQueue::Get(this);
+    if (!SpawnQueue || Bytes.IsEmpty() || !FEditorClipboard::MakeSpawnRequests(MoveTemp(Bytes), Requests) || Requests.IsEmpty())
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Red, TEXT("No Object to Paste!"));
+        return;
+    }
+
+    for (FTruSpawnRequest& Request : Requests)
+    {
+        Request.Name = FName(*GenerateUniqueName(Request.Name.ToString()));
+    }
+
+    // Spawning is spread over frames by the queue instead of happening inside the input handler
+    TWeakObjectPtr<AEditorPlayerController> WeakThis(this);
+    SpawnQueue->EnqueueBatch(MoveTemp(Requests), this, [WeakThis](const TArray<ATruGameObject*>& Spawned, bool bCancelled)
+    {
+        if (WeakThis.IsValid() && Spawned.Num() > 0)
+        {
+            FEditorTransactionLog& TransactionLog = WeakThis->GetTransactionLog();
+            TransactionLog.BeginTransaction(TEXT("Paste"));
+            for (ATruGameObject* PastedObject : Spawned)
+            {
+                TransactionLog.RecordCreated(PastedObject);
+            }
+            TransactionLog.EndTransaction();
+
+            WeakThis->SetSelection(Spawned);
+            GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Green, FString::Printf(TEXT("Pasted %d objects"), Spawned.Num()));
+        }
+    }, ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn);
 }
 
-void AEditorPlayerController::BeginPlay()
+FString AEditorPlayerController::GenerateUniqueName(const FString& BaseName)
 {
-    Super::BeginPlay();
-
-    EditorUI = CreateWidget<UEditorUI>(this, EditorUIClass);
-    EditorUI->AddToViewport();
-    
-    CurrentSelected = GetWorld()->SpawnActor<ATruGameObject>();
-    CurrentSelected->SetActorLocation(GetPawn()->GetActorLocation());
-
-    Arrows = GetWorld()->SpawnActor<AMoveArrows>(MoveArrowsClass);
+    if (UTruNameRegistry* NameRegistry = UTruNameRegistry::Get(this))
+    {
+        return NameRegistry->MakeUniqueName(BaseName);
+    }
+    return BaseName;
 }
 
-void AEditorPlayerController::OnGameObjectsRefreshed()
+void AEditorPlayerController::SaveScene(const FString& SceneName)
 {
-    if(EditorUI)
-        EditorUI->Refresh();
+    const FString Filename = FTruSceneFile::ResolveScenePath(SceneName);
+    if (FTruSceneFile::SaveWorld(GetWorld(), Filename))
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Green, FString::Printf(TEXT("Scene saved to %s"), *Filename));
+    }
+    else
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Red, FString::Printf(TEXT("Could not save scene to %s"), *Filename));
+    }
 }
 
-void AEditorPlayerController::SetSelected(ATruGameObject* GameObject)
+void AEditorPlayerController::LoadScene(const FString& SceneName)
 {
-    Arrows->SetVisibility(GameObject != nullptr);
-    CurrentSelected = GameObject;
+    const FString Filename = FTruSceneFile::ResolveScenePath(SceneName);
 
-    OnObjectSelected.Broadcast(GameObject);
-    if (EditorUI)
+    FTruSceneFileReader Reader;
+    FString Error;
+    if (!UTruSpawnQueue::Get(this) || !Reader.Open(Filename, &Error))
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Red, FString::Printf(TEXT("Could not load %s: %s"), *Filename, *Error));
+        return;
+    }
+
+    SpawnScene(Reader, Filename);
+}
+
+void AEditorPlayerController::Autosave()
+{
+    UTruAutosave* TruAutosave = UTruAutosave::Get(this);
+    if (!TruAutosave || !TruAutosave->AutosaveNow())
     {
-        EditorUI->OnSelectedObject(GameObject);
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Yellow, TEXT("Nothing changed since the last autosave"));
+        return;
     }
+
+    GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Green, FString::Printf(TEXT("Autosaving %d objects (%.3f ms on the game thread)"),
+        TruAutosave->GetLastNumObjects(), TruAutosave->GetLastSnapshotMs()));
 }
 
+void AEditorPlayerController::RecoverAutosave()
+{
+    UTruAutosave* TruAutosave = UTruAutosave::Get(this);
+    FTruSceneFileReader Reader;
+    FString Error;
+    if (!TruAutosave || !UTruSpawnQueue::Get(this) || !TruAutosave->LoadAutosave(Reader, &Error))
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Red, FString::Printf(TEXT("Could not recover the autosave: %s"), *Error));
+        return;
+    }
 
-bool AEditorPlayerController::DragObject()
+    SpawnScene(Reader, UTruAutosave::GetSnapshotPath());
+}
+
+void AEditorPlayerController::ImportPlacements(const FString& Filename)
 {
-    if (bIsDraggingObject && DraggedObject)
+    const FString Path = FTruSceneFile::ResolveScenePath(Filename);
+
+    FString Error;
+    const bool bStarted = FTruPlacementImport::Start(GetWorld(), Path, this, [Path](const FTruPlacementImportStats& Stats)
     {
-        FVector WorldOrigin;
-        FVector WorldDirection;
-        FVector2D MousePosition;
+        UE_LOG(LogTemp, Log, TEXT("Imported %d of %d placements from %s over %.2f s: %d renamed, %d unknown classes, %d missing parents, %d unreadable rows%s"),
+            Stats.NumSpawned, Stats.NumRows, *Path, Stats.Seconds, Stats.NumRenamed, Stats.NumUnknownClasses, Stats.NumMissingParents, Stats.NumParseErrors,
+            Stats.bCancelled ? TEXT(" (cancelled)") : TEXT(""));
+        const bool bClean = !Stats.bCancelled && Stats.NumUnknownClasses == 0 && Stats.NumMissingParents == 0 && Stats.NumParseErrors == 0;
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, bClean ? FColor::Green : FColor::Yellow, FString::Printf(TEXT("Imported %d placements from %s"), Stats.NumSpawned, *Path));
+    }, &Error);
 
-        if (GetMousePosition(MousePosition.X, MousePosition.Y))
-        {
-            if (DeprojectScreenPositionToWorld(MousePosition.X, MousePosition.Y, WorldOrigin, WorldDirection))
-            {
-                FVector NewLocation = WorldOrigin + WorldDirection * 10000.0f;
-                FVector StartLocation = WorldOrigin;
-            
-                FHitResult HitResult;
-                FCollisionQueryParams CollisionParams;
-                CollisionParams.AddIgnoredActor(DraggedObject);
-                CollisionParams.AddIgnoredActor(Arrows);
-            
-                if (GetWorld()->LineTraceSingleByChannel(HitResult, StartLocation, NewLocation, ECC_Visibility, CollisionParams))
-                {
-                    NewLocation = HitResult.Location;
-                }
-                
-                DraggedObject->SetActorLocation(NewLocation);
-            }
-        }
-        return true;
+    if (!bStarted)
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Red, FString::Printf(TEXT("Could not import %s: %s"), *Path, *Error));
     }
-    return false;
 }
 
-void AEditorPlayerController::PlayerTick(float DeltaTime)
+void AEditorPlayerController::ExportPlacements(const FString& Filename)
 {
-    Super::PlayerTick(DeltaTime);
+    const FString Path = FTruSceneFile::ResolveScenePath(Filename);
 
-    if (DragObject())
+    FString Error;
+    const int32 NumRows = FTruPlacementImport::Export(GetWorld(), Path, &Error);
+    if (NumRows == INDEX_NONE)
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Red, FString::Printf(TEXT("Could not export to %s: %s"), *Path, *Error));
         return;
-    
-    FVector2D MousePosition;
-    if (!GetMousePosition(MousePosition.X, MousePosition.Y))
+    }
+
+    GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Green, FString::Printf(TEXT("Exported %d placements to %s"), NumRows, *Path));
+}
+
+void AEditorPlayerController::CreatePrefab(const FString& PrefabName)
+{
+    UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this);
+    if (!PrefabLibrary || Selection.IsEmpty() || PrefabName.IsEmpty())
     {
         return;
     }
 
-    FVector WorldOrigin;
-    FVector WorldDirection;
+    // Attached objects are captured with their parent; the root keeps the primary selection's placement without its scale
+    TArray<ATruGameObject*> TopLevelObjects;
+    Selection.GetTopLevelObjects(TopLevelObjects);
+    const ATruGameObject* Primary = CurrentSelected ? CurrentSelected : TopLevelObjects.Last();
+    const FTransform Root(Primary->GetActorQuat(), Primary->GetActorLocation());
 
-    if (!DeprojectScreenPositionToWorld(MousePosition.X, MousePosition.Y, WorldOrigin, WorldDirection))
+    FString Error;
+    if (PrefabLibrary->CreateDefinition(FName(*PrefabName), TopLevelObjects, Root, &Error) == INDEX_NONE)
     {
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Red, FString::Printf(TEXT("Could not create prefab %s: %s"), *PrefabName, *Error));
         return;
     }
 
-    FVector Start = WorldOrigin;
-    FVector End = Start + WorldDirection * 10000.0f;
+    GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Green, FString::Printf(TEXT("Saved prefab %s to %s"), *PrefabName, *UTruPrefabLibrary::GetPrefabPath(FName(*PrefabName))));
+}
+
+void AEditorPlayerController::PlacePrefab(const FString& PrefabName)
+{
+    UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this);
+    if (!PrefabLibrary || PrefabName.IsEmpty())
+    {
+        return;
+    }
 
-    FHitResult HitResult;
-    bool bHit = false;
-    UPrimitiveComponent* HitComponent = nullptr;
+    FString Error;
+    const int32 Definition = PrefabLibrary->FindOrLoadDefinition(FName(*PrefabName), &Error);
+    if (Definition == INDEX_NONE)
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Red, FString::Printf(TEXT("Could not load prefab %s: %s"), *PrefabName, *Error));
+        return;
+    }
 
-    if (Arrows)
+    FVector Location = FVector::ZeroVector;
+    FVector WorldOrigin;
+    FVector WorldDirection;
+    FVector2D MousePosition;
+    if (GetMousePosition(MousePosition.X, MousePosition.Y) && DeprojectScreenPositionToWorld(MousePosition.X, MousePosition.Y, WorldOrigin, WorldDirection))
+    {
+        FTruSceneHit Hit;
+        Location = TraceEditorScene(WorldOrigin, WorldOrigin + WorldDirection * 10000.0f, Hit, { GetPawn() }) ? Hit.Location : WorldOrigin + WorldDirection * 1000.0f;
+    }
+    else if (const APawn* EditorPawn = GetPawn())
     {
-        TArray<UPrimitiveComponent*> ComponentsToTrace = { Arrows->GetForwardArrow(), Arrows->GetUpArrow(), Arrows->GetRightArrow() };
+        Location = EditorPawn->GetActorLocation() + EditorPawn->GetActorForwardVector() * 1000.0f;
+    }
 
-        FCollisionQueryParams TraceParams(FName(TEXT("ArrowsTrace")), true, this);
-        TraceParams.bReturnPhysicalMaterial = false;
-        TraceParams.bTraceComplex = true;
-        TraceParams.AddIgnoredActor(GetPawn()); // Ignore the player pawn
+    TransactionLog.BeginTransaction(TEXT("Place prefab"));
+    TransactionLog.RecordPrefabInstanceCreated(PrefabLibrary, PrefabLibrary->AddInstance(Definition, FTransform(Location)));
+    TransactionLog.EndTransaction();
+}
 
-        for (UPrimitiveComponent* Component : ComponentsToTrace)
-        {
-            if (Component)
-            {
-                FHitResult ComponentHitResult;
-                bHit = Component->LineTraceComponent(ComponentHitResult, Start, End, TraceParams);
-                if (bHit)
-                {
-                    HitResult = ComponentHitResult;
-                    HitComponent = Component;
-                    break;
-                }
-            }
-        }
+void AEditorPlayerController::ApplyPrefab()
+{
+    UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this);
+    if (!PrefabLibrary || bIsDraggingObject)
+    {
+        return;
     }
 
-    // Handle cursor over and end events
-    if (CurrentHoveredComponent != HitComponent)
+    int32 Instance = PrefabLibrary->FindOpenInstance(CurrentSelected);
+    if (Instance == INDEX_NONE)
     {
-        if (CurrentHoveredComponent)
-        {
-            Arrows->OnCursorEnd(CurrentHoveredComponent);
-        }
-        if (HitComponent)
+        TArray<int32> OpenInstances;
+        PrefabLibrary->GetOpenInstances(OpenInstances);
+        if (OpenInstances.Num() != 1)
         {
-            Arrows->OnCursorOver(HitComponent);
+            GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Yellow, TEXT("Select a part of the prefab instance to apply"));
+            return;
         }
-        CurrentHoveredComponent = HitComponent;
+        Instance = OpenInstances[0];
     }
 
-    // Handle dragging logic
-    if (bIsMouseDown)
+    // The parts are destroyed when the instance closes
+    SetSelected(nullptr);
+
+    FString Error;
+    if (!PrefabLibrary->ApplyInstance(Instance, &Error))
     {
-        if (HitComponent && !bIsDragging)
-        {
-            Arrows->OnArrowClicked(HitComponent, EKeys::LeftMouseButton);
-            bIsDragging = true;
-        }
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Red, FString::Printf(TEXT("Could not apply the prefab: %s"), *Error));
+        return;
     }
-    else
+
+    GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Green, FString::Printf(TEXT("Applied the prefab to its instances in %.2f ms"), PrefabLibrary->GetLastUpdateMs()));
+}
+
+void AEditorPlayerController::ClosePrefabs()
+{
+    UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this);
+    if (!PrefabLibrary || bIsDraggingObject)
     {
-        if (bIsDragging)
-        {
-            Arrows->OnArrowReleased(CurrentHoveredComponent, EKeys::LeftMouseButton);
-            bIsDragging = false;
-        }
+        return;
+    }
+
+    TArray<int32> OpenInstances;
+    PrefabLibrary->GetOpenInstances(OpenInstances);
+    if (OpenInstances.IsEmpty())
+    {
+        return;
+    }
+
+    SetSelected(nullptr);
+    for (const int32 Instance : OpenInstances)
+    {
+        ClosePrefabInstance(PrefabLibrary, Instance);
     }
 }
 
+void AEditorPlayerController::DeletePrefab()
+{
+    UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this);
+    const int32 Instance = FindTargetPrefabInstance();
+    if (!PrefabLibrary || bIsDraggingObject || Instance == INDEX_NONE)
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Yellow, TEXT("Point at a prefab instance or select a part of one"));
+        return;
+    }
+
+    // Its open parts go with it
+    if (PrefabLibrary->IsInstanceOpen(Instance))
+    {
+        SetSelected(nullptr);
+    }
+
+    TransactionLog.BeginTransaction(TEXT("Delete prefab"));
+    TransactionLog.RecordPrefabInstanceDestroyed(PrefabLibrary, Instance);
+    TransactionLog.EndTransaction();
+    PrefabLibrary->RemoveInstance(Instance);
+}
 
-void AEditorPlayerController::CopyObject()
+void AEditorPlayerController::MovePrefab(float X, float Y, float Z)
 {
-    if (CurrentSelected)
+    UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this);
+    const int32 Instance = FindTargetPrefabInstance();
+    if (!PrefabLibrary || bIsDraggingObject || Instance == INDEX_NONE)
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Yellow, TEXT("Point at a prefab instance or select a part of one"));
+        return;
+    }
+
+    // Moving closes an open instance, which destroys its parts
+    if (PrefabLibrary->IsInstanceOpen(Instance))
     {
-        CopiedObject = CurrentSelected; // Store the selected object
-        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Green, TEXT("Object Copied!"));
+        SetSelected(nullptr);
     }
+
+    FTransform Transform = PrefabLibrary->FindInstance(Instance)->GetTransform();
+    Transform.AddToTranslation(FVector(X, Y, Z));
+
+    TransactionLog.BeginTransaction(TEXT("Move prefab"));
+    TransactionLog.ModifyPrefabInstance(PrefabLibrary, Instance);
+    PrefabLibrary->SetInstanceTransform(Instance, Transform);
+    TransactionLog.EndTransaction();
 }
 
-void AEditorPlayerController::PasteObject()
+void AEditorPlayerController::PrefabStats()
 {
-    if (CopiedObject)
+    const UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this);
+    if (!PrefabLibrary)
     {
-        FTransform CopyTransform = CopiedObject->GetActorTransform(); // Get transform of copied actor
-        FString NewName = GenerateUniqueName(CopiedObject->GetName());
+        return;
+    }
 
-        FActorSpawnParameters SpawnParams;
-        SpawnParams.Owner = this;
-        SpawnParams.Instigator = GetPawn();
-        SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
-        SpawnParams.NameMode = FActorSpawnParameters::ESpawnActorNameMode::Requested;
-        SpawnParams.Name = FName(*NewName); // Use the generated unique name
+    const FString Stats = FString::Printf(TEXT("%d prefabs, %d instances of %d bytes, %d overrides, %.1f KB; last apply took %.2f ms"),
+        PrefabLibrary->GetNumDefinitions(), PrefabLibrary->GetNumInstances(), (int32)sizeof(FTruPrefabInstance), PrefabLibrary->GetNumOverrides(),
+        PrefabLibrary->GetAllocatedSize() / 1024.0, PrefabLibrary->GetLastUpdateMs());
+    UE_LOG(LogTemp, Log, TEXT("%s"), *Stats);
+    GEngine->AddOnScreenDebugMessage(-1, 10.0f, FColor::Cyan, Stats);
+}
 
-        ATruGameObject* PastedObject = GetWorld()->SpawnActor<ATruGameObject>(CopiedObject->GetClass(), CopyTransform, SpawnParams);
+int32 AEditorPlayerController::FindTargetPrefabInstance() const
+{
+    const UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this);
+    if (!PrefabLibrary)
+    {
+        return INDEX_NONE;
+    }
 
-        if (PastedObject)
+    for (const ATruGameObject* GameObject : Selection.GetObjects())
+    {
+        const int32 Instance = PrefabLibrary->FindOpenInstance(GameObject);
+        if (Instance != INDEX_NONE)
         {
-            SetSelected(PastedObject); // Set the pasted object as selected
-            GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Green, FString::Printf(TEXT("Object Pasted with name: %s"), *NewName));
+            return Instance;
         }
     }
-    else
+
+    FVector WorldOrigin;
+    FVector WorldDirection;
+    FVector2D MousePosition;
+    FTruSceneHit Hit;
+    if (GetMousePosition(MousePosition.X, MousePosition.Y) && DeprojectScreenPositionToWorld(MousePosition.X, MousePosition.Y, WorldOrigin, WorldDirection)
+        && TraceEditorScene(WorldOrigin, WorldOrigin + WorldDirection * 10000.0f, Hit, { GetPawn() }))
     {
-        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Red, TEXT("No Object to Paste!"));
+        return Hit.PrefabInstance;
     }
+    return INDEX_NONE;
 }
 
-FString AEditorPlayerController::GenerateUniqueName(const FString& BaseName)
+void AEditorPlayerController::ClosePrefabInstance(UTruPrefabLibrary* PrefabLibrary, int32 Instance)
 {
-    int32 Suffix = 0;
-    FString NewName = BaseName;
+    PrefabLibrary->CloseInstance(Instance);
+    if (PrefabLibrary->IsInstanceEmpty(Instance))
+    {
+        TransactionLog.BeginTransaction(TEXT("Delete prefab"));
+        TransactionLog.RecordPrefabInstanceDestroyed(PrefabLibrary, Instance);
+        TransactionLog.EndTransaction();
+        PrefabLibrary->RemoveInstance(Instance);
+    }
+}
 
-    bool bNameExists = true;
-    while (bNameExists)
+void AEditorPlayerController::CloseUnselectedPrefabs()
+{
+    UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this);
+    TArray<int32> OpenInstances;
+    if (PrefabLibrary)
+    {
+        PrefabLibrary->GetOpenInstances(OpenInstances);
+    }
+    if (OpenInstances.IsEmpty())
     {
-        bNameExists = false;
-        NewName = FString::Printf(TEXT("%s (%d)"), *BaseName, Suffix++);
+        return;
+    }
 
-        for (TActorIterator<ATruGameObject> It(GetWorld()); It; ++It)
+    // Objects attached to a part since it was opened keep its instance open too
+    TSet<int32> SelectedInstances;
+    for (const ATruGameObject* GameObject : Selection.GetObjects())
+    {
+        for (const ATruGameObject* Ancestor = GameObject; Ancestor; Ancestor = Ancestor->GetParentGameObject())
         {
-            if (It->GetName() == NewName)
+            const int32 Instance = PrefabLibrary->FindOpenInstance(Ancestor);
+            if (Instance != INDEX_NONE)
             {
-                bNameExists = true;
+                SelectedInstances.Add(Instance);
                 break;
             }
         }
     }
 
-    return NewName;
+    for (const int32 Instance : OpenInstances)
+    {
+        if (!SelectedInstances.Contains(Instance))
+        {
+            ClosePrefabInstance(PrefabLibrary, Instance);
+        }
+    }
+}
+
+void AEditorPlayerController::SpawnScene(const FTruSceneFileReader& Reader, const FString& Source)
+{
+    UTruSpawnQueue* SpawnQueue = UTruSpawnQueue::Get(this);
+    if (!SpawnQueue)
+    {
+        return;
+    }
+
+    // Instances are records rather than actors, so they are placed right away
+    if (UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this))
+    {
+        PrefabLibrary->ReadInstances(Reader);
+    }
+
+    TArray<FTruSpawnRequest> Requests;
+    FTruSceneFile::MakeSpawnRequests(Reader, Requests);
+
+    const double StartTime = FPlatformTime::Seconds();
+    SpawnQueue->EnqueueBatch(MoveTemp(Requests), this, [Source, StartTime](const TArray<ATruGameObject*>& Spawned, bool bCancelled)
+    {
+        UE_LOG(LogTemp, Log, TEXT("Loaded %d objects from %s over %.2f s%s"), Spawned.Num(), *Source, FPlatformTime::Seconds() - StartTime, bCancelled ? TEXT(" (cancelled)") : TEXT(""));
+        GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Green, FString::Printf(TEXT("Loaded %d objects from %s"), Spawned.Num(), *Source));
+    });
+}
+
+void AEditorPlayerController::CancelSpawning()
+{
+    if (UTruSpawnQueue* SpawnQueue = UTruSpawnQueue::Get(this))
+    {
+        SpawnQueue->CancelAll();
+    }
 }
 
 void AEditorPlayerController::SetupInputComponent()
@@ -245,9 +1159,14 @@ void AEditorPlayerController::SetupInputComponent()
 
     InputComponent->BindKey(EKeys::C, IE_Pressed, this, &AEditorPlayerController::DragginSpawn);
     InputComponent->BindKey(EKeys::C, IE_Released, this, &AEditorPlayerController::DragginDespawn);
+    InputComponent->BindKey(EKeys::B, IE_Pressed, this, &AEditorPlayerController::ScatterBrushOn);
+    InputComponent->BindKey(EKeys::B, IE_Released, this, &AEditorPlayerController::ScatterBrushOff);
 
     InputComponent->BindKey(EKeys::C, IE_Pressed, this, &AEditorPlayerController::OnCopyPressed);
     InputComponent->BindKey(EKeys::V, IE_Pressed, this, &AEditorPlayerController::OnPastePressed);
+    InputComponent->BindKey(EKeys::Z, IE_Pressed, this, &AEditorPlayerController::OnUndoPressed);
+    InputComponent->BindKey(EKeys::Y, IE_Pressed, this, &AEditorPlayerController::OnRedoPressed);
+    InputComponent->BindKey(EKeys::Delete, IE_Pressed, this, &AEditorPlayerController::DeleteSelected);
 }
 
 void AEditorPlayerController::OnCopyPressed()
@@ -265,9 +1184,66 @@ void AEditorPlayerController::OnPastePressed()
         PasteObject();
     }
 }
+void AEditorPlayerController::OnUndoPressed()
+{
+    if (IsInputKeyDown(EKeys::LeftControl) || IsInputKeyDown(EKeys::RightControl))
+    {
+        Undo();
+    }
+}
+
+void AEditorPlayerController::OnRedoPressed()
+{
+    if (IsInputKeyDown(EKeys::LeftControl) || IsInputKeyDown(EKeys::RightControl))
+    {
+        Redo();
+    }
+}
+
+bool AEditorPlayerController::IsWaitingForSpawns() const
+{
+    const UTruSpawnQueue* SpawnQueue = UTruSpawnQueue::Get(this);
+    if (!SpawnQueue || !SpawnQueue->IsBusy())
+    {
+        return false;
+    }
+    GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Yellow, TEXT("Wait for spawning to finish, or CancelSpawning"));
+    return true;
+}
+
+void AEditorPlayerController::Undo()
+{
+    if (IsWaitingForSpawns())
+    {
+        return;
+    }
+    if (!TransactionLog.Undo(GetWorld()))
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, TEXT("Nothing to Undo!"));
+    }
+}
+
+void AEditorPlayerController::Redo()
+{
+    if (IsWaitingForSpawns())
+    {
+        return;
+    }
+    if (!TransactionLog.Redo(GetWorld()))
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, TEXT("Nothing to Redo!"));
+    }
+}
+
 void AEditorPlayerController::OnLeftMouseDown()
 {
     bIsMouseDown = true;
+
+    if (!bIsDraggingObject && bCanScatter)
+    {
+        ScatterBrush.BeginStroke(this);
+        return;
+    }
     
     if (!bIsDraggingObject && bCanSpawn)
     {
@@ -281,17 +1257,14 @@ void AEditorPlayerController::OnLeftMouseDown()
             {
                 FVector TtSpawnLocation = WorldOrigin + WorldDirection * 1000.0f;
                 
-                FHitResult HitResult;
+                FTruSceneHit Hit;
                 FVector TraceEnd = WorldOrigin + WorldDirection * 1000.0f;
                 
-                FCollisionQueryParams CollisionParams;
-                CollisionParams.AddIgnoredActor(this->GetPawn());
-                
-                bool bHit = GetWorld()->LineTraceSingleByChannel(HitResult, WorldOrigin, TraceEnd, ECC_Visibility, CollisionParams);
+                bool bHit = TraceEditorScene(WorldOrigin, TraceEnd, Hit, { GetPawn() });
                 
                 if (bHit) 
                 {
-                    TtSpawnLocation = HitResult.Location;
+                    TtSpawnLocation = Hit.Location;
                 }
                 
                 FActorSpawnParameters SpawnParams;
@@ -299,10 +1272,11 @@ void AEditorPlayerController::OnLeftMouseDown()
                 SpawnParams.Instigator = GetPawn();
                 SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
 
-                DraggedObject = GetWorld()->SpawnActor<ATruGameObject>(ATruGameObject::StaticClass(), TtSpawnLocation, FRotator::ZeroRotator, SpawnParams);
+                DraggedObject = UTruGameObjectPool::SpawnGameObject(GetWorld(), ATruGameObject::StaticClass(), FTransform(TtSpawnLocation), SpawnParams);
 
                 if (DraggedObject)
                 {
+                    // Recorded on mouse up, once the placement drag has settled where the object goes
                     SetSelected(DraggedObject);
                     bIsDraggingObject = true;
                 }
@@ -311,6 +1285,16 @@ void AEditorPlayerController::OnLeftMouseDown()
         return;
     }
 
+    // A press on a hovered arrow belongs to the gizmo; it never picks, deselects or starts a marquee
+    if (CurrentHoveredComponent)
+    {
+        return;
+    }
+
+    // Shift+click adds an object to the selection or takes it out again
+    const bool bExtendSelection = IsInputKeyDown(EKeys::LeftShift) || IsInputKeyDown(EKeys::RightShift);
+    const bool bSubtractSelection = IsInputKeyDown(EKeys::LeftControl) || IsInputKeyDown(EKeys::RightControl);
+
     FVector WorldOrigin;
     FVector WorldDirection;
     FVector2D MousePosition;
@@ -321,18 +1305,42 @@ void AEditorPlayerController::OnLeftMouseDown()
             FVector NewLocation = WorldOrigin + WorldDirection * 10000.0f;
             FVector StartLocation = WorldOrigin;
             
-            FHitResult HitResult;
-            FCollisionQueryParams CollisionParams;
-            if (GetWorld()->LineTraceSingleByChannel(HitResult, StartLocation, NewLocation, ECC_Visibility, CollisionParams))
+            // The gizmo is not part of the BVH, so a hit here is always level content or a game object
+            FTruSceneHit Hit;
+            if (TraceEditorScene(StartLocation, NewLocation, Hit))
             {
-                ATruGameObject* TruGameObject = Cast<ATruGameObject>(HitResult.GetActor());
-                if(TruGameObject && HitResult.GetActor() != Arrows)
-                    SetSelected(TruGameObject);
+                ATruGameObject* TruGameObject = Hit.GameObject;
+                if (TruGameObject || Hit.EntityId.IsValid() || Hit.PrefabInstance != INDEX_NONE)
+                {
+                    // A picked entity becomes an object again for as long as it stays selected
+                    if (!TruGameObject && Hit.EntityId.IsValid())
+                    {
+                        TruGameObject = PromoteEntity(Hit.EntityId);
+                    }
+                    // A picked prefab instance is opened and the part under the cursor selected
+                    else if (!TruGameObject)
+                    {
+                        TruGameObject = OpenPrefabInstance(Hit.PrefabInstance, Hit.PrefabPart);
+                    }
+                    if (!TruGameObject)
+                    {
+                        return;
+                    }
+
+                    if (bExtendSelection)
+                        ToggleSelected(TruGameObject);
+                    else
+                        SetSelected(TruGameObject);
+                    return;
+                }
             }
-            else
+            else if (!bExtendSelection && !bSubtractSelection)
             {
                 SetSelected(nullptr);
             }
+
+            // Pressing on empty space (or the floor) starts a rectangle selection
+            Marquee.Begin(MousePosition, bExtendSelection ? EEditorMarqueeMode::Add : bSubtractSelection ? EEditorMarqueeMode::Subtract : EEditorMarqueeMode::Replace);
         }
     }
 }
@@ -340,6 +1348,18 @@ void AEditorPlayerController::OnLeftMouseDown()
 void AEditorPlayerController::OnLeftMouseUp()
 {
     bIsMouseDown = false;
+    ScatterBrush.EndStroke();
+    if (Marquee.bActive)
+    {
+        ApplyMarquee();
+    }
+    // The placement is one undo step that creates the object where the drag left it
+    if (bIsDraggingObject && DraggedObject)
+    {
+        TransactionLog.BeginTransaction(TEXT("Place"));
+        TransactionLog.RecordCreated(DraggedObject);
+        TransactionLog.EndTransaction();
+    }
     bIsDraggingObject = false;
     DraggedObject = nullptr;
 }
\ No newline at end of file
@@ -2,10 +2,18 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/PlayerController.h"
+#include "EditorMarquee.h"
+#include "EditorScatterBrush.h"
+#include "EditorSelection.h"
+#include "EditorTransactionLog.h"
 #include "EditorPlayerController.generated.h"
 
 class AMoveArrows;
 class ATruGameObject;
+class UMaterialInterface;
+class UTruPrefabLibrary;
+class FTruSceneFileReader;
+struct FTruSceneHit;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnObjectSelected, ATruGameObject*, SelectedObject);
 
@@ -18,6 +26,7 @@ public:
 	AEditorPlayerController();
 
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void PlayerTick(float DeltaTime) override;
 	virtual void SetupInputComponent() override;
 	void OnCopyPressed();
@@ -25,42 +34,167 @@ public:
 	UPROPERTY(EditAnywhere) TSubclassOf<AMoveArrows> MoveArrowsClass;
 	UPROPERTY(EditAnywhere) TSubclassOf<class UEditorUI> EditorUIClass;
 	UPROPERTY() TObjectPtr<UEditorUI> EditorUI;
+	/** Primary selection: the most recently selected object. The gizmo still moves the whole selection. */
 	UFUNCTION(BlueprintCallable) ATruGameObject* GetSelectedObject() const;
+	UFUNCTION(BlueprintCallable) int32 GetNumSelected() const { return Selection.Num(); }
+	UFUNCTION(BlueprintCallable) bool IsSelected(const ATruGameObject* GameObject) const { return Selection.Contains(GameObject); }
+	const FEditorSelection& GetSelection() const { return Selection; }
 	UFUNCTION(BlueprintCallable) AMoveArrows* GetArrows() const;
 
+	/** Full outliner rebuild; only needed when the incremental events below cannot describe the change. */
 	void OnGameObjectsRefreshed();
-
+	// Forwarded to the change hub and delivered to the outliner and gizmo once per frame
+	void OnGameObjectAdded(ATruGameObject* GameObject);
+	void OnGameObjectRemoved(ATruGameObject* GameObject);
+	void OnGameObjectReparented(ATruGameObject* GameObject);
+	void OnGameObjectRenamed(ATruGameObject* GameObject);
+	// From the entity store: the object became entity Id, or entity Id became the object
+	void OnGameObjectDemoted(ATruGameObject* GameObject, FTruObjectId Id);
+	/** Any object's root moved; a selected one moves the gizmo pivot. */
+	void OnGameObjectMoved(const ATruGameObject* GameObject) { Selection.MarkMoved(GameObject); }
+	void OnGameObjectPromoted(ATruGameObject* GameObject, FTruObjectId Id);
+
+	/** Turns an entity store record back into an object so it can be selected or edited. Null if there is no such entity. */
+	ATruGameObject* PromoteEntity(FTruObjectId EntityId);
+	/** Opens a prefab instance so its parts can be edited as objects, and returns the part at PartIndex. It is closed again once nothing of it is selected. */
+	ATruGameObject* OpenPrefabInstance(int32 Instance, int32 PartIndex);
+	/** False while an edit holds on to object pointers (open transaction, placement drag, brush stroke). */
+	bool CanDemoteObjects() const;
+	/** Selected or being placed: the object has to stay an actor. */
+	bool IsEditing(const ATruGameObject* GameObject) const { return Selection.Contains(GameObject) || DraggedObject == GameObject; }
+
+	/** Replaces the selection with GameObject, or clears it when null. */
 	void SetSelected(ATruGameObject* GameObject);
+	void SetSelection(TConstArrayView<ATruGameObject*> GameObjects);
+	void AddToSelection(ATruGameObject* GameObject);
+	void RemoveFromSelection(ATruGameObject* GameObject);
+	// Bulk variants notify listeners once for the whole array
+	void AddToSelection(TConstArrayView<ATruGameObject*> GameObjects);
+	void RemoveFromSelection(TConstArrayView<ATruGameObject*> GameObjects);
+	void ToggleSelected(ATruGameObject* GameObject);
 	bool DragObject();
 	
-	// New Copy and Paste methods
+	/** Copies the selection and everything attached to it, to the platform clipboard as well as locally. */
 	UFUNCTION(BlueprintCallable) void CopyObject();
+	/** Pastes the clipboard through the spawn queue and selects the pasted objects once they all exist. */
 	UFUNCTION(BlueprintCallable) void PasteObject();
 	FString GenerateUniqueName(const FString& BaseName);
 
+	// Scene files. A bare name is resolved to Saved/Scenes/<Name>.truscene; loading adds to the current level.
+	UFUNCTION(Exec, BlueprintCallable) void SaveScene(const FString& SceneName);
+	UFUNCTION(Exec, BlueprintCallable) void LoadScene(const FString& SceneName);
+	/** Writes the objects changed since the last autosave now instead of waiting for tru.AutosaveInterval. */
+	UFUNCTION(Exec, BlueprintCallable) void Autosave();
+	/** Adds the last autosave (snapshot plus journal) to the level. Before this session's first autosave that is the previous session's. */
+	UFUNCTION(Exec, BlueprintCallable) void RecoverAutosave();
+	/** Streams a .jsonl or .csv placement file into the level through the spawn queue; a relative name is under Saved/Scenes. */
+	UFUNCTION(Exec, BlueprintCallable) void ImportPlacements(const FString& Filename);
+	/** Writes every object, entity and prefab instance part to a .jsonl or .csv placement file. */
+	UFUNCTION(Exec, BlueprintCallable) void ExportPlacements(const FString& Filename);
+	/** Saves the selection and everything attached to it as Saved/Prefabs/<Name>.truprefab, rooted at the primary selection. The objects stay. */
+	UFUNCTION(Exec, BlueprintCallable) void CreatePrefab(const FString& PrefabName);
+	/** Places an instance of a saved prefab where the cursor points. */
+	UFUNCTION(Exec, BlueprintCallable) void PlacePrefab(const FString& PrefabName);
+	/** Makes the open prefab instance of the selected object (or the only open one) the prefab, updating all its instances. */
+	UFUNCTION(Exec, BlueprintCallable) void ApplyPrefab();
+	/** Closes every open prefab instance, keeping edits to them as overrides of that instance only. */
+	UFUNCTION(Exec, BlueprintCallable) void ClosePrefabs();
+	/** Deletes the open prefab instance of the selection, or else the one under the cursor, as one undo step. */
+	UFUNCTION(Exec, BlueprintCallable) void DeletePrefab();
+	/** Moves the same instance DeletePrefab would delete by X, Y, Z as one undo step, closing it if it is open. */
+	UFUNCTION(Exec, BlueprintCallable) void MovePrefab(float X, float Y, float Z);
+	/** Prints prefab and instance counts, the size of an instance record and the library's memory. */
+	UFUNCTION(Exec, BlueprintCallable) void PrefabStats();
+	/** Deletes the selected objects and everything attached to them as one undo step. */
+	UFUNCTION(Exec, BlueprintCallable) void DeleteSelected();
+	/** Spawns and deletes NumObjects through SpawnActor/Destroy and through the object pool, and prints both timings. */
+	UFUNCTION(Exec, BlueprintCallable) void BenchmarkObjectPool(int32 NumObjects = 10000);
+	/** Times octree queries against GetAllActorsOfClass plus a bounds filter at 1k, 10k and 100k objects. */
+	UFUNCTION(Exec, BlueprintCallable) void BenchmarkSpatialIndex(int32 NumQueries = 100);
+	/** Prints GC time and resident memory for 10k, 100k and 1M entities, and for as many actors up to MaxActors. */
+	UFUNCTION(Exec, BlueprintCallable) void BenchmarkEntityStore(int32 MaxActors = 100000);
+	/** Marks up to NumDirty objects changed and prints how long the autosave of them holds up the game thread. */
+	UFUNCTION(Exec, BlueprintCallable) void BenchmarkAutosave(int32 NumDirty = 1000);
+
+	/** Stops every queued spawn; objects that already exist stay. */
+	UFUNCTION(Exec, BlueprintCallable) void CancelSpawning();
+
+	/** Prints how many change notifications each subscriber received and how many updates they were merged into. */
+	UFUNCTION(Exec, BlueprintCallable) void EditorChangeStats();
+
+	UFUNCTION(Exec, BlueprintCallable) void Undo();
+	UFUNCTION(Exec, BlueprintCallable) void Redo();
+	FEditorTransactionLog& GetTransactionLog() { return TransactionLog; }
+
 	UPROPERTY(BlueprintAssignable, Category = "Selection")
 	FOnObjectSelected OnObjectSelected;
 private:
-	bool bIsDraggingObject;
-	ATruGameObject* DraggedObject;
-	ATruGameObject* CopiedObject;  // Holds the copied actor
+	FEditorTransactionLog TransactionLog;
+
+	bool bIsDraggingObject = false;
+	ATruGameObject* DraggedObject = nullptr;
+	TArray<uint8> ClipboardBytes;	// Last copy as a clipboard buffer, see FEditorClipboard
 
 	UPROPERTY() AMoveArrows* Arrows;
 	UPROPERTY() ATruGameObject* CurrentSelected;
+	FEditorSelection Selection;
+	/** Set when the selection changes; open prefab instances it has left are closed on the next tick. */
+	bool bCheckOpenPrefabs = false;
 	UPROPERTY() UPrimitiveComponent* CurrentHoveredComponent = nullptr;
 
 	// Mouse input flags
-	bool bIsMouseDown;
-	bool bIsDragging;
+	bool bIsMouseDown = false;
+	bool bIsDragging = false;
+
+	/** Picking and placement trace through the editor BVH, or through the physics scene when tru.BVHTraces is off. */
+	bool TraceEditorScene(const FVector& Start, const FVector& End, FTruSceneHit& OutHit, TConstArrayView<const AActor*> IgnoredActors = {}) const;
+	/** TraceEditorScene without entity store records and prefab instances. */
+	bool TraceObjects(const FVector& Start, const FVector& End, FTruSceneHit& OutHit, TConstArrayView<const AActor*> IgnoredActors = {}) const;
+
+	// Started by pressing the mouse over empty space, applied on release
+	FEditorMarquee Marquee;
+	void UpdateMarquee();
+	void ApplyMarquee();
+
+	/** The open prefab instance a selected object belongs to, or else the closed one under the cursor. */
+	int32 FindTargetPrefabInstance() const;
+	/** Closes an open prefab instance; one with none of its parts left is then deleted as its own undo step. */
+	void ClosePrefabInstance(UTruPrefabLibrary* PrefabLibrary, int32 Instance);
+	/** Closes the open prefab instances that no selected object belongs to, directly or through an ancestor. */
+	void CloseUnselectedPrefabs();
+
+	/** Moves the primary selection to NewPrimary and tells the gizmo, outliner and listeners that the selection changed. */
+	void OnSelectionChanged(ATruGameObject* NewPrimary);
+
+	/** True, with a message, while the spawn queue is filling in batches; deleting or undoing would pull objects out from under it. */
+	bool IsWaitingForSpawns() const;
+
+	/** Queues every object in Reader for spawning; Source names it in messages. */
+	void SpawnScene(const FTruSceneFileReader& Reader, const FString& Source);
 
 	void OnPastePressed();
+	void OnUndoPressed();
+	void OnRedoPressed();
 	// Input handlers
 	void OnLeftMouseDown();
 	void OnLeftMouseUp();
 
+	TArray<int32> ChangeSubscriberIds;
+
 	bool bCanSpawn;
 	void DragginSpawn() { bCanSpawn = true;}
 	void DragginDespawn() { bCanSpawn = false; }
+
+	// Holding B and dragging paints objects across the surfaces under the cursor
+	FEditorScatterBrush ScatterBrush;
+	/** Deferred decal material for the brush outline; a "BrushColor" vector parameter, if present, shows when it paints. */
+	UPROPERTY(EditAnywhere) UMaterialInterface* ScatterBrushMaterial = nullptr;
+	UPROPERTY() class UDecalComponent* ScatterBrushDecal = nullptr;
+	bool bCanScatter = false;
+	void ScatterBrushOn() { bCanScatter = true; }
+	void ScatterBrushOff() { bCanScatter = false; }
+	/** Feeds the brush the surface under the cursor; true while a stroke is being painted. */
+	bool UpdateScatterBrush();
 };
 
 FORCEINLINE ATruGameObject* AEditorPlayerController::GetSelectedObject() const
@@ -0,0 +1,475 @@
+#include "EditorScatterBrush.h"
+
+#include "EditorPlayerController.h"
+#include "Async/Async.h"
+#include "Components/DecalComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "truworld/GameObjects/TruGameObject.h"
+#include "truworld/GameObjects/TruSceneBVH.h"
+#include "truworld/GameObjects/TruSpawnQueue.h"
+
+static TAutoConsoleVariable<float> CVarTruScatterRadius(
+	TEXT("tru.ScatterRadius"),
+	500.0f,
+	TEXT("Radius of the scatter brush, in world units."));
+
+static TAutoConsoleVariable<float> CVarTruScatterDensity(
+	TEXT("tru.ScatterDensity"),
+	0.5f,
+	TEXT("Objects the scatter brush places per square metre of surface."));
+
+static TAutoConsoleVariable<int32> CVarTruScatterMaxPerStamp(
+	TEXT("tru.ScatterMaxPerStamp"),
+	1000,
+	TEXT("Most objects a single scatter brush stamp may place."));
+
+namespace EditorScatterBrush
+{
+	// Tries around an active point before it is retired, as in Bridson's algorithm
+	static constexpr int32 CandidatesPerPoint = 30;
+	// Poisson disk sampling ends up with roughly this many points per MinDistance squared of area
+	static constexpr double PackingDensity = 0.7;
+	// Background grid cells per side for each sqrt of the points it can hold, and the most it ever has
+	static constexpr int32 GridCellsPerPoint = 4;
+	static constexpr int32 MaxGridSize = 2048;
+	// How deep the brush decal projects on either side of the surface, in world units
+	static constexpr double DecalDepth = 50.0;
+}
+
+FIntVector FEditorScatterBrush::FStroke::ToCell(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt32(Location.X / MinDistance),
+		FMath::FloorToInt32(Location.Y / MinDistance),
+		FMath::FloorToInt32(Location.Z / MinDistance));
+}
+
+bool FEditorScatterBrush::FStroke::IsClear(const FVector& Location) const
+{
+	const FIntVector Cell = ToCell(Location);
+	for (int32 X = Cell.X - 1; X <= Cell.X + 1; ++X)
+	{
+		for (int32 Y = Cell.Y - 1; Y <= Cell.Y + 1; ++Y)
+		{
+			for (int32 Z = Cell.Z - 1; Z <= Cell.Z + 1; ++Z)
+			{
+				if (const TArray<int32>* Indices = PlacedCells.Find(FIntVector(X, Y, Z)))
+				{
+					for (const int32 Index : *Indices)
+					{
+						if (FVector::DistSquared(Placed[Index], Location) < FMath::Square(MinDistance))
+						{
+							return false;
+						}
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void FEditorScatterBrush::FStroke::AddPlaced(const FVector& Location)
+{
+	PlacedCells.FindOrAdd(ToCell(Location)).Add(Placed.Add(Location));
+}
+
+void FEditorScatterBrush::BeginStroke(AEditorPlayerController* Controller)
+{
+	EndStroke();
+
+	const double Density = FMath::Max(0.0001, (double)CVarTruScatterDensity.GetValueOnGameThread());
+
+	Stroke = MakeShared<FStroke>();
+	Stroke->Controller = Controller;
+	Stroke->Radius = FMath::Max(1.0, (double)CVarTruScatterRadius.GetValueOnGameThread());
+	// Density is per square metre, 100 x 100 world units
+	Stroke->MinDistance = FMath::Max(1.0, 100.0 * FMath::Sqrt(EditorScatterBrush::PackingDensity / Density));
+	Stroke->Random.Initialize(FPlatformTime::Cycles());
+}
+
+void FEditorScatterBrush::EndStroke()
+{
+	if (Stroke.IsValid())
+	{
+		Stroke->bEnded = true;
+		FinishStrokeIfDone(Stroke.ToSharedRef());
+		Stroke.Reset();
+	}
+}
+
+void FEditorScatterBrush::Tick(AEditorPlayerController* Controller, const FTruSceneHit* CursorHit, UDecalComponent* BrushDecal)
+{
+	UWorld* World = Controller ? Controller->GetWorld() : nullptr;
+	if (!World)
+	{
+		return;
+	}
+
+	UpdateBrushDecal(BrushDecal, CursorHit);
+
+	if (Stage == EStage::Sampling && SampleResult.IsReady())
+	{
+		StartTraces(World, SampleResult.Get());
+	}
+	if (Stage == EStage::Tracing)
+	{
+		FinishStamp(World);
+	}
+
+	// Stamps are spaced half a radius apart along the stroke
+	if (Stage == EStage::Idle && IsPainting() && CursorHit
+		&& (!Stroke->bHasStamped || FVector::DistSquared(Stroke->LastStampCenter, CursorHit->Location) >= FMath::Square(Stroke->Radius * 0.5)))
+	{
+		StartStamp(World, CursorHit->Location, CursorHit->Normal);
+	}
+}
+
+void FEditorScatterBrush::UpdateBrushDecal(UDecalComponent* BrushDecal, const FTruSceneHit* CursorHit) const
+{
+	if (!BrushDecal)
+	{
+		return;
+	}
+	if (!CursorHit)
+	{
+		BrushDecal->SetVisibility(false);
+		return;
+	}
+
+	// Decals project along their X axis, so X goes into the surface
+	const double Radius = IsPainting() ? Stroke->Radius : (double)CVarTruScatterRadius.GetValueOnGameThread();
+	BrushDecal->DecalSize = FVector(EditorScatterBrush::DecalDepth, Radius, Radius);
+	BrushDecal->SetWorldLocationAndRotation(CursorHit->Location, FRotationMatrix::MakeFromX(-CursorHit->Normal).Rotator());
+	BrushDecal->SetVisibility(true);
+
+	if (UMaterialInstanceDynamic* Material = Cast<UMaterialInstanceDynamic>(BrushDecal->GetDecalMaterial()))
+	{
+		Material->SetVectorParameterValue(TEXT("BrushColor"), IsPainting() ? FLinearColor::Green : FLinearColor::White);
+	}
+}
+
+void FEditorScatterBrush::StartStamp(UWorld* World, const FVector& Center, const FVector& Normal)
+{
+	StampStroke = Stroke;
+	StampStroke->bHasStamped = true;
+	StampStroke->LastStampCenter = Center;
+	++StampStroke->PendingStamps;
+
+	StampCenter = Center;
+	StampNormal = Normal.GetSafeNormal(UE_SMALL_NUMBER, FVector::UpVector);
+	StampNormal.FindBestAxisVectors(StampAxisX, StampAxisY);
+
+	// Earlier placements around the disc, flattened into it, so the new samples keep their distance from them
+	const double Radius = StampStroke->Radius;
+	const double MinDistance = StampStroke->MinDistance;
+	const double Reach = Radius + MinDistance;
+	TArray<FVector2D> Obstacles;
+	auto AddObstacles = [&](const TArray<int32>& Indices)
+	{
+		for (const int32 Index : Indices)
+		{
+			const FVector Offset = StampStroke->Placed[Index] - StampCenter;
+			if (Offset.SizeSquared() <= FMath::Square(Reach))
+			{
+				Obstacles.Emplace(Offset | StampAxisX, Offset | StampAxisY);
+			}
+		}
+	};
+
+	const FIntVector MinCell = StampStroke->ToCell(StampCenter - FVector(Reach));
+	const FIntVector MaxCell = StampStroke->ToCell(StampCenter + FVector(Reach));
+	const FIntVector Span = MaxCell - MinCell + FIntVector(1);
+	if ((int64)Span.X * Span.Y * Span.Z > StampStroke->PlacedCells.Num())
+	{
+		for (const TPair<FIntVector, TArray<int32>>& Cell : StampStroke->PlacedCells)
+		{
+			AddObstacles(Cell.Value);
+		}
+	}
+	else
+	{
+		for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+			{
+				for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+				{
+					if (const TArray<int32>* Indices = StampStroke->PlacedCells.Find(FIntVector(X, Y, Z)))
+					{
+						AddObstacles(*Indices);
+					}
+				}
+			}
+		}
+	}
+
+	const int32 MaxSamples = FMath::Max(1, CVarTruScatterMaxPerStamp.GetValueOnGameThread());
+	const int32 Seed = StampStroke->Random.RandHelper(MAX_int32);
+	SampleResult = Async(EAsyncExecution::ThreadPool, [Radius, MinDistance, Obstacles = MoveTemp(Obstacles), MaxSamples, Seed]()
+	{
+		return GeneratePoissonDisk(Radius, MinDistance, Obstacles, MaxSamples, Seed);
+	});
+	Stage = EStage::Sampling;
+}
+
+void FEditorScatterBrush::StartTraces(UWorld* World, const TArray<FVector2D>& Samples)
+{
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(TruScatterBrush), /*bTraceComplex*/ false);
+	if (AEditorPlayerController* Controller = StampStroke->Controller.Get())
+	{
+		Params.AddIgnoredActor(Controller->GetPawn());
+	}
+
+	// Only the level's surface: objects and their instance batches are world dynamic, and entities have no collision
+	const FCollisionObjectQueryParams ObjectParams(ECC_WorldStatic);
+
+	// Each sample is dropped onto the surface from one radius above the disc
+	const double Radius = StampStroke->Radius;
+	TraceHandles.Reset(Samples.Num());
+	for (const FVector2D& Sample : Samples)
+	{
+		const FVector Start = StampCenter + StampAxisX * Sample.X + StampAxisY * Sample.Y + StampNormal * Radius;
+		const FVector End = Start - StampNormal * (2.0 * Radius);
+		TraceHandles.Add(World->AsyncLineTraceByObjectType(EAsyncTraceType::Single, Start, End, ObjectParams, Params));
+	}
+
+	Stage = EStage::Tracing;
+	SampleResult.Reset();
+}
+
+void FEditorScatterBrush::FinishStamp(UWorld* World)
+{
+	// Results are only kept for a frame after they complete, so every trace is still valid or already done
+	for (const FTraceHandle& Handle : TraceHandles)
+	{
+		FTraceDatum Datum;
+		if (!World->QueryTraceData(Handle, Datum) && World->IsTraceHandleValid(Handle, /*bOverlapTrace*/ false))
+		{
+			return;
+		}
+	}
+
+	FStroke& StrokeState = *StampStroke;
+	TArray<FTruSpawnRequest> Requests;
+	int32 NumExpired = 0;
+	for (const FTraceHandle& Handle : TraceHandles)
+	{
+		FTraceDatum Datum;
+		if (!World->QueryTraceData(Handle, Datum))
+		{
+			++NumExpired;
+			continue;
+		}
+		if (Datum.OutHits.IsEmpty() || !Datum.OutHits[0].bBlockingHit)
+		{
+			continue;
+		}
+
+		// The drop onto an uneven surface can pull neighbours together; the stroke keeps the spacing in world space
+		const FVector Location = Datum.OutHits[0].ImpactPoint;
+		if (!StrokeState.IsClear(Location))
+		{
+			continue;
+		}
+		StrokeState.AddPlaced(Location);
+
+		FTruSpawnRequest& Request = Requests.AddDefaulted_GetRef();
+		Request.Class = ATruGameObject::StaticClass();
+		Request.Transform = FTransform(FRotator(0.0, StrokeState.Random.FRandRange(0.0, 360.0), 0.0), Location);
+	}
+	TraceHandles.Reset();
+
+	if (NumExpired > 0)
+	{
+		StrokeState.NumExpiredSamples += NumExpired;
+		UE_LOG(LogTemp, Warning, TEXT("Scatter brush lost %d samples whose traces expired before the stamp collected them"), NumExpired);
+	}
+
+	UTruSpawnQueue* SpawnQueue = UTruSpawnQueue::Get(World);
+	if (Requests.IsEmpty() || !SpawnQueue)
+	{
+		--StrokeState.PendingStamps;
+		FinishStrokeIfDone(StampStroke.ToSharedRef());
+	}
+	else
+	{
+		const TSharedRef<FStroke> BatchStroke = StampStroke.ToSharedRef();
+		SpawnQueue->EnqueueBatch(MoveTemp(Requests), StrokeState.Controller.Get(), [BatchStroke](const TArray<ATruGameObject*>& Spawned, bool bCancelled)
+		{
+			for (ATruGameObject* GameObject : Spawned)
+			{
+				BatchStroke->Spawned.Add(GameObject);
+			}
+			--BatchStroke->PendingStamps;
+			FinishStrokeIfDone(BatchStroke);
+		});
+	}
+
+	StampStroke.Reset();
+	Stage = EStage::Idle;
+}
+
+void FEditorScatterBrush::FinishStrokeIfDone(const TSharedRef<FStroke>& DoneStroke)
+{
+	if (!DoneStroke->bEnded || DoneStroke->PendingStamps > 0)
+	{
+		return;
+	}
+
+	TArray<ATruGameObject*> Spawned;
+	for (const TWeakObjectPtr<ATruGameObject>& GameObject : DoneStroke->Spawned)
+	{
+		if (GameObject.IsValid() && !GameObject->IsPooled())
+		{
+			Spawned.Add(GameObject.Get());
+		}
+	}
+	DoneStroke->Spawned.Reset();
+
+	AEditorPlayerController* Controller = DoneStroke->Controller.Get();
+	if (!Controller || Spawned.IsEmpty())
+	{
+		return;
+	}
+
+	FEditorTransactionLog& TransactionLog = Controller->GetTransactionLog();
+	TransactionLog.BeginTransaction(TEXT("Scatter"));
+	for (ATruGameObject* GameObject : Spawned)
+	{
+		TransactionLog.RecordCreated(GameObject);
+	}
+	TransactionLog.EndTransaction();
+
+	if (DoneStroke->NumExpiredSamples > 0)
+	{
+		GEngine->AddOnScreenDebugMessage(-1, 3.0f, FColor::Yellow, FString::Printf(TEXT("Scattered %d objects, %d samples lost to expired traces"),
+			Spawned.Num(), DoneStroke->NumExpiredSamples));
+	}
+	else
+	{
+		GEngine->AddOnScreenDebugMessage(-1, 3.0f, FColor::Green, FString::Printf(TEXT("Scattered %d objects"), Spawned.Num()));
+	}
+}
+
+TArray<FVector2D> FEditorScatterBrush::GeneratePoissonDisk(double Radius, double MinDistance, const TArray<FVector2D>& Obstacles, int32 MaxSamples, int32 Seed)
+{
+	TArray<FVector2D> Points;
+	if (Radius <= 0.0 || MinDistance <= 0.0 || MaxSamples <= 0)
+	{
+		return Points;
+	}
+
+	// Background grid over the disc plus the margin obstacles can reach in from. Cells are chained lists because
+	// obstacles flattened into the disc are not guaranteed to be MinDistance apart. A wide disc with dense spacing
+	// would need far more cells than MaxSamples can fill, so the grid is sized by the points it can hold instead,
+	// with cells larger than MinDistance / sqrt(2) holding more than one point.
+	const double GridExtent = 2.0 * (Radius + MinDistance);
+	const int64 MaxPoints = (int64)MaxSamples + Obstacles.Num();
+	const int32 GridSizeLimit = (int32)FMath::Min<int64>(EditorScatterBrush::MaxGridSize,
+		FMath::CeilToInt64(FMath::Sqrt((double)MaxPoints)) * EditorScatterBrush::GridCellsPerPoint);
+	const double MinCellSize = MinDistance / UE_SQRT_2;
+	const int32 GridSize = (int32)FMath::Clamp(FMath::CeilToDouble(GridExtent / MinCellSize), 1.0, (double)GridSizeLimit);
+	const double CellSize = FMath::Max(MinCellSize, GridExtent / GridSize);
+	const double GridMin = -(Radius + MinDistance);
+	TArray<int32> CellHeads;
+	CellHeads.Init(INDEX_NONE, GridSize * GridSize);
+	TArray<int32> NextInCell;
+	TArray<int32> Active;
+
+	auto ToCell = [GridMin, CellSize, GridSize](const FVector2D& Point, int32& OutX, int32& OutY)
+	{
+		OutX = FMath::Clamp(FMath::FloorToInt32((Point.X - GridMin) / CellSize), 0, GridSize - 1);
+		OutY = FMath::Clamp(FMath::FloorToInt32((Point.Y - GridMin) / CellSize), 0, GridSize - 1);
+	};
+
+	auto IsClear = [&](const FVector2D& Point)
+	{
+		int32 CellX;
+		int32 CellY;
+		ToCell(Point, CellX, CellY);
+		for (int32 Y = FMath::Max(0, CellY - 2); Y <= FMath::Min(GridSize - 1, CellY + 2); ++Y)
+		{
+			for (int32 X = FMath::Max(0, CellX - 2); X <= FMath::Min(GridSize - 1, CellX + 2); ++X)
+			{
+				for (int32 Index = CellHeads[Y * GridSize + X]; Index != INDEX_NONE; Index = NextInCell[Index])
+				{
+					if (FVector2D::DistSquared(Points[Index], Point) < FMath::Square(MinDistance))
+					{
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	};
+
+	auto AddPoint = [&](const FVector2D& Point)
+	{
+		int32 CellX;
+		int32 CellY;
+		ToCell(Point, CellX, CellY);
+		const int32 Index = Points.Add(Point);
+		NextInCell.Add(CellHeads[CellY * GridSize + CellX]);
+		CellHeads[CellY * GridSize + CellX] = Index;
+		Active.Add(Index);
+	};
+
+	// Obstacles grow the distribution outwards the same way new samples do, so overlapping stamps join up
+	for (const FVector2D& Obstacle : Obstacles)
+	{
+		if (Obstacle.SizeSquared() <= FMath::Square(Radius + MinDistance))
+		{
+			AddPoint(Obstacle);
+		}
+	}
+	const int32 NumObstacles = Points.Num();
+
+	FRandomStream Random(Seed);
+	auto RandomPointInDisc = [&Random, Radius]()
+	{
+		const double Distance = Radius * FMath::Sqrt(Random.FRand());
+		const double Angle = Random.FRandRange(0.0, UE_TWO_PI);
+		return FVector2D(FMath::Cos(Angle), FMath::Sin(Angle)) * Distance;
+	};
+
+	for (int32 Attempt = 0; Attempt < EditorScatterBrush::CandidatesPerPoint; ++Attempt)
+	{
+		const FVector2D Point = RandomPointInDisc();
+		if (IsClear(Point))
+		{
+			AddPoint(Point);
+			break;
+		}
+	}
+
+	while (Active.Num() > 0 && Points.Num() - NumObstacles < MaxSamples)
+	{
+		const int32 ActiveIndex = Random.RandHelper(Active.Num());
+		const FVector2D Origin = Points[Active[ActiveIndex]];
+
+		bool bFound = false;
+		for (int32 Attempt = 0; Attempt < EditorScatterBrush::CandidatesPerPoint && !bFound; ++Attempt)
+		{
+			const double Distance = Random.FRandRange(MinDistance, 2.0 * MinDistance);
+			const double Angle = Random.FRandRange(0.0, UE_TWO_PI);
+			const FVector2D Candidate = Origin + FVector2D(FMath::Cos(Angle), FMath::Sin(Angle)) * Distance;
+			if (Candidate.SizeSquared() <= FMath::Square(Radius) && IsClear(Candidate))
+			{
+				AddPoint(Candidate);
+				bFound = true;
+			}
+		}
+
+		if (!bFound)
+		{
+			Active.RemoveAtSwap(ActiveIndex, 1, EAllowShrinking::No);
+		}
+	}
+
+	Points.RemoveAt(0, NumObstacles, EAllowShrinking::No);
+	return Points;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "WorldCollision.h"
+
+class AEditorPlayerController;
+class ATruGameObject;
+class UDecalComponent;
+struct FTruSceneHit;
+
+/**
+ * Paints TruGameObjects across the surfaces under the cursor. Size and spacing come from tru.ScatterRadius and
+ * tru.ScatterDensity.
+ *
+ * A stroke is a series of stamps, one each time the cursor has moved half a radius. A stamp goes through three stages:
+ *  1. Poisson disk samples in the brush disc are generated on a worker thread, kept clear of the stroke's earlier
+ *     placements so overlapping stamps continue the same distribution instead of piling up.
+ *  2. Every sample is dropped onto the surface with an async line trace against world static geometry only, so
+ *     it lands on the level rather than on objects, scattered or not. All traces of a stamp are issued in one
+ *     frame and collected on a later one; samples whose results expired before collection are counted as lost.
+ *  3. The hits are spawned as one UTruSpawnQueue batch.
+ * One stamp is in flight at a time; stamps requested meanwhile collapse into the latest cursor position.
+ * The whole stroke is one undo step, recorded once its last batch has spawned.
+ */
+class TRUWORLD_API FEditorScatterBrush
+{
+public:
+	void BeginStroke(AEditorPlayerController* Controller);
+	void EndStroke();
+
+	bool IsPainting() const { return Stroke.IsValid() && !Stroke->bEnded; }
+	/** A stamp is still being sampled or traced; Tick has to keep being called. */
+	bool IsBusy() const { return Stage != EStage::Idle; }
+
+	/**
+	 * Advances the current stamp and starts the next one. CursorHit is the surface under the mouse, if any.
+	 * BrushDecal is projected onto it as the brush outline; pass null to hide it.
+	 */
+	void Tick(AEditorPlayerController* Controller, const FTruSceneHit* CursorHit, UDecalComponent* BrushDecal);
+
+	/** Poisson disk samples at least MinDistance apart inside a disc of Radius around the origin, avoiding Obstacles. */
+	static TArray<FVector2D> GeneratePoissonDisk(double Radius, double MinDistance, const TArray<FVector2D>& Obstacles, int32 MaxSamples, int32 Seed);
+
+private:
+	struct FStroke
+	{
+		TWeakObjectPtr<AEditorPlayerController> Controller;
+		double Radius = 0.0;
+		double MinDistance = 0.0;
+		FRandomStream Random;
+
+		// Every placement of the stroke, hashed by MinDistance cells for the spacing checks
+		TArray<FVector> Placed;
+		TMap<FIntVector, TArray<int32>> PlacedCells;
+
+		TArray<TWeakObjectPtr<ATruGameObject>> Spawned;
+		/** Samples dropped because their trace result was gone by the time the stamp collected it. */
+		int32 NumExpiredSamples = 0;
+		int32 PendingStamps = 0;
+		bool bEnded = false;
+		bool bHasStamped = false;
+		FVector LastStampCenter = FVector::ZeroVector;
+
+		FIntVector ToCell(const FVector& Location) const;
+		bool IsClear(const FVector& Location) const;
+		void AddPlaced(const FVector& Location);
+	};
+
+	enum class EStage : uint8
+	{
+		Idle,
+		Sampling,
+		Tracing
+	};
+
+	void StartStamp(UWorld* World, const FVector& Center, const FVector& Normal);
+	void StartTraces(UWorld* World, const TArray<FVector2D>& Samples);
+	void FinishStamp(UWorld* World);
+	void UpdateBrushDecal(UDecalComponent* BrushDecal, const FTruSceneHit* CursorHit) const;
+	static void FinishStrokeIfDone(const TSharedRef<FStroke>& DoneStroke);
+
+	TSharedPtr<FStroke> Stroke;
+
+	// The stamp in flight, which may belong to a stroke that has already ended
+	EStage Stage = EStage::Idle;
+	TSharedPtr<FStroke> StampStroke;
+	FVector StampCenter = FVector::ZeroVector;
+	FVector StampNormal = FVector::UpVector;
+	FVector StampAxisX = FVector::ForwardVector;
+	FVector StampAxisY = FVector::RightVector;
+	TFuture<TArray<FVector2D>> SampleResult;
+	TArray<FTraceHandle> TraceHandles;
+};
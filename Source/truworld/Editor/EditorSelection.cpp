@@ -0,0 +1,95 @@
+#include "EditorSelection.h"
+
+#include "truworld/GameObjects/TruGameObject.h"
+
+bool FEditorSelection::Add(ATruGameObject* GameObject)
+{
+	// Objects get their id in BeginPlay and lose it in the pool; neither kind can be selected
+	if (!GameObject || !GameObject->GetObjectId().IsValid() || Contains(GameObject))
+	{
+		return false;
+	}
+
+	Indices.Add(GameObject->GetObjectId(), Ids.Add(GameObject->GetObjectId()));
+	Objects.Add(GameObject);
+	bPivotDirty = true;
+	return true;
+}
+
+bool FEditorSelection::Remove(ATruGameObject* GameObject)
+{
+	int32 Index;
+	if (!GameObject || !Indices.RemoveAndCopyValue(GameObject->GetObjectId(), Index))
+	{
+		return false;
+	}
+
+	Ids.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Objects.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	if (Ids.IsValidIndex(Index))
+	{
+		Indices.Add(Ids[Index], Index);
+	}
+	bPivotDirty = true;
+	return true;
+}
+
+void FEditorSelection::Empty()
+{
+	Ids.Reset();
+	Objects.Reset();
+	Indices.Reset();
+	bPivotDirty = true;
+}
+
+bool FEditorSelection::Contains(const ATruGameObject* GameObject) const
+{
+	return GameObject && Indices.Contains(GameObject->GetObjectId());
+}
+
+FVector FEditorSelection::GetPivot() const
+{
+	if (!bPivotDirty)
+	{
+		return CachedPivot;
+	}
+
+	FVector Sum = FVector::ZeroVector;
+	for (const ATruGameObject* GameObject : Objects)
+	{
+		Sum += GameObject->GetActorLocation();
+	}
+	CachedPivot = Objects.IsEmpty() ? FVector::ZeroVector : Sum / Objects.Num();
+	bPivotDirty = false;
+	return CachedPivot;
+}
+
+void FEditorSelection::MarkMoved(const ATruGameObject* GameObject)
+{
+	if (!bPivotDirty && Contains(GameObject))
+	{
+		bPivotDirty = true;
+	}
+}
+
+void FEditorSelection::GetTopLevelObjects(TArray<ATruGameObject*>& OutObjects) const
+{
+	OutObjects.Reset(Objects.Num());
+	for (ATruGameObject* GameObject : Objects)
+	{
+		bool bHasSelectedAncestor = false;
+		for (ATruGameObject* Parent = GameObject->GetParentGameObject(); Parent; Parent = Parent->GetParentGameObject())
+		{
+			if (Contains(Parent))
+			{
+				bHasSelectedAncestor = true;
+				break;
+			}
+		}
+
+		if (!bHasSelectedAncestor)
+		{
+			OutObjects.Add(GameObject);
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "truworld/GameObjects/TruObjectRegistry.h"
+
+class ATruGameObject;
+
+/**
+ * Set of selected objects, keyed by their FTruObjectId so an actor the pool hands out again is never taken for the
+ * object that was selected. The objects sit in one contiguous array next to their ids so bulk operations can walk or
+ * split it directly. Membership tests and removals are O(1); removal swaps the last object into the freed slot.
+ */
+class TRUWORLD_API FEditorSelection
+{
+public:
+	bool Add(ATruGameObject* GameObject);
+	bool Remove(ATruGameObject* GameObject);
+	void Empty();
+
+	bool Contains(const ATruGameObject* GameObject) const;
+	bool Contains(FTruObjectId Id) const { return Indices.Contains(Id); }
+	int32 Num() const { return Ids.Num(); }
+	bool IsEmpty() const { return Ids.IsEmpty(); }
+	const TArray<FTruObjectId>& GetIds() const { return Ids; }
+	/** The selected objects, in the same order as GetIds(). */
+	const TArray<ATruGameObject*>& GetObjects() const { return Objects; }
+
+	/** Average location of the selected objects; the gizmo sits here. Cached until the selection changes or one of them moves. */
+	FVector GetPivot() const;
+	/** Called for every object that moved; only a selected one invalidates the pivot. */
+	void MarkMoved(const ATruGameObject* GameObject);
+
+	/** Selected objects that do not have a selected ancestor. Moving these moves the whole selection exactly once. */
+	void GetTopLevelObjects(TArray<ATruGameObject*>& OutObjects) const;
+
+private:
+	TArray<FTruObjectId> Ids;
+	TArray<ATruGameObject*> Objects;
+	TMap<FTruObjectId, int32> Indices;
+
+	mutable FVector CachedPivot = FVector::ZeroVector;
+	mutable bool bPivotDirty = false;
+};
@@ -0,0 +1,214 @@
+#include "EditorSnapping.h"
+
+#include "HAL/IConsoleManager.h"
+#include "truworld/GameObjects/TruGameObject.h"
+#include "truworld/GameObjects/TruSpatialHash.h"
+
+static TAutoConsoleVariable<bool> CVarTruSnapToGrid(
+	TEXT("tru.SnapToGrid"),
+	false,
+	TEXT("Snap gizmo drags and placement to the grid set by tru.GridSize, tru.RotationGridSize and tru.ScaleGridSize."));
+
+static TAutoConsoleVariable<float> CVarTruGridSize(
+	TEXT("tru.GridSize"),
+	10.0f,
+	TEXT("Translation grid increment, in world units."));
+
+static TAutoConsoleVariable<float> CVarTruRotationGridSize(
+	TEXT("tru.RotationGridSize"),
+	15.0f,
+	TEXT("Rotation grid increment, in degrees."));
+
+static TAutoConsoleVariable<float> CVarTruScaleGridSize(
+	TEXT("tru.ScaleGridSize"),
+	0.25f,
+	TEXT("Scale grid increment."));
+
+static TAutoConsoleVariable<bool> CVarTruSnapToObjects(
+	TEXT("tru.SnapToObjects"),
+	false,
+	TEXT("Snap the bounds of dragged objects to the bounds of nearby objects. Takes precedence over the grid."));
+
+static TAutoConsoleVariable<float> CVarTruSnapDistance(
+	TEXT("tru.SnapDistance"),
+	20.0f,
+	TEXT("How far along the drag axis a face or centre is pulled to line up with a nearby object, in world units."));
+
+static TAutoConsoleVariable<float> CVarTruSnapSearchRadius(
+	TEXT("tru.SnapSearchRadius"),
+	100.0f,
+	TEXT("How far around the dragged bounds other objects are considered for object snapping, in world units."));
+
+bool FEditorSnapping::IsGridEnabled()
+{
+	return CVarTruSnapToGrid.GetValueOnGameThread();
+}
+
+double FEditorSnapping::GetGridSize()
+{
+	return CVarTruGridSize.GetValueOnGameThread();
+}
+
+double FEditorSnapping::SnapToGrid(double Value, double GridSize)
+{
+	return GridSize > 0.0 ? FMath::RoundToDouble(Value / GridSize) * GridSize : Value;
+}
+
+FVector FEditorSnapping::SnapLocationToGrid(const FVector& Location, const FVector& AxisMask)
+{
+	if (!IsGridEnabled())
+	{
+		return Location;
+	}
+
+	const double GridSize = GetGridSize();
+	FVector Snapped = Location;
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		if (AxisMask[Axis] != 0.0)
+		{
+			Snapped[Axis] = SnapToGrid(Location[Axis], GridSize);
+		}
+	}
+	return Snapped;
+}
+
+FVector FEditorSnapping::SnapSurfaceLocationToGrid(const FVector& Location, const FVector& SurfaceNormal)
+{
+	const FVector AbsNormal = SurfaceNormal.GetAbs();
+	const int32 NormalAxis = AbsNormal.X >= AbsNormal.Y && AbsNormal.X >= AbsNormal.Z ? 0 : (AbsNormal.Y >= AbsNormal.Z ? 1 : 2);
+
+	FVector AxisMask = FVector::OneVector;
+	AxisMask[NormalAxis] = 0.0;
+	return SnapLocationToGrid(Location, AxisMask);
+}
+
+FRotator FEditorSnapping::SnapRotation(const FRotator& Rotation)
+{
+	if (!IsGridEnabled())
+	{
+		return Rotation;
+	}
+	return Rotation.GridSnap(FRotator(CVarTruRotationGridSize.GetValueOnGameThread()));
+}
+
+FVector FEditorSnapping::SnapScale(const FVector& Scale)
+{
+	if (!IsGridEnabled())
+	{
+		return Scale;
+	}
+
+	// A scale of zero cannot be dragged out of again
+	const double GridSize = CVarTruScaleGridSize.GetValueOnGameThread();
+	FVector Snapped;
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		const double Value = SnapToGrid(Scale[Axis], GridSize);
+		Snapped[Axis] = Value == 0.0 && GridSize > 0.0 ? FMath::Sign(Scale[Axis]) * GridSize : Value;
+	}
+	return Snapped;
+}
+
+void FEditorDragSnap::Begin(TConstArrayView<ATruGameObject*> DraggedObjects, const FVector& InPivot, const FVector& InAxis)
+{
+	Reset();
+	Pivot = InPivot;
+	Axis = InAxis.GetSafeNormal();
+
+	TArray<AActor*> AttachedActors;
+	for (ATruGameObject* GameObject : DraggedObjects)
+	{
+		Ignored.Add(GameObject);
+		StartBounds += GameObject->GetGameObjectBounds();
+
+		GameObject->GetAttachedActors(AttachedActors, /*bResetArray*/ true, /*bRecursivelyIncludeAttachedActors*/ true);
+		for (AActor* AttachedActor : AttachedActors)
+		{
+			if (const ATruGameObject* AttachedObject = Cast<ATruGameObject>(AttachedActor))
+			{
+				Ignored.Add(AttachedObject);
+				StartBounds += AttachedObject->GetGameObjectBounds();
+			}
+		}
+	}
+
+	if (StartBounds.IsValid)
+	{
+		ProjectOnAxis(StartBounds, StartMin, StartMax);
+		const double PivotOnAxis = Pivot | Axis;
+		StartMin -= PivotOnAxis;
+		StartMax -= PivotOnAxis;
+	}
+}
+
+void FEditorDragSnap::Reset()
+{
+	StartBounds = FBox(ForceInit);
+	StartMin = StartMax = 0.0;
+	Ignored.Reset();
+	Candidates.Reset();
+	CandidateBounds.Reset();
+}
+
+double FEditorDragSnap::Snap(const UObject* WorldContextObject, double Distance)
+{
+	const double PivotOnAxis = Pivot | Axis;
+
+	UTruSpatialHash* SpatialHash = UTruSpatialHash::Get(WorldContextObject);
+	if (CVarTruSnapToObjects.GetValueOnGameThread() && SpatialHash && StartBounds.IsValid)
+	{
+		const double SnapDistance = CVarTruSnapDistance.GetValueOnGameThread();
+		const FBox MovedBounds = StartBounds.ShiftBy(Axis * Distance);
+		SpatialHash->FindInBox(MovedBounds.ExpandBy(FMath::Max((double)CVarTruSnapSearchRadius.GetValueOnGameThread(), SnapDistance)),
+			Candidates, CandidateBounds, Ignored);
+
+		// Min face, centre and max face of the selection, and of every candidate, as positions on the axis
+		const double Features[3] = { StartMin, (StartMin + StartMax) * 0.5, StartMax };
+		double BestDistance = Distance;
+		double BestError = SnapDistance;
+		bool bSnapped = false;
+		for (const FBox& Bounds : CandidateBounds)
+		{
+			double TargetMin;
+			double TargetMax;
+			ProjectOnAxis(Bounds, TargetMin, TargetMax);
+			const double Targets[3] = { TargetMin - PivotOnAxis, (TargetMin + TargetMax) * 0.5 - PivotOnAxis, TargetMax - PivotOnAxis };
+
+			for (const double Target : Targets)
+			{
+				for (const double Feature : Features)
+				{
+					const double Candidate = Target - Feature;
+					const double Error = FMath::Abs(Candidate - Distance);
+					if (Error <= BestError)
+					{
+						BestError = Error;
+						BestDistance = Candidate;
+						bSnapped = true;
+					}
+				}
+			}
+		}
+
+		if (bSnapped)
+		{
+			return BestDistance;
+		}
+	}
+
+	if (FEditorSnapping::IsGridEnabled())
+	{
+		return FEditorSnapping::SnapToGrid(PivotOnAxis + Distance, FEditorSnapping::GetGridSize()) - PivotOnAxis;
+	}
+	return Distance;
+}
+
+void FEditorDragSnap::ProjectOnAxis(const FBox& Box, double& OutMin, double& OutMax) const
+{
+	const FVector Extent = Box.GetExtent();
+	const double Center = Box.GetCenter() | Axis;
+	const double Radius = FMath::Abs(Extent.X * Axis.X) + FMath::Abs(Extent.Y * Axis.Y) + FMath::Abs(Extent.Z * Axis.Z);
+	OutMin = Center - Radius;
+	OutMax = Center + Radius;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class ATruGameObject;
+
+/**
+ * Grid snapping for the gizmo and for placement. Increments and toggles are console variables:
+ * tru.SnapToGrid, tru.GridSize, tru.RotationGridSize and tru.ScaleGridSize.
+ */
+struct TRUWORLD_API FEditorSnapping
+{
+	static bool IsGridEnabled();
+	static double GetGridSize();
+
+	static double SnapToGrid(double Value, double GridSize);
+	/** Location on the translation grid. Components where AxisMask is zero are left alone. */
+	static FVector SnapLocationToGrid(const FVector& Location, const FVector& AxisMask = FVector::OneVector);
+	/** Placement on a surface: snapped along the surface, but kept on it along the normal's dominant axis. */
+	static FVector SnapSurfaceLocationToGrid(const FVector& Location, const FVector& SurfaceNormal);
+
+	// For the gizmo's rotate and scale modes; both return the input unchanged while grid snapping is off
+	static FRotator SnapRotation(const FRotator& Rotation);
+	static FVector SnapScale(const FVector& Scale);
+};
+
+/**
+ * Snapping for one axis-constrained gizmo drag.
+ *
+ * The faces and centre of the dragged selection's bounds snap to the faces and centres of nearby objects that are
+ * within tru.SnapDistance along the axis; bounds corners line up with it as a consequence. Mesh vertices are not
+ * snap targets, only bounds. Candidates come from the spatial hash around the moved bounds, so a frame looks at a
+ * handful of cells however dense the scene is. When nothing is close enough the pivot snaps to the translation grid
+ * instead. Both kinds of snapping are off until tru.SnapToObjects or tru.SnapToGrid is set.
+ */
+struct TRUWORLD_API FEditorDragSnap
+{
+	/** DraggedObjects are the top-level objects being moved; they and everything attached to them are never targets. */
+	void Begin(TConstArrayView<ATruGameObject*> DraggedObjects, const FVector& Pivot, const FVector& Axis);
+	void Reset();
+
+	/** Distance along the axis the pivot should move for a raw drag of Distance. */
+	double Snap(const UObject* WorldContextObject, double Distance);
+
+private:
+	FVector Pivot = FVector::ZeroVector;
+	FVector Axis = FVector::ForwardVector;
+	FBox StartBounds = FBox(ForceInit);
+	// Start bounds projected on the axis, relative to the pivot
+	double StartMin = 0.0;
+	double StartMax = 0.0;
+	TSet<const ATruGameObject*> Ignored;
+	TArray<ATruGameObject*> Candidates;
+	TArray<FBox> CandidateBounds;
+
+	/** Projection of Box onto the axis. */
+	void ProjectOnAxis(const FBox& Box, double& OutMin, double& OutMax) const;
+};
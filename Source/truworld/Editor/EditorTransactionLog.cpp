@@ -0,0 +1,652 @@
+#include "EditorTransactionLog.h"
+
+#include "Engine/World.h"
+#include "truworld/GameObjects/TruEntityStore.h"
+#include "truworld/GameObjects/TruGameObject.h"
+#include "truworld/GameObjects/TruGameObjectPool.h"
+#include "truworld/GameObjects/TruPrefab.h"
+
+FEditorTransformState FEditorTransformState::FromTransform(const FTransform& Transform)
+{
+	FEditorTransformState State;
+	State.Location = Transform.GetLocation();
+	State.Rotation = FQuat4f(Transform.GetRotation());
+	State.Scale = FVector3f(Transform.GetScale3D());
+	return State;
+}
+
+FTransform FEditorTransformState::ToTransform() const
+{
+	return FTransform(FQuat(Rotation), Location, FVector(Scale));
+}
+
+bool FEditorTransformState::Equals(const FEditorTransformState& Other) const
+{
+	return Location.Equals(Other.Location, KINDA_SMALL_NUMBER)
+		&& Rotation.Equals(Other.Rotation, KINDA_SMALL_NUMBER)
+		&& Scale.Equals(Other.Scale, KINDA_SMALL_NUMBER);
+}
+
+SIZE_T FEditorTransaction::GetAllocatedSize() const
+{
+	SIZE_T Size = sizeof(*this) + Changes.GetAllocatedSize();
+	for (const FEditorChange& Change : Changes)
+	{
+		Size += Change.PrefabOverrides.GetAllocatedSize();
+	}
+	return Size;
+}
+
+FEditorTransactionLog::FEditorTransactionLog(int32 InMaxTransactions, SIZE_T InMaxMemoryBytes)
+	: MaxTransactions(InMaxTransactions)
+	, MaxMemoryBytes(InMaxMemoryBytes)
+{
+}
+
+void FEditorTransactionLog::BeginTransaction(const TCHAR* Description)
+{
+	if (OpenDepth++ == 0)
+	{
+		OpenTransaction = FEditorTransaction();
+		OpenTransaction.Description = Description;
+		OpenChangeIndices.Reset();
+		OpenPrefabChangeIndices.Reset();
+	}
+}
+
+void FEditorTransactionLog::EndTransaction()
+{
+	if (OpenDepth == 0 || --OpenDepth > 0)
+	{
+		return;
+	}
+
+	for (FEditorChange& Change : OpenTransaction.Changes)
+	{
+		CaptureAfterState(Change);
+	}
+
+	// A click on the gizmo without moving it is not worth an undo step
+	OpenTransaction.Changes.RemoveAll([](const FEditorChange& Change)
+	{
+		return Change.Type == EEditorChangeType::Modified && Change.Before.Equals(Change.After) && Change.NameBefore == Change.NameAfter;
+	});
+	OpenChangeIndices.Reset();
+	OpenPrefabChangeIndices.Reset();
+
+	if (!OpenTransaction.Changes.IsEmpty())
+	{
+		// Counted before anything is dropped, so a slot shared with a dropped entry is never freed from under this one
+		AddSlotReferences(OpenTransaction, 1);
+
+		// A new edit discards everything that could have been redone
+		for (int32 Index = UndoCount; Index < Transactions.Num(); ++Index)
+		{
+			MemoryUsage -= Transactions[Index].GetAllocatedSize();
+			AddSlotReferences(Transactions[Index], -1);
+		}
+		Transactions.SetNum(UndoCount);
+
+		OpenTransaction.Changes.Shrink();
+		MemoryUsage += OpenTransaction.GetAllocatedSize();
+		Transactions.Add(MoveTemp(OpenTransaction));
+		UndoCount = Transactions.Num();
+
+		TrimHistory();
+	}
+
+	for (const int32 Slot : NewSlots)
+	{
+		if (Slots[Slot].NumReferences == 0)
+		{
+			ReleaseSlot(Slot);
+		}
+	}
+	NewSlots.Reset();
+}
+
+void FEditorTransactionLog::Modify(ATruGameObject* GameObject)
+{
+	if (!IsTransactionOpen() || !GameObject)
+	{
+		return;
+	}
+
+	const int32 Slot = GetSlot(GameObject);
+	if (OpenChangeIndices.Contains(Slot))
+	{
+		return;
+	}
+
+	FEditorChange& Change = OpenTransaction.Changes.AddDefaulted_GetRef();
+	Change.Type = EEditorChangeType::Modified;
+	Change.ObjectSlot = Slot;
+	Change.NameBefore = GameObject->GetFName();
+	Change.Before = FEditorTransformState::FromTransform(GameObject->GetActorTransform());
+	FindPrefabPart(GameObject, Change);
+	OpenChangeIndices.Add(Slot, OpenTransaction.Changes.Num() - 1);
+}
+
+void FEditorTransactionLog::RecordCreated(ATruGameObject* GameObject)
+{
+	if (!IsTransactionOpen() || !GameObject)
+	{
+		return;
+	}
+
+	const int32 Slot = GetSlot(GameObject);
+	if (const int32* ChangeIndex = OpenChangeIndices.Find(Slot))
+	{
+		OpenTransaction.Changes[*ChangeIndex].Type = EEditorChangeType::Created;
+		return;
+	}
+
+	// Everything else about a created object is captured when the transaction closes
+	FEditorChange& Change = OpenTransaction.Changes.AddDefaulted_GetRef();
+	Change.Type = EEditorChangeType::Created;
+	Change.ObjectSlot = Slot;
+	OpenChangeIndices.Add(Slot, OpenTransaction.Changes.Num() - 1);
+}
+
+void FEditorTransactionLog::RecordDestroyed(ATruGameObject* GameObject)
+{
+	if (!IsTransactionOpen() || !GameObject)
+	{
+		return;
+	}
+
+	const int32 Slot = GetSlot(GameObject);
+	ATruGameObject* Parent = GameObject->GetParentGameObject();
+	const int32 ParentSlot = Parent ? GetSlot(Parent) : INDEX_NONE;
+
+	if (const int32* ChangeIndex = OpenChangeIndices.Find(Slot))
+	{
+		FEditorChange& Existing = OpenTransaction.Changes[*ChangeIndex];
+		if (Existing.Type == EEditorChangeType::Created)
+		{
+			// Created and destroyed within the same transaction: nothing to undo
+			OpenTransaction.Changes.RemoveAt(*ChangeIndex);
+			RebuildOpenChangeIndices();
+			return;
+		}
+
+		// Keep the state from before the transaction, which is what undo has to bring back
+		Existing.Type = EEditorChangeType::Destroyed;
+		Existing.Class = GameObject->GetClass();
+		Existing.ObjectId = GameObject->GetObjectId();
+		Existing.ParentSlot = ParentSlot;
+		return;
+	}
+
+	FEditorChange& Change = OpenTransaction.Changes.AddDefaulted_GetRef();
+	Change.Type = EEditorChangeType::Destroyed;
+	Change.ObjectSlot = Slot;
+	Change.ParentSlot = ParentSlot;
+	Change.Class = GameObject->GetClass();
+	Change.ObjectId = GameObject->GetObjectId();
+	Change.NameBefore = GameObject->GetFName();
+	Change.Before = FEditorTransformState::FromTransform(GameObject->GetActorTransform());
+	FindPrefabPart(GameObject, Change);
+	OpenChangeIndices.Add(Slot, OpenTransaction.Changes.Num() - 1);
+}
+
+void FEditorTransactionLog::ModifyPrefabInstance(UTruPrefabLibrary* Library, int32 Instance)
+{
+	FTruPrefabInstanceState State;
+	if (!IsTransactionOpen() || !Library || !Library->GetInstanceState(Instance, State))
+	{
+		return;
+	}
+
+	const FTruObjectId InstanceId = Library->GetInstanceId(Instance);
+	if (OpenPrefabChangeIndices.Contains(InstanceId))
+	{
+		return;
+	}
+
+	PrefabLibrary = Library;
+	FEditorChange& Change = OpenTransaction.Changes.AddDefaulted_GetRef();
+	Change.Type = EEditorChangeType::Modified;
+	Change.ObjectId = InstanceId;
+	Change.Prefab = State.Prefab;
+	Change.Before = FEditorTransformState::FromTransform(State.Transform);
+	OpenPrefabChangeIndices.Add(InstanceId, OpenTransaction.Changes.Num() - 1);
+}
+
+void FEditorTransactionLog::RecordPrefabInstanceCreated(UTruPrefabLibrary* Library, int32 Instance)
+{
+	FTruPrefabInstanceState State;
+	if (!IsTransactionOpen() || !Library || !Library->GetInstanceState(Instance, State))
+	{
+		return;
+	}
+
+	const FTruObjectId InstanceId = Library->GetInstanceId(Instance);
+	PrefabLibrary = Library;
+	if (const int32* ChangeIndex = OpenPrefabChangeIndices.Find(InstanceId))
+	{
+		OpenTransaction.Changes[*ChangeIndex].Type = EEditorChangeType::Created;
+		return;
+	}
+
+	// Its transform and overrides are captured when the transaction closes
+	FEditorChange& Change = OpenTransaction.Changes.AddDefaulted_GetRef();
+	Change.Type = EEditorChangeType::Created;
+	Change.ObjectId = InstanceId;
+	Change.Prefab = State.Prefab;
+	OpenPrefabChangeIndices.Add(InstanceId, OpenTransaction.Changes.Num() - 1);
+}
+
+void FEditorTransactionLog::RecordPrefabInstanceDestroyed(UTruPrefabLibrary* Library, int32 Instance)
+{
+	FTruPrefabInstanceState State;
+	if (!IsTransactionOpen() || !Library || !Library->GetInstanceState(Instance, State))
+	{
+		return;
+	}
+
+	const FTruObjectId InstanceId = Library->GetInstanceId(Instance);
+	PrefabLibrary = Library;
+	if (const int32* ChangeIndex = OpenPrefabChangeIndices.Find(InstanceId))
+	{
+		FEditorChange& Existing = OpenTransaction.Changes[*ChangeIndex];
+		if (Existing.Type == EEditorChangeType::Created)
+		{
+			OpenTransaction.Changes.RemoveAt(*ChangeIndex);
+			RebuildOpenChangeIndices();
+			return;
+		}
+
+		// The transform from before the transaction is kept, as for objects
+		Existing.Type = EEditorChangeType::Destroyed;
+		Existing.PrefabOverrides = MoveTemp(State.Overrides);
+		return;
+	}
+
+	FEditorChange& Change = OpenTransaction.Changes.AddDefaulted_GetRef();
+	Change.Type = EEditorChangeType::Destroyed;
+	Change.ObjectId = InstanceId;
+	Change.Prefab = State.Prefab;
+	Change.PrefabOverrides = MoveTemp(State.Overrides);
+	Change.Before = FEditorTransformState::FromTransform(State.Transform);
+	OpenPrefabChangeIndices.Add(InstanceId, OpenTransaction.Changes.Num() - 1);
+}
+
+bool FEditorTransactionLog::Undo(UWorld* World)
+{
+	if (!CanUndo() || !World)
+	{
+		return false;
+	}
+
+	const FEditorTransaction& Transaction = Transactions[--UndoCount];
+	for (int32 Index = Transaction.Changes.Num() - 1; Index >= 0; --Index)
+	{
+		ApplyChange(World, Transaction.Changes[Index], /*bUndo*/ true);
+	}
+	return true;
+}
+
+bool FEditorTransactionLog::Redo(UWorld* World)
+{
+	if (!CanRedo() || !World)
+	{
+		return false;
+	}
+
+	const FEditorTransaction& Transaction = Transactions[UndoCount++];
+	for (const FEditorChange& Change : Transaction.Changes)
+	{
+		ApplyChange(World, Change, /*bUndo*/ false);
+	}
+	return true;
+}
+
+void FEditorTransactionLog::Reset()
+{
+	Transactions.Reset();
+	UndoCount = 0;
+	OpenTransaction = FEditorTransaction();
+	OpenChangeIndices.Reset();
+	OpenPrefabChangeIndices.Reset();
+	OpenDepth = 0;
+	Slots.Reset();
+	FreeSlots.Reset();
+	NewSlots.Reset();
+	SlotIndices.Reset();
+	PrefabLibrary = nullptr;
+	PrefabInstanceIds.Reset();
+	MemoryUsage = 0;
+}
+
+int32 FEditorTransactionLog::GetSlot(ATruGameObject* GameObject)
+{
+	// A pooled actor that was reused since is a different object as far as the history is concerned
+	const int32* ExistingSlot = SlotIndices.Find(GameObject);
+	if (ExistingSlot && Slots[*ExistingSlot].PoolGeneration == GameObject->GetPoolGeneration())
+	{
+		return *ExistingSlot;
+	}
+
+	const int32 Slot = FreeSlots.IsEmpty() ? Slots.AddDefaulted() : FreeSlots.Pop(EAllowShrinking::No);
+	AssignSlot(Slot, GameObject);
+	NewSlots.Add(Slot);
+	return Slot;
+}
+
+ATruGameObject* FEditorTransactionLog::ResolveSlot(int32 Slot)
+{
+	if (!Slots.IsValidIndex(Slot))
+	{
+		return nullptr;
+	}
+
+	// Released to the pool or reused for something else: the object this slot stood for is gone
+	ATruGameObject* GameObject = Slots[Slot].GameObject.Get();
+	if (GameObject && !GameObject->IsPooled() && GameObject->GetPoolGeneration() == Slots[Slot].PoolGeneration)
+	{
+		return GameObject;
+	}
+
+	// ...unless it was demoted to an entity since. It is either an entity still or an actor again under the same id.
+	const FTruObjectId ObjectId = Slots[Slot].ObjectId;
+	UWorld* World = Slots[Slot].World.Get();
+	if (!ObjectId.IsValid() || !World)
+	{
+		return nullptr;
+	}
+
+	UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(World);
+	GameObject = ObjectRegistry ? ObjectRegistry->Find(ObjectId) : nullptr;
+	if (!GameObject)
+	{
+		UTruEntityStore* EntityStore = UTruEntityStore::Get(World);
+		GameObject = EntityStore ? EntityStore->Promote(ObjectId) : nullptr;
+	}
+	if (GameObject)
+	{
+		AssignSlot(Slot, GameObject);
+	}
+	return GameObject;
+}
+
+void FEditorTransactionLog::AssignSlot(int32 Slot, ATruGameObject* GameObject)
+{
+	FObjectSlot& ObjectSlot = Slots[Slot];
+	if (const int32* Previous = SlotIndices.Find(ObjectSlot.Key); Previous && *Previous == Slot)
+	{
+		SlotIndices.Remove(ObjectSlot.Key);
+	}
+
+	ObjectSlot.GameObject = GameObject;
+	ObjectSlot.Key = GameObject;
+	ObjectSlot.PoolGeneration = GameObject->GetPoolGeneration();
+	ObjectSlot.ObjectId = GameObject->GetObjectId();
+	ObjectSlot.World = GameObject->GetWorld();
+	SlotIndices.Add(GameObject, Slot);
+}
+
+void FEditorTransactionLog::AddSlotReferences(const FEditorTransaction& Transaction, int32 Delta)
+{
+	for (const FEditorChange& Change : Transaction.Changes)
+	{
+		for (const int32 Slot : { Change.ObjectSlot, Change.ParentSlot })
+		{
+			if (Slots.IsValidIndex(Slot) && (Slots[Slot].NumReferences += Delta) == 0)
+			{
+				ReleaseSlot(Slot);
+			}
+		}
+	}
+}
+
+void FEditorTransactionLog::ReleaseSlot(int32 Slot)
+{
+	// The object may have a newer slot by now, which keeps its entry
+	if (const int32* Current = SlotIndices.Find(Slots[Slot].Key); Current && *Current == Slot)
+	{
+		SlotIndices.Remove(Slots[Slot].Key);
+	}
+	Slots[Slot] = FObjectSlot();
+	FreeSlots.Add(Slot);
+}
+
+void FEditorTransactionLog::RebuildOpenChangeIndices()
+{
+	OpenChangeIndices.Reset();
+	OpenPrefabChangeIndices.Reset();
+	for (int32 Index = 0; Index < OpenTransaction.Changes.Num(); ++Index)
+	{
+		const FEditorChange& Change = OpenTransaction.Changes[Index];
+		if (Change.IsPrefabInstance())
+		{
+			OpenPrefabChangeIndices.Add(Change.ObjectId, Index);
+		}
+		else
+		{
+			OpenChangeIndices.Add(Change.ObjectSlot, Index);
+		}
+	}
+}
+
+FTruObjectId FEditorTransactionLog::ResolvePrefabInstanceId(FTruObjectId Id) const
+{
+	const FTruObjectId* Current = PrefabInstanceIds.Find(Id);
+	return Current ? *Current : Id;
+}
+
+void FEditorTransactionLog::CaptureAfterState(FEditorChange& Change)
+{
+	if (Change.IsPrefabInstance())
+	{
+		UTruPrefabLibrary* Library = PrefabLibrary.Get();
+		FTruPrefabInstanceState State;
+		if (Change.Type != EEditorChangeType::Destroyed && Library && Library->GetInstanceState(Library->FindInstanceById(Change.ObjectId), State))
+		{
+			Change.After = FEditorTransformState::FromTransform(State.Transform);
+			if (Change.Type == EEditorChangeType::Created)
+			{
+				Change.PrefabOverrides = MoveTemp(State.Overrides);
+			}
+		}
+		return;
+	}
+
+	ATruGameObject* GameObject = ResolveSlot(Change.ObjectSlot);
+	if (!GameObject || Change.Type == EEditorChangeType::Destroyed)
+	{
+		return;
+	}
+
+	Change.NameAfter = GameObject->GetFName();
+	Change.After = FEditorTransformState::FromTransform(GameObject->GetActorTransform());
+
+	if (Change.Type == EEditorChangeType::Created)
+	{
+		ATruGameObject* Parent = GameObject->GetParentGameObject();
+		Change.Class = GameObject->GetClass();
+		Change.ObjectId = GameObject->GetObjectId();
+		Change.ParentSlot = Parent ? GetSlot(Parent) : INDEX_NONE;
+	}
+}
+
+void FEditorTransactionLog::ApplyChange(UWorld* World, const FEditorChange& Change, bool bUndo)
+{
+	if (Change.IsPrefabInstance())
+	{
+		ApplyPrefabChange(World, Change, bUndo);
+		return;
+	}
+
+	ATruGameObject* GameObject = ResolveSlot(Change.ObjectSlot);
+
+	switch (Change.Type)
+	{
+	case EEditorChangeType::Modified:
+		// A part whose prefab instance was closed, or opened again, since: it is an override now, or a new object
+		if (!GameObject && Change.IsPrefabPart())
+		{
+			UTruPrefabLibrary* Library = UTruPrefabLibrary::Get(World);
+			GameObject = Library ? Library->SetPartTransform(ResolvePrefabInstanceId(Change.PrefabInstanceId), Change.PrefabPart, (bUndo ? Change.Before : Change.After).ToTransform()) : nullptr;
+			if (GameObject)
+			{
+				AssignSlot(Change.ObjectSlot, GameObject);
+			}
+		}
+		if (GameObject)
+		{
+			GameObject->SetActorTransform((bUndo ? Change.Before : Change.After).ToTransform());
+
+			const FName Name = bUndo ? Change.NameBefore : Change.NameAfter;
+			if (GameObject->GetFName() != Name)
+			{
+				GameObject->RenameGameObject(Name.ToString());
+			}
+		}
+		break;
+
+	case EEditorChangeType::Created:
+	case EEditorChangeType::Destroyed:
+	{
+		// Undoing a creation and redoing a destruction both remove the object; the other two bring it back
+		const bool bShouldExist = (Change.Type == EEditorChangeType::Created) != bUndo;
+		UTruPrefabLibrary* Library = Change.IsPrefabPart() ? UTruPrefabLibrary::Get(World) : nullptr;
+		const FTruObjectId PrefabInstanceId = ResolvePrefabInstanceId(Change.PrefabInstanceId);
+		if (!bShouldExist)
+		{
+			// A part stays removed from its instance even if that was closed since
+			if (Library && Library->RemovePart(PrefabInstanceId, Change.PrefabPart))
+			{
+				break;
+			}
+			if (GameObject)
+			{
+				UTruGameObjectPool::DestroyGameObject(GameObject);
+			}
+		}
+		else if (!GameObject && Change.IsPrefabPart())
+		{
+			// Back into its instance: as an object if the instance is open, by clearing its removal if not. A part
+			// whose instance is gone stays gone; undoing the instance's removal brings it back.
+			GameObject = Library ? Library->RestorePart(PrefabInstanceId, Change.PrefabPart, Change.Before.ToTransform()) : nullptr;
+			if (GameObject)
+			{
+				AssignSlot(Change.ObjectSlot, GameObject);
+				if (ATruGameObject* Parent = ResolveSlot(Change.ParentSlot))
+				{
+					GameObject->SetParentGameObject(Parent);
+				}
+			}
+		}
+		else if (!GameObject)
+		{
+			const bool bUseAfterState = Change.Type == EEditorChangeType::Created;
+			Respawn(World, Change, bUseAfterState ? Change.After : Change.Before, bUseAfterState ? Change.NameAfter : Change.NameBefore);
+		}
+		break;
+	}
+	}
+}
+
+void FEditorTransactionLog::FindPrefabPart(const ATruGameObject* GameObject, FEditorChange& Change)
+{
+	if (const UTruPrefabLibrary* Library = UTruPrefabLibrary::Get(GameObject))
+	{
+		Library->FindOpenPart(GameObject, Change.PrefabInstanceId, Change.PrefabPart);
+	}
+}
+
+void FEditorTransactionLog::ApplyPrefabChange(UWorld* World, const FEditorChange& Change, bool bUndo)
+{
+	UTruPrefabLibrary* Library = UTruPrefabLibrary::Get(World);
+	if (!Library)
+	{
+		return;
+	}
+
+	const FTruObjectId InstanceId = ResolvePrefabInstanceId(Change.ObjectId);
+	const int32 Instance = Library->FindInstanceById(InstanceId);
+
+	switch (Change.Type)
+	{
+	case EEditorChangeType::Modified:
+		if (Instance != INDEX_NONE)
+		{
+			Library->SetInstanceTransform(Instance, (bUndo ? Change.Before : Change.After).ToTransform());
+		}
+		break;
+
+	case EEditorChangeType::Created:
+	case EEditorChangeType::Destroyed:
+	{
+		const bool bShouldExist = (Change.Type == EEditorChangeType::Created) != bUndo;
+		if (!bShouldExist)
+		{
+			if (Instance != INDEX_NONE)
+			{
+				Library->RemoveInstance(Instance);
+			}
+		}
+		else if (Instance == INDEX_NONE)
+		{
+			FTruPrefabInstanceState State;
+			State.Prefab = Change.Prefab;
+			State.Transform = (Change.Type == EEditorChangeType::Created ? Change.After : Change.Before).ToTransform();
+			State.Overrides = Change.PrefabOverrides;
+			const FTruObjectId AddedId = Library->GetInstanceId(Library->AddInstance(State, InstanceId));
+
+			// Its id was taken while it was gone, so entries that name it by either id are pointed at the new one
+			if (AddedId.IsValid() && AddedId != InstanceId)
+			{
+				for (TPair<FTruObjectId, FTruObjectId>& Remapped : PrefabInstanceIds)
+				{
+					if (Remapped.Value == InstanceId)
+					{
+						Remapped.Value = AddedId;
+					}
+				}
+				PrefabInstanceIds.Add(InstanceId, AddedId);
+			}
+		}
+		break;
+	}
+	}
+}
+
+ATruGameObject* FEditorTransactionLog::Respawn(UWorld* World, const FEditorChange& Change, const FEditorTransformState& State, FName Name)
+{
+	UClass* Class = Change.Class.Get();
+	if (!Class)
+	{
+		return nullptr;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParams.NameMode = FActorSpawnParameters::ESpawnActorNameMode::Requested;
+	SpawnParams.Name = Name;
+
+	ATruGameObject* GameObject = UTruGameObjectPool::SpawnGameObject(World, Class, State.ToTransform(), SpawnParams, Change.ObjectId);
+	if (GameObject)
+	{
+		// Later entries refer to the slot, so they now act on the new actor
+		AssignSlot(Change.ObjectSlot, GameObject);
+
+		if (ATruGameObject* Parent = ResolveSlot(Change.ParentSlot))
+		{
+			GameObject->SetParentGameObject(Parent);
+		}
+	}
+	return GameObject;
+}
+
+void FEditorTransactionLog::TrimHistory()
+{
+	while (Transactions.Num() > MaxTransactions || (MemoryUsage > MaxMemoryBytes && Transactions.Num() > 1))
+	{
+		MemoryUsage -= Transactions[0].GetAllocatedSize();
+		AddSlotReferences(Transactions[0], -1);
+		Transactions.RemoveAt(0);
+		UndoCount = FMath::Max(0, UndoCount - 1);
+	}
+}
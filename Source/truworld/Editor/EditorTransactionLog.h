@@ -0,0 +1,155 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+#include "truworld/GameObjects/TruObjectRegistry.h"
+#include "truworld/GameObjects/TruPrefab.h"
+
+class ATruGameObject;
+class UWorld;
+
+/** Transform stored with single precision rotation and scale; location keeps full precision. */
+struct FEditorTransformState
+{
+	FVector Location = FVector::ZeroVector;
+	FQuat4f Rotation = FQuat4f::Identity;
+	FVector3f Scale = FVector3f::OneVector;
+
+	static FEditorTransformState FromTransform(const FTransform& Transform);
+	FTransform ToTransform() const;
+	bool Equals(const FEditorTransformState& Other) const;
+};
+
+enum class EEditorChangeType : uint8
+{
+	Modified,	// Transform and/or name
+	Created,
+	Destroyed
+};
+
+/**
+ * One object's part of a transaction. Objects are referred to by log slot so recreated actors can be remapped; whole
+ * prefab instances have no actor and so no slot, and are found by their id in the prefab library instead.
+ */
+struct FEditorChange
+{
+	EEditorChangeType Type = EEditorChangeType::Modified;
+	int32 ObjectSlot = INDEX_NONE;
+	int32 ParentSlot = INDEX_NONE;
+	TWeakObjectPtr<UClass> Class;
+	FTruObjectId ObjectId;	// Given back to the object when undo or redo recreates it
+	FName NameBefore;
+	FName NameAfter;
+	FEditorTransformState Before;
+	FEditorTransformState After;
+
+	// Set for prefab instances only
+	FName Prefab;
+	TArray<TPair<FName, FTruPrefabOverride>> PrefabOverrides;
+
+	// Set for parts of an open prefab instance, which go back into the instance rather than coming back as objects
+	FTruObjectId PrefabInstanceId;
+	FName PrefabPart;
+
+	bool IsPrefabInstance() const { return !Prefab.IsNone(); }
+	bool IsPrefabPart() const { return !PrefabPart.IsNone(); }
+};
+
+struct FEditorTransaction
+{
+	const TCHAR* Description = nullptr;
+	TArray<FEditorChange> Changes;
+
+	SIZE_T GetAllocatedSize() const;
+};
+
+/**
+ * Undo/redo history for editor operations, stored as per-object deltas rather than scene snapshots.
+ *
+ * Usage follows the engine's Modify() pattern: open a transaction, call Modify() on every object before changing it
+ * (or RecordCreated/RecordDestroyed), and close it. The state after the change is captured when the outermost
+ * transaction ends, so a gizmo drag that touches an object every frame still ends up as a single entry.
+ * Undo and redo cost O(objects changed by that entry). Memory is capped; the oldest entries are dropped first, and
+ * the slots of objects that no remaining entry refers to are freed with them, so the slot table stays bounded too.
+ */
+class TRUWORLD_API FEditorTransactionLog
+{
+public:
+	explicit FEditorTransactionLog(int32 InMaxTransactions = 256, SIZE_T InMaxMemoryBytes = 32 * 1024 * 1024);
+
+	void BeginTransaction(const TCHAR* Description);
+	void EndTransaction();
+	bool IsTransactionOpen() const { return OpenDepth > 0; }
+
+	/** Snapshots the object before it changes. Repeated calls within one transaction keep the first snapshot. */
+	void Modify(ATruGameObject* GameObject);
+	void RecordCreated(ATruGameObject* GameObject);
+	/** Must be called before the object is destroyed. */
+	void RecordDestroyed(ATruGameObject* GameObject);
+
+	/** The same three for a whole prefab instance. Its open parts are recorded as objects. */
+	void ModifyPrefabInstance(UTruPrefabLibrary* Library, int32 Instance);
+	void RecordPrefabInstanceCreated(UTruPrefabLibrary* Library, int32 Instance);
+	/** Must be called before the instance is removed. */
+	void RecordPrefabInstanceDestroyed(UTruPrefabLibrary* Library, int32 Instance);
+
+	bool Undo(UWorld* World);
+	bool Redo(UWorld* World);
+	bool CanUndo() const { return !IsTransactionOpen() && UndoCount > 0; }
+	bool CanRedo() const { return !IsTransactionOpen() && UndoCount < Transactions.Num(); }
+
+	void Reset();
+	SIZE_T GetMemoryUsage() const { return MemoryUsage; }
+
+private:
+	int32 GetSlot(ATruGameObject* GameObject);
+	/** The slot's object, promoting it from the entity store first if it was demoted since. */
+	ATruGameObject* ResolveSlot(int32 Slot);
+	void AssignSlot(int32 Slot, ATruGameObject* GameObject);
+	/** Counts Transaction's references to its slots up or down; a slot that drops to none is freed. */
+	void AddSlotReferences(const FEditorTransaction& Transaction, int32 Delta);
+	void ReleaseSlot(int32 Slot);
+	void RebuildOpenChangeIndices();
+	/** The id the instance recorded as Id has now; it only differs when undo could not give the instance its id back. */
+	FTruObjectId ResolvePrefabInstanceId(FTruObjectId Id) const;
+
+	void CaptureAfterState(FEditorChange& Change);
+	void ApplyChange(UWorld* World, const FEditorChange& Change, bool bUndo);
+	static void FindPrefabPart(const ATruGameObject* GameObject, FEditorChange& Change);
+	void ApplyPrefabChange(UWorld* World, const FEditorChange& Change, bool bUndo);
+	ATruGameObject* Respawn(UWorld* World, const FEditorChange& Change, const FEditorTransformState& State, FName Name);
+	void TrimHistory();
+
+	TArray<FEditorTransaction> Transactions;
+	/** Transactions[0, UndoCount) can be undone, the rest can be redone. */
+	int32 UndoCount = 0;
+
+	FEditorTransaction OpenTransaction;
+	TMap<int32, int32> OpenChangeIndices;	// Object slot -> index into OpenTransaction.Changes
+	TMap<FTruObjectId, int32> OpenPrefabChangeIndices;	// Prefab instance id -> index into OpenTransaction.Changes
+	int32 OpenDepth = 0;
+
+	struct FObjectSlot
+	{
+		TWeakObjectPtr<ATruGameObject> GameObject;
+		TObjectKey<ATruGameObject> Key;	// Its entry in SlotIndices
+		uint32 PoolGeneration = 0;
+		FTruObjectId ObjectId;
+		TWeakObjectPtr<UWorld> World;
+		int32 NumReferences = 0;	// Changes in Transactions that refer to it
+	};
+	TArray<FObjectSlot> Slots;
+	TArray<int32> FreeSlots;
+	/** Slots made since the open transaction began; those none of its kept changes refer to are freed when it ends. */
+	TArray<int32> NewSlots;
+	TMap<TObjectKey<ATruGameObject>, int32> SlotIndices;
+
+	/** Where the open transaction's prefab instances are captured when it ends. */
+	TWeakObjectPtr<UTruPrefabLibrary> PrefabLibrary;
+	/** Recorded prefab instance id -> the id it came back with, for instances whose id was taken while they were gone. */
+	TMap<FTruObjectId, FTruObjectId> PrefabInstanceIds;
+
+	int32 MaxTransactions;
+	SIZE_T MaxMemoryBytes;
+	SIZE_T MemoryUsage = 0;
+};
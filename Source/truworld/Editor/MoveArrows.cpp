@@ -7,6 +7,8 @@
 #include "GameFramework/PlayerController.h"
 #include "Engine/World.h"
 #include "Kismet/KismetMathLibrary.h"
+#include "Engine/StaticMesh.h"
+#include "StaticMeshResources.h"
 #include "truworld/GameObjects/TruGameObject.h"
 
 // Constructor
@@ -69,18 +71,206 @@ void AMoveArrows::BeginPlay()
             Arrow->OnReleased.AddDynamic(this, &AMoveArrows::OnArrowReleased);
         }
     }
+
+    BuildHitShapes();
+}
+
+void AMoveArrows::BuildHitShapes()
+{
+    const UStaticMeshComponent* ArrowComponents[3] = { Forward, Up, Right };
+    for (int32 Index = 0; Index < 3; ++Index)
+    {
+        FArrowHitShape& Shape = ArrowHitShapes[Index];
+        Shape = FArrowHitShape();
+
+        const UStaticMesh* Mesh = ArrowComponents[Index] ? ArrowComponents[Index]->GetStaticMesh() : nullptr;
+        if (!Mesh)
+        {
+            continue;
+        }
+
+        // The arrow runs along the longest side of its bounds and points towards the positive end
+        const FBox Bounds = Mesh->GetBoundingBox();
+        const FVector Extent = Bounds.GetExtent();
+        const int32 Axis = Extent.X >= Extent.Y && Extent.X >= Extent.Z ? 0 : (Extent.Y >= Extent.Z ? 1 : 2);
+
+        FVector Tail = Bounds.GetCenter();
+        Tail[Axis] = Bounds.Min[Axis];
+        FVector Tip = Bounds.GetCenter();
+        Tip[Axis] = Bounds.Max[Axis];
+
+        Shape.Tail = Tail;
+        Shape.Tip = Tip;
+        Shape.HeadBase = FMath::Lerp(Tip, Tail, (double)HeadLengthFraction);
+        Shape.HeadRadius = FMath::Max(Extent[(Axis + 1) % 3], Extent[(Axis + 2) % 3]);
+        Shape.ShaftRadius = GetShaftRadius(*Mesh, Bounds.GetCenter(), Axis, Shape.HeadBase[Axis]);
+        if (Shape.ShaftRadius <= 0.0)
+        {
+            Shape.ShaftRadius = Shape.HeadRadius * ShaftRadiusFraction;
+        }
+    }
+    bHitCacheValid = false;
+}
+
+double AMoveArrows::GetShaftRadius(const UStaticMesh& Mesh, const FVector& Center, int32 Axis, double HeadStart)
+{
+    // Widest vertex behind the head, measured from the arrow axis. Cooked meshes without CPU access have no
+    // positions to read; the caller falls back to a fraction of the head then.
+    const FStaticMeshRenderData* RenderData = Mesh.GetRenderData();
+    if (!RenderData || RenderData->LODResources.IsEmpty())
+    {
+        return 0.0;
+    }
+
+    const FPositionVertexBuffer& Positions = RenderData->LODResources[0].VertexBuffers.PositionVertexBuffer;
+    if (!Positions.GetVertexData())
+    {
+        return 0.0;
+    }
+
+    double RadiusSquared = 0.0;
+    for (uint32 Vertex = 0; Vertex < Positions.GetNumVertices(); ++Vertex)
+    {
+        const FVector Position(Positions.VertexPosition(Vertex));
+        if (Position[Axis] < HeadStart)
+        {
+            FVector Offset = Position - Center;
+            Offset[Axis] = 0.0;
+            RadiusSquared = FMath::Max(RadiusSquared, Offset.SizeSquared());
+        }
+    }
+    return FMath::Sqrt(RadiusSquared);
+}
+
+UStaticMeshComponent* AMoveArrows::HitTestArrows(const FVector& RayOrigin, const FVector& RayDirection, double RayLength)
+{
+    const FVector RayEnd = RayOrigin + RayDirection * RayLength;
+    const bool bVisible = IsVisible();
+    const FTransform& GizmoTransform = GetActorTransform();
+
+    // Neither the mouse, the camera nor the gizmo moved: same answer as last frame
+    if (bHitCacheValid && bVisible == bCachedVisible && RayOrigin.Equals(CachedRayOrigin) && RayEnd.Equals(CachedRayEnd)
+        && GizmoTransform.Equals(CachedGizmoTransform))
+    {
+        return CachedHitArrow;
+    }
+
+    bHitCacheValid = true;
+    bCachedVisible = bVisible;
+    CachedRayOrigin = RayOrigin;
+    CachedRayEnd = RayEnd;
+    CachedGizmoTransform = GizmoTransform;
+    CachedHitArrow = nullptr;
+
+    // Hidden arrows cannot be hovered
+    if (!bVisible)
+    {
+        return nullptr;
+    }
+
+    UStaticMeshComponent* ArrowComponents[3] = { Forward, Up, Right };
+    for (int32 Index = 0; Index < 3; ++Index)
+    {
+        if (!ArrowComponents[Index])
+        {
+            continue;
+        }
+
+        // In component space the distance scale is already part of the transform
+        const FTransform& ComponentTransform = ArrowComponents[Index]->GetComponentTransform();
+        const FVector LocalStart = ComponentTransform.InverseTransformPosition(RayOrigin);
+        const FVector LocalDelta = ComponentTransform.InverseTransformPosition(RayEnd) - LocalStart;
+        if (IntersectHitShape(ArrowHitShapes[Index], LocalStart, LocalDelta))
+        {
+            CachedHitArrow = ArrowComponents[Index];
+            break;
+        }
+    }
+    return CachedHitArrow;
+}
+
+bool AMoveArrows::IntersectHitShape(const FArrowHitShape& Shape, const FVector& Start, const FVector& Delta)
+{
+    if (Shape.HeadRadius <= 0.0)
+    {
+        return false;
+    }
+
+    // Shaft: segment against capsule
+    FVector PointOnRay;
+    FVector PointOnShaft;
+    FMath::SegmentDistToSegment(Start, Start + Delta, Shape.Tail, Shape.HeadBase, PointOnRay, PointOnShaft);
+    if (FVector::DistSquared(PointOnRay, PointOnShaft) <= FMath::Square(Shape.ShaftRadius))
+    {
+        return true;
+    }
+
+    // Head: segment Start + T * Delta, T in [0, 1], against a cone with its apex at the tip
+    const FVector AxisVector = Shape.HeadBase - Shape.Tip;
+    const double Height = AxisVector.Size();
+    if (Height < UE_SMALL_NUMBER)
+    {
+        return false;
+    }
+
+    const FVector Axis = AxisVector / Height;
+    const double CosSquared = FMath::Square(Height) / (FMath::Square(Height) + FMath::Square(Shape.HeadRadius));
+    const FVector FromApex = Start - Shape.Tip;
+    const double DeltaAlongAxis = Delta | Axis;
+    const double StartAlongAxis = FromApex | Axis;
+
+    auto IsOnCone = [&](double T)
+    {
+        const double AlongAxis = StartAlongAxis + T * DeltaAlongAxis;
+        return T >= 0.0 && T <= 1.0 && AlongAxis >= 0.0 && AlongAxis <= Height;
+    };
+
+    const double A = FMath::Square(DeltaAlongAxis) - (Delta | Delta) * CosSquared;
+    const double B = 2.0 * (DeltaAlongAxis * StartAlongAxis - (Delta | FromApex) * CosSquared);
+    const double C = FMath::Square(StartAlongAxis) - (FromApex | FromApex) * CosSquared;
+    if (FMath::IsNearlyZero(A))
+    {
+        if (!FMath::IsNearlyZero(B) && IsOnCone(-C / B))
+        {
+            return true;
+        }
+    }
+    else
+    {
+        const double Discriminant = B * B - 4.0 * A * C;
+        if (Discriminant >= 0.0)
+        {
+            const double Root = FMath::Sqrt(Discriminant);
+            if (IsOnCone((-B - Root) / (2.0 * A)) || IsOnCone((-B + Root) / (2.0 * A)))
+            {
+                return true;
+            }
+        }
+    }
+
+    // The cone's base disc
+    if (!FMath::IsNearlyZero(DeltaAlongAxis))
+    {
+        const double T = (Height - StartAlongAxis) / DeltaAlongAxis;
+        if (T >= 0.0 && T <= 1.0 && FVector::DistSquared(Start + Delta * T, Shape.HeadBase) <= FMath::Square(Shape.HeadRadius))
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
 void AMoveArrows::Tick(float DeltaTime)
 {
     Super::Tick(DeltaTime);
 
-    if(ATruGameObject* GameObject = CastChecked<AEditorPlayerController>(GetWorld()->GetFirstPlayerController())->GetSelectedObject())
+    const FEditorSelection& Selection = CastChecked<AEditorPlayerController>(GetWorld()->GetFirstPlayerController())->GetSelection();
+    if(!Selection.IsEmpty())
     {
         if(!bIsDragging)
-            SetActorLocation(GameObject->GetActorLocation());
+            SetActorLocation(Selection.GetPivot());
         else
-            GameObject->SetActorLocation(GetActorLocation());
+            ApplyDragOffset(GetActorLocation() - DragStartLocation);
     }
 
     APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
@@ -145,9 +335,9 @@ void AMoveArrows::Tick(float DeltaTime)
 
                     FVector ClosestPointOnAxis = Origin1 + sc * Dir1;
 
-                    // Update actor location
-                    FVector NewLocation = ClosestPointOnAxis + DragOffset;
-                    SetActorLocation(NewLocation);
+                    // Update actor location; snapping works on the distance travelled along the axis
+                    const double DragDistance = (ClosestPointOnAxis + DragOffset - DragStartLocation) | DragDirection;
+                    SetActorLocation(DragStartLocation + DragDirection * DragSnap.Snap(this, DragDistance));
                 }
             }
         }
@@ -164,6 +354,28 @@ void AMoveArrows::StartDragging(UStaticMeshComponent* Component, FVector Directi
     APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
     if (!PlayerController)
         return;
+
+    // The whole drag becomes one undo step; it is closed in StopDragging
+    if (AEditorPlayerController* EditorController = Cast<AEditorPlayerController>(PlayerController))
+    {
+        // Children of selected objects follow their parent, so only the top-level objects are moved and recorded
+        EditorController->GetSelection().GetTopLevelObjects(DragObjects);
+        DragObjectStartLocations.Reset(DragObjects.Num());
+        for (ATruGameObject* GameObject : DragObjects)
+        {
+            DragObjectStartLocations.Add(GameObject->GetActorLocation());
+        }
+        AppliedDragOffset = FVector::ZeroVector;
+        DragSnap.Begin(DragObjects, DragStartLocation, DragDirection);
+
+        EditorController->GetTransactionLog().BeginTransaction(TEXT("Move"));
+        for (ATruGameObject* GameObject : DragObjects)
+        {
+            EditorController->GetTransactionLog().Modify(GameObject);
+        }
+        bTransactionOpen = true;
+    }
+
     FVector2D MousePosition;
     if (PlayerController->GetMousePosition(MousePosition.X, MousePosition.Y))
     {
@@ -196,10 +408,43 @@ void AMoveArrows::StartDragging(UStaticMeshComponent* Component, FVector Directi
     }
 }
 
+void AMoveArrows::ApplyDragOffset(const FVector& Offset)
+{
+    // The cursor often rests mid-drag; nothing has to move then
+    if (Offset.Equals(AppliedDragOffset))
+    {
+        return;
+    }
+    AppliedDragOffset = Offset;
+
+    // Targets go into one contiguous array so the whole selection moves, and notifies its listeners, as one batch
+    const int32 NumObjects = DragObjects.Num();
+    DragObjectTargetLocations.SetNumUninitialized(NumObjects, EAllowShrinking::No);
+    for (int32 Index = 0; Index < NumObjects; ++Index)
+    {
+        DragObjectTargetLocations[Index] = DragObjectStartLocations[Index] + Offset;
+    }
+
+    ATruGameObject::SetActorLocations(DragObjects, DragObjectTargetLocations);
+}
+
+void AMoveArrows::OnGameObjectRemoved(ATruGameObject* GameObject)
+{
+    const int32 Index = DragObjects.Find(GameObject);
+    if (Index != INDEX_NONE)
+    {
+        DragObjects.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+        DragObjectStartLocations.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+    }
+}
+
 void AMoveArrows::StopDragging()
 {
     bIsDragging = false;
     DraggedComponent = nullptr;
+    DragObjects.Reset();
+    DragObjectStartLocations.Reset();
+    DragSnap.Reset();
 
     // Check if the cursor is over the highlighted arrow
     APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
@@ -208,20 +453,26 @@ void AMoveArrows::StopDragging()
         return;
     }
 
-    FVector2D MousePosition;
-    if (PlayerController->GetMousePosition(MousePosition.X, MousePosition.Y))
+    // StopDragging is called both by the arrow release and by the pawn's mouse release
+    if (bTransactionOpen)
     {
-        FHitResult HitResult;
-        PlayerController->GetHitResultAtScreenPosition(MousePosition, ECollisionChannel::ECC_Visibility, true, HitResult);
+        if (AEditorPlayerController* EditorController = Cast<AEditorPlayerController>(PlayerController))
+        {
+            EditorController->GetTransactionLog().EndTransaction();
+        }
+        bTransactionOpen = false;
+    }
 
-        if (HitResult.Component.IsValid())
+    FVector2D MousePosition;
+    FVector WorldOrigin;
+    FVector WorldDirection;
+    if (PlayerController->GetMousePosition(MousePosition.X, MousePosition.Y)
+        && PlayerController->DeprojectScreenPositionToWorld(MousePosition.X, MousePosition.Y, WorldOrigin, WorldDirection))
+    {
+        if (HighlightedArrow && HitTestArrows(WorldOrigin, WorldDirection, 10000.0) == HighlightedArrow)
         {
-            UPrimitiveComponent* HoveredComponent = HitResult.Component.Get();
-            if (HoveredComponent == HighlightedArrow)
-            {
-                // The cursor is still over the arrow; keep it highlighted
-                return;
-            }
+            // The cursor is still over the arrow; keep it highlighted
+            return;
         }
     }
 
@@ -3,8 +3,10 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "Materials/MaterialInstanceDynamic.h"
+#include "EditorSnapping.h"
 #include "MoveArrows.generated.h"
 
+class ATruGameObject;
 
 UENUM()
 enum class EArrowMode : uint8
@@ -47,6 +49,19 @@ public:
     UStaticMeshComponent* GetRightArrow() const { return Right; }
 
     void SetVisibility(bool bVisible);
+    bool IsVisible() const { return Forward->IsVisible(); }
+    UStaticMeshComponent* GetHighlightedArrow() const { return HighlightedArrow; }
+
+    /**
+     * Arrow under the ray, or null. Each arrow is tested analytically in its own component space as a capsule (shaft)
+     * and a cone (head) sized from its mesh bounds, so the distance scale applied in Tick is taken into account.
+     * Arrows are checked in the order forward, up, right and the first hit wins, as the component traces did.
+     * The answer is reused while neither the ray nor the gizmo transform has changed. Never allocates or touches physics.
+     */
+    UStaticMeshComponent* HitTestArrows(const FVector& RayOrigin, const FVector& RayDirection, double RayLength);
+
+    /** Forgets an object destroyed in the middle of a drag. */
+    void OnGameObjectRemoved(ATruGameObject* GameObject);
 private:
     // Root component
     UPROPERTY(VisibleAnywhere)
@@ -72,6 +87,13 @@ private:
     UPROPERTY(EditAnywhere, Category = "Materials")
     UMaterialInterface* ForwardMaterial;
 
+    // Hit shapes, relative to each arrow mesh's bounds. The arrow axis is the longest side of the bounds.
+    UPROPERTY(EditAnywhere, Category = "Hit Testing", meta = (ClampMin = "0", ClampMax = "1"))
+    float HeadLengthFraction = 0.25f;   // Part of the arrow length taken by the cone
+
+    UPROPERTY(EditAnywhere, Category = "Hit Testing", meta = (ClampMin = "0", ClampMax = "1"))
+    float ShaftRadiusFraction = 0.4f;   // Shaft radius relative to the cone radius, for meshes whose vertices can't be read
+
     UStaticMeshComponent* HighlightedArrow = nullptr;
 
     // Dynamic Material Instances
@@ -91,6 +113,7 @@ private:
 
     // Dragging variables
     bool bIsDragging;
+    bool bTransactionOpen = false;
     UStaticMeshComponent* DraggedComponent;
     FVector DragDirection;
     FVector DragStartLocation;
@@ -99,5 +122,39 @@ private:
     FVector MouseStartWorldLocation;
     FPlane DragPlane;
 
+    struct FArrowHitShape
+    {
+        // Component space
+        FVector Tail = FVector::ZeroVector;
+        FVector HeadBase = FVector::ZeroVector;
+        FVector Tip = FVector::ZeroVector;
+        double ShaftRadius = 0.0;
+        double HeadRadius = 0.0;
+    };
+
+    // Forward, Up, Right
+    FArrowHitShape ArrowHitShapes[3];
+    void BuildHitShapes();
+    static double GetShaftRadius(const UStaticMesh& Mesh, const FVector& Center, int32 Axis, double HeadStart);
+    static bool IntersectHitShape(const FArrowHitShape& Shape, const FVector& Start, const FVector& Delta);
+
+    // Last hit test, reused while its inputs are unchanged
+    FVector CachedRayOrigin = FVector::ZeroVector;
+    FVector CachedRayEnd = FVector::ZeroVector;
+    FTransform CachedGizmoTransform;
+    bool bHitCacheValid = false;
+    bool bCachedVisible = false;
+    UStaticMeshComponent* CachedHitArrow = nullptr;
+
+    // Selected objects without a selected ancestor, and where they were when the drag started.
+    // Kept as parallel contiguous arrays so the per-frame update is one pass over each.
+    TArray<ATruGameObject*> DragObjects;
+    TArray<FVector> DragObjectStartLocations;
+    TArray<FVector> DragObjectTargetLocations;
+    FVector AppliedDragOffset = FVector::ZeroVector;
+    FEditorDragSnap DragSnap;
+
     void StartDragging(UStaticMeshComponent* Component, FVector Direction);
+    /** Moves the dragged objects by Offset from their start locations; does nothing if Offset did not change. */
+    void ApplyDragOffset(const FVector& Offset);
 };
@@ -1,93 +1,386 @@
 #include "EditorUI.h"
 #include "Engine/World.h"
+#include "EngineUtils.h"
+#include "truworld/GameObjects/TruEntityStore.h"
 #include "truworld/GameObjects/TruGameObject.h"
 #include "TruGameObjectWidget.h"
 #include "Components/VerticalBox.h"
 #include "Components/VerticalBoxSlot.h"
-#include "Kismet/GameplayStatics.h"
+#include "ContextMenuWidget.h"
+#include "truworld/Editor/EditorChangeHub.h"
+#include "Blueprint/WidgetLayoutLibrary.h"
+#include "Rendering/DrawElements.h"
+#include "Styling/CoreStyle.h"
 
 void UEditorUI::Refresh()
 {
-	UE_LOG(LogTemp, Log, TEXT("Refresh called! ATruGameObject was added or removed."));
+	UE_LOG(LogTemp, Log, TEXT("Refresh called! Rebuilding the outliner from the level."));
 
 	if (!ObjectsInLevel)
 	{
 		return;
 	}
 
-	// Clear existing widgets
-	ObjectsInLevel->ClearChildren();
-
 	// Get all ATruGameObject instances in the level
-	TArray<AActor*> FoundActors;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), ATruGameObject::StaticClass(), FoundActors);
+	TArray<ATruGameObject*> FoundObjects;
+	for (TActorIterator<ATruGameObject> It(GetWorld()); It; ++It)
+	{
+		if (!It->IsPooled())
+		{
+			FoundObjects.Add(*It);
+		}
+	}
+
+	TArray<FTruObjectId> EntityIds;
+	if (UTruEntityStore* EntityStore = UTruEntityStore::Get(this))
+	{
+		EntityStore->GetEntityIds(EntityIds);
+	}
+
+	OutlinerModel.Reset(FoundObjects, EntityIds);
+
+	// Names may have changed without an event, so every widget is bound again
+	for (FOutlinerRow& BoundRow : BoundRows)
+	{
+		BoundRow = FOutlinerRow();
+	}
+	SyncRows(0);
+}
+
+int32 UEditorUI::AddToModel(ATruGameObject* GameObject, const TSet<ATruGameObject*>& Batch)
+{
+	if (!GameObject || OutlinerModel.Contains(GameObject))
+	{
+		return INDEX_NONE;
+	}
+
+	int32 FirstChangedRow = MAX_int32;
+	ATruGameObject* Parent = GameObject->GetParentGameObject();
+	if (Parent && Batch.Contains(Parent) && !OutlinerModel.Contains(Parent))
+	{
+		const int32 ParentRow = AddToModel(Parent, Batch);
+		if (ParentRow != INDEX_NONE)
+		{
+			FirstChangedRow = ParentRow;
+		}
+	}
 
-	// Build a parent-to-children map
-	TMap<ATruGameObject*, TArray<ATruGameObject*>> ParentToChildrenMap;
+	const int32 Row = OutlinerModel.Add(GameObject, Parent);
+	return Row == INDEX_NONE ? (FirstChangedRow == MAX_int32 ? INDEX_NONE : FirstChangedRow) : FMath::Min(FirstChangedRow, Row);
+}
 
-	for (AActor* Actor : FoundActors)
+void UEditorUI::ApplyChanges(const FEditorChangeSet& Changes, ATruGameObject* SelectedGameObject)
+{
+	int32 FirstChangedRow = MAX_int32;
+	auto NoteChangedRow = [&FirstChangedRow](int32 Row)
 	{
-		ATruGameObject* GameObject = Cast<ATruGameObject>(Actor);
-		if (GameObject)
+		if (Row != INDEX_NONE)
 		{
-			ATruGameObject* Parent = Cast<ATruGameObject>(GameObject->GetParentActor());
-			ParentToChildrenMap.FindOrAdd(Parent).Add(GameObject);
+			FirstChangedRow = FMath::Min(FirstChangedRow, Row);
 		}
+	};
+
+	for (ATruGameObject* GameObject : Changes.Removed)
+	{
+		NoteChangedRow(OutlinerModel.Remove(GameObject));
+	}
+
+	// Demoted and promoted objects keep their row; only what it shows changes
+	for (const TPair<FTruObjectId, ATruGameObject*>& Demoted : Changes.Demoted)
+	{
+		NoteChangedRow(OutlinerModel.ReplaceWithEntity(Demoted.Value, Demoted.Key));
 	}
+	for (const TPair<FTruObjectId, ATruGameObject*>& Promoted : Changes.Promoted)
+	{
+		NoteChangedRow(OutlinerModel.ReplaceWithObject(Promoted.Key, Promoted.Value));
+	}
+
+	const TSet<ATruGameObject*> Batch(Changes.Added);
+	for (ATruGameObject* GameObject : Changes.Added)
+	{
+		NoteChangedRow(AddToModel(GameObject, Batch));
+	}
+
+	for (ATruGameObject* GameObject : Changes.Reparented)
+	{
+		NoteChangedRow(OutlinerModel.Reparent(GameObject, GameObject->GetParentGameObject()));
+	}
+
+	SyncRows(FirstChangedRow == MAX_int32 ? INDEX_NONE : FirstChangedRow);
 
-	// Start with root objects (objects with no parent)
-	TArray<ATruGameObject*>* RootObjects = ParentToChildrenMap.Find(nullptr);
-	if (RootObjects)
+	// Renames do not move rows; only rows on screen have a widget to rebind
+	for (ATruGameObject* GameObject : Changes.Renamed)
 	{
-		for (ATruGameObject* RootObject : *RootObjects)
+		const int32 PoolIndex = OutlinerModel.FindRow(GameObject) - FirstVisibleRow;
+		if (OutlinerModel.Contains(GameObject) && RowWidgets.IsValidIndex(PoolIndex))
 		{
-			AddGameObjectWidget(RootObject, 0, ParentToChildrenMap);
+			BindPooledWidget(PoolIndex, /*bForce*/ true);
 		}
 	}
+
+	if (EnumHasAnyFlags(Changes.Flags, EEditorChangeFlags::Selection))
+	{
+		OnSelectedObject(SelectedGameObject);
+	}
 }
 
-void UEditorUI::AddGameObjectWidget(ATruGameObject* GameObject, int32 IndentLevel, TMap<ATruGameObject*, TArray<ATruGameObject*>>& ParentToChildrenMap)
+void UEditorUI::SyncRows(int32 FirstChangedRow)
 {
-	if (!GameObject || !ObjectsInLevel)
+	if (FirstChangedRow == INDEX_NONE || !ObjectsInLevel)
 	{
 		return;
 	}
 
-	UTruGameObjectWidget* Widget = CreateWidget<UTruGameObjectWidget>(this, GameObjectWidgetClass);
-	if (Widget)
+	const int32 NumRows = OutlinerModel.GetRows().Num();
+	const int32 PoolSize = FMath::Min(VisibleRowCount, NumRows);
+
+	// Rows removed at the bottom can pull the window up; everything on screen then shows a new row
+	const int32 ClampedFirstRow = ClampFirstVisibleRow(FirstVisibleRow);
+	if (ClampedFirstRow != FirstVisibleRow)
 	{
-		Widget->Setup(GameObject, this);
+		FirstVisibleRow = ClampedFirstRow;
+		FirstChangedRow = 0;
+	}
 
-		// Add the widget to the vertical box
-		UVerticalBoxSlot* VerticalBoxSlot = ObjectsInLevel->AddChildToVerticalBox(Widget);
-		if (VerticalBoxSlot)
+	// Widgets are only created until the pool covers the visible window
+	const int32 OldPoolSize = RowWidgets.Num();
+	while (RowWidgets.Num() < PoolSize)
+	{
+		UTruGameObjectWidget* Widget = CreateWidget<UTruGameObjectWidget>(this, GameObjectWidgetClass);
+		if (!Widget)
 		{
-			// Set padding based on indent level
-			float LeftPadding = IndentLevel * 20.f;
-			VerticalBoxSlot->SetPadding(FMargin(LeftPadding, 0.f, 0.f, 0.f));
+			return;
 		}
+		ObjectsInLevel->AddChildToVerticalBox(Widget);
+		RowWidgets.Add(Widget);
+		BoundRows.AddDefaulted();
+	}
 
-		// Recursively add children
-		TArray<ATruGameObject*>* Children = ParentToChildrenMap.Find(GameObject);
-		if (Children)
-		{
-			for (ATruGameObject* Child : *Children)
-			{
-				AddGameObjectWidget(Child, IndentLevel + 1, ParentToChildrenMap);
-			}
-		}
+	while (RowWidgets.Num() > PoolSize)
+	{
+		RowWidgets.Pop()->RemoveFromParent();
+		BoundRows.Pop();
+	}
+
+	const int32 FirstChangedPoolIndex = FMath::Min(FMath::Max(0, FirstChangedRow - FirstVisibleRow), OldPoolSize);
+	for (int32 PoolIndex = FirstChangedPoolIndex; PoolIndex < RowWidgets.Num(); ++PoolIndex)
+	{
+		BindPooledWidget(PoolIndex);
+	}
+}
+
+void UEditorUI::BindPooledWidget(int32 PoolIndex, bool bForce)
+{
+	const FOutlinerRow& Row = OutlinerModel.GetRows()[FirstVisibleRow + PoolIndex];
+	if (!bForce && BoundRows[PoolIndex] == Row)
+	{
+		return;
+	}
+	BoundRows[PoolIndex] = Row;
+
+	UTruGameObjectWidget* Widget = RowWidgets[PoolIndex];
+	Widget->Setup(Row.GetGameObject(), Row.EntityId, this);
+
+	if (UVerticalBoxSlot* VerticalBoxSlot = Cast<UVerticalBoxSlot>(Widget->Slot))
+	{
+		// Set padding based on indent level
+		float LeftPadding = Row.IndentLevel * 20.f;
+		VerticalBoxSlot->SetPadding(FMargin(LeftPadding, 0.f, 0.f, 0.f));
+	}
+}
+
+int32 UEditorUI::ClampFirstVisibleRow(int32 RowIndex) const
+{
+	const int32 MaxFirstRow = FMath::Max(0, OutlinerModel.GetRows().Num() - VisibleRowCount);
+	return FMath::Clamp(RowIndex, 0, MaxFirstRow);
+}
+
+void UEditorUI::SetFirstVisibleRow(int32 RowIndex)
+{
+	const int32 NewFirstRow = ClampFirstVisibleRow(RowIndex);
+	if (NewFirstRow == FirstVisibleRow)
+	{
+		return;
+	}
+
+	FirstVisibleRow = NewFirstRow;
+
+	// A context menu opened on a pooled row would act on whatever that row shows after the scroll
+	if (ContextMenuWidget)
+	{
+		ContextMenuWidget->SetVisibility(ESlateVisibility::Collapsed);
+	}
+
+	for (int32 PoolIndex = 0; PoolIndex < RowWidgets.Num(); ++PoolIndex)
+	{
+		BindPooledWidget(PoolIndex);
+	}
+}
+
+void UEditorUI::ScrollRowIntoView(int32 RowIndex)
+{
+	if (RowIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	if (RowIndex < FirstVisibleRow || RowIndex >= FirstVisibleRow + RowWidgets.Num())
+	{
+		SetFirstVisibleRow(RowIndex - RowWidgets.Num() / 2);
+	}
+}
+
+FReply UEditorUI::NativeOnMouseWheel(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent)
+{
+	if (ObjectsInLevel && ObjectsInLevel->GetCachedGeometry().IsUnderLocation(InMouseEvent.GetScreenSpacePosition()))
+	{
+		const int32 Steps = FMath::RoundToInt(InMouseEvent.GetWheelDelta());
+		SetFirstVisibleRow(FirstVisibleRow - Steps * RowsPerWheelStep);
+		return FReply::Handled();
+	}
+
+	return Super::NativeOnMouseWheel(InGeometry, InMouseEvent);
+}
+
+bool UEditorUI::GetScrollBarRects(const FGeometry& MyGeometry, FBox2D& OutTrack, FBox2D& OutThumb) const
+{
+	const int32 NumRows = OutlinerModel.GetRows().Num();
+	if (!ObjectsInLevel || NumRows <= VisibleRowCount)
+	{
+		return false;
+	}
+
+	// The track runs down the inside of the row list's right edge
+	const FGeometry& ListGeometry = ObjectsInLevel->GetCachedGeometry();
+	const FVector2D ListMin = MyGeometry.AbsoluteToLocal(ListGeometry.LocalToAbsolute(FVector2D::ZeroVector));
+	const FVector2D ListMax = MyGeometry.AbsoluteToLocal(ListGeometry.LocalToAbsolute(ListGeometry.GetLocalSize()));
+	if (ListMax.Y <= ListMin.Y)
+	{
+		return false;
 	}
+	OutTrack = FBox2D(FVector2D(ListMax.X - ScrollBarWidth, ListMin.Y), ListMax);
+
+	// The thumb is as long as the share of rows on screen, but never too short to grab
+	const double TrackHeight = OutTrack.GetSize().Y;
+	const double ThumbHeight = FMath::Clamp(TrackHeight * VisibleRowCount / NumRows, FMath::Min(2.0 * ScrollBarWidth, TrackHeight), TrackHeight);
+	const double ThumbTop = OutTrack.Min.Y + (TrackHeight - ThumbHeight) * FirstVisibleRow / (NumRows - VisibleRowCount);
+	OutThumb = FBox2D(FVector2D(OutTrack.Min.X, ThumbTop), FVector2D(OutTrack.Max.X, ThumbTop + ThumbHeight));
+	return true;
+}
+
+void UEditorUI::ScrollToThumb(const FGeometry& MyGeometry, double ThumbTop)
+{
+	FBox2D Track;
+	FBox2D Thumb;
+	if (!GetScrollBarRects(MyGeometry, Track, Thumb))
+	{
+		return;
+	}
+
+	const double Travel = Track.GetSize().Y - Thumb.GetSize().Y;
+	const double Fraction = Travel > 0.0 ? FMath::Clamp((ThumbTop - Track.Min.Y) / Travel, 0.0, 1.0) : 0.0;
+	SetFirstVisibleRow(FMath::RoundToInt(Fraction * (OutlinerModel.GetRows().Num() - VisibleRowCount)));
+}
+
+FReply UEditorUI::NativeOnMouseButtonDown(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent)
+{
+	FBox2D Track;
+	FBox2D Thumb;
+	const FVector2D LocalPosition = InGeometry.AbsoluteToLocal(InMouseEvent.GetScreenSpacePosition());
+	if (InMouseEvent.GetEffectingButton() != EKeys::LeftMouseButton || !GetScrollBarRects(InGeometry, Track, Thumb) || !Track.IsInside(LocalPosition))
+	{
+		return Super::NativeOnMouseButtonDown(InGeometry, InMouseEvent);
+	}
+
+	// A press on the track away from the thumb centres the thumb there, then drags it like a press on the thumb
+	if (Thumb.IsInside(LocalPosition))
+	{
+		ThumbGrabOffset = LocalPosition.Y - Thumb.Min.Y;
+	}
+	else
+	{
+		ThumbGrabOffset = Thumb.GetSize().Y * 0.5;
+		ScrollToThumb(InGeometry, LocalPosition.Y - ThumbGrabOffset);
+	}
+	return FReply::Handled().CaptureMouse(TakeWidget());
+}
+
+FReply UEditorUI::NativeOnMouseMove(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent)
+{
+	if (ThumbGrabOffset < 0.0 || !HasMouseCapture())
+	{
+		return Super::NativeOnMouseMove(InGeometry, InMouseEvent);
+	}
+
+	const FVector2D LocalPosition = InGeometry.AbsoluteToLocal(InMouseEvent.GetScreenSpacePosition());
+	ScrollToThumb(InGeometry, LocalPosition.Y - ThumbGrabOffset);
+	return FReply::Handled();
+}
+
+FReply UEditorUI::NativeOnMouseButtonUp(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent)
+{
+	if (ThumbGrabOffset < 0.0)
+	{
+		return Super::NativeOnMouseButtonUp(InGeometry, InMouseEvent);
+	}
+
+	ThumbGrabOffset = -1.0;
+	return FReply::Handled().ReleaseMouseCapture();
 }
 
 void UEditorUI::OnSelectedObject(ATruGameObject* SelectedGameObject)
 {
-	// You mentioned you'll implement the rest
-	for(UWidget* widget : ObjectsInLevel->GetAllChildren())
+	if (SelectedGameObject)
 	{
-		UTruGameObjectWidget* casted_widget = Cast<UTruGameObjectWidget>(widget);
-		if(casted_widget)
-			casted_widget->UpdateBorderColor();
+		ScrollRowIntoView(OutlinerModel.FindRow(SelectedGameObject));
 	}
+
+	// Only the pooled widgets exist, so this is bounded by VisibleRowCount
+	for (UTruGameObjectWidget* Widget : RowWidgets)
+	{
+		Widget->UpdateBorderColor();
+	}
+}
+
+void UEditorUI::SetMarquee(const FBox2D& ViewportRect)
+{
+	// The UI covers the whole viewport, so only the DPI scale separates viewport pixels from widget space
+	const float ViewportScale = UWidgetLayoutLibrary::GetViewportScale(this);
+	MarqueeRect = ViewportScale > 0.f ? FBox2D(ViewportRect.Min / ViewportScale, ViewportRect.Max / ViewportScale) : ViewportRect;
+}
+
+void UEditorUI::ClearMarquee()
+{
+	MarqueeRect = FBox2D(ForceInit);
+}
+
+int32 UEditorUI::NativePaint(const FPaintArgs& Args, const FGeometry& AllottedGeometry, const FSlateRect& MyCullingRect, FSlateWindowElementList& OutDrawElements, int32 LayerId, const FWidgetStyle& InWidgetStyle, bool bParentEnabled) const
+{
+	LayerId = Super::NativePaint(Args, AllottedGeometry, MyCullingRect, OutDrawElements, LayerId, InWidgetStyle, bParentEnabled);
+
+	FBox2D Track;
+	FBox2D Thumb;
+	if (GetScrollBarRects(AllottedGeometry, Track, Thumb))
+	{
+		const FSlateBrush* WhiteBox = FCoreStyle::Get().GetBrush("GenericWhiteBox");
+		FSlateDrawElement::MakeBox(OutDrawElements, ++LayerId, AllottedGeometry.ToPaintGeometry(Track.GetSize(), FSlateLayoutTransform(Track.Min)),
+			WhiteBox, ESlateDrawEffect::None, FLinearColor(0.0f, 0.0f, 0.0f, 0.3f));
+		FSlateDrawElement::MakeBox(OutDrawElements, ++LayerId, AllottedGeometry.ToPaintGeometry(Thumb.GetSize(), FSlateLayoutTransform(Thumb.Min)),
+			WhiteBox, ESlateDrawEffect::None, FLinearColor(1.0f, 1.0f, 1.0f, ThumbGrabOffset >= 0.0 ? 0.8f : 0.5f));
+	}
+
+	if (!MarqueeRect.bIsValid)
+	{
+		return LayerId;
+	}
+
+	const FVector2D Size = MarqueeRect.GetSize();
+	const FPaintGeometry PaintGeometry = AllottedGeometry.ToPaintGeometry(Size, FSlateLayoutTransform(MarqueeRect.Min));
+	FSlateDrawElement::MakeBox(OutDrawElements, ++LayerId, PaintGeometry, FCoreStyle::Get().GetBrush("GenericWhiteBox"), ESlateDrawEffect::None, FLinearColor(0.3f, 0.5f, 1.0f, 0.15f));
+
+	const TArray<FVector2D> Outline = { FVector2D(0.0, 0.0), FVector2D(Size.X, 0.0), Size, FVector2D(0.0, Size.Y), FVector2D(0.0, 0.0) };
+	FSlateDrawElement::MakeLines(OutDrawElements, ++LayerId, PaintGeometry, Outline, ESlateDrawEffect::None, FLinearColor(0.3f, 0.5f, 1.0f, 1.0f), true, 1.0f);
+	return LayerId;
 }
 
 void UEditorUI::NativeConstruct()
@@ -98,5 +391,6 @@ void UEditorUI::NativeConstruct()
 
 void UEditorUI::NativeDestruct()
 {
+	OutlinerModel.Empty();
 	Super::NativeDestruct();
 }
\ No newline at end of file
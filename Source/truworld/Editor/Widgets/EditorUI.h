@@ -2,28 +2,80 @@
 
 #include "CoreMinimal.h"
 #include "Blueprint/UserWidget.h"
+#include "OutlinerModel.h"
 #include "EditorUI.generated.h"
 
+class ATruGameObject;
+struct FEditorChangeSet;
+
 UCLASS()
 class TRUWORLD_API UEditorUI : public UUserWidget
 {
 	GENERATED_BODY()
 	
 public:
+	/** Rebuilds the outliner model from every ATruGameObject in the level. Only used on demand. */
 	void Refresh();
 	void OnSelectedObject(class ATruGameObject* SelectedGameObject);
+	/** Applies one frame's worth of changes to the model with a single row sync. */
+	void ApplyChanges(const FEditorChangeSet& Changes, ATruGameObject* SelectedGameObject);
 
 	class UContextMenuWidget* GetContextWindow() const { return ContextMenuWidget; }
+
+	/** Scrolls the outliner so that RowIndex is the first visible row (clamped to the row range). */
+	void SetFirstVisibleRow(int32 RowIndex);
+	void ScrollRowIntoView(int32 RowIndex);
+
+	/** Shows the selection rectangle, given in viewport pixels, until ClearMarquee is called. */
+	void SetMarquee(const FBox2D& ViewportRect);
+	void ClearMarquee();
 protected:
 	virtual void NativeConstruct() override;
 	virtual void NativeDestruct() override;
+	virtual FReply NativeOnMouseWheel(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent) override;
+	// Scrollbar dragging; presses anywhere else fall through to the viewport
+	virtual FReply NativeOnMouseButtonDown(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent) override;
+	virtual FReply NativeOnMouseMove(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent) override;
+	virtual FReply NativeOnMouseButtonUp(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent) override;
+	virtual int32 NativePaint(const FPaintArgs& Args, const FGeometry& AllottedGeometry, const FSlateRect& MyCullingRect, FSlateWindowElementList& OutDrawElements, int32 LayerId, const FWidgetStyle& InWidgetStyle, bool bParentEnabled) const override;
 
 	UPROPERTY(meta=(BindWidget)) TObjectPtr<class UContextMenuWidget> ContextMenuWidget;
 	UPROPERTY(meta=(BindWidget)) TObjectPtr<class UVerticalBox> ObjectsInLevel;
 	UPROPERTY(EditAnywhere) TSubclassOf<class UTruGameObjectWidget> GameObjectWidgetClass;
+
+	// Size of the row widget pool, i.e. how many outliner rows are on screen at once
+	UPROPERTY(EditAnywhere, Category = "Outliner", meta = (ClampMin = "1")) int32 VisibleRowCount = 40;
+	// Rows scrolled per mouse wheel notch
+	UPROPERTY(EditAnywhere, Category = "Outliner", meta = (ClampMin = "1")) int32 RowsPerWheelStep = 3;
+	// Width of the scrollbar drawn along the right edge of the row list while not every row fits
+	UPROPERTY(EditAnywhere, Category = "Outliner", meta = (ClampMin = "2")) float ScrollBarWidth = 8.f;
 private:
 	FDelegateHandle ActorSpawnedDelegateHandle;
 
-	void AddGameObjectWidget(ATruGameObject* GameObject, int32 IndentLevel, TMap<ATruGameObject*, TArray<ATruGameObject*>>& ParentToChildrenMap);
+	/** Sizes the widget pool to the visible window and rebinds pooled widgets showing rows at or after FirstChangedRow. */
+	void SyncRows(int32 FirstChangedRow);
+	/** Points a pooled widget at its row. Skipped when the widget already shows that row, unless bForce (a rename). */
+	void BindPooledWidget(int32 PoolIndex, bool bForce = false);
+	int32 AddToModel(ATruGameObject* GameObject, const TSet<ATruGameObject*>& Batch);
+	int32 ClampFirstVisibleRow(int32 RowIndex) const;
+
+	/** Scrollbar track and thumb in this widget's space; false while every row fits on screen. */
+	bool GetScrollBarRects(const FGeometry& MyGeometry, FBox2D& OutTrack, FBox2D& OutThumb) const;
+	/** Scrolls so that the thumb's top edge sits at ThumbTop, in this widget's space. */
+	void ScrollToThumb(const FGeometry& MyGeometry, double ThumbTop);
+
+	FOutlinerModel OutlinerModel;
+
+	// Fixed pool of row widgets. Pool entry N shows model row FirstVisibleRow + N, so the widget count
+	// never exceeds VisibleRowCount no matter how many objects are in the level.
+	UPROPERTY() TArray<TObjectPtr<class UTruGameObjectWidget>> RowWidgets;
+	/** What each pooled widget was last bound to, so a shift that leaves a widget on the same row costs nothing. */
+	TArray<FOutlinerRow> BoundRows;
+	int32 FirstVisibleRow = 0;
+	// Where the thumb was grabbed, from its top edge; negative while it is not being dragged
+	double ThumbGrabOffset = -1.0;
+
+	// Selection rectangle in widget space; invalid while no marquee is being dragged
+	FBox2D MarqueeRect = FBox2D(ForceInit);
 
 };
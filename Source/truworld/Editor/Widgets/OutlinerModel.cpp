@@ -0,0 +1,369 @@
+#include "OutlinerModel.h"
+
+#include "truworld/GameObjects/TruGameObject.h"
+
+void FOutlinerModel::Reset(const TArray<ATruGameObject*>& GameObjects, const TArray<FTruObjectId>& EntityIds)
+{
+	Empty();
+
+	TSet<ATruGameObject*> Known(GameObjects);
+	TArray<ATruGameObject*> RootObjects;
+	for (ATruGameObject* GameObject : GameObjects)
+	{
+		if (!GameObject)
+		{
+			continue;
+		}
+
+		ATruGameObject* Parent = GameObject->GetParentGameObject();
+		if (!Known.Contains(Parent))
+		{
+			Parent = nullptr;
+		}
+		ChildToParentMap.Add(GameObject, Parent);
+		if (Parent)
+		{
+			ParentToChildrenMap.FindOrAdd(Parent).Add(GameObject);
+		}
+		else
+		{
+			RootObjects.Add(GameObject);
+		}
+	}
+
+	// Start with root objects (objects with no parent)
+	for (ATruGameObject* RootObject : RootObjects)
+	{
+		AppendSubtree(RootObject, 0);
+	}
+
+	for (const FTruObjectId EntityId : EntityIds)
+	{
+		AddEntityRow(EntityId);
+	}
+}
+
+void FOutlinerModel::Empty()
+{
+	Rows.Reset();
+	RowIndices.Reset();
+	EntityRowIndices.Reset();
+	FirstStaleRow = MAX_int32;
+	ParentToChildrenMap.Reset();
+	ChildToParentMap.Reset();
+}
+
+int32 FOutlinerModel::Add(ATruGameObject* GameObject, ATruGameObject* Parent)
+{
+	if (!GameObject || Contains(GameObject))
+	{
+		return INDEX_NONE;
+	}
+
+	// A parent that is not in the outliner yet is treated as a root; the next full refresh fixes it up
+	if (Parent && !Contains(Parent))
+	{
+		Parent = nullptr;
+	}
+
+	ChildToParentMap.Add(GameObject, Parent);
+	if (Parent)
+	{
+		ParentToChildrenMap.FindOrAdd(Parent).Add(GameObject);
+	}
+
+	int32 InsertAt = Rows.Num();
+	int32 IndentLevel = 0;
+	if (Parent)
+	{
+		const int32 ParentRow = FindKeyRow(Parent);
+		InsertAt = ParentRow + GetSubtreeSize(ParentRow);
+		IndentLevel = Rows[ParentRow].IndentLevel + 1;
+	}
+
+	FOutlinerRow& Row = Rows.InsertDefaulted_GetRef(InsertAt);
+	Row.GameObject = GameObject;
+	Row.IndentLevel = IndentLevel;
+	MarkStale(InsertAt + 1);
+	RowIndices.Add(GameObject, InsertAt);
+	return InsertAt;
+}
+
+int32 FOutlinerModel::Remove(ATruGameObject* GameObject)
+{
+	if (!Contains(GameObject))
+	{
+		return INDEX_NONE;
+	}
+
+	const FGameObjectKey Parent = ChildToParentMap.FindRef(GameObject);
+	int32 FirstChangedRow = MAX_int32;
+
+	// Children that outlive their parent move up one level
+	const TArray<FGameObjectKey> Children = ParentToChildrenMap.FindRef(GameObject);
+	for (const FGameObjectKey Child : Children)
+	{
+		const int32 ChangedRow = ReparentKey(Child, Parent);
+		if (ChangedRow != INDEX_NONE)
+		{
+			FirstChangedRow = FMath::Min(FirstChangedRow, ChangedRow);
+		}
+	}
+
+	const int32 Row = FindKeyRow(GameObject);
+	RowIndices.Remove(GameObject);
+	Rows.RemoveAt(Row);
+	MarkStale(Row);
+
+	if (TArray<FGameObjectKey>* Siblings = ParentToChildrenMap.Find(Parent))
+	{
+		Siblings->Remove(GameObject);
+	}
+	ParentToChildrenMap.Remove(GameObject);
+	ChildToParentMap.Remove(GameObject);
+
+	return FMath::Min(FirstChangedRow, Row);
+}
+
+int32 FOutlinerModel::Reparent(ATruGameObject* GameObject, ATruGameObject* NewParent)
+{
+	return ReparentKey(GameObject, NewParent);
+}
+
+int32 FOutlinerModel::ReparentKey(FGameObjectKey GameObject, FGameObjectKey NewParent)
+{
+	const FGameObjectKey NoObject;
+	if (!RowIndices.Contains(GameObject))
+	{
+		return INDEX_NONE;
+	}
+
+	if (NewParent != NoObject && !RowIndices.Contains(NewParent))
+	{
+		NewParent = NoObject;
+	}
+
+	const FGameObjectKey OldParent = ChildToParentMap.FindRef(GameObject);
+	if (OldParent == NewParent || NewParent == GameObject || IsAncestorOf(GameObject, NewParent))
+	{
+		return INDEX_NONE;
+	}
+
+	// Both rows are looked up before anything moves, so at most one renumbering is needed
+	const int32 Row = FindKeyRow(GameObject);
+	int32 ParentRow = NewParent != NoObject ? FindKeyRow(NewParent) : INDEX_NONE;
+
+	// Lift the whole subtree out as one contiguous block
+	const int32 Size = GetSubtreeSize(Row);
+	TArray<FOutlinerRow> Block(Rows.GetData() + Row, Size);
+	Rows.RemoveAt(Row, Size);
+
+	if (TArray<FGameObjectKey>* OldSiblings = ParentToChildrenMap.Find(OldParent))
+	{
+		OldSiblings->Remove(GameObject);
+	}
+	if (NewParent != NoObject)
+	{
+		ParentToChildrenMap.FindOrAdd(NewParent).Add(GameObject);
+	}
+	ChildToParentMap.Add(GameObject, NewParent);
+
+	int32 InsertAt = Rows.Num();
+	int32 IndentLevel = 0;
+	if (NewParent != NoObject)
+	{
+		if (ParentRow > Row)
+		{
+			ParentRow -= Size;
+		}
+		InsertAt = ParentRow + GetSubtreeSize(ParentRow);
+		IndentLevel = Rows[ParentRow].IndentLevel + 1;
+	}
+
+	const int32 IndentDelta = IndentLevel - Block[0].IndentLevel;
+	for (FOutlinerRow& BlockRow : Block)
+	{
+		BlockRow.IndentLevel += IndentDelta;
+	}
+	Rows.Insert(Block, InsertAt);
+
+	const int32 FirstChangedRow = FMath::Min(Row, InsertAt);
+	MarkStale(FirstChangedRow);
+	return FirstChangedRow;
+}
+
+int32 FOutlinerModel::ReplaceWithEntity(ATruGameObject* GameObject, FTruObjectId EntityId)
+{
+	if (ContainsEntity(EntityId))
+	{
+		return INDEX_NONE;
+	}
+
+	// Only childless roots are demoted; anything else is removed and the entity added at the end
+	const TArray<FGameObjectKey>* Children = ParentToChildrenMap.Find(GameObject);
+	if (!Contains(GameObject) || ChildToParentMap.FindRef(GameObject) != FGameObjectKey() || (Children && Children->Num() > 0))
+	{
+		const int32 RemovedRow = Remove(GameObject);
+		const int32 AddedRow = AddEntityRow(EntityId);
+		return RemovedRow == INDEX_NONE ? AddedRow : FMath::Min(RemovedRow, AddedRow);
+	}
+
+	// The row stays where it is, so no other index changes
+	const int32 RowIndex = FindKeyRow(GameObject);
+	RowIndices.Remove(GameObject);
+	ParentToChildrenMap.Remove(GameObject);
+	ChildToParentMap.Remove(GameObject);
+
+	FOutlinerRow& Row = Rows[RowIndex];
+	Row = FOutlinerRow();
+	Row.EntityId = EntityId;
+	EntityRowIndices.Add(EntityId, RowIndex);
+	return RowIndex;
+}
+
+int32 FOutlinerModel::ReplaceWithObject(FTruObjectId EntityId, ATruGameObject* GameObject)
+{
+	if (!GameObject || Contains(GameObject))
+	{
+		return RemoveEntity(EntityId);
+	}
+
+	// Promoted objects always come back as roots
+	const int32 RowIndex = FindEntityRow(EntityId);
+	if (RowIndex == INDEX_NONE)
+	{
+		return Add(GameObject, nullptr);
+	}
+	EntityRowIndices.Remove(EntityId);
+
+	ChildToParentMap.Add(GameObject, FGameObjectKey());
+	FOutlinerRow& Row = Rows[RowIndex];
+	Row = FOutlinerRow();
+	Row.GameObject = GameObject;
+	RowIndices.Add(GameObject, RowIndex);
+	return RowIndex;
+}
+
+int32 FOutlinerModel::RemoveEntity(FTruObjectId EntityId)
+{
+	const int32 Row = FindEntityRow(EntityId);
+	if (Row == INDEX_NONE)
+	{
+		return INDEX_NONE;
+	}
+
+	EntityRowIndices.Remove(EntityId);
+	Rows.RemoveAt(Row);
+	MarkStale(Row);
+	return Row;
+}
+
+int32 FOutlinerModel::FindRow(const ATruGameObject* GameObject) const
+{
+	return FindKeyRow(GameObject);
+}
+
+int32 FOutlinerModel::FindKeyRow(FGameObjectKey GameObject) const
+{
+	const int32* Row = RowIndices.Find(GameObject);
+	if (!Row)
+	{
+		return INDEX_NONE;
+	}
+
+	// Rows above the watermark have not moved, and an index that still finds its object is right wherever it is
+	if (*Row < FirstStaleRow || (Rows.IsValidIndex(*Row) && Rows[*Row].GameObject == GameObject))
+	{
+		return *Row;
+	}
+
+	RefreshIndices();
+	return RowIndices.FindChecked(GameObject);
+}
+
+int32 FOutlinerModel::FindEntityRow(FTruObjectId EntityId) const
+{
+	const int32* Row = EntityRowIndices.Find(EntityId);
+	if (!Row)
+	{
+		return INDEX_NONE;
+	}
+
+	if (*Row < FirstStaleRow || (Rows.IsValidIndex(*Row) && Rows[*Row].EntityId == EntityId))
+	{
+		return *Row;
+	}
+
+	RefreshIndices();
+	return EntityRowIndices.FindChecked(EntityId);
+}
+
+int32 FOutlinerModel::GetSubtreeSize(int32 RowIndex) const
+{
+	const int32 IndentLevel = Rows[RowIndex].IndentLevel;
+	int32 End = RowIndex + 1;
+	while (End < Rows.Num() && Rows[End].IndentLevel > IndentLevel)
+	{
+		++End;
+	}
+	return End - RowIndex;
+}
+
+bool FOutlinerModel::IsAncestorOf(FGameObjectKey Ancestor, FGameObjectKey GameObject) const
+{
+	for (FGameObjectKey Current = ChildToParentMap.FindRef(GameObject); Current != FGameObjectKey(); Current = ChildToParentMap.FindRef(Current))
+	{
+		if (Current == Ancestor)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void FOutlinerModel::RefreshIndices() const
+{
+	for (int32 Index = FirstStaleRow; Index < Rows.Num(); ++Index)
+	{
+		const FOutlinerRow& Row = Rows[Index];
+		if (Row.IsEntity())
+		{
+			EntityRowIndices.Add(Row.EntityId, Index);
+		}
+		else
+		{
+			RowIndices.Add(Row.GameObject, Index);
+		}
+	}
+	FirstStaleRow = MAX_int32;
+}
+
+int32 FOutlinerModel::AddEntityRow(FTruObjectId EntityId)
+{
+	if (ContainsEntity(EntityId))
+	{
+		return INDEX_NONE;
+	}
+
+	const int32 Row = Rows.AddDefaulted();
+	Rows[Row].EntityId = EntityId;
+	EntityRowIndices.Add(EntityId, Row);
+	return Row;
+}
+
+void FOutlinerModel::AppendSubtree(FGameObjectKey GameObject, int32 IndentLevel)
+{
+	const int32 Row = Rows.AddDefaulted();
+	Rows[Row].GameObject = GameObject;
+	Rows[Row].IndentLevel = IndentLevel;
+	RowIndices.Add(GameObject, Row);
+
+	// Recursively add children
+	if (const TArray<FGameObjectKey>* Children = ParentToChildrenMap.Find(GameObject))
+	{
+		for (const FGameObjectKey Child : *Children)
+		{
+			AppendSubtree(Child, IndentLevel + 1);
+		}
+	}
+}
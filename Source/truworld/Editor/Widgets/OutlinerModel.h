@@ -0,0 +1,81 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+#include "truworld/GameObjects/TruObjectRegistry.h"
+
+class ATruGameObject;
+
+/** One visible line of the outliner: the object it shows and how deep it sits in the hierarchy. */
+struct FOutlinerRow
+{
+	/** Weak, so a row never keeps a destroyed object alive or hands out a dangling pointer. */
+	TObjectKey<ATruGameObject> GameObject;
+	int32 IndentLevel = 0;
+	/** Set instead of GameObject for objects that are entity store records right now. Entity rows are always roots. */
+	FTruObjectId EntityId;
+
+	bool IsEntity() const { return EntityId.IsValid(); }
+	/** Null once the object is gone. */
+	ATruGameObject* GetGameObject() const { return GameObject.ResolveObjectPtr(); }
+
+	bool operator==(const FOutlinerRow& Other) const { return GameObject == Other.GameObject && IndentLevel == Other.IndentLevel && EntityId == Other.EntityId; }
+	bool operator!=(const FOutlinerRow& Other) const { return !(*this == Other); }
+};
+
+/**
+ * Flattened, depth-first view of the ATruGameObject hierarchy that is patched in place.
+ *
+ * Every mutation returns the index of the first row whose contents changed (or INDEX_NONE),
+ * so the view only has to rebind rows from that point on instead of recreating the whole list.
+ *
+ * Row indices are not renumbered on every change. Mutations only lower a stale watermark; an index below it, or one
+ * that still finds its object, is returned as is, and the rest are renumbered once on the first lookup that needs
+ * them. A frame of many changes therefore costs one renumbering at most, instead of one per change.
+ */
+class TRUWORLD_API FOutlinerModel
+{
+public:
+	/** Full rebuild from scratch. Only used when the UI explicitly asks for it. */
+	void Reset(const TArray<ATruGameObject*>& GameObjects, const TArray<FTruObjectId>& EntityIds = {});
+	void Empty();
+
+	int32 Add(ATruGameObject* GameObject, ATruGameObject* Parent);
+	int32 Remove(ATruGameObject* GameObject);
+	int32 Reparent(ATruGameObject* GameObject, ATruGameObject* NewParent);
+
+	// Demotion and promotion keep the row where it is and only change what it shows
+	int32 ReplaceWithEntity(ATruGameObject* GameObject, FTruObjectId EntityId);
+	int32 ReplaceWithObject(FTruObjectId EntityId, ATruGameObject* GameObject);
+	int32 RemoveEntity(FTruObjectId EntityId);
+
+	const TArray<FOutlinerRow>& GetRows() const { return Rows; }
+	int32 FindRow(const ATruGameObject* GameObject) const;
+	bool Contains(const ATruGameObject* GameObject) const { return RowIndices.Contains(FGameObjectKey(GameObject)); }
+	bool ContainsEntity(FTruObjectId EntityId) const { return EntityRowIndices.Contains(EntityId); }
+
+private:
+	typedef TObjectKey<ATruGameObject> FGameObjectKey;
+
+	/** Number of rows taken by GameObject and all of its descendants. */
+	int32 GetSubtreeSize(int32 RowIndex) const;
+	bool IsAncestorOf(FGameObjectKey Ancestor, FGameObjectKey GameObject) const;
+	/** Reparent by key, so children of an object that is already destroyed can still be moved up. */
+	int32 ReparentKey(FGameObjectKey GameObject, FGameObjectKey NewParent);
+	int32 FindKeyRow(FGameObjectKey GameObject) const;
+	int32 FindEntityRow(FTruObjectId EntityId) const;
+	/** Rows from FirstRow on may have moved; their indices are renumbered when next asked for. */
+	void MarkStale(int32 FirstRow) { FirstStaleRow = FMath::Min(FirstStaleRow, FirstRow); }
+	void RefreshIndices() const;
+	void AppendSubtree(FGameObjectKey GameObject, int32 IndentLevel);
+
+	int32 AddEntityRow(FTruObjectId EntityId);
+
+	TArray<FOutlinerRow> Rows;
+	mutable TMap<FGameObjectKey, int32> RowIndices;
+	mutable TMap<FTruObjectId, int32> EntityRowIndices;
+	mutable int32 FirstStaleRow = MAX_int32;
+	// Root objects have no entry: with hundreds of thousands of roots, removing one from a shared list would be linear
+	TMap<FGameObjectKey, TArray<FGameObjectKey>> ParentToChildrenMap;
+	TMap<FGameObjectKey, FGameObjectKey> ChildToParentMap;
+};
@@ -6,19 +6,29 @@
 #include "Components/TextBlock.h"
 #include "Components/EditableTextBox.h"  // Include for EditableTextBox
 #include "Components/Border.h"
+#include "truworld/GameObjects/TruEntityStore.h"
 #include "truworld/GameObjects/TruGameObject.h"
 #include "Engine/World.h"
+#include "Framework/Application/SlateApplication.h"
 #include "truworld/Editor/EditorPlayerController.h"
 
-void UTruGameObjectWidget::Setup(ATruGameObject* InGameObject, UEditorUI* EditorUI)
+void UTruGameObjectWidget::Setup(ATruGameObject* InGameObject, FTruObjectId InEntityId, UEditorUI* EditorUI)
 {
+	// Rows are rebound when the outliner shifts; a pending rename belongs to the previous object
+	if (bIsEditMode && (GameObject != InGameObject || EntityId != InEntityId))
+	{
+		ToggleEditMode(false);
+	}
+
 	GameObject = InGameObject;
+	EntityId = InEntityId;
 	this->Parent = EditorUI;
 
+	UTruEntityStore* EntityStore = UTruEntityStore::Get(this);
 	int max_characters = 40;
-	if (ObjectNameText && GameObject)
+	if (ObjectNameText && (GameObject || EntityStore))
 	{
-		FString Name = GameObject->GetName();
+		FString Name = GameObject ? GameObject->GetName() : EntityStore->GetEntityName(EntityId).ToString();
 		if (Name.Len() > max_characters)
 		{
 			Name = Name.Left(max_characters) + TEXT("...");
@@ -72,24 +82,48 @@ void UTruGameObjectWidget::NativeOnMouseEnter(const FGeometry& InGeometry, const
 {
 	Super::NativeOnMouseEnter(InGeometry, InMouseEvent);
 
-	if (Border && !IsSelected())
-	{
-		Border->SetBrushColor(FLinearColor(0.1f, 0.1f, 0.4f, 1.0f));
-	}
+	bIsMouseOver = true;
+	UpdateBorderColor();
 }
 
 void UTruGameObjectWidget::NativeOnMouseLeave(const FPointerEvent& InMouseEvent)
 {
 	Super::NativeOnMouseLeave(InMouseEvent);
 
+	bIsMouseOver = false;
 	UpdateBorderColor();
 }
 
+ATruGameObject* UTruGameObjectWidget::ResolveGameObject()
+{
+	AEditorPlayerController* Controller = Cast<AEditorPlayerController>(GetWorld()->GetFirstPlayerController());
+	if (!GameObject && EntityId.IsValid() && Controller)
+	{
+		// The row is rebound to the promoted object on the next outliner update; until then it acts on it directly
+		GameObject = Controller->PromoteEntity(EntityId);
+		if (GameObject)
+		{
+			EntityId = FTruObjectId();
+		}
+	}
+	return GameObject;
+}
+
 void UTruGameObjectWidget::OnButtonClicked()
 {
 	if(AEditorPlayerController* Controller = Cast<AEditorPlayerController>(GetWorld()->GetFirstPlayerController()))
 	{
-		Controller->SetSelected(GameObject);
+		ResolveGameObject();
+
+		// Same modifier as in the viewport: shift adds to or removes from the selection
+		if (FSlateApplication::Get().GetModifierKeys().IsShiftDown())
+		{
+			Controller->ToggleSelected(GameObject);
+		}
+		else
+		{
+			Controller->SetSelected(GameObject);
+		}
 	}
 	UpdateBorderColor();
 }
@@ -97,7 +131,7 @@ void UTruGameObjectWidget::OnButtonClicked()
 bool UTruGameObjectWidget::IsSelected() const
 {
 	AEditorPlayerController* PlayerController = Cast<AEditorPlayerController>(GetWorld()->GetFirstPlayerController());
-	return PlayerController && PlayerController->GetSelectedObject() == GameObject;
+	return PlayerController && PlayerController->IsSelected(GameObject);
 }
 
 void UTruGameObjectWidget::UpdateBorderColor()
@@ -111,6 +145,11 @@ void UTruGameObjectWidget::UpdateBorderColor()
 	{
 		Border->SetBrushColor(FLinearColor(0.3f, 0.5f, 1.0f, 1.0f));
 	}
+	else if (bIsMouseOver)
+	{
+		// The row stays hovered when scrolling rebinds it to another object
+		Border->SetBrushColor(FLinearColor(0.1f, 0.1f, 0.4f, 1.0f));
+	}
 	else
 	{
 		Border->SetBrushColor(FLinearColor(0.0f, 0.0f, 0.3f, 1.0f));
@@ -121,15 +160,28 @@ void UTruGameObjectWidget::OnNameTextCommitted(const FText& Text, ETextCommit::T
 {
 	if (CommitMethod == ETextCommit::OnEnter || CommitMethod == ETextCommit::OnUserMovedFocus)
 	{
+		// Names already used by another object are rejected and the row falls back to the current name
 		if (GameObject)
 		{
-			GameObject->Rename(*Text.ToString());
+			AEditorPlayerController* Controller = Cast<AEditorPlayerController>(GetWorld()->GetFirstPlayerController());
+			if (Controller)
+			{
+				Controller->GetTransactionLog().BeginTransaction(TEXT("Rename"));
+				Controller->GetTransactionLog().Modify(GameObject);
+			}
+
+			GameObject->RenameGameObject(Text.ToString());
+
+			if (Controller)
+			{
+				Controller->GetTransactionLog().EndTransaction();
+			}
 		}
 
 		// Update the text displayed in the non-edit mode view
 		if (ObjectNameText)
 		{
-			ObjectNameText->SetText(Text);
+			ObjectNameText->SetText(GameObject ? FText::FromString(GameObject->GetName()) : Text);
 		}
 
 		// Exit edit mode after committing
@@ -143,6 +195,12 @@ FReply UTruGameObjectWidget::NativeOnMouseButtonDown(const FGeometry& InGeometry
 	{
 		if (!bIsEditMode)
 		{
+			// The menu acts on an actor, and the actor has to stay one while the menu is open
+			AEditorPlayerController* Controller = Cast<AEditorPlayerController>(GetWorld()->GetFirstPlayerController());
+			if (!GameObject && ResolveGameObject() && Controller)
+			{
+				Controller->SetSelected(GameObject);
+			}
 			Parent->GetContextWindow()->ShowMenuAtMousePosition(this);
 			//ToggleEditMode(true);
 		}
@@ -3,6 +3,7 @@
 #include "CoreMinimal.h"
 #include "ContextMenuWidgetItem.h"
 #include "Blueprint/UserWidget.h"
+#include "truworld/GameObjects/TruObjectRegistry.h"
 #include "TruGameObjectWidget.generated.h"
 
 UCLASS()
@@ -11,7 +12,8 @@ class TRUWORLD_API UTruGameObjectWidget : public UUserWidget, public IContextMen
 	GENERATED_BODY()
 
 public:
-	void Setup(class ATruGameObject* InGameObject, class UEditorUI* EditorUI);
+	/** Shows InGameObject, or the entity store record InEntityId when the object is currently an entity. */
+	void Setup(class ATruGameObject* InGameObject, FTruObjectId InEntityId, class UEditorUI* EditorUI);
 	void UpdateBorderColor();
 	void ToggleEditMode(bool bEnableEditMode);
 	
@@ -36,9 +38,13 @@ private:
 	virtual FReply NativeOnMouseButtonDown(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent) override;
 
 	bool IsSelected() const;
+	/** The row's object, promoting the entity it shows first if need be. */
+	ATruGameObject* ResolveGameObject();
 	
 	UPROPERTY()
 	ATruGameObject* GameObject;
+	FTruObjectId EntityId;
 
 	bool bIsEditMode = false;  // New flag to track edit mode
+	bool bIsMouseOver = false;
 };
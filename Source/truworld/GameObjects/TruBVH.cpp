@@ -0,0 +1,460 @@
+// TruBVH.cpp
+
+#include "TruBVH.h"
+
+namespace
+{
+	double SurfaceArea(const FBox& Box)
+	{
+		const FVector Size = Box.GetSize();
+		return 2.0 * (Size.X * Size.Y + Size.Y * Size.Z + Size.Z * Size.X);
+	}
+
+	/** Slab test of the segment Start + T * Delta, T in [0, MaxT], against an axis-aligned box. */
+	bool IntersectBounds(const FBox& Box, const FVector& Start, const FVector& Delta, double MaxT, double& OutEntryT)
+	{
+		double TMin = 0.0;
+		double TMax = MaxT;
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			if (FMath::IsNearlyZero(Delta[Axis]))
+			{
+				if (Start[Axis] < Box.Min[Axis] || Start[Axis] > Box.Max[Axis])
+				{
+					return false;
+				}
+				continue;
+			}
+
+			const double InvDelta = 1.0 / Delta[Axis];
+			double T0 = (Box.Min[Axis] - Start[Axis]) * InvDelta;
+			double T1 = (Box.Max[Axis] - Start[Axis]) * InvDelta;
+			if (T0 > T1)
+			{
+				Swap(T0, T1);
+			}
+
+			TMin = FMath::Max(TMin, T0);
+			TMax = FMath::Min(TMax, T1);
+			if (TMin > TMax)
+			{
+				return false;
+			}
+		}
+
+		OutEntryT = TMin;
+		return true;
+	}
+}
+
+int32 FTruBVH::AddProxy(const FBox& LocalBox, const FTransform& Transform)
+{
+	const int32 ProxyId = FreeProxies.Num() > 0 ? FreeProxies.Pop(EAllowShrinking::No) : Proxies.AddDefaulted();
+	FProxy& Proxy = Proxies[ProxyId];
+	Proxy.LocalBox = LocalBox;
+	Proxy.Transform = Transform;
+	Proxy.bDirty = false;
+
+	const int32 Leaf = AllocateNode();
+	Nodes[Leaf].ProxyId = ProxyId;
+	Nodes[Leaf].Bounds = LocalBox.TransformBy(Transform);
+	Proxy.Leaf = Leaf;
+	InsertLeaf(Leaf);
+
+	++NumProxies;
+	return ProxyId;
+}
+
+void FTruBVH::RemoveProxy(int32 ProxyId)
+{
+	if (!Proxies.IsValidIndex(ProxyId) || Proxies[ProxyId].Leaf == INDEX_NONE)
+	{
+		return;
+	}
+
+	FProxy& Proxy = Proxies[ProxyId];
+	RemoveLeaf(Proxy.Leaf);
+	FreeNode(Proxy.Leaf);
+	Proxy.Leaf = INDEX_NONE;
+	Proxy.bDirty = false;
+
+	FreeProxies.Add(ProxyId);
+	--NumProxies;
+}
+
+void FTruBVH::MoveProxy(int32 ProxyId, const FTransform& Transform)
+{
+	if (!Proxies.IsValidIndex(ProxyId) || Proxies[ProxyId].Leaf == INDEX_NONE)
+	{
+		return;
+	}
+
+	FProxy& Proxy = Proxies[ProxyId];
+	Proxy.Transform = Transform;
+	if (!Proxy.bDirty)
+	{
+		Proxy.bDirty = true;
+		DirtyProxies.Add(ProxyId);
+	}
+}
+
+void FTruBVH::Refit()
+{
+	if (DirtyProxies.IsEmpty())
+	{
+		return;
+	}
+
+	// Refitting keeps the topology, which gets worse the further objects travel; rebuild once every leaf could have moved
+	RefitsSinceRebuild += DirtyProxies.Num();
+	if (RefitsSinceRebuild >= NumProxies && NumProxies > 64)
+	{
+		Rebuild();
+		return;
+	}
+
+	for (const int32 ProxyId : DirtyProxies)
+	{
+		FProxy& Proxy = Proxies[ProxyId];
+		if (!Proxy.bDirty)
+		{
+			continue;
+		}
+		Proxy.bDirty = false;
+
+		Nodes[Proxy.Leaf].Bounds = Proxy.LocalBox.TransformBy(Proxy.Transform);
+		RefitAncestors(Nodes[Proxy.Leaf].Parent);
+	}
+	DirtyProxies.Reset();
+}
+
+void FTruBVH::Rebuild()
+{
+	Nodes.Reset();
+	FreeNodes.Reset();
+	Root = INDEX_NONE;
+	DirtyProxies.Reset();
+	RefitsSinceRebuild = 0;
+
+	for (int32 ProxyId = 0; ProxyId < Proxies.Num(); ++ProxyId)
+	{
+		FProxy& Proxy = Proxies[ProxyId];
+		Proxy.bDirty = false;
+		if (Proxy.Leaf == INDEX_NONE)
+		{
+			continue;
+		}
+
+		Proxy.Leaf = AllocateNode();
+		Nodes[Proxy.Leaf].ProxyId = ProxyId;
+		Nodes[Proxy.Leaf].Bounds = Proxy.LocalBox.TransformBy(Proxy.Transform);
+		InsertLeaf(Proxy.Leaf);
+	}
+}
+
+void FTruBVH::Reset()
+{
+	Nodes.Reset();
+	FreeNodes.Reset();
+	Root = INDEX_NONE;
+	Proxies.Reset();
+	FreeProxies.Reset();
+	DirtyProxies.Reset();
+	NumProxies = 0;
+	RefitsSinceRebuild = 0;
+}
+
+SIZE_T FTruBVH::GetAllocatedSize() const
+{
+	return Nodes.GetAllocatedSize() + FreeNodes.GetAllocatedSize() + Proxies.GetAllocatedSize() + FreeProxies.GetAllocatedSize() + DirtyProxies.GetAllocatedSize();
+}
+
+bool FTruBVH::Raycast(const FVector& Start, const FVector& End, FHit& OutHit, TFunctionRef<bool(int32 ProxyId)> ShouldIgnore) const
+{
+	const FVector Delta = End - Start;
+	const double Length = Delta.Size();
+	if (Root == INDEX_NONE || Length < UE_SMALL_NUMBER)
+	{
+		return false;
+	}
+
+	double BestT = 1.0;
+	bool bHit = false;
+
+	TArray<int32, TInlineAllocator<64>> Stack;
+	Stack.Add(Root);
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(EAllowShrinking::No)];
+
+		double EntryT;
+		if (!IntersectBounds(Node.Bounds, Start, Delta, BestT, EntryT))
+		{
+			continue;
+		}
+
+		if (Node.IsLeaf())
+		{
+			double T;
+			FVector Normal;
+			if (!ShouldIgnore(Node.ProxyId) && IntersectProxy(Proxies[Node.ProxyId], Start, Delta, BestT, T, Normal))
+			{
+				BestT = T;
+				OutHit.ProxyId = Node.ProxyId;
+				OutHit.Normal = Normal;
+				bHit = true;
+			}
+			continue;
+		}
+
+		// Visit the nearer child first so BestT shrinks as early as possible
+		double T0 = UE_BIG_NUMBER;
+		double T1 = UE_BIG_NUMBER;
+		const bool bHit0 = IntersectBounds(Nodes[Node.Children[0]].Bounds, Start, Delta, BestT, T0);
+		const bool bHit1 = IntersectBounds(Nodes[Node.Children[1]].Bounds, Start, Delta, BestT, T1);
+		if (bHit0 && bHit1)
+		{
+			Stack.Add(T0 < T1 ? Node.Children[1] : Node.Children[0]);
+			Stack.Add(T0 < T1 ? Node.Children[0] : Node.Children[1]);
+		}
+		else if (bHit0)
+		{
+			Stack.Add(Node.Children[0]);
+		}
+		else if (bHit1)
+		{
+			Stack.Add(Node.Children[1]);
+		}
+	}
+
+	if (bHit)
+	{
+		OutHit.Distance = BestT * Length;
+		OutHit.Location = Start + Delta * BestT;
+	}
+	return bHit;
+}
+
+bool FTruBVH::FindNearestSurface(const FVector& Point, double MaxDistance, FHit& OutHit, TFunctionRef<bool(int32 ProxyId)> ShouldIgnore) const
+{
+	if (Root == INDEX_NONE)
+	{
+		return false;
+	}
+
+	double BestDistanceSquared = FMath::Square(MaxDistance);
+	bool bHit = false;
+
+	TArray<int32, TInlineAllocator<64>> Stack;
+	Stack.Add(Root);
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(EAllowShrinking::No)];
+		if (Node.Bounds.ComputeSquaredDistanceToPoint(Point) > BestDistanceSquared)
+		{
+			continue;
+		}
+
+		if (Node.IsLeaf())
+		{
+			if (ShouldIgnore(Node.ProxyId))
+			{
+				continue;
+			}
+
+			const FProxy& Proxy = Proxies[Node.ProxyId];
+			const FVector LocalPoint = Proxy.Transform.InverseTransformPosition(Point);
+			const FVector ClosestPoint = Proxy.Transform.TransformPosition(LocalPoint.BoundToBox(Proxy.LocalBox.Min, Proxy.LocalBox.Max));
+			const double DistanceSquared = FVector::DistSquared(Point, ClosestPoint);
+			if (DistanceSquared <= BestDistanceSquared)
+			{
+				BestDistanceSquared = DistanceSquared;
+				OutHit.ProxyId = Node.ProxyId;
+				OutHit.Location = ClosestPoint;
+				OutHit.Normal = (Point - ClosestPoint).GetSafeNormal();
+				bHit = true;
+			}
+			continue;
+		}
+
+		const double Distance0 = Nodes[Node.Children[0]].Bounds.ComputeSquaredDistanceToPoint(Point);
+		const double Distance1 = Nodes[Node.Children[1]].Bounds.ComputeSquaredDistanceToPoint(Point);
+		Stack.Add(Distance0 < Distance1 ? Node.Children[1] : Node.Children[0]);
+		Stack.Add(Distance0 < Distance1 ? Node.Children[0] : Node.Children[1]);
+	}
+
+	if (bHit)
+	{
+		OutHit.Distance = FMath::Sqrt(BestDistanceSquared);
+	}
+	return bHit;
+}
+
+int32 FTruBVH::AllocateNode()
+{
+	const int32 NodeIndex = FreeNodes.Num() > 0 ? FreeNodes.Pop(EAllowShrinking::No) : Nodes.AddDefaulted();
+	Nodes[NodeIndex] = FNode();
+	return NodeIndex;
+}
+
+void FTruBVH::FreeNode(int32 NodeIndex)
+{
+	Nodes[NodeIndex].ProxyId = INDEX_NONE;
+	FreeNodes.Add(NodeIndex);
+}
+
+void FTruBVH::InsertLeaf(int32 Leaf)
+{
+	if (Root == INDEX_NONE)
+	{
+		Root = Leaf;
+		Nodes[Leaf].Parent = INDEX_NONE;
+		return;
+	}
+
+	// Walk down towards the sibling that grows the tree's surface area the least
+	const FBox LeafBounds = Nodes[Leaf].Bounds;
+	int32 Sibling = Root;
+	while (!Nodes[Sibling].IsLeaf())
+	{
+		const FNode& Node = Nodes[Sibling];
+		const double CombinedArea = SurfaceArea(Node.Bounds + LeafBounds);
+
+		// Cost of pairing with this node, and the area every level below has to inherit
+		const double PairCost = 2.0 * CombinedArea;
+		const double InheritedCost = 2.0 * (CombinedArea - SurfaceArea(Node.Bounds));
+
+		double ChildCosts[2];
+		for (int32 ChildIndex = 0; ChildIndex < 2; ++ChildIndex)
+		{
+			const FNode& Child = Nodes[Node.Children[ChildIndex]];
+			const double ChildArea = SurfaceArea(Child.Bounds + LeafBounds);
+			ChildCosts[ChildIndex] = (Child.IsLeaf() ? ChildArea : ChildArea - SurfaceArea(Child.Bounds)) + InheritedCost;
+		}
+
+		if (PairCost < ChildCosts[0] && PairCost < ChildCosts[1])
+		{
+			break;
+		}
+		Sibling = ChildCosts[0] < ChildCosts[1] ? Node.Children[0] : Node.Children[1];
+	}
+
+	const int32 OldParent = Nodes[Sibling].Parent;
+	const int32 NewParent = AllocateNode();
+	Nodes[NewParent].Parent = OldParent;
+	Nodes[NewParent].Bounds = Nodes[Sibling].Bounds + LeafBounds;
+	Nodes[NewParent].Children[0] = Sibling;
+	Nodes[NewParent].Children[1] = Leaf;
+	Nodes[Sibling].Parent = NewParent;
+	Nodes[Leaf].Parent = NewParent;
+
+	if (OldParent == INDEX_NONE)
+	{
+		Root = NewParent;
+		return;
+	}
+
+	FNode& Parent = Nodes[OldParent];
+	Parent.Children[Parent.Children[0] == Sibling ? 0 : 1] = NewParent;
+	RefitAncestors(OldParent);
+}
+
+void FTruBVH::RemoveLeaf(int32 Leaf)
+{
+	if (Leaf == Root)
+	{
+		Root = INDEX_NONE;
+		return;
+	}
+
+	// The leaf's parent goes away and the sibling takes its place
+	const int32 Parent = Nodes[Leaf].Parent;
+	const int32 GrandParent = Nodes[Parent].Parent;
+	const int32 Sibling = Nodes[Parent].Children[0] == Leaf ? Nodes[Parent].Children[1] : Nodes[Parent].Children[0];
+
+	Nodes[Sibling].Parent = GrandParent;
+	FreeNode(Parent);
+
+	if (GrandParent == INDEX_NONE)
+	{
+		Root = Sibling;
+		return;
+	}
+
+	FNode& Node = Nodes[GrandParent];
+	Node.Children[Node.Children[0] == Parent ? 0 : 1] = Sibling;
+	RefitAncestors(GrandParent);
+}
+
+void FTruBVH::RefitAncestors(int32 NodeIndex)
+{
+	while (NodeIndex != INDEX_NONE)
+	{
+		FNode& Node = Nodes[NodeIndex];
+		const FBox Bounds = Nodes[Node.Children[0]].Bounds + Nodes[Node.Children[1]].Bounds;
+		if (Bounds == Node.Bounds)
+		{
+			// Everything above was built from this box, so it is unchanged too
+			break;
+		}
+		Node.Bounds = Bounds;
+		NodeIndex = Node.Parent;
+	}
+}
+
+bool FTruBVH::IntersectProxy(const FProxy& Proxy, const FVector& Start, const FVector& Delta, double MaxT, double& OutT, FVector& OutNormal)
+{
+	// In the box's own space the test is a plain slab test. The segment parameter T is the same in both spaces.
+	const FVector LocalStart = Proxy.Transform.InverseTransformPosition(Start);
+	const FVector LocalDelta = Proxy.Transform.InverseTransformVector(Delta);
+
+	double EnterT = -UE_BIG_NUMBER;
+	double ExitT = UE_BIG_NUMBER;
+	int32 EnterAxis = INDEX_NONE;
+	double EnterSign = 0.0;
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		if (FMath::IsNearlyZero(LocalDelta[Axis]))
+		{
+			if (LocalStart[Axis] < Proxy.LocalBox.Min[Axis] || LocalStart[Axis] > Proxy.LocalBox.Max[Axis])
+			{
+				return false;
+			}
+			continue;
+		}
+
+		const double InvDelta = 1.0 / LocalDelta[Axis];
+		double T0 = (Proxy.LocalBox.Min[Axis] - LocalStart[Axis]) * InvDelta;
+		double T1 = (Proxy.LocalBox.Max[Axis] - LocalStart[Axis]) * InvDelta;
+		double Sign = -1.0;
+		if (T0 > T1)
+		{
+			Swap(T0, T1);
+			Sign = 1.0;
+		}
+
+		if (T0 > EnterT)
+		{
+			EnterT = T0;
+			EnterAxis = Axis;
+			EnterSign = Sign;
+		}
+		ExitT = FMath::Min(ExitT, T1);
+		if (EnterT > ExitT)
+		{
+			return false;
+		}
+	}
+
+	// Starting inside the box counts as a miss, like a line trace that begins in penetration
+	if (EnterAxis == INDEX_NONE || EnterT < 0.0 || EnterT > MaxT)
+	{
+		return false;
+	}
+
+	FVector LocalNormal = FVector::ZeroVector;
+	LocalNormal[EnterAxis] = EnterSign;
+	OutT = EnterT;
+	OutNormal = Proxy.Transform.GetRotation().RotateVector(LocalNormal);
+	return true;
+}
@@ -0,0 +1,84 @@
+// TruBVH.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Dynamic bounding volume hierarchy over oriented boxes.
+ *
+ * Each proxy is a local-space box plus a transform, so leaf tests are exact for box-shaped meshes while the tree
+ * itself works on world AABBs. Proxies are inserted with a surface area heuristic; moving a proxy only marks it,
+ * and Refit() later updates the affected leaves and walks their ancestors. When refits have touched as many leaves
+ * as the tree holds, the next Refit() rebuilds it to recover quality.
+ */
+class TRUWORLD_API FTruBVH
+{
+public:
+	struct FHit
+	{
+		int32 ProxyId = INDEX_NONE;
+		double Distance = 0.0;
+		FVector Location = FVector::ZeroVector;
+		FVector Normal = FVector::ZeroVector;
+	};
+
+	int32 AddProxy(const FBox& LocalBox, const FTransform& Transform);
+	void RemoveProxy(int32 ProxyId);
+	/** Records the new transform; the tree is updated by the next Refit(). */
+	void MoveProxy(int32 ProxyId, const FTransform& Transform);
+	void Refit();
+	void Rebuild();
+	void Reset();
+
+	bool HasPendingRefit() const { return DirtyProxies.Num() > 0; }
+	int32 GetNumProxies() const { return NumProxies; }
+	SIZE_T GetAllocatedSize() const;
+
+	/**
+	 * Closest box entered by the segment Start -> End. Rays starting inside a box do not hit it, as with physics
+	 * line traces. Call Refit() first if proxies moved.
+	 */
+	bool Raycast(const FVector& Start, const FVector& End, FHit& OutHit, TFunctionRef<bool(int32 ProxyId)> ShouldIgnore) const;
+
+	/** Closest point on any box within MaxDistance of Point. Points inside a box report distance 0. */
+	bool FindNearestSurface(const FVector& Point, double MaxDistance, FHit& OutHit, TFunctionRef<bool(int32 ProxyId)> ShouldIgnore) const;
+
+private:
+	struct FNode
+	{
+		FBox Bounds = FBox(ForceInit);
+		int32 Parent = INDEX_NONE;
+		int32 Children[2] = { INDEX_NONE, INDEX_NONE };
+		int32 ProxyId = INDEX_NONE;	// Set on leaves only
+
+		bool IsLeaf() const { return ProxyId != INDEX_NONE; }
+	};
+
+	struct FProxy
+	{
+		FBox LocalBox = FBox(ForceInit);
+		FTransform Transform;
+		int32 Leaf = INDEX_NONE;	// INDEX_NONE when the proxy slot is free
+		bool bDirty = false;
+	};
+
+	int32 AllocateNode();
+	void FreeNode(int32 NodeIndex);
+	void InsertLeaf(int32 Leaf);
+	void RemoveLeaf(int32 Leaf);
+	void RefitAncestors(int32 NodeIndex);
+
+	/** Entry distance of the ray into a proxy's box in [0, MaxT], or false when it misses. */
+	static bool IntersectProxy(const FProxy& Proxy, const FVector& Start, const FVector& Delta, double MaxT, double& OutT, FVector& OutNormal);
+
+	TArray<FNode> Nodes;
+	TArray<int32> FreeNodes;
+	int32 Root = INDEX_NONE;
+
+	TArray<FProxy> Proxies;
+	TArray<int32> FreeProxies;
+	TArray<int32> DirtyProxies;
+	int32 NumProxies = 0;
+	int32 RefitsSinceRebuild = 0;
+};
@@ -0,0 +1,650 @@
+// TruEntityStore.cpp
+
+#include "TruEntityStore.h"
+
+#include "Async/ParallelFor.h"
+#include "Components/ChildActorComponent.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "ConvexVolume.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "TruGameObject.h"
+#include "TruGameObjectPool.h"
+#include "TruNameRegistry.h"
+#include "TruPrefab.h"
+#include "TruSceneBVH.h"
+#include "TruSpawnQueue.h"
+#include "truworld/Editor/EditorPlayerController.h"
+
+static TAutoConsoleVariable<bool> CVarTruEntityStore(
+	TEXT("tru.EntityStore"),
+	false,
+	TEXT("Demote TruGameObjects nobody is editing to compact instanced records, and promote them back to actors when they are picked."));
+
+static TAutoConsoleVariable<int32> CVarTruEntityDemotionsPerFrame(
+	TEXT("tru.EntityDemotionsPerFrame"),
+	1000,
+	TEXT("How many demotion candidates the entity store looks at per frame."));
+
+namespace
+{
+	double TimeGarbageCollection()
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS, /*bPerformFullPurge*/ true);
+		return (FPlatformTime::Seconds() - StartTime) * 1000.0;
+	}
+
+	int64 GetResidentBytes()
+	{
+		return (int64)FPlatformMemory::GetStats().UsedPhysical;
+	}
+}
+
+UTruEntityStore* UTruEntityStore::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UTruEntityStore>() : nullptr;
+}
+
+bool UTruEntityStore::IsEnabled()
+{
+	return CVarTruEntityStore.GetValueOnGameThread();
+}
+
+void UTruEntityStore::AddCandidate(ATruGameObject* GameObject)
+{
+	// Pooled actors stay in the level, hidden, and show up in actor iterators
+	if (GameObject && bSeeded && !GameObject->IsPooled())
+	{
+		Candidates.Add(GameObject);
+	}
+}
+
+bool UTruEntityStore::Demote(ATruGameObject* GameObject)
+{
+	int32 BatchIndex;
+	FTruEntity Entity;
+	if (!TakeRecord(GameObject, BatchIndex, Entity))
+	{
+		return false;
+	}
+
+	AddEntities(BatchIndex, MakeArrayView(&Entity, 1));
+	return true;
+}
+
+bool UTruEntityStore::TakeRecord(ATruGameObject* GameObject, int32& OutBatchIndex, FTruEntity& OutEntity)
+{
+	if (!CanEverDemote(GameObject))
+	{
+		return false;
+	}
+
+	UStaticMeshComponent* MeshComponent = GameObject->GetMeshComponent();
+	UStaticMesh* Mesh = MeshComponent ? MeshComponent->GetStaticMesh() : nullptr;
+	const FTruObjectId Id = GameObject->GetObjectId();
+	if (!Mesh || !Id.IsValid())
+	{
+		return false;
+	}
+
+	OutBatchIndex = FindOrAddBatch(GameObject->GetClass(), Mesh, MeshComponent->GetMaterial(0), MeshComponent->GetRelativeTransform());
+	if (OutBatchIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	const FTransform Transform = GameObject->GetActorTransform();
+	OutEntity = FTruEntity();
+	OutEntity.Id = Id;
+	OutEntity.Location = Transform.GetLocation();
+	OutEntity.Rotation = FQuat4f(Transform.GetRotation());
+	OutEntity.Scale = FVector3f(Transform.GetScale3D());
+	OutEntity.Name = GameObject->GetFName();
+
+	// Takes the object out of the registries, the outliner and its instance batch. The actor is destroyed rather than
+	// pooled: freeing it is what demotion is for, and the pool would keep it around hidden
+	GameObject->Destroy();
+
+	// ...and keeps its id and name from being handed to anything else while it is an entity
+	if (UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(this))
+	{
+		OutEntity.Id = ObjectRegistry->Reserve(Id);
+	}
+	if (UTruNameRegistry* NameRegistry = UTruNameRegistry::Get(this))
+	{
+		NameRegistry->ReserveName(OutEntity.Name);
+	}
+
+	if (AEditorPlayerController* EditorController = Cast<AEditorPlayerController>(GetWorld()->GetFirstPlayerController()))
+	{
+		EditorController->OnGameObjectDemoted(GameObject, OutEntity.Id);
+	}
+	return true;
+}
+
+ATruGameObject* UTruEntityStore::Promote(FTruObjectId Id)
+{
+	UWorld* World = GetWorld();
+	const FEntityLocation* Location = EntityLocations.Find(Id);
+	if (!World || !Location)
+	{
+		return nullptr;
+	}
+
+	const FTruEntityBatch& Batch = Batches[Location->BatchIndex];
+	const FTruEntity Entity = Batch.Entities[Location->EntityIndex];
+	UClass* Class = Batch.Class;
+	UStaticMesh* Mesh = Batch.Mesh;
+	UMaterialInterface* Material = Batch.Material;
+	RemoveEntity(Id);
+
+	// The new actor claims the id and name again when it registers
+	if (UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(this))
+	{
+		ObjectRegistry->Release(Id);
+	}
+	if (UTruNameRegistry* NameRegistry = UTruNameRegistry::Get(this))
+	{
+		NameRegistry->ReleaseName(Entity.Name);
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParams.NameMode = FActorSpawnParameters::ESpawnActorNameMode::Requested;
+	SpawnParams.Name = Entity.Name;
+
+	ATruGameObject* GameObject = UTruGameObjectPool::SpawnGameObject(World, Class, Entity.GetTransform(), SpawnParams, Id);
+	if (!GameObject)
+	{
+		return nullptr;
+	}
+
+	// The object comes back with its class default mesh; put back whatever it had been given instead
+	UStaticMeshComponent* MeshComponent = GameObject->GetMeshComponent();
+	if (MeshComponent->GetStaticMesh() != Mesh || MeshComponent->GetMaterial(0) != Material)
+	{
+		const bool bWasInstanced = GameObject->IsRenderInstanced();
+		GameObject->SetRenderInstanced(false);
+		MeshComponent->SetStaticMesh(Mesh);
+		MeshComponent->SetMaterial(0, Material);
+		GameObject->SetRenderInstanced(bWasInstanced);
+	}
+
+	if (AEditorPlayerController* EditorController = Cast<AEditorPlayerController>(World->GetFirstPlayerController()))
+	{
+		EditorController->OnGameObjectPromoted(GameObject, Id);
+	}
+	return GameObject;
+}
+
+void UTruEntityStore::DiscardEntity(FTruObjectId Id)
+{
+	const FTruEntity* Entity = FindEntity(Id);
+	if (!Entity)
+	{
+		return;
+	}
+
+	const FName Name = Entity->Name;
+	RemoveEntity(Id);
+	if (UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(this))
+	{
+		ObjectRegistry->Release(Id);
+	}
+	if (UTruNameRegistry* NameRegistry = UTruNameRegistry::Get(this))
+	{
+		NameRegistry->ReleaseName(Name);
+	}
+
+	if (AEditorPlayerController* EditorController = Cast<AEditorPlayerController>(GetWorld()->GetFirstPlayerController()))
+	{
+		EditorController->OnGameObjectPromoted(nullptr, Id);
+	}
+}
+
+FName UTruEntityStore::GetEntityName(FTruObjectId Id) const
+{
+	const FEntityLocation* Location = EntityLocations.Find(Id);
+	return Location ? Batches[Location->BatchIndex].Entities[Location->EntityIndex].Name : NAME_None;
+}
+
+const FTruEntity* UTruEntityStore::FindEntity(FTruObjectId Id, const FTruEntityBatch** OutBatch) const
+{
+	const FEntityLocation* Location = EntityLocations.Find(Id);
+	if (!Location)
+	{
+		return nullptr;
+	}
+
+	const FTruEntityBatch& Batch = Batches[Location->BatchIndex];
+	if (OutBatch)
+	{
+		*OutBatch = &Batch;
+	}
+	return &Batch.Entities[Location->EntityIndex];
+}
+
+void UTruEntityStore::GetEntityIds(TArray<FTruObjectId>& OutIds) const
+{
+	OutIds.Reset(EntityLocations.Num());
+	for (const FTruEntityBatch& Batch : Batches)
+	{
+		for (const FTruEntity& Entity : Batch.Entities)
+		{
+			OutIds.Add(Entity.Id);
+		}
+	}
+}
+
+bool UTruEntityStore::Raycast(const FVector& Start, const FVector& End, FTruSceneHit& OutHit) const
+{
+	// Entities never move, so the tree never needs a refit
+	FTruBVH::FHit Hit;
+	if (!BVH.Raycast(Start, End, Hit, [](int32 ProxyId) { return false; }))
+	{
+		return false;
+	}
+
+	OutHit = FTruSceneHit();
+	OutHit.EntityId = ProxyEntities[Hit.ProxyId];
+	OutHit.Distance = Hit.Distance;
+	OutHit.Location = Hit.Location;
+	OutHit.Normal = Hit.Normal;
+	return true;
+}
+
+void UTruEntityStore::FindInFrustum(const FConvexVolume& Frustum, TArray<FTruObjectId>& OutIds, TArray<FBox>& OutBounds) const
+{
+	OutIds.Reset();
+	OutBounds.Reset();
+
+	TArray<FBox> Bounds;
+	TArray<bool> Inside;
+	for (const FTruEntityBatch& Batch : Batches)
+	{
+		const int32 NumEntities = Batch.Entities.Num();
+		Bounds.SetNumUninitialized(NumEntities, EAllowShrinking::No);
+		Inside.SetNumUninitialized(NumEntities, EAllowShrinking::No);
+
+		ParallelFor(NumEntities, [&Batch, &Frustum, &Bounds, &Inside](int32 Index)
+		{
+			const FBox Box = Batch.LocalBox.TransformBy(Batch.GetMeshTransform(Batch.Entities[Index]));
+			Bounds[Index] = Box;
+			Inside[Index] = Frustum.IntersectBox(Box.GetCenter(), Box.GetExtent());
+		}, NumEntities < 1024 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+
+		for (int32 Index = 0; Index < NumEntities; ++Index)
+		{
+			if (Inside[Index])
+			{
+				OutIds.Add(Batch.Entities[Index].Id);
+				OutBounds.Add(Bounds[Index]);
+			}
+		}
+	}
+}
+
+SIZE_T UTruEntityStore::GetAllocatedSize() const
+{
+	SIZE_T Size = Batches.GetAllocatedSize() + EntityLocations.GetAllocatedSize() + BVH.GetAllocatedSize()
+		+ ProxyEntities.GetAllocatedSize() + Candidates.GetAllocatedSize();
+	for (const FTruEntityBatch& Batch : Batches)
+	{
+		Size += Batch.Entities.GetAllocatedSize();
+	}
+	return Size;
+}
+
+void UTruEntityStore::RunBenchmark(int32 NumEntities, int32 MaxActors, FTruEntityBenchmark& OutResult)
+{
+	UWorld* World = GetWorld();
+	OutResult = FTruEntityBenchmark();
+	OutResult.NumEntities = NumEntities;
+	const ATruGameObject* DefaultObject = GetDefault<ATruGameObject>();
+	if (!World || NumEntities <= 0 || !DefaultObject->GetMeshComponent())
+	{
+		return;
+	}
+
+	// A grid far below the scene, so nothing the user placed is touched or overlapped
+	const int32 GridSize = FMath::CeilToInt(FMath::Sqrt((double)NumEntities));
+	auto GetLocation = [GridSize](int32 Index)
+	{
+		return FVector((Index % GridSize) * 200.0, (Index / GridSize) * 200.0, -100000.0);
+	};
+
+	TimeGarbageCollection();
+	int64 BaseResidentBytes = GetResidentBytes();
+	const SIZE_T BaseStoreBytes = GetAllocatedSize();
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	// Real objects go through the same candidate queue and demotion as idle ones do, a chunk at a time so that
+	// a million entities never exist as a million actors at once
+	TArray<TWeakObjectPtr<ATruGameObject>> SavedCandidates = MoveTemp(Candidates);
+	const int32 SavedNextCandidate = NextCandidate;
+	TArray<FTruObjectId> BenchmarkIds;
+	BenchmarkIds.Reserve(NumEntities);
+	for (int32 ChunkStart = 0; ChunkStart < NumEntities; ChunkStart += BenchmarkChunkSize)
+	{
+		const int32 ChunkEnd = FMath::Min(NumEntities, ChunkStart + BenchmarkChunkSize);
+		TArray<TWeakObjectPtr<ATruGameObject>> Chunk;
+		Chunk.Reserve(ChunkEnd - ChunkStart);
+		for (int32 Index = ChunkStart; Index < ChunkEnd; ++Index)
+		{
+			if (ATruGameObject* GameObject = World->SpawnActor<ATruGameObject>(ATruGameObject::StaticClass(), FTransform(GetLocation(Index)), SpawnParams))
+			{
+				Chunk.Add(GameObject);
+				BenchmarkIds.Add(GameObject->GetObjectId());
+			}
+		}
+		// Registering queued them already when the store is seeded; the chunk replaces that queue
+		Candidates = MoveTemp(Chunk);
+		NextCandidate = 0;
+
+		const double StartTime = FPlatformTime::Seconds();
+		DemoteCandidates(Candidates.Num());
+		OutResult.DemoteMs += (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+		// Whatever could not be demoted right now (the editor was busy) is not part of the measurement
+		for (const TWeakObjectPtr<ATruGameObject>& Candidate : Candidates)
+		{
+			if (ATruGameObject* GameObject = Candidate.Get(); GameObject && !GameObject->IsActorBeingDestroyed())
+			{
+				GameObject->Destroy();
+			}
+		}
+		TimeGarbageCollection();
+	}
+	Candidates = MoveTemp(SavedCandidates);
+	NextCandidate = SavedNextCandidate;
+
+	for (const FTruObjectId Id : BenchmarkIds)
+	{
+		OutResult.NumDemoted += Contains(Id) ? 1 : 0;
+	}
+	OutResult.EntityStoreBytes = (int64)GetAllocatedSize() - (int64)BaseStoreBytes;
+	OutResult.EntityResidentBytes = GetResidentBytes() - BaseResidentBytes;
+	OutResult.EntityGCMs = TimeGarbageCollection();
+
+	for (const FTruObjectId Id : BenchmarkIds)
+	{
+		DiscardEntity(Id);
+	}
+
+	if (NumEntities > MaxActors)
+	{
+		return;
+	}
+
+	TimeGarbageCollection();
+	BaseResidentBytes = GetResidentBytes();
+
+	TArray<ATruGameObject*> Spawned;
+	Spawned.Reserve(NumEntities);
+	for (int32 Index = 0; Index < NumEntities; ++Index)
+	{
+		Spawned.Add(World->SpawnActor<ATruGameObject>(ATruGameObject::StaticClass(), FTransform(GetLocation(Index)), SpawnParams));
+	}
+
+	OutResult.ActorResidentBytes = GetResidentBytes() - BaseResidentBytes;
+	OutResult.ActorGCMs = TimeGarbageCollection();
+
+	for (ATruGameObject* GameObject : Spawned)
+	{
+		if (GameObject)
+		{
+			GameObject->Destroy();
+		}
+	}
+	TimeGarbageCollection();
+}
+
+void UTruEntityStore::Tick(float DeltaTime)
+{
+	for (FTruEntityBatch& Batch : Batches)
+	{
+		if (Batch.bRenderStateDirty && IsValid(Batch.Component))
+		{
+			Batch.Component->MarkRenderStateDirty();
+		}
+		Batch.bRenderStateDirty = false;
+	}
+
+	// Entities that exist when the store is switched off stay entities until they are picked
+	if (!IsEnabled())
+	{
+		Candidates.Reset();
+		NextCandidate = 0;
+		bSeeded = false;
+		return;
+	}
+
+	if (!bSeeded)
+	{
+		bSeeded = true;
+		for (TActorIterator<ATruGameObject> It(GetWorld()); It; ++It)
+		{
+			AddCandidate(*It);
+		}
+	}
+
+	DemoteCandidates(FMath::Max(0, CVarTruEntityDemotionsPerFrame.GetValueOnGameThread()));
+}
+
+TStatId UTruEntityStore::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTruEntityStore, STATGROUP_Tickables);
+}
+
+void UTruEntityStore::Deinitialize()
+{
+	Batches.Reset();
+	EntityLocations.Reset();
+	BVH.Reset();
+	ProxyEntities.Reset();
+	Candidates.Reset();
+	NextCandidate = 0;
+	BatchHost = nullptr;
+
+	Super::Deinitialize();
+}
+
+bool UTruEntityStore::CanEverDemote(const ATruGameObject* GameObject)
+{
+	if (!IsValid(GameObject) || GameObject->IsPooled() || !GameObject->HasActorBegunPlay()
+		|| GameObject->GetAttachParentActor() || GameObject->GetParentActor() || GameObject->FindComponentByClass<UChildActorComponent>())
+	{
+		return false;
+	}
+
+	// Anything attached to the object that it does not own is another actor
+	for (const USceneComponent* Component : { GameObject->GetRootComponent(), (const USceneComponent*)GameObject->GetMeshComponent() })
+	{
+		for (const USceneComponent* Child : Component->GetAttachChildren())
+		{
+			if (Child && Child->GetOwner() != GameObject)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void UTruEntityStore::DemoteCandidates(int32 Budget)
+{
+	AEditorPlayerController* EditorController = Cast<AEditorPlayerController>(GetWorld()->GetFirstPlayerController());
+
+	// Spawn batches, open transactions and brush strokes hold on to object pointers until they are done
+	const UTruSpawnQueue* SpawnQueue = UTruSpawnQueue::Get(this);
+	if ((SpawnQueue && SpawnQueue->IsBusy()) || (EditorController && !EditorController->CanDemoteObjects()))
+	{
+		return;
+	}
+
+	// Parts of an open prefab instance are tracked by id until it is closed
+	const UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this);
+
+	TMap<int32, TArray<FTruEntity>> NewEntities;
+	const int32 End = FMath::Min(Candidates.Num(), NextCandidate + Budget);
+	for (; NextCandidate < End; ++NextCandidate)
+	{
+		ATruGameObject* GameObject = Candidates[NextCandidate].Get();
+		if (!CanEverDemote(GameObject))
+		{
+			continue;
+		}
+
+		if ((EditorController && EditorController->IsEditing(GameObject)) || (PrefabLibrary && PrefabLibrary->IsOpenPart(GameObject)))
+		{
+			Candidates.Add(GameObject);
+			continue;
+		}
+
+		int32 BatchIndex;
+		FTruEntity Entity;
+		if (TakeRecord(GameObject, BatchIndex, Entity))
+		{
+			NewEntities.FindOrAdd(BatchIndex).Add(Entity);
+		}
+	}
+
+	for (const TPair<int32, TArray<FTruEntity>>& Pair : NewEntities)
+	{
+		AddEntities(Pair.Key, Pair.Value);
+	}
+
+	if (NextCandidate == Candidates.Num())
+	{
+		Candidates.Reset();
+		NextCandidate = 0;
+	}
+	else if (NextCandidate > Budget && NextCandidate * 2 > Candidates.Num())
+	{
+		Candidates.RemoveAt(0, NextCandidate, EAllowShrinking::No);
+		NextCandidate = 0;
+	}
+}
+
+int32 UTruEntityStore::FindOrAddBatch(UClass* Class, UStaticMesh* Mesh, UMaterialInterface* Material, const FTransform& MeshRelativeTransform)
+{
+	// There are only ever a handful of class/mesh/material combinations
+	for (int32 BatchIndex = 0; BatchIndex < Batches.Num(); ++BatchIndex)
+	{
+		const FTruEntityBatch& Batch = Batches[BatchIndex];
+		if (Batch.Class == Class && Batch.Mesh == Mesh && Batch.Material == Material)
+		{
+			return BatchIndex;
+		}
+	}
+	return AddBatch(Class, Mesh, Material, MeshRelativeTransform);
+}
+
+int32 UTruEntityStore::AddBatch(UClass* Class, UStaticMesh* Mesh, UMaterialInterface* Material, const FTransform& MeshRelativeTransform)
+{
+	UWorld* World = GetWorld();
+	if (!World || !Class || !Mesh)
+	{
+		return INDEX_NONE;
+	}
+
+	if (!BatchHost)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags |= RF_Transient;
+		BatchHost = World->SpawnActor<AActor>(SpawnParams);
+		if (!BatchHost)
+		{
+			return INDEX_NONE;
+		}
+
+		USceneComponent* HostRoot = NewObject<USceneComponent>(BatchHost, TEXT("Root"));
+		BatchHost->SetRootComponent(HostRoot);
+		HostRoot->RegisterComponent();
+	}
+
+	// Picking goes through the store's BVH, so the instances need no physics bodies
+	UHierarchicalInstancedStaticMeshComponent* Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(BatchHost);
+	Component->SetMobility(EComponentMobility::Movable);
+	Component->SetStaticMesh(Mesh);
+	Component->SetMaterial(0, Material);
+	Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Component->SetupAttachment(BatchHost->GetRootComponent());
+	Component->RegisterComponent();
+	BatchHost->AddInstanceComponent(Component);
+
+	FTruEntityBatch& Batch = Batches.AddDefaulted_GetRef();
+	Batch.Class = Class;
+	Batch.Mesh = Mesh;
+	Batch.Material = Material;
+	Batch.Component = Component;
+	Batch.MeshRelativeTransform = MeshRelativeTransform;
+	Batch.LocalBox = Mesh->GetBoundingBox();
+	return Batches.Num() - 1;
+}
+
+void UTruEntityStore::AddEntities(int32 BatchIndex, TConstArrayView<FTruEntity> NewEntities)
+{
+	FTruEntityBatch& Batch = Batches[BatchIndex];
+
+	TArray<FTransform> MeshTransforms;
+	MeshTransforms.Reserve(NewEntities.Num());
+	for (const FTruEntity& Entity : NewEntities)
+	{
+		MeshTransforms.Add(Batch.GetMeshTransform(Entity));
+	}
+	Batch.Component->AddInstances(MeshTransforms, /*bShouldReturnIndices*/ false, /*bWorldSpace*/ true);
+	Batch.bRenderStateDirty = true;
+
+	const int32 FirstIndex = Batch.Entities.Num();
+	Batch.Entities.Append(NewEntities.GetData(), NewEntities.Num());
+	EntityLocations.Reserve(EntityLocations.Num() + NewEntities.Num());
+	for (int32 Index = FirstIndex; Index < Batch.Entities.Num(); ++Index)
+	{
+		FTruEntity& Entity = Batch.Entities[Index];
+		Entity.ProxyId = BVH.AddProxy(Batch.LocalBox, MeshTransforms[Index - FirstIndex]);
+		if (Entity.ProxyId >= ProxyEntities.Num())
+		{
+			ProxyEntities.SetNum(Entity.ProxyId + 1);
+		}
+		ProxyEntities[Entity.ProxyId] = Entity.Id;
+		EntityLocations.Add(Entity.Id, { BatchIndex, Index });
+	}
+}
+
+void UTruEntityStore::RemoveEntity(FTruObjectId Id)
+{
+	FEntityLocation Location;
+	if (!EntityLocations.RemoveAndCopyValue(Id, Location))
+	{
+		return;
+	}
+
+	FTruEntityBatch& Batch = Batches[Location.BatchIndex];
+	BVH.RemoveProxy(Batch.Entities[Location.EntityIndex].ProxyId);
+
+	// Same remove-at-swap as the instanced renderer, so record and instance indices keep matching
+	const int32 LastIndex = Batch.Entities.Num() - 1;
+	if (Location.EntityIndex != LastIndex)
+	{
+		const FTruEntity& MovedEntity = Batch.Entities[LastIndex];
+		if (IsValid(Batch.Component))
+		{
+			Batch.Component->UpdateInstanceTransform(Location.EntityIndex, Batch.GetMeshTransform(MovedEntity), /*bWorldSpace*/ true, /*bMarkRenderStateDirty*/ false, /*bTeleport*/ true);
+		}
+		EntityLocations.FindChecked(MovedEntity.Id).EntityIndex = Location.EntityIndex;
+		Batch.Entities[Location.EntityIndex] = MovedEntity;
+	}
+
+	Batch.Entities.Pop(EAllowShrinking::No);
+	if (IsValid(Batch.Component))
+	{
+		Batch.Component->RemoveInstance(LastIndex);
+	}
+	Batch.bRenderStateDirty = true;
+}
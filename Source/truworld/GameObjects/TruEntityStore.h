@@ -0,0 +1,160 @@
+// TruEntityStore.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TruBVH.h"
+#include "TruObjectRegistry.h"
+#include "TruEntityStore.generated.h"
+
+class ATruGameObject;
+class UHierarchicalInstancedStaticMeshComponent;
+class UMaterialInterface;
+class UStaticMesh;
+struct FConvexVolume;
+struct FTruSceneHit;
+
+/** Everything an idle object needs to be drawn, picked, saved and turned back into an actor. */
+struct FTruEntity
+{
+	FTruObjectId Id;
+	FVector Location = FVector::ZeroVector;
+	FQuat4f Rotation = FQuat4f::Identity;
+	FVector3f Scale = FVector3f::OneVector;
+	FName Name;
+	int32 ProxyId = INDEX_NONE;	// Picking proxy in the store's BVH
+
+	FTransform GetTransform() const { return FTransform(FQuat(Rotation), Location, FVector(Scale)); }
+};
+
+/** Entities of one class and mesh/material pair, drawn by a single HISM component. Entity index == instance index. */
+USTRUCT()
+struct FTruEntityBatch
+{
+	GENERATED_BODY()
+
+	UPROPERTY() TObjectPtr<UClass> Class;
+	UPROPERTY() TObjectPtr<UStaticMesh> Mesh;
+	UPROPERTY() TObjectPtr<UMaterialInterface> Material;
+	UPROPERTY() TObjectPtr<UHierarchicalInstancedStaticMeshComponent> Component;
+
+	/** Mesh component transform relative to the actor, the same for every object of the class. */
+	FTransform MeshRelativeTransform;
+	FBox LocalBox = FBox(ForceInit);
+
+	// Kept dense with remove-at-swap so it always matches the component's instances
+	TArray<FTruEntity> Entities;
+
+	bool bRenderStateDirty = false;
+
+	FTransform GetMeshTransform(const FTruEntity& Entity) const { return MeshRelativeTransform * Entity.GetTransform(); }
+};
+
+/** Results of one BenchmarkEntityStore size. Actor numbers are negative when that size was skipped. */
+struct FTruEntityBenchmark
+{
+	int32 NumEntities = 0;
+	/** Objects the demotion pass actually turned into entities; fewer than NumEntities if the editor was busy. */
+	int32 NumDemoted = 0;
+	double DemoteMs = 0.0;
+	double EntityGCMs = 0.0;
+	int64 EntityResidentBytes = 0;
+	int64 EntityStoreBytes = 0;
+	double ActorGCMs = -1.0;
+	int64 ActorResidentBytes = -1;
+};
+
+/**
+ * Compact storage for objects nobody is editing.
+ *
+ * With tru.EntityStore on, root objects without children are demoted a few per frame once they are not selected or
+ * being placed: the actor goes back to the pool (or is destroyed) and a small record - id, transform, name, and the
+ * class/mesh/material batch it belongs to - is drawn through a HISM component without collision. Their id stays
+ * reserved in UTruObjectRegistry and their name in UTruNameRegistry, so nothing else can take them meanwhile.
+ *
+ * Picking goes through the store's own BVH; selecting, dragging or opening the context menu on an entity promotes it
+ * to an actor with the same id, name and transform, and it is demoted again once it is left alone. Anything that
+ * only looks at actors (spatial index, transform mirror, snapping, the scatter brush) does not see entities, which is
+ * why the store is off by default.
+ */
+UCLASS()
+class TRUWORLD_API UTruEntityStore : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UTruEntityStore* Get(const UObject* WorldContextObject);
+	static bool IsEnabled();
+
+	/** Queues GameObject to be looked at for demotion. Called when an object registers and when its hierarchy changes. */
+	void AddCandidate(ATruGameObject* GameObject);
+
+	/** Turns GameObject into an entity right away if it can be one. The caller is responsible for it not being in use. */
+	bool Demote(ATruGameObject* GameObject);
+	/** Spawns the entity back as an actor with its id, name and transform, and removes the record. */
+	ATruGameObject* Promote(FTruObjectId Id);
+
+	bool Contains(FTruObjectId Id) const { return EntityLocations.Contains(Id); }
+	FName GetEntityName(FTruObjectId Id) const;
+	/** The entity's record and the batch it is drawn by. Valid until the next demotion or promotion. */
+	const FTruEntity* FindEntity(FTruObjectId Id, const FTruEntityBatch** OutBatch = nullptr) const;
+	void GetEntityIds(TArray<FTruObjectId>& OutIds) const;
+	int32 Num() const { return EntityLocations.Num(); }
+	const TArray<FTruEntityBatch>& GetBatches() const { return Batches; }
+
+	/** Closest entity box entered by the segment; fills EntityId rather than GameObject. */
+	bool Raycast(const FVector& Start, const FVector& End, FTruSceneHit& OutHit) const;
+	/** Entities whose bounds intersect Frustum, with those bounds. */
+	void FindInFrustum(const FConvexVolume& Frustum, TArray<FTruObjectId>& OutIds, TArray<FBox>& OutBounds) const;
+
+	/** Records, lookup table, picking BVH and name storage; the HISM components are not included. */
+	SIZE_T GetAllocatedSize() const;
+
+	/**
+	 * Spawns NumEntities objects and demotes them through the candidate queue, BenchmarkChunkSize at a time, then
+	 * measures GC time and resident memory. Does the same with NumEntities actors when that is no more than MaxActors.
+	 * The benchmark entities and actors are removed again afterwards.
+	 */
+	void RunBenchmark(int32 NumEntities, int32 MaxActors, FTruEntityBenchmark& OutResult);
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+private:
+	struct FEntityLocation
+	{
+		int32 BatchIndex = INDEX_NONE;
+		int32 EntityIndex = INDEX_NONE;
+	};
+
+	static constexpr int32 BenchmarkChunkSize = 10000;
+
+	/** Children, parents and child actors stay actors; so do objects the pool already took back. */
+	static bool CanEverDemote(const ATruGameObject* GameObject);
+	void DemoteCandidates(int32 Budget);
+	/** Demote without adding the record yet, so a frame's demotions can go into each batch in one call. */
+	bool TakeRecord(ATruGameObject* GameObject, int32& OutBatchIndex, FTruEntity& OutEntity);
+
+	int32 FindOrAddBatch(UClass* Class, UStaticMesh* Mesh, UMaterialInterface* Material, const FTransform& MeshRelativeTransform);
+	int32 AddBatch(UClass* Class, UStaticMesh* Mesh, UMaterialInterface* Material, const FTransform& MeshRelativeTransform);
+	void AddEntities(int32 BatchIndex, TConstArrayView<FTruEntity> NewEntities);
+	void RemoveEntity(FTruObjectId Id);
+	/** Removes the entity for good, releasing its id and name, as if it had been promoted and deleted. */
+	void DiscardEntity(FTruObjectId Id);
+
+	UPROPERTY() TObjectPtr<AActor> BatchHost;
+	UPROPERTY() TArray<FTruEntityBatch> Batches;
+
+	TMap<FTruObjectId, FEntityLocation> EntityLocations;
+
+	FTruBVH BVH;
+	TArray<FTruObjectId> ProxyEntities;	// Indexed by proxy id
+
+	// Objects still to be looked at. Ones that are in use right now are appended again, so they come round later.
+	TArray<TWeakObjectPtr<ATruGameObject>> Candidates;
+	int32 NextCandidate = 0;
+	// Objects that existed before tru.EntityStore was switched on are queued on the first tick after it
+	bool bSeeded = false;
+};
@@ -1,7 +1,21 @@
 // TruGameObject.cpp
 
 #include "TruGameObject.h"
+#include "TruEntityStore.h"
+#include "TruInstancedRenderer.h"
+#include "TruNameRegistry.h"
+#include "TruSceneBVH.h"
+#include "TruSpatialHash.h"
+#include "TruSpatialIndex.h"
+#include "TruTransformMirror.h"
 #include "truworld/Editor/EditorPlayerController.h"
+#include "truworld/Scene/TruAutosave.h"
+
+namespace
+{
+	// Set while SetActorLocations moves a batch; root updates are collected here rather than notified one at a time
+	TArray<ATruGameObject*>* BatchedMoves = nullptr;
+}
 
 ATruGameObject::ATruGameObject()
 {
@@ -9,6 +23,7 @@ ATruGameObject::ATruGameObject()
 
 	// Initialize components
 	Root = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+	Root->bWantsOnUpdateTransform = true;
 	RootComponent = Root;
 
 	BoxMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("BoxMesh"));
@@ -26,7 +41,9 @@ ATruGameObject::ATruGameObject()
 		BoxMesh->SetMaterial(0, Material.Object);
 	}
 
+	// Blocks everything like level geometry, but as a dynamic object so surface-only traces can skip it
 	BoxMesh->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+	BoxMesh->SetCollisionObjectType(ECC_WorldDynamic);
 }
 
 ATruGameObject::~ATruGameObject()
@@ -35,37 +52,379 @@ ATruGameObject::~ATruGameObject()
 
 void ATruGameObject::OnSelected()
 {
+	// The gizmo and the drag traces work on the object's own component
+	SetRenderInstanced(false);
 }
 
 void ATruGameObject::OnDeselected()
 {
+	SetRenderInstanced(UTruInstancedRenderer::IsEnabled());
+}
+
+void ATruGameObject::SetActorLocations(TConstArrayView<ATruGameObject*> GameObjects, TConstArrayView<FVector> Locations)
+{
+	check(GameObjects.Num() == Locations.Num());
+	check(IsInGameThread() && !BatchedMoves);
+
+	// Attached children move with their parents and report through the same root updates, so they are collected too
+	TArray<ATruGameObject*> Moved;
+	Moved.Reserve(GameObjects.Num());
+	{
+		TGuardValue<TArray<ATruGameObject*>*> CollectMoves(BatchedMoves, &Moved);
+		for (int32 Index = 0; Index < GameObjects.Num(); ++Index)
+		{
+			if (ATruGameObject* GameObject = GameObjects[Index])
+			{
+				GameObject->Root->SetWorldLocation(Locations[Index], /*bSweep*/ false, nullptr, ETeleportType::TeleportPhysics);
+			}
+		}
+	}
+	NotifyMoved(Moved);
+}
+
+FBox ATruGameObject::GetGameObjectBounds() const
+{
+	const UStaticMesh* Mesh = BoxMesh->GetStaticMesh();
+	if (!Mesh)
+	{
+		return FBox(GetActorLocation(), GetActorLocation());
+	}
+	return Mesh->GetBoundingBox().TransformBy(GetMeshTransform());
+}
+
+void ATruGameObject::SetRenderInstanced(bool bInstanced)
+{
+	if (bInstanced == bRenderInstanced)
+	{
+		return;
+	}
+
+	UTruInstancedRenderer* InstancedRenderer = UTruInstancedRenderer::Get(this);
+	if (!InstancedRenderer)
+	{
+		return;
+	}
+
+	if (bInstanced)
+	{
+		if (!InstancedRenderer->AddInstance(this))
+		{
+			return;
+		}
+
+		// Unregistering drops the render proxy and the physics body, not just the visibility
+		if (BoxMesh->IsRegistered())
+		{
+			BoxMesh->UnregisterComponent();
+		}
+	}
+	else
+	{
+		InstancedRenderer->RemoveInstance(this);
+		if (!BoxMesh->IsRegistered())
+		{
+			BoxMesh->RegisterComponent();
+		}
+	}
+	bRenderInstanced = bInstanced;
+}
+
+ATruGameObject* ATruGameObject::GetParentGameObject() const
+{
+	if (ATruGameObject* AttachParent = Cast<ATruGameObject>(GetAttachParentActor()))
+	{
+		return AttachParent;
+	}
+	return Cast<ATruGameObject>(GetParentActor());
+}
+
+void ATruGameObject::SetParentGameObject(ATruGameObject* NewParent)
+{
+	ATruGameObject* OldParent = GetParentGameObject();
+	if (NewParent == this || NewParent == OldParent)
+	{
+		return;
+	}
+
+	if (NewParent)
+	{
+		AttachToActor(NewParent, FAttachmentTransformRules::KeepWorldTransform);
+	}
+	else
+	{
+		DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+	}
+
+	if (AEditorPlayerController* EditorController = GetEditorPlayerController())
+	{
+		EditorController->OnGameObjectReparented(this);
+	}
+	if (UTruAutosave* Autosave = UTruAutosave::Get(this))
+	{
+		Autosave->MarkDirty(ObjectId);
+	}
+
+	// Either side may have just become a childless root
+	if (UTruEntityStore* EntityStore = UTruEntityStore::Get(this))
+	{
+		EntityStore->AddCandidate(this);
+		EntityStore->AddCandidate(OldParent);
+	}
+}
+
+bool ATruGameObject::RenameGameObject(const FString& NewName)
+{
+	const FName OldName = GetFName();
+	const FName RequestedName(*NewName);
+	if (NewName.IsEmpty() || RequestedName == OldName)
+	{
+		return false;
+	}
+
+	UTruNameRegistry* NameRegistry = UTruNameRegistry::Get(this);
+	if (NameRegistry && NameRegistry->IsNameTaken(RequestedName))
+	{
+		return false;
+	}
+
+	// Other objects in the level (not only TruGameObjects) share the namespace
+	if (!Rename(*NewName, nullptr, REN_Test))
+	{
+		return false;
+	}
+
+	Rename(*NewName);
+	if (NameRegistry)
+	{
+		NameRegistry->OnRenamed(OldName, GetFName());
+	}
+	if (AEditorPlayerController* EditorController = GetEditorPlayerController())
+	{
+		EditorController->OnGameObjectRenamed(this);
+	}
+	if (UTruAutosave* Autosave = UTruAutosave::Get(this))
+	{
+		Autosave->MarkDirty(ObjectId);
+	}
+	return true;
 }
 
 void ATruGameObject::BeginPlay()
 {
 	Super::BeginPlay();
-	NotifyEditorPlayerController();
+	RegisterWithWorld();
 }
 
 void ATruGameObject::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
+	// Pooled objects already left the editor when they were released
+	if (!bPooled)
+	{
+		UnregisterFromWorld();
+	}
 	Super::EndPlay(EndPlayReason);
-	NotifyEditorPlayerController();
+}
+
+void ATruGameObject::RegisterWithWorld()
+{
+	if (UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(this))
+	{
+		ObjectId = ObjectRegistry->Register(this, ObjectId);
+	}
+	if (UTruNameRegistry* NameRegistry = UTruNameRegistry::Get(this))
+	{
+		NameRegistry->Register(this);
+	}
+	if (UTruSceneBVH* SceneBVH = UTruSceneBVH::Get(this))
+	{
+		SceneBVH->Register(this);
+	}
+	if (UTruTransformMirror* TransformMirror = UTruTransformMirror::Get(this))
+	{
+		TransformMirror->Register(this);
+	}
+	if (UTruSpatialIndex* SpatialIndex = UTruSpatialIndex::Get(this))
+	{
+		SpatialIndex->Register(this);
+	}
+	if (UTruSpatialHash* SpatialHash = UTruSpatialHash::Get(this))
+	{
+		SpatialHash->Register(this);
+	}
+	Root->TransformUpdated.AddUObject(this, &ATruGameObject::OnRootTransformUpdated);
+
+	// An object coming back from the pool has no registered mesh; when it goes straight into the instance batch it never needs one
+	SetRenderInstanced(UTruInstancedRenderer::IsEnabled());
+	if (!bRenderInstanced && !BoxMesh->IsRegistered())
+	{
+		BoxMesh->RegisterComponent();
+	}
+
+	if (AEditorPlayerController* EditorController = GetEditorPlayerController())
+	{
+		EditorController->OnGameObjectAdded(this);
+	}
+	if (UTruEntityStore* EntityStore = UTruEntityStore::Get(this))
+	{
+		EntityStore->AddCandidate(this);
+	}
+	if (UTruAutosave* Autosave = UTruAutosave::Get(this))
+	{
+		Autosave->MarkDirty(ObjectId);
+	}
+}
+
+void ATruGameObject::UnregisterFromWorld()
+{
+	if (AEditorPlayerController* EditorController = GetEditorPlayerController())
+	{
+		EditorController->OnGameObjectRemoved(this);
+	}
+	if (UTruNameRegistry* NameRegistry = UTruNameRegistry::Get(this))
+	{
+		NameRegistry->Unregister(this);
+	}
+	if (UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(this))
+	{
+		ObjectRegistry->Unregister(ObjectId);
+	}
+	if (UTruAutosave* Autosave = UTruAutosave::Get(this))
+	{
+		Autosave->MarkDirty(ObjectId);
+	}
+	if (UTruSceneBVH* SceneBVH = UTruSceneBVH::Get(this))
+	{
+		SceneBVH->Unregister(this);
+	}
+	if (UTruTransformMirror* TransformMirror = UTruTransformMirror::Get(this))
+	{
+		TransformMirror->Unregister(this);
+	}
+	if (UTruSpatialIndex* SpatialIndex = UTruSpatialIndex::Get(this))
+	{
+		SpatialIndex->Unregister(this);
+	}
+	if (UTruSpatialHash* SpatialHash = UTruSpatialHash::Get(this))
+	{
+		SpatialHash->Unregister(this);
+	}
+	if (bRenderInstanced)
+	{
+		if (UTruInstancedRenderer* InstancedRenderer = UTruInstancedRenderer::Get(this))
+		{
+			InstancedRenderer->RemoveInstance(this);
+		}
+		bRenderInstanced = false;
+	}
+	Root->TransformUpdated.RemoveAll(this);
+}
+
+void ATruGameObject::ReturnToPool(FName PooledName)
+{
+	UnregisterFromWorld();
+
+	if (GetAttachParentActor())
+	{
+		DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+	}
+	if (BoxMesh->IsRegistered())
+	{
+		BoxMesh->UnregisterComponent();
+	}
+	SetActorHiddenInGame(true);
+	SetOwner(nullptr);
+	SetInstigator(nullptr);
+
+	// Frees the name for new objects; the registry already forgot it
+	Rename(*PooledName.ToString(), nullptr, REN_DontCreateRedirectors | REN_DoNotDirty | REN_NonTransactional);
+
+	ObjectId = FTruObjectId();
+	bPooled = true;
+	++PoolGeneration;
+}
+
+void ATruGameObject::TakeFromPool(const FTransform& Transform, FName Name, AActor* NewOwner, APawn* NewInstigator, FTruObjectId RequestedId)
+{
+	Rename(*Name.ToString(), nullptr, REN_DontCreateRedirectors | REN_DoNotDirty | REN_NonTransactional);
+	SetOwner(NewOwner);
+	SetInstigator(NewInstigator);
+	SetActorHiddenInGame(false);
+
+	// Nothing listens to the root yet, so moving it here costs no BVH or instance update
+	SetActorTransform(Transform, /*bSweep*/ false, nullptr, ETeleportType::TeleportPhysics);
+
+	ObjectId = RequestedId;
+	bPooled = false;
+	RegisterWithWorld();
 }
 
 void ATruGameObject::OnConstruction(const FTransform& Transform)
 {
 	Super::OnConstruction(Transform);
-	NotifyEditorPlayerController();
 }
 
-void ATruGameObject::NotifyEditorPlayerController()
+void ATruGameObject::OnRootTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
 {
-	if(!GetWorld())
+	if (BatchedMoves)
+	{
+		BatchedMoves->Add(this);
+		return;
+	}
+	NotifyMoved(MakeArrayView<ATruGameObject*>({ this }));
+}
+
+void ATruGameObject::NotifyMoved(TConstArrayView<ATruGameObject*> GameObjects)
+{
+	if (GameObjects.IsEmpty())
+	{
 		return;
-	AEditorPlayerController* EditorController = Cast<AEditorPlayerController>(GetWorld()->GetFirstPlayerController());
-	if (EditorController)
+	}
+
+	const ATruGameObject* WorldContext = GameObjects[0];
+	UTruSceneBVH* SceneBVH = UTruSceneBVH::Get(WorldContext);
+	UTruTransformMirror* TransformMirror = UTruTransformMirror::Get(WorldContext);
+	UTruSpatialIndex* SpatialIndex = UTruSpatialIndex::Get(WorldContext);
+	UTruSpatialHash* SpatialHash = UTruSpatialHash::Get(WorldContext);
+	UTruAutosave* Autosave = UTruAutosave::Get(WorldContext);
+	UTruInstancedRenderer* InstancedRenderer = UTruInstancedRenderer::Get(WorldContext);
+	AEditorPlayerController* EditorController = WorldContext->GetEditorPlayerController();
+
+	for (ATruGameObject* GameObject : GameObjects)
 	{
-		EditorController->OnGameObjectsRefreshed();
+		if (SceneBVH)
+		{
+			SceneBVH->MarkMoved(GameObject);
+		}
+		if (TransformMirror)
+		{
+			TransformMirror->MarkMoved(GameObject);
+		}
+		if (SpatialIndex)
+		{
+			SpatialIndex->MarkMoved(GameObject);
+		}
+		if (SpatialHash)
+		{
+			SpatialHash->MarkMoved(GameObject);
+		}
+		if (Autosave)
+		{
+			Autosave->MarkDirty(GameObject->ObjectId);
+		}
+		if (InstancedRenderer && GameObject->bRenderInstanced)
+		{
+			InstancedRenderer->UpdateInstanceTransform(GameObject);
+		}
+		if (EditorController)
+		{
+			EditorController->OnGameObjectMoved(GameObject);
+		}
 	}
 }
+
+AEditorPlayerController* ATruGameObject::GetEditorPlayerController() const
+{
+	if(!GetWorld())
+		return nullptr;
+	return Cast<AEditorPlayerController>(GetWorld()->GetFirstPlayerController());
+}
@@ -6,8 +6,11 @@
 #include "GameFramework/Actor.h"
 #include "Components/SceneComponent.h"
 #include "Components/StaticMeshComponent.h"
+#include "TruObjectRegistry.h"
 #include "TruGameObject.generated.h"
 
+class AEditorPlayerController;
+
 UCLASS()
 class TRUWORLD_API ATruGameObject : public AActor
 {
@@ -18,18 +21,79 @@ public:
 	virtual ~ATruGameObject();
 
 
+	/** The object became, or stopped being, the primary selection that the gizmo and drag traces act on. */
 	void OnSelected();
 	void OnDeselected();
+
+	/**
+	 * Moves every object to the matching location without sweeping. Each actor still takes its own component update;
+	 * what is batched is everything listening to moves (BVH, mirror, spatial indices, autosave, instance batch and
+	 * selection), which is told about all the moved objects, children included, in one pass per listener afterwards.
+	 */
+	static void SetActorLocations(TConstArrayView<ATruGameObject*> GameObjects, TConstArrayView<FVector> Locations);
+
+	/** Outliner parent: the TruGameObject this one is attached to, or the owner of its child actor component. */
+	ATruGameObject* GetParentGameObject() const;
+	/** Attaches to NewParent (or detaches when null), keeping the world transform, and tells the outliner. */
+	void SetParentGameObject(ATruGameObject* NewParent);
+
+	/** Renames the actor if no other TruGameObject in the world uses NewName. Returns false and keeps the old name otherwise. */
+	bool RenameGameObject(const FString& NewName);
+
+	UStaticMeshComponent* GetMeshComponent() const { return BoxMesh; }
+
+	/** Stable id from UTruObjectRegistry, assigned in BeginPlay and invalid while pooled. */
+	FTruObjectId GetObjectId() const { return ObjectId; }
+
+	/**
+	 * World-space bounds of the mesh, computed from the actor transform so they are right whether or not BoxMesh
+	 * is registered. Only reads state, so worker threads may call it while the game thread waits on them.
+	 */
+	FBox GetGameObjectBounds() const;
+	/** Mesh-to-world transform, also valid while BoxMesh is unregistered. */
+	FTransform GetMeshTransform() const { return BoxMesh->GetRelativeTransform() * GetActorTransform(); }
+
+	/**
+	 * Switches between drawing through the world's shared instance batch and drawing (and colliding) through
+	 * BoxMesh. Objects are instanced while idle and use their own component while selected.
+	 */
+	void SetRenderInstanced(bool bInstanced);
+	bool IsRenderInstanced() const { return bRenderInstanced; }
+
+	/** Released to UTruGameObjectPool: hidden, unregistered from the editor and waiting to be reused. */
+	bool IsPooled() const { return bPooled; }
+	/** Incremented whenever the object goes back to the pool, so a kept pointer can tell a reused object from the one it saw. */
+	uint32 GetPoolGeneration() const { return PoolGeneration; }
 protected:
 	virtual void BeginPlay() override;
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void OnConstruction(const FTransform& Transform) override;
 
-	void NotifyEditorPlayerController();
+	AEditorPlayerController* GetEditorPlayerController() const;
+
+	void OnRootTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+	/** Tells the world's move listeners about objects whose root moved, looking each listener up once. */
+	static void NotifyMoved(TConstArrayView<ATruGameObject*> GameObjects);
 
 	
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
 	USceneComponent* Root;
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
 	UStaticMeshComponent* BoxMesh;
+
+private:
+	friend class UTruGameObjectPool;
+
+	/** Everything BeginPlay and reuse from the pool hook up: name registry, BVH, rendering and the editor. */
+	void RegisterWithWorld();
+	void UnregisterFromWorld();
+
+	void ReturnToPool(FName PooledName);
+	void TakeFromPool(const FTransform& Transform, FName Name, AActor* NewOwner, APawn* NewInstigator, FTruObjectId RequestedId);
+
+	/** Before BeginPlay this is the id requested by whoever spawned the object; the registry may hand out another. */
+	FTruObjectId ObjectId;
+	bool bRenderInstanced = false;
+	bool bPooled = false;
+	uint32 PoolGeneration = 0;
 };
@@ -0,0 +1,220 @@
+// TruGameObjectPool.cpp
+
+#include "TruGameObjectPool.h"
+
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "TruGameObject.h"
+
+static TAutoConsoleVariable<bool> CVarTruPoolGameObjects(
+	TEXT("tru.PoolGameObjects"),
+	true,
+	TEXT("Keep deleted TruGameObjects hidden in a pool and reuse them for new spawns instead of destroying them."));
+
+static TAutoConsoleVariable<int32> CVarTruPoolMaxFree(
+	TEXT("tru.PoolMaxFree"),
+	16384,
+	TEXT("Released TruGameObjects kept for reuse; deletes beyond this destroy the actor."));
+
+UTruGameObjectPool* UTruGameObjectPool::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UTruGameObjectPool>() : nullptr;
+}
+
+bool UTruGameObjectPool::IsEnabled()
+{
+	return CVarTruPoolGameObjects.GetValueOnGameThread();
+}
+
+ATruGameObject* UTruGameObjectPool::SpawnGameObject(UWorld* World, UClass* Class, const FTransform& Transform, const FActorSpawnParameters& SpawnParams, FTruObjectId ObjectId)
+{
+	if (!World || !Class)
+	{
+		return nullptr;
+	}
+
+	return Spawn(World, IsEnabled() ? World->GetSubsystem<UTruGameObjectPool>() : nullptr, Class, Transform, SpawnParams, ObjectId);
+}
+
+ATruGameObject* UTruGameObjectPool::Spawn(UWorld* World, UTruGameObjectPool* Pool, UClass* Class, const FTransform& Transform,
+	const FActorSpawnParameters& SpawnParams, FTruObjectId ObjectId)
+{
+	ULevel* Level = SpawnParams.OverrideLevel ? SpawnParams.OverrideLevel.Get() : World->PersistentLevel.Get();
+	ATruGameObject* GameObject = Pool ? Pool->TakeFree(Class, Level) : nullptr;
+	if (!GameObject)
+	{
+		if (!ObjectId.IsValid())
+		{
+			return World->SpawnActor<ATruGameObject>(Class, Transform, SpawnParams);
+		}
+
+		// The id has to be in place before BeginPlay registers the object
+		FActorSpawnParameters IdSpawnParams = SpawnParams;
+		IdSpawnParams.CustomPreSpawnInitalization = [ObjectId, PreSpawn = SpawnParams.CustomPreSpawnInitalization](AActor* Actor)
+		{
+			CastChecked<ATruGameObject>(Actor)->ObjectId = ObjectId;
+			if (PreSpawn)
+			{
+				PreSpawn(Actor);
+			}
+		};
+		return World->SpawnActor<ATruGameObject>(Class, Transform, IdSpawnParams);
+	}
+
+	// Same rule as ESpawnActorNameMode::Requested: the name if it is free, otherwise a unique one based on it
+	FName Name = SpawnParams.Name;
+	if (Name.IsNone() || StaticFindObjectFast(nullptr, Level, Name))
+	{
+		Name = MakeUniqueObjectName(Level, Class, Name.IsNone() ? Class->GetFName() : Name);
+	}
+
+	GameObject->TakeFromPool(Transform, Name, SpawnParams.Owner, SpawnParams.Instigator, ObjectId);
+	return GameObject;
+}
+
+void UTruGameObjectPool::DestroyGameObject(ATruGameObject* GameObject)
+{
+	if (!IsValid(GameObject) || GameObject->IsPooled())
+	{
+		return;
+	}
+
+	Destroy(GameObject, IsEnabled() ? Get(GameObject) : nullptr, CVarTruPoolMaxFree.GetValueOnGameThread());
+}
+
+void UTruGameObjectPool::Destroy(ATruGameObject* GameObject, UTruGameObjectPool* Pool, int32 MaxFree)
+{
+	// Child actors belong to their component, which would respawn them on its own
+	if (!Pool || GameObject->GetParentActor() || Pool->NumFree >= MaxFree)
+	{
+		GameObject->Destroy();
+		return;
+	}
+
+	Pool->Release(GameObject);
+}
+
+ATruGameObject* UTruGameObjectPool::TakeFree(UClass* Class, ULevel* Level)
+{
+	TArray<TWeakObjectPtr<ATruGameObject>>* Free = FreeObjects.Find(Class);
+	while (Free && Free->Num() > 0)
+	{
+		ATruGameObject* GameObject = Free->Pop(EAllowShrinking::No).Get();
+		--NumFree;
+		if (IsValid(GameObject) && GameObject->IsPooled() && GameObject->GetLevel() == Level)
+		{
+			return GameObject;
+		}
+	}
+	return nullptr;
+}
+
+void UTruGameObjectPool::Release(ATruGameObject* GameObject)
+{
+	TArray<AActor*> AttachedActors;
+	GameObject->GetAttachedActors(AttachedActors);
+	for (AActor* AttachedActor : AttachedActors)
+	{
+		if (ATruGameObject* AttachedGameObject = Cast<ATruGameObject>(AttachedActor))
+		{
+			AttachedGameObject->SetParentGameObject(nullptr);
+		}
+		else
+		{
+			AttachedActor->DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+		}
+	}
+
+	GameObject->ReturnToPool(MakeUniqueObjectName(GameObject->GetLevel(), GameObject->GetClass(), TEXT("PooledTruGameObject")));
+	FreeObjects.FindOrAdd(GameObject->GetClass()).Add(GameObject);
+	++NumFree;
+}
+
+void UTruGameObjectPool::RunBenchmark(int32 NumObjects, FTruPoolBenchmark& OutResult)
+{
+	UWorld* World = GetWorld();
+	OutResult = FTruPoolBenchmark();
+	OutResult.NumObjects = NumObjects;
+	if (!World || NumObjects <= 0)
+	{
+		return;
+	}
+
+	// A grid far below the scene, so nothing the user placed is touched or overlapped
+	const int32 GridSize = FMath::CeilToInt(FMath::Sqrt((double)NumObjects));
+	TArray<FTransform> Transforms;
+	Transforms.Reserve(NumObjects);
+	for (int32 Index = 0; Index < NumObjects; ++Index)
+	{
+		Transforms.Emplace(FVector((Index % GridSize) * 200.0, (Index / GridSize) * 200.0, -100000.0));
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	TArray<ATruGameObject*> Spawned;
+	Spawned.Reserve(NumObjects);
+
+	double StartTime = FPlatformTime::Seconds();
+	for (const FTransform& Transform : Transforms)
+	{
+		Spawned.Add(World->SpawnActor<ATruGameObject>(ATruGameObject::StaticClass(), Transform, SpawnParams));
+	}
+	OutResult.SpawnActorMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	StartTime = FPlatformTime::Seconds();
+	for (ATruGameObject* GameObject : Spawned)
+	{
+		if (GameObject)
+		{
+			GameObject->Destroy();
+		}
+	}
+	OutResult.DestroyMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	// The pool is used whatever tru.PoolGameObjects and tru.PoolMaxFree say, and it is big enough for the whole batch.
+	// Fill it first so the timed pass measures reuse rather than first-time construction.
+	const int32 MaxFree = NumFree + NumObjects;
+
+	Spawned.Reset();
+	for (const FTransform& Transform : Transforms)
+	{
+		Spawned.Add(Spawn(World, this, ATruGameObject::StaticClass(), Transform, SpawnParams, FTruObjectId()));
+	}
+	for (ATruGameObject* GameObject : Spawned)
+	{
+		if (IsValid(GameObject) && !GameObject->IsPooled())
+		{
+			Destroy(GameObject, this, MaxFree);
+		}
+	}
+
+	Spawned.Reset();
+	StartTime = FPlatformTime::Seconds();
+	for (const FTransform& Transform : Transforms)
+	{
+		Spawned.Add(Spawn(World, this, ATruGameObject::StaticClass(), Transform, SpawnParams, FTruObjectId()));
+	}
+	OutResult.PoolSpawnMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	StartTime = FPlatformTime::Seconds();
+	for (ATruGameObject* GameObject : Spawned)
+	{
+		if (IsValid(GameObject) && !GameObject->IsPooled())
+		{
+			Destroy(GameObject, this, MaxFree);
+		}
+	}
+	OutResult.PoolReleaseMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+}
+
+void UTruGameObjectPool::Deinitialize()
+{
+	// The pooled actors are ordinary level actors and go away with the world
+	FreeObjects.Reset();
+	NumFree = 0;
+
+	Super::Deinitialize();
+}
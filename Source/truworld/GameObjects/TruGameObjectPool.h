@@ -0,0 +1,71 @@
+// TruGameObjectPool.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "TruObjectRegistry.h"
+#include "TruGameObjectPool.generated.h"
+
+class ATruGameObject;
+
+/** Timings of one BenchmarkObjectPool run, all in milliseconds for the whole batch. */
+struct FTruPoolBenchmark
+{
+	int32 NumObjects = 0;
+	double SpawnActorMs = 0.0;
+	double DestroyMs = 0.0;
+	double PoolSpawnMs = 0.0;
+	double PoolReleaseMs = 0.0;
+};
+
+/**
+ * Recycles deleted TruGameObjects instead of destroying them.
+ *
+ * A released object is taken out of the editor (outliner, selection, name registry, BVH, instance batch), its mesh is
+ * unregistered and it is hidden and renamed out of the way. Spawning an object of the same class later just renames
+ * and moves it and hooks it up again, skipping actor construction, component creation and, while instancing is on,
+ * mesh registration. Every editor spawn and delete goes through SpawnGameObject/DestroyGameObject; with tru.PoolGameObjects
+ * off they are plain SpawnActor and Destroy.
+ */
+UCLASS()
+class TRUWORLD_API UTruGameObjectPool : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UTruGameObjectPool* Get(const UObject* WorldContextObject);
+	static bool IsEnabled();
+
+	/**
+	 * SpawnActor replacement. SpawnParams.Name is honoured like ESpawnActorNameMode::Requested, and ObjectId the same
+	 * way: it is used when no live object has it. Collision handling only applies to new actors.
+	 */
+	static ATruGameObject* SpawnGameObject(UWorld* World, UClass* Class, const FTransform& Transform, const FActorSpawnParameters& SpawnParams,
+		FTruObjectId ObjectId = FTruObjectId());
+	/** Destroy replacement. Attached objects are detached and stay in the level, as they would with Destroy. */
+	static void DestroyGameObject(ATruGameObject* GameObject);
+
+	int32 GetNumFree() const { return NumFree; }
+
+	/**
+	 * Spawns and deletes NumObjects through SpawnActor/Destroy and then through the pool. The pool pass ignores
+	 * tru.PoolGameObjects and tru.PoolMaxFree, so it measures pooling even where it is switched off. Leaves the pool warm.
+	 */
+	void RunBenchmark(int32 NumObjects, FTruPoolBenchmark& OutResult);
+
+	virtual void Deinitialize() override;
+
+private:
+	/** SpawnGameObject and DestroyGameObject with the pool and its limit given rather than read from the cvars. Pool may be null. */
+	static ATruGameObject* Spawn(UWorld* World, UTruGameObjectPool* Pool, UClass* Class, const FTransform& Transform,
+		const FActorSpawnParameters& SpawnParams, FTruObjectId ObjectId);
+	static void Destroy(ATruGameObject* GameObject, UTruGameObjectPool* Pool, int32 MaxFree);
+
+	ATruGameObject* TakeFree(UClass* Class, ULevel* Level);
+	void Release(ATruGameObject* GameObject);
+
+	TMap<TObjectKey<UClass>, TArray<TWeakObjectPtr<ATruGameObject>>> FreeObjects;
+	int32 NumFree = 0;
+};
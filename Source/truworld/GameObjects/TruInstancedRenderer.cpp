@@ -0,0 +1,201 @@
+// TruInstancedRenderer.cpp
+
+#include "TruInstancedRenderer.h"
+
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "TruGameObject.h"
+
+static TAutoConsoleVariable<bool> CVarTruInstancedRendering(
+	TEXT("tru.InstancedRendering"),
+	true,
+	TEXT("Render TruGameObjects that are not being edited through shared instanced static mesh components."));
+
+UTruInstancedRenderer* UTruInstancedRenderer::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UTruInstancedRenderer>() : nullptr;
+}
+
+bool UTruInstancedRenderer::IsEnabled()
+{
+	return CVarTruInstancedRendering.GetValueOnGameThread();
+}
+
+bool UTruInstancedRenderer::AddInstance(ATruGameObject* GameObject)
+{
+	if (!GameObject || InstanceLocations.Contains(GameObject))
+	{
+		return false;
+	}
+
+	UStaticMeshComponent* MeshComponent = GameObject->GetMeshComponent();
+	if (!MeshComponent || !MeshComponent->GetStaticMesh())
+	{
+		return false;
+	}
+
+	const int32 BatchIndex = FindOrAddBatch(MeshComponent->GetStaticMesh(), MeshComponent->GetMaterial(0));
+	if (BatchIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	FTruInstanceBatch& Batch = Batches[BatchIndex];
+	const int32 InstanceIndex = Batch.Component->AddInstance(GetInstanceTransform(GameObject), /*bWorldSpace*/ true);
+	check(InstanceIndex == Batch.InstanceToObject.Num());
+
+	Batch.InstanceToObject.Add(GameObject);
+	InstanceLocations.Add(GameObject, { BatchIndex, InstanceIndex });
+	return true;
+}
+
+void UTruInstancedRenderer::RemoveInstance(ATruGameObject* GameObject)
+{
+	FInstanceLocation Location;
+	if (!InstanceLocations.RemoveAndCopyValue(GameObject, Location))
+	{
+		return;
+	}
+
+	FTruInstanceBatch& Batch = Batches[Location.BatchIndex];
+	const int32 LastIndex = Batch.InstanceToObject.Num() - 1;
+
+	// Move the last instance into the freed slot ourselves so the index -> object table never depends on
+	// how the component reorders its instances internally
+	if (Location.InstanceIndex != LastIndex)
+	{
+		ATruGameObject* MovedObject = Batch.InstanceToObject[LastIndex];
+		if (IsValid(Batch.Component))
+		{
+			Batch.Component->UpdateInstanceTransform(Location.InstanceIndex, GetInstanceTransform(MovedObject), /*bWorldSpace*/ true, /*bMarkRenderStateDirty*/ false, /*bTeleport*/ true);
+		}
+		Batch.InstanceToObject[Location.InstanceIndex] = MovedObject;
+		InstanceLocations.FindChecked(MovedObject).InstanceIndex = Location.InstanceIndex;
+	}
+
+	Batch.InstanceToObject.Pop();
+	if (IsValid(Batch.Component))
+	{
+		Batch.Component->RemoveInstance(LastIndex);
+	}
+}
+
+void UTruInstancedRenderer::UpdateInstanceTransform(ATruGameObject* GameObject)
+{
+	const FInstanceLocation* Location = InstanceLocations.Find(GameObject);
+	if (!Location)
+	{
+		return;
+	}
+
+	// Render state is flushed once per frame in Tick, however many instances moved
+	FTruInstanceBatch& Batch = Batches[Location->BatchIndex];
+	Batch.Component->UpdateInstanceTransform(Location->InstanceIndex, GetInstanceTransform(GameObject), /*bWorldSpace*/ true, /*bMarkRenderStateDirty*/ false, /*bTeleport*/ true);
+	Batch.bRenderStateDirty = true;
+}
+
+ATruGameObject* UTruInstancedRenderer::GetGameObjectFromHit(const FHitResult& HitResult) const
+{
+	if (ATruGameObject* GameObject = Cast<ATruGameObject>(HitResult.GetActor()))
+	{
+		return GameObject;
+	}
+
+	if (!BatchHost || HitResult.GetActor() != BatchHost)
+	{
+		return nullptr;
+	}
+
+	for (const FTruInstanceBatch& Batch : Batches)
+	{
+		if (Batch.Component == HitResult.GetComponent())
+		{
+			return Batch.InstanceToObject.IsValidIndex(HitResult.Item) ? Batch.InstanceToObject[HitResult.Item] : nullptr;
+		}
+	}
+	return nullptr;
+}
+
+void UTruInstancedRenderer::Tick(float DeltaTime)
+{
+	for (FTruInstanceBatch& Batch : Batches)
+	{
+		if (Batch.bRenderStateDirty && IsValid(Batch.Component))
+		{
+			Batch.Component->MarkRenderStateDirty();
+		}
+		Batch.bRenderStateDirty = false;
+	}
+}
+
+TStatId UTruInstancedRenderer::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTruInstancedRenderer, STATGROUP_Tickables);
+}
+
+void UTruInstancedRenderer::Deinitialize()
+{
+	InstanceLocations.Reset();
+	Batches.Reset();
+	BatchHost = nullptr;
+
+	Super::Deinitialize();
+}
+
+int32 UTruInstancedRenderer::FindOrAddBatch(UStaticMesh* Mesh, UMaterialInterface* Material)
+{
+	// There are only ever a handful of mesh/material pairs
+	for (int32 BatchIndex = 0; BatchIndex < Batches.Num(); ++BatchIndex)
+	{
+		if (Batches[BatchIndex].Mesh == Mesh && Batches[BatchIndex].Material == Material)
+		{
+			return BatchIndex;
+		}
+	}
+
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return INDEX_NONE;
+	}
+
+	if (!BatchHost)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags |= RF_Transient;
+		BatchHost = World->SpawnActor<AActor>(SpawnParams);
+		if (!BatchHost)
+		{
+			return INDEX_NONE;
+		}
+
+		USceneComponent* HostRoot = NewObject<USceneComponent>(BatchHost, TEXT("Root"));
+		BatchHost->SetRootComponent(HostRoot);
+		HostRoot->RegisterComponent();
+	}
+
+	UHierarchicalInstancedStaticMeshComponent* Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(BatchHost);
+	Component->SetMobility(EComponentMobility::Movable);
+	Component->SetStaticMesh(Mesh);
+	Component->SetMaterial(0, Material);
+	Component->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+	Component->SetCollisionObjectType(ECC_WorldDynamic);
+	Component->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+	Component->SetupAttachment(BatchHost->GetRootComponent());
+	Component->RegisterComponent();
+	BatchHost->AddInstanceComponent(Component);
+
+	FTruInstanceBatch& Batch = Batches.AddDefaulted_GetRef();
+	Batch.Mesh = Mesh;
+	Batch.Material = Material;
+	Batch.Component = Component;
+	return Batches.Num() - 1;
+}
+
+FTransform UTruInstancedRenderer::GetInstanceTransform(const ATruGameObject* GameObject)
+{
+	return GameObject->GetMeshTransform();
+}
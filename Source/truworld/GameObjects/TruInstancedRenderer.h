@@ -0,0 +1,74 @@
+// TruInstancedRenderer.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TruInstancedRenderer.generated.h"
+
+class ATruGameObject;
+class UHierarchicalInstancedStaticMeshComponent;
+class UMaterialInterface;
+class UStaticMesh;
+
+/** All TruGameObjects that share one mesh/material pair, drawn by a single HISM component. */
+USTRUCT()
+struct FTruInstanceBatch
+{
+	GENERATED_BODY()
+
+	UPROPERTY() TObjectPtr<UStaticMesh> Mesh;
+	UPROPERTY() TObjectPtr<UMaterialInterface> Material;
+	UPROPERTY() TObjectPtr<UHierarchicalInstancedStaticMeshComponent> Component;
+
+	// Instance index -> object. Kept dense with remove-at-swap so it always matches the component's instances.
+	TArray<ATruGameObject*> InstanceToObject;
+
+	bool bRenderStateDirty = false;
+};
+
+/**
+ * World-level batching for ATruGameObject rendering.
+ *
+ * Objects that are not being edited hand their mesh over to a shared HISM component and unregister their own
+ * UStaticMeshComponent, so draw calls, render proxies and physics bodies no longer scale with object count.
+ * The selected object renders through its own component again so the gizmo and drag traces behave as before.
+ */
+UCLASS()
+class TRUWORLD_API UTruInstancedRenderer : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UTruInstancedRenderer* Get(const UObject* WorldContextObject);
+	static bool IsEnabled();
+
+	bool AddInstance(ATruGameObject* GameObject);
+	void RemoveInstance(ATruGameObject* GameObject);
+	void UpdateInstanceTransform(ATruGameObject* GameObject);
+
+	/** Maps a trace hit back to its object, whether it hit an object's own mesh or one of the batch instances. */
+	ATruGameObject* GetGameObjectFromHit(const FHitResult& HitResult) const;
+
+	int32 GetNumBatches() const { return Batches.Num(); }
+	int32 GetNumInstances() const { return InstanceLocations.Num(); }
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+private:
+	struct FInstanceLocation
+	{
+		int32 BatchIndex = INDEX_NONE;
+		int32 InstanceIndex = INDEX_NONE;
+	};
+
+	int32 FindOrAddBatch(UStaticMesh* Mesh, UMaterialInterface* Material);
+	static FTransform GetInstanceTransform(const ATruGameObject* GameObject);
+
+	UPROPERTY() TObjectPtr<AActor> BatchHost;
+	UPROPERTY() TArray<FTruInstanceBatch> Batches;
+
+	TMap<const ATruGameObject*, FInstanceLocation> InstanceLocations;
+};
@@ -0,0 +1,50 @@
+// TruNameRegistry.cpp
+
+#include "TruNameRegistry.h"
+
+#include "Engine/World.h"
+#include "TruGameObject.h"
+
+UTruNameRegistry* UTruNameRegistry::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UTruNameRegistry>() : nullptr;
+}
+
+void UTruNameRegistry::Register(const ATruGameObject* GameObject)
+{
+	if (GameObject)
+	{
+		SpawnNames.Remove(GameObject->GetFName());
+		LiveNames.Add(GameObject->GetFName());
+	}
+}
+
+void UTruNameRegistry::Unregister(const ATruGameObject* GameObject)
+{
+	if (GameObject)
+	{
+		LiveNames.Remove(GameObject->GetFName());
+	}
+}
+
+void UTruNameRegistry::OnRenamed(FName OldName, FName NewName)
+{
+	LiveNames.Remove(OldName);
+	LiveNames.Add(NewName);
+}
+
+FString UTruNameRegistry::MakeUniqueName(const FString& BaseName)
+{
+	int32& Suffix = NextSuffix.FindOrAdd(BaseName, 0);
+
+	// Only names that were taken by hand (rename, loaded level) can make this loop more than once
+	FString NewName;
+	do
+	{
+		NewName = FString::Printf(TEXT("%s (%d)"), *BaseName, Suffix++);
+	}
+	while (IsNameTaken(FName(*NewName)));
+
+	return NewName;
+}
@@ -0,0 +1,47 @@
+// TruNameRegistry.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TruNameRegistry.generated.h"
+
+class ATruGameObject;
+
+/**
+ * Per-world set of live ATruGameObject names, plus the names held by entity store records.
+ * Answers "is this name taken" and hands out "Base (N)" names without walking the actors in the world.
+ */
+UCLASS()
+class TRUWORLD_API UTruNameRegistry : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UTruNameRegistry* Get(const UObject* WorldContextObject);
+
+	void Register(const ATruGameObject* GameObject);
+	void Unregister(const ATruGameObject* GameObject);
+	void OnRenamed(FName OldName, FName NewName);
+
+	/** Keeps Name taken while its object is an entity; kept apart so an actor reusing the name cannot release it. */
+	void ReserveName(FName Name) { ReservedNames.Add(Name); }
+	void ReleaseName(FName Name) { ReservedNames.Remove(Name); }
+
+	/** Keeps Name taken for an object the spawn queue has yet to create; it becomes a live name once that object registers. */
+	void ReserveSpawnName(FName Name) { SpawnNames.Add(Name); }
+	void ReleaseSpawnName(FName Name) { SpawnNames.Remove(Name); }
+
+	bool IsNameTaken(FName Name) const { return LiveNames.Contains(Name) || ReservedNames.Contains(Name) || SpawnNames.Contains(Name); }
+
+	/** Returns "BaseName (N)" that no live, demoted or queued object uses. Amortized O(1): N only ever moves forward per base name. */
+	FString MakeUniqueName(const FString& BaseName);
+
+	int32 Num() const { return LiveNames.Num(); }
+
+private:
+	TSet<FName> LiveNames;
+	TSet<FName> ReservedNames;
+	TSet<FName> SpawnNames;
+	TMap<FString, int32> NextSuffix;
+};
@@ -0,0 +1,160 @@
+// TruObjectRegistry.cpp
+
+#include "TruObjectRegistry.h"
+
+#include "Engine/World.h"
+#include "TruGameObject.h"
+
+UTruObjectRegistry* UTruObjectRegistry::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UTruObjectRegistry>() : nullptr;
+}
+
+FTruObjectId UTruObjectRegistry::Register(ATruGameObject* GameObject, FTruObjectId RequestedId)
+{
+	if (!GameObject)
+	{
+		return FTruObjectId();
+	}
+
+	const uint32 Index = Claim(RequestedId);
+	Slots[Index].GameObject = GameObject;
+	++NumLive;
+	return FTruObjectId(Index, Slots[Index].Generation);
+}
+
+FTruObjectId UTruObjectRegistry::Reserve(FTruObjectId RequestedId)
+{
+	const uint32 Index = Claim(RequestedId);
+	Slots[Index].bReserved = true;
+	++NumReservedIds;
+	return FTruObjectId(Index, Slots[Index].Generation);
+}
+
+void UTruObjectRegistry::Release(FTruObjectId Id)
+{
+	if (!IsReserved(Id))
+	{
+		return;
+	}
+
+	const uint32 Index = Id.GetIndex();
+	Slots[Index].bReserved = false;
+	FreeSlots.Add(Index);
+	--NumReservedIds;
+}
+
+uint32 UTruObjectRegistry::Claim(FTruObjectId RequestedId)
+{
+	if (RequestedId.IsValid() && TryClaim(RequestedId))
+	{
+		return RequestedId.GetIndex();
+	}
+
+	uint32 Index = INDEX_NONE;
+	while (FreeSlots.Num() > 0)
+	{
+		const uint32 FreeIndex = FreeSlots.Pop(EAllowShrinking::No);
+		if (Slots[FreeIndex].IsFree())
+		{
+			Index = FreeIndex;
+			break;
+		}
+	}
+	if (Index == (uint32)INDEX_NONE)
+	{
+		Index = Slots.AddDefaulted();
+	}
+
+	FSlot& Slot = Slots[Index];
+	Slot.Generation = FMath::Max(Slot.Generation + 1, 1u);
+	return Index;
+}
+
+bool UTruObjectRegistry::TryClaim(FTruObjectId Id)
+{
+	// Ids from files and the clipboard are not trusted: an index far past the table would allocate it all the way up
+	const uint32 Index = Id.GetIndex();
+	if (Id.GetGeneration() == 0 || Index >= (uint32)Slots.Num() + MaxRequestedIndexGap)
+	{
+		return false;
+	}
+
+	// Slots skipped over by a high requested index become free for ordinary registrations
+	if (Index >= (uint32)Slots.Num())
+	{
+		const uint32 OldNum = Slots.Num();
+		Slots.SetNum(Index + 1);
+		for (uint32 NewIndex = Index; NewIndex-- > OldNum;)
+		{
+			FreeSlots.Add(NewIndex);
+		}
+	}
+
+	// Going back to an older generation would hand the newer ones out again, and their stale ids would resolve
+	FSlot& Slot = Slots[Index];
+	if (!Slot.IsFree() || Id.GetGeneration() < Slot.Generation)
+	{
+		return false;
+	}
+
+	Slot.Generation = Id.GetGeneration();
+	return true;
+}
+
+void UTruObjectRegistry::Unregister(FTruObjectId Id)
+{
+	if (!Find(Id))
+	{
+		return;
+	}
+
+	const uint32 Index = Id.GetIndex();
+	Slots[Index].GameObject = nullptr;
+	FreeSlots.Add(Index);
+	--NumLive;
+}
+
+ATruGameObject* UTruObjectRegistry::Find(FTruObjectId Id) const
+{
+	const uint32 Index = Id.GetIndex();
+	if (!Id.IsValid() || Index >= (uint32)Slots.Num() || Slots[Index].Generation != Id.GetGeneration())
+	{
+		return nullptr;
+	}
+	return Slots[Index].GameObject;
+}
+
+bool UTruObjectRegistry::IsReserved(FTruObjectId Id) const
+{
+	const uint32 Index = Id.GetIndex();
+	return Id.IsValid() && Index < (uint32)Slots.Num() && Slots[Index].Generation == Id.GetGeneration() && Slots[Index].bReserved;
+}
+
+bool UTruObjectRegistry::IsIdTaken(FTruObjectId Id) const
+{
+	return Find(Id) != nullptr || IsReserved(Id);
+}
+
+void UTruObjectRegistry::GetIds(TArray<FTruObjectId>& OutIds, int32 MaxIds) const
+{
+	OutIds.Reset(FMath::Min(MaxIds, NumLive + NumReservedIds));
+	for (int32 Index = 0; Index < Slots.Num() && OutIds.Num() < MaxIds; ++Index)
+	{
+		if (!Slots[Index].IsFree())
+		{
+			OutIds.Emplace((uint32)Index, Slots[Index].Generation);
+		}
+	}
+}
+
+void UTruObjectRegistry::Deinitialize()
+{
+	Slots.Empty();
+	FreeSlots.Empty();
+	NumLive = 0;
+	NumReservedIds = 0;
+
+	Super::Deinitialize();
+}
@@ -0,0 +1,92 @@
+// TruObjectRegistry.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TruObjectRegistry.generated.h"
+
+class ATruGameObject;
+
+/**
+ * Stable 64-bit handle to a TruGameObject: a slot index in the low half and the slot's generation in the high half.
+ * Generations start at 1, so 0 is never a valid id. Ids are saved with scenes and carried by the clipboard and
+ * the undo history, so they survive the actor they name being destroyed and recreated.
+ */
+struct FTruObjectId
+{
+	uint64 Value = 0;
+
+	FTruObjectId() = default;
+	explicit FTruObjectId(uint64 InValue) : Value(InValue) {}
+	FTruObjectId(uint32 Index, uint32 Generation) : Value(((uint64)Generation << 32) | Index) {}
+
+	bool IsValid() const { return Value != 0; }
+	uint32 GetIndex() const { return (uint32)Value; }
+	uint32 GetGeneration() const { return (uint32)(Value >> 32); }
+	FString ToString() const { return FString::Printf(TEXT("%016llx"), Value); }
+
+	bool operator==(const FTruObjectId& Other) const { return Value == Other.Value; }
+	bool operator!=(const FTruObjectId& Other) const { return Value != Other.Value; }
+	friend uint32 GetTypeHash(const FTruObjectId& Id) { return GetTypeHash(Id.Value); }
+};
+
+/**
+ * Per-world id -> TruGameObject table.
+ *
+ * Slots are kept in one dense array indexed by the id's slot index, so lookups are an array access plus a generation
+ * check. Freed slots go on a free list and come back with the next generation, which makes stale ids resolve to null
+ * instead of to whatever reused the slot.
+ */
+UCLASS()
+class TRUWORLD_API UTruObjectRegistry : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UTruObjectRegistry* Get(const UObject* WorldContextObject);
+
+	/** Gives GameObject RequestedId when that id can be claimed (see TryClaim), otherwise a new id. */
+	FTruObjectId Register(ATruGameObject* GameObject, FTruObjectId RequestedId = FTruObjectId());
+	void Unregister(FTruObjectId Id);
+
+	/** Holds an id for something that is not an actor right now (an entity store record). Same id rules as Register. */
+	FTruObjectId Reserve(FTruObjectId RequestedId = FTruObjectId());
+	void Release(FTruObjectId Id);
+
+	ATruGameObject* Find(FTruObjectId Id) const;
+	bool IsReserved(FTruObjectId Id) const;
+	bool IsIdTaken(FTruObjectId Id) const;
+
+	/** Ids of every live object and every reserved one, such as entity store records, at most MaxIds of them. */
+	void GetIds(TArray<FTruObjectId>& OutIds, int32 MaxIds = MAX_int32) const;
+
+	int32 Num() const { return NumLive; }
+	int32 NumReserved() const { return NumReservedIds; }
+
+	virtual void Deinitialize() override;
+
+private:
+	struct FSlot
+	{
+		ATruGameObject* GameObject = nullptr;
+		uint32 Generation = 0;
+		bool bReserved = false;
+
+		bool IsFree() const { return !GameObject && !bReserved; }
+	};
+
+	/** Requested ids may grow the table by at most this many slots; ones further out get a new id instead. */
+	static constexpr uint32 MaxRequestedIndexGap = 1 << 16;
+
+	/** Slot index for RequestedId when it is free, otherwise a free or new slot with its generation moved on. */
+	uint32 Claim(FTruObjectId RequestedId);
+	/** Takes Id's slot if it is free, within MaxRequestedIndexGap of the table and not behind Id's generation. */
+	bool TryClaim(FTruObjectId Id);
+
+	TArray<FSlot> Slots;
+	/** May hold slots that were claimed by a requested id since; those are skipped when popped. */
+	TArray<uint32> FreeSlots;
+	int32 NumLive = 0;
+	int32 NumReservedIds = 0;
+};
@@ -0,0 +1,305 @@
+// TruOctree.cpp
+
+#include "TruOctree.h"
+
+#include "ConvexVolume.h"
+
+FTruOctree::FTruOctree(double InRootHalfSize, int32 InMaxDepth)
+	: RootHalfSize(InRootHalfSize)
+	, MaxDepth(InMaxDepth)
+{
+	Reset();
+}
+
+int32 FTruOctree::AddElement(const FBox& Bounds)
+{
+	const int32 ElementId = FreeElements.Num() > 0 ? FreeElements.Pop(EAllowShrinking::No) : Elements.AddDefaulted();
+	Elements[ElementId].Bounds = Bounds;
+	Insert(ElementId);
+
+	++NumElements;
+	return ElementId;
+}
+
+void FTruOctree::RemoveElement(int32 ElementId)
+{
+	if (!Elements.IsValidIndex(ElementId) || Elements[ElementId].Node == INDEX_NONE)
+	{
+		return;
+	}
+
+	RemoveFromNode(ElementId);
+	FreeElements.Add(ElementId);
+	--NumElements;
+}
+
+void FTruOctree::UpdateElement(int32 ElementId, const FBox& Bounds)
+{
+	if (!Elements.IsValidIndex(ElementId) || Elements[ElementId].Node == INDEX_NONE)
+	{
+		return;
+	}
+
+	FElement& Element = Elements[ElementId];
+	Element.Bounds = Bounds;
+
+	// Small moves stay inside the loose bounds, which is the common case while dragging. A node that has split
+	// since the element arrived may have a better child for it, but that only costs query time. The root keeps
+	// whatever fits nowhere else, so only an element that could now go deeper leaves it.
+	const bool bStays = Element.Node != 0
+		? Fits(Nodes[Element.Node], Bounds)
+		: Nodes[0].FirstChild == INDEX_NONE || !Fits(Nodes[0], Bounds);
+	if (bStays)
+	{
+		return;
+	}
+
+	RemoveFromNode(ElementId);
+	Insert(ElementId);
+}
+
+void FTruOctree::Reset()
+{
+	Nodes.Reset();
+	Elements.Reset();
+	FreeElements.Reset();
+	NumElements = 0;
+
+	FNode& Root = Nodes.AddDefaulted_GetRef();
+	Root.HalfSize = RootHalfSize;
+}
+
+bool FTruOctree::Fits(const FNode& Node, const FBox& Bounds) const
+{
+	const FVector Center = Bounds.GetCenter();
+	const FVector Extent = Bounds.GetExtent();
+	return Extent.GetMax() <= Node.HalfSize
+		&& FMath::Abs(Center.X - Node.Center.X) <= Node.HalfSize
+		&& FMath::Abs(Center.Y - Node.Center.Y) <= Node.HalfSize
+		&& FMath::Abs(Center.Z - Node.Center.Z) <= Node.HalfSize;
+}
+
+FBox FTruOctree::GetLooseBounds(const FNode& Node) const
+{
+	return FBox::BuildAABB(Node.Center, FVector(Node.HalfSize * 2.0));
+}
+
+int32 FTruOctree::GetChildFor(const FNode& Node, const FVector& Point) const
+{
+	return Node.FirstChild
+		+ (Point.X >= Node.Center.X ? 1 : 0)
+		+ (Point.Y >= Node.Center.Y ? 2 : 0)
+		+ (Point.Z >= Node.Center.Z ? 4 : 0);
+}
+
+void FTruOctree::Insert(int32 ElementId)
+{
+	const FBox& Bounds = Elements[ElementId].Bounds;
+	const FVector Center = Bounds.GetCenter();
+
+	// Anything the root cell cannot hold stays in the root, which every query visits
+	int32 NodeIndex = 0;
+	if (Fits(Nodes[0], Bounds))
+	{
+		while (Nodes[NodeIndex].FirstChild != INDEX_NONE)
+		{
+			const int32 Child = GetChildFor(Nodes[NodeIndex], Center);
+			if (!Fits(Nodes[Child], Bounds))
+			{
+				break;
+			}
+			NodeIndex = Child;
+		}
+	}
+
+	AddToNode(NodeIndex, ElementId);
+	if (Nodes[NodeIndex].FirstChild == INDEX_NONE && Nodes[NodeIndex].Elements.Num() > SplitThreshold && Nodes[NodeIndex].Depth < MaxDepth)
+	{
+		Split(NodeIndex);
+	}
+}
+
+void FTruOctree::AddToNode(int32 NodeIndex, int32 ElementId)
+{
+	FElement& Element = Elements[ElementId];
+	Element.Node = NodeIndex;
+	Element.IndexInNode = Nodes[NodeIndex].Elements.Add(ElementId);
+}
+
+void FTruOctree::RemoveFromNode(int32 ElementId)
+{
+	FElement& Element = Elements[ElementId];
+	TArray<int32>& NodeElements = Nodes[Element.Node].Elements;
+
+	NodeElements.RemoveAtSwap(Element.IndexInNode, 1, EAllowShrinking::No);
+	if (NodeElements.IsValidIndex(Element.IndexInNode))
+	{
+		Elements[NodeElements[Element.IndexInNode]].IndexInNode = Element.IndexInNode;
+	}
+
+	Element.Node = INDEX_NONE;
+	Element.IndexInNode = INDEX_NONE;
+}
+
+void FTruOctree::Split(int32 NodeIndex)
+{
+	const int32 FirstChild = Nodes.AddDefaulted(8);
+	FNode& Node = Nodes[NodeIndex];
+	Node.FirstChild = FirstChild;
+
+	const double ChildHalfSize = Node.HalfSize * 0.5;
+	for (int32 ChildIndex = 0; ChildIndex < 8; ++ChildIndex)
+	{
+		FNode& Child = Nodes[FirstChild + ChildIndex];
+		Child.HalfSize = ChildHalfSize;
+		Child.Depth = Node.Depth + 1;
+		Child.Center = Node.Center + FVector(
+			(ChildIndex & 1) ? ChildHalfSize : -ChildHalfSize,
+			(ChildIndex & 2) ? ChildHalfSize : -ChildHalfSize,
+			(ChildIndex & 4) ? ChildHalfSize : -ChildHalfSize);
+	}
+
+	// Push down what fits a child; large elements stay here
+	TArray<int32> ToMove = MoveTemp(Nodes[NodeIndex].Elements);
+	Nodes[NodeIndex].Elements.Reset();
+	for (const int32 ElementId : ToMove)
+	{
+		const FBox& Bounds = Elements[ElementId].Bounds;
+		const int32 Child = GetChildFor(Nodes[NodeIndex], Bounds.GetCenter());
+		AddToNode(Fits(Nodes[Child], Bounds) ? Child : NodeIndex, ElementId);
+	}
+}
+
+template <typename NodeTestType, typename ElementTestType>
+void FTruOctree::Query(NodeTestType&& NodeTest, ElementTestType&& ElementTest, TArray<int32>& OutElements) const
+{
+	OutElements.Reset();
+
+	TArray<int32, TInlineAllocator<64>> Stack;
+	Stack.Add(0);
+	while (Stack.Num() > 0)
+	{
+		const int32 NodeIndex = Stack.Pop(EAllowShrinking::No);
+		const FNode& Node = Nodes[NodeIndex];
+
+		// The root also holds elements outside its cell, so it is always searched
+		if (NodeIndex != 0 && !NodeTest(GetLooseBounds(Node)))
+		{
+			continue;
+		}
+
+		for (const int32 ElementId : Node.Elements)
+		{
+			if (ElementTest(Elements[ElementId].Bounds))
+			{
+				OutElements.Add(ElementId);
+			}
+		}
+
+		if (Node.FirstChild != INDEX_NONE)
+		{
+			for (int32 ChildIndex = 0; ChildIndex < 8; ++ChildIndex)
+			{
+				Stack.Add(Node.FirstChild + ChildIndex);
+			}
+		}
+	}
+}
+
+void FTruOctree::FindInBox(const FBox& Box, TArray<int32>& OutElements) const
+{
+	auto Test = [&Box](const FBox& Bounds) { return Bounds.Intersect(Box); };
+	Query(Test, Test, OutElements);
+}
+
+void FTruOctree::FindInSphere(const FVector& Center, double Radius, TArray<int32>& OutElements) const
+{
+	const double RadiusSquared = FMath::Square(Radius);
+	auto Test = [&Center, RadiusSquared](const FBox& Bounds) { return Bounds.ComputeSquaredDistanceToPoint(Center) <= RadiusSquared; };
+	Query(Test, Test, OutElements);
+}
+
+void FTruOctree::FindInFrustum(const FConvexVolume& Frustum, TArray<int32>& OutElements) const
+{
+	auto Test = [&Frustum](const FBox& Bounds) { return Frustum.IntersectBox(Bounds.GetCenter(), Bounds.GetExtent()); };
+	Query(Test, Test, OutElements);
+}
+
+void FTruOctree::FindNearest(const FVector& Point, int32 K, double MaxDistance, TArray<int32>& OutElements) const
+{
+	OutElements.Reset();
+	if (K <= 0)
+	{
+		return;
+	}
+
+	struct FCandidate
+	{
+		double DistanceSquared;
+		int32 Index;
+	};
+
+	// Best first: nodes come off a min-heap by the distance to their loose bounds, and the search stops once the
+	// nearest remaining node is further away than the K-th best element found so far
+	auto NodeOrder = [](const FCandidate& A, const FCandidate& B) { return A.DistanceSquared < B.DistanceSquared; };
+	auto ResultOrder = [](const FCandidate& A, const FCandidate& B) { return A.DistanceSquared > B.DistanceSquared; };
+
+	TArray<FCandidate, TInlineAllocator<64>> NodeHeap;
+	TArray<FCandidate> Results;
+	Results.Reserve(K);
+	NodeHeap.HeapPush({ 0.0, 0 }, NodeOrder);
+
+	double MaxDistanceSquared = FMath::Square(MaxDistance);
+	while (NodeHeap.Num() > 0)
+	{
+		FCandidate NodeCandidate;
+		NodeHeap.HeapPop(NodeCandidate, NodeOrder, EAllowShrinking::No);
+		if (NodeCandidate.DistanceSquared > MaxDistanceSquared)
+		{
+			break;
+		}
+
+		const FNode& Node = Nodes[NodeCandidate.Index];
+		for (const int32 ElementId : Node.Elements)
+		{
+			const double DistanceSquared = Elements[ElementId].Bounds.ComputeSquaredDistanceToPoint(Point);
+			if (DistanceSquared > MaxDistanceSquared)
+			{
+				continue;
+			}
+
+			if (Results.Num() == K)
+			{
+				FCandidate Evicted;
+				Results.HeapPop(Evicted, ResultOrder, EAllowShrinking::No);
+			}
+			Results.HeapPush({ DistanceSquared, ElementId }, ResultOrder);
+
+			// With K results in hand, nothing further than the worst of them matters any more
+			if (Results.Num() == K)
+			{
+				MaxDistanceSquared = Results.HeapTop().DistanceSquared;
+			}
+		}
+
+		if (Node.FirstChild != INDEX_NONE)
+		{
+			for (int32 ChildIndex = 0; ChildIndex < 8; ++ChildIndex)
+			{
+				const int32 Child = Node.FirstChild + ChildIndex;
+				const double DistanceSquared = GetLooseBounds(Nodes[Child]).ComputeSquaredDistanceToPoint(Point);
+				if (DistanceSquared <= MaxDistanceSquared)
+				{
+					NodeHeap.HeapPush({ DistanceSquared, Child }, NodeOrder);
+				}
+			}
+		}
+	}
+
+	Results.Sort([](const FCandidate& A, const FCandidate& B) { return A.DistanceSquared < B.DistanceSquared; });
+	OutElements.Reserve(Results.Num());
+	for (const FCandidate& Result : Results)
+	{
+		OutElements.Add(Result.Index);
+	}
+}
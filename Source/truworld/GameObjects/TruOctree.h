@@ -0,0 +1,76 @@
+// TruOctree.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FConvexVolume;
+
+/**
+ * Loose octree over axis-aligned boxes.
+ *
+ * Every node's cell is stretched to twice its size for membership, so an element lives in the deepest node whose cell
+ * contains its center and whose half size is at least its largest extent. That makes updates cheap: an element that
+ * moves within its node's loose bounds stays where it is, and anything else is one remove and one insert. Leaves split
+ * once they hold more than SplitThreshold elements. Elements outside the root cell stay in the root.
+ */
+class TRUWORLD_API FTruOctree
+{
+public:
+	explicit FTruOctree(double InRootHalfSize = 1048576.0, int32 InMaxDepth = 12);
+
+	int32 AddElement(const FBox& Bounds);
+	void RemoveElement(int32 ElementId);
+	void UpdateElement(int32 ElementId, const FBox& Bounds);
+	void Reset();
+
+	int32 GetNumElements() const { return NumElements; }
+	int32 GetNumNodes() const { return Nodes.Num(); }
+	const FBox& GetElementBounds(int32 ElementId) const { return Elements[ElementId].Bounds; }
+
+	void FindInBox(const FBox& Box, TArray<int32>& OutElements) const;
+	void FindInSphere(const FVector& Center, double Radius, TArray<int32>& OutElements) const;
+	void FindInFrustum(const FConvexVolume& Frustum, TArray<int32>& OutElements) const;
+	/** Up to K elements whose bounds are closest to Point and within MaxDistance, nearest first. */
+	void FindNearest(const FVector& Point, int32 K, double MaxDistance, TArray<int32>& OutElements) const;
+
+private:
+	static constexpr int32 SplitThreshold = 16;
+
+	struct FNode
+	{
+		FVector Center = FVector::ZeroVector;
+		double HalfSize = 0.0;
+		int32 FirstChild = INDEX_NONE;	// Children are allocated as 8 consecutive nodes
+		int32 Depth = 0;
+		TArray<int32> Elements;
+	};
+
+	struct FElement
+	{
+		FBox Bounds = FBox(ForceInit);
+		int32 Node = INDEX_NONE;		// INDEX_NONE when the element slot is free
+		int32 IndexInNode = INDEX_NONE;
+	};
+
+	bool Fits(const FNode& Node, const FBox& Bounds) const;
+	FBox GetLooseBounds(const FNode& Node) const;
+	int32 GetChildFor(const FNode& Node, const FVector& Point) const;
+
+	void Insert(int32 ElementId);
+	void AddToNode(int32 NodeIndex, int32 ElementId);
+	void RemoveFromNode(int32 ElementId);
+	void Split(int32 NodeIndex);
+
+	/** Walks the nodes whose loose bounds pass NodeTest and collects the elements that pass ElementTest. */
+	template <typename NodeTestType, typename ElementTestType>
+	void Query(NodeTestType&& NodeTest, ElementTestType&& ElementTest, TArray<int32>& OutElements) const;
+
+	TArray<FNode> Nodes;
+	TArray<FElement> Elements;
+	TArray<int32> FreeElements;
+	int32 NumElements = 0;
+
+	double RootHalfSize;
+	int32 MaxDepth;
+};
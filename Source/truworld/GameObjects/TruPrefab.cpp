@@ -0,0 +1,1401 @@
+// TruPrefab.cpp
+
+#include "TruPrefab.h"
+
+#include "Async/ParallelFor.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "Misc/Paths.h"
+#include "TruGameObject.h"
+#include "TruGameObjectPool.h"
+#include "TruNameRegistry.h"
+#include "TruSceneBVH.h"
+#include "truworld/Scene/TruAutosave.h"
+#include "truworld/Scene/TruPlacementFile.h"
+#include "truworld/Scene/TruSceneFile.h"
+
+namespace
+{
+	// A part that comes back from an open instance within this of its definition is not an override
+	static constexpr double OverrideTolerance = 1.e-3;
+
+	// Exact part tests after a hit on an instance's bounds; instances whose parts all miss are skipped this many times
+	static constexpr int32 MaxRaycastAttempts = 8;
+}
+
+UTruPrefabLibrary* UTruPrefabLibrary::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UTruPrefabLibrary>() : nullptr;
+}
+
+FString UTruPrefabLibrary::GetPrefabDirectory()
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Prefabs"));
+}
+
+FString UTruPrefabLibrary::GetPrefabPath(FName PrefabName)
+{
+	return FPaths::Combine(GetPrefabDirectory(), PrefabName.ToString() + TruPrefab::Extension);
+}
+
+int32 UTruPrefabLibrary::CreateDefinition(FName PrefabName, TConstArrayView<ATruGameObject*> GameObjects, const FTransform& Root, FString* OutError)
+{
+	TArray<FTruPrefabPart> Parts;
+	CaptureParts(GameObjects, Root, Parts);
+	if (PrefabName.IsNone() || Parts.IsEmpty() || Parts.Num() > MAX_uint16)
+	{
+		if (OutError)
+		{
+			*OutError = PrefabName.IsNone() ? TEXT("A prefab needs a name") : Parts.IsEmpty() ? TEXT("Nothing to make a prefab of") : TEXT("Too many objects for one prefab");
+		}
+		return INDEX_NONE;
+	}
+	if (!SaveDefinition(PrefabName, Parts, OutError))
+	{
+		return INDEX_NONE;
+	}
+
+	int32 DefinitionIndex = INDEX_NONE;
+	if (const int32* Existing = DefinitionIndices.Find(PrefabName))
+	{
+		DefinitionIndex = *Existing;
+		CloseInstances(DefinitionIndex, INDEX_NONE);
+	}
+	else
+	{
+		DefinitionIndex = AddDefinition(PrefabName, OutError);
+	}
+
+	if (DefinitionIndex != INDEX_NONE)
+	{
+		SetParts(DefinitionIndex, MoveTemp(Parts));
+	}
+	return DefinitionIndex;
+}
+
+int32 UTruPrefabLibrary::FindOrLoadDefinition(FName PrefabName, FString* OutError)
+{
+	if (const int32* Existing = DefinitionIndices.Find(PrefabName))
+	{
+		return *Existing;
+	}
+
+	TArray<FTruPrefabPart> Parts;
+	if (!LoadParts(GetPrefabPath(PrefabName), Parts, OutError))
+	{
+		return INDEX_NONE;
+	}
+
+	const int32 DefinitionIndex = AddDefinition(PrefabName, OutError);
+	if (DefinitionIndex != INDEX_NONE)
+	{
+		SetParts(DefinitionIndex, MoveTemp(Parts));
+	}
+	return DefinitionIndex;
+}
+
+const FTruPrefabDefinition* UTruPrefabLibrary::GetDefinition(int32 DefinitionIndex) const
+{
+	return Definitions.IsValidIndex(DefinitionIndex) ? &Definitions[DefinitionIndex] : nullptr;
+}
+
+int32 UTruPrefabLibrary::AddInstance(int32 DefinitionIndex, const FTransform& Transform, FTruObjectId RequestedId)
+{
+	if (!Definitions.IsValidIndex(DefinitionIndex))
+	{
+		return INDEX_NONE;
+	}
+
+	FTruPrefabDefinition& Definition = Definitions[DefinitionIndex];
+
+	FTruPrefabInstance NewInstance;
+	NewInstance.Rotation = FQuat4f(Transform.GetRotation());
+	NewInstance.Location = Transform.GetLocation();
+	NewInstance.Scale = FVector3f(Transform.GetScale3D());
+	NewInstance.Definition = (uint16)DefinitionIndex;
+	NewInstance.Slot = Definition.Instances.Num();
+
+	// Read back from the record, so the parts sit exactly where a later redraw puts them
+	const FTransform InstanceTransform = NewInstance.GetTransform();
+	if (Definition.LocalBounds.IsValid)
+	{
+		NewInstance.ProxyId = BVH.AddProxy(Definition.LocalBounds, InstanceTransform);
+	}
+
+	const int32 Instance = Instances.Add(NewInstance);
+	Definition.Instances.Add(Instance);
+	if (Instance >= InstanceIds.Num())
+	{
+		InstanceIds.SetNum(Instance + 1);
+	}
+	if (UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(this))
+	{
+		InstanceIds[Instance] = ObjectRegistry->Reserve(RequestedId);
+		InstancesById.Add(InstanceIds[Instance], Instance);
+	}
+	MarkDirty(Instance);
+	if (NewInstance.ProxyId != INDEX_NONE)
+	{
+		if (NewInstance.ProxyId >= ProxyInstances.Num())
+		{
+			ProxyInstances.SetNum(NewInstance.ProxyId + 1);
+		}
+		ProxyInstances[NewInstance.ProxyId] = Instance;
+	}
+
+	// In part order, which is the order of the parts within each batch
+	for (const FTruPrefabPart& Part : Definition.Parts)
+	{
+		if (Part.Batch != INDEX_NONE && IsValid(Definition.Batches[Part.Batch].Component))
+		{
+			Definition.Batches[Part.Batch].Component->AddInstance(Part.MeshRelativeTransform * Part.RootTransform * InstanceTransform, /*bWorldSpace*/ true);
+		}
+	}
+	Definition.bRenderStateDirty = true;
+	return Instance;
+}
+
+int32 UTruPrefabLibrary::AddInstance(const FTruPrefabInstanceState& State, FTruObjectId RequestedId, FString* OutError)
+{
+	const int32 DefinitionIndex = FindOrLoadDefinition(State.Prefab, OutError);
+	const int32 Instance = AddInstance(DefinitionIndex, State.Transform, RequestedId);
+	if (Instance == INDEX_NONE || State.Overrides.IsEmpty())
+	{
+		return Instance;
+	}
+
+	const FTruPrefabDefinition& Definition = Definitions[DefinitionIndex];
+	FTruPrefabInstance& Placed = Instances[Instance];
+	for (const TPair<FName, FTruPrefabOverride>& Override : State.Overrides)
+	{
+		const int32 PartIndex = Definition.Parts.IndexOfByPredicate([&Override](const FTruPrefabPart& Part) { return Part.Name == Override.Key; });
+		if (PartIndex != INDEX_NONE && !Overrides.Contains(GetOverrideKey(Instance, PartIndex)))
+		{
+			Overrides.Add(GetOverrideKey(Instance, PartIndex), Override.Value);
+			++Placed.NumOverrides;
+		}
+	}
+	UpdateSlot(Instance);
+	return Instance;
+}
+
+void UTruPrefabLibrary::RemoveInstance(int32 Instance)
+{
+	if (!Instances.IsValidIndex(Instance))
+	{
+		return;
+	}
+
+	// Its objects go with it
+	FOpenInstance Open;
+	if (OpenInstances.RemoveAndCopyValue(Instance, Open))
+	{
+		UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(this);
+		for (const FTruObjectId PartId : Open.Parts)
+		{
+			OpenParts.Remove(PartId);
+			if (ATruGameObject* GameObject = ObjectRegistry ? ObjectRegistry->Find(PartId) : nullptr)
+			{
+				UTruGameObjectPool::DestroyGameObject(GameObject);
+			}
+		}
+	}
+
+	const FTruPrefabInstance Removed = Instances[Instance];
+	FTruPrefabDefinition& Definition = Definitions[Removed.Definition];
+	if (Removed.NumOverrides > 0)
+	{
+		for (int32 PartIndex = 0; PartIndex < Definition.Parts.Num(); ++PartIndex)
+		{
+			Overrides.Remove(GetOverrideKey(Instance, PartIndex));
+		}
+	}
+	if (Removed.ProxyId != INDEX_NONE)
+	{
+		BVH.RemoveProxy(Removed.ProxyId);
+	}
+
+	// Same remove-at-swap as the entity store, so slots and component instance indices keep matching
+	const int32 LastSlot = Definition.Instances.Num() - 1;
+	if (Removed.Slot != LastSlot)
+	{
+		const int32 Moved = Definition.Instances[LastSlot];
+		Definition.Instances[Removed.Slot] = Moved;
+		Instances[Moved].Slot = Removed.Slot;
+		UpdateSlot(Moved);
+	}
+	Definition.Instances.Pop(EAllowShrinking::No);
+	for (const FTruPrefabBatch& Batch : Definition.Batches)
+	{
+		if (IsValid(Batch.Component))
+		{
+			for (int32 BatchOffset = Batch.NumParts - 1; BatchOffset >= 0; --BatchOffset)
+			{
+				Batch.Component->RemoveInstance(Batch.GetInstanceIndex(LastSlot, BatchOffset));
+			}
+		}
+	}
+	Definition.bRenderStateDirty = true;
+
+	if (InstanceIds[Instance].IsValid())
+	{
+		MarkDirty(Instance);
+		InstancesById.Remove(InstanceIds[Instance]);
+		if (UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(this))
+		{
+			ObjectRegistry->Release(InstanceIds[Instance]);
+		}
+		InstanceIds[Instance] = FTruObjectId();
+	}
+	Instances.RemoveAt(Instance);
+}
+
+void UTruPrefabLibrary::SetInstanceTransform(int32 Instance, const FTransform& Transform)
+{
+	// The open instance's objects would be left behind
+	CloseInstance(Instance);
+	if (!Instances.IsValidIndex(Instance))
+	{
+		return;
+	}
+
+	FTruPrefabInstance& Moved = Instances[Instance];
+	Moved.Rotation = FQuat4f(Transform.GetRotation());
+	Moved.Location = Transform.GetLocation();
+	Moved.Scale = FVector3f(Transform.GetScale3D());
+	if (Moved.ProxyId != INDEX_NONE)
+	{
+		BVH.MoveProxy(Moved.ProxyId, Moved.GetTransform());
+		BVH.Refit();
+	}
+	UpdateSlot(Instance);
+	MarkDirty(Instance);
+}
+
+const FTruPrefabInstance* UTruPrefabLibrary::FindInstance(int32 Instance) const
+{
+	return Instances.IsValidIndex(Instance) ? &Instances[Instance] : nullptr;
+}
+
+FTruObjectId UTruPrefabLibrary::GetInstanceId(int32 Instance) const
+{
+	return Instances.IsValidIndex(Instance) ? InstanceIds[Instance] : FTruObjectId();
+}
+
+int32 UTruPrefabLibrary::FindInstanceById(FTruObjectId Id) const
+{
+	const int32* Instance = InstancesById.Find(Id);
+	return Instance ? *Instance : INDEX_NONE;
+}
+
+bool UTruPrefabLibrary::GetInstanceState(int32 Instance, FTruPrefabInstanceState& OutState) const
+{
+	if (!Instances.IsValidIndex(Instance))
+	{
+		return false;
+	}
+
+	const FTruPrefabInstance& Placed = Instances[Instance];
+	const FTruPrefabDefinition& Definition = Definitions[Placed.Definition];
+	OutState.Prefab = Definition.Name;
+	OutState.Transform = Placed.GetTransform();
+	OutState.Overrides.Reset();
+
+	if (const FOpenInstance* Open = OpenInstances.Find(Instance))
+	{
+		TArray<TPair<int32, FTruPrefabOverride>> OpenOverrides;
+		TArray<ATruGameObject*> PartObjects;
+		CaptureOverrides(Instance, *Open, OpenOverrides, PartObjects);
+		for (const TPair<int32, FTruPrefabOverride>& Override : OpenOverrides)
+		{
+			OutState.Overrides.Emplace(Definition.Parts[Override.Key].Name, Override.Value);
+		}
+		return true;
+	}
+
+	for (int32 PartIndex = 0; Placed.NumOverrides > 0 && PartIndex < Definition.Parts.Num(); ++PartIndex)
+	{
+		if (const FTruPrefabOverride* Override = Overrides.Find(GetOverrideKey(Instance, PartIndex)))
+		{
+			OutState.Overrides.Emplace(Definition.Parts[PartIndex].Name, *Override);
+		}
+	}
+	return true;
+}
+
+bool UTruPrefabLibrary::Raycast(const FVector& Start, const FVector& End, FTruSceneHit& OutHit) const
+{
+	// Instances move one at a time and SetInstanceTransform refits right away, so the tree is always current. Their
+	// bounds are only a first guess: the parts of a prefab rarely fill its box, so a hit there is confirmed against
+	// the parts before it counts.
+	TArray<int32, TInlineAllocator<MaxRaycastAttempts>> Rejected;
+	TArray<FTransform> PartTransforms;
+	TBitArray<> Visible;
+	for (int32 Attempt = 0; Attempt < MaxRaycastAttempts; ++Attempt)
+	{
+		FTruBVH::FHit BoundsHit;
+		const bool bHit = BVH.Raycast(Start, End, BoundsHit, [this, &Rejected](int32 ProxyId)
+		{
+			return Rejected.Contains(ProxyId) || OpenInstances.Contains(ProxyInstances[ProxyId]);
+		});
+		if (!bHit)
+		{
+			return false;
+		}
+
+		const int32 Instance = ProxyInstances[BoundsHit.ProxyId];
+		const FTruPrefabDefinition& Definition = Definitions[Instances[Instance].Definition];
+		GetPartTransforms(Instance, PartTransforms, Visible);
+
+		float BestTime = 2.0f;
+		int32 BestPart = INDEX_NONE;
+		FVector BestNormal = FVector::ZeroVector;
+		for (int32 PartIndex = 0; PartIndex < Definition.Parts.Num(); ++PartIndex)
+		{
+			const FTruPrefabPart& Part = Definition.Parts[PartIndex];
+			if (!Visible[PartIndex] || !Part.LocalBox.IsValid)
+			{
+				continue;
+			}
+
+			// The segment fraction is the same in mesh space, and box faces there only need rotating back out
+			const FTransform MeshTransform = Part.MeshRelativeTransform * PartTransforms[PartIndex];
+			FVector HitLocation;
+			FVector HitNormal;
+			float HitTime;
+			if (FMath::LineExtentBoxIntersection(Part.LocalBox, MeshTransform.InverseTransformPosition(Start), MeshTransform.InverseTransformPosition(End),
+				FVector::ZeroVector, HitLocation, HitNormal, HitTime) && HitTime < BestTime)
+			{
+				BestTime = HitTime;
+				BestPart = PartIndex;
+				BestNormal = MeshTransform.GetRotation().RotateVector(HitNormal);
+			}
+		}
+
+		if (BestPart != INDEX_NONE)
+		{
+			OutHit = FTruSceneHit();
+			OutHit.PrefabInstance = Instance;
+			OutHit.PrefabPart = BestPart;
+			OutHit.Distance = (End - Start).Size() * BestTime;
+			OutHit.Location = FMath::Lerp(Start, End, (double)BestTime);
+			OutHit.Normal = BestNormal;
+			return true;
+		}
+		Rejected.Add(BoundsHit.ProxyId);
+	}
+	return false;
+}
+
+bool UTruPrefabLibrary::OpenInstance(int32 Instance, TArray<ATruGameObject*>& OutParts)
+{
+	OutParts.Reset();
+	UWorld* World = GetWorld();
+	if (!World || !Instances.IsValidIndex(Instance) || OpenInstances.Contains(Instance))
+	{
+		return false;
+	}
+
+	const FTruPrefabDefinition& Definition = Definitions[Instances[Instance].Definition];
+	TArray<FTransform> PartTransforms;
+	TBitArray<> Visible;
+	GetPartTransforms(Instance, PartTransforms, Visible);
+
+	FOpenInstance Open;
+	for (int32 PartIndex = 0; PartIndex < Definition.Parts.Num(); ++PartIndex)
+	{
+		const FTruPrefabPart& Part = Definition.Parts[PartIndex];
+		ATruGameObject*& GameObject = OutParts.Add_GetRef(Visible[PartIndex] ? SpawnPart(Part, PartTransforms[PartIndex]) : nullptr);
+		FTruObjectId& PartId = Open.Parts.AddDefaulted_GetRef();
+		if (!GameObject)
+		{
+			continue;
+		}
+
+		if (Part.ParentIndex != INDEX_NONE && OutParts[Part.ParentIndex])
+		{
+			GameObject->SetParentGameObject(OutParts[Part.ParentIndex]);
+		}
+
+		PartId = GameObject->GetObjectId();
+		OpenParts.Add(PartId, Instance);
+	}
+
+	OpenInstances.Add(Instance, MoveTemp(Open));
+	UpdateSlot(Instance);
+	return true;
+}
+
+void UTruPrefabLibrary::CloseInstance(int32 Instance)
+{
+	FOpenInstance Open;
+	if (!OpenInstances.RemoveAndCopyValue(Instance, Open))
+	{
+		return;
+	}
+
+	TArray<TPair<int32, FTruPrefabOverride>> NewOverrides;
+	TArray<ATruGameObject*> PartObjects;
+	CaptureOverrides(Instance, Open, NewOverrides, PartObjects);
+	for (const FTruObjectId PartId : Open.Parts)
+	{
+		OpenParts.Remove(PartId);
+	}
+
+	for (ATruGameObject* GameObject : PartObjects)
+	{
+		UTruGameObjectPool::DestroyGameObject(GameObject);
+	}
+
+	FTruPrefabInstance& Closed = Instances[Instance];
+	const FTruPrefabDefinition& Definition = Definitions[Closed.Definition];
+	for (int32 PartIndex = 0; Closed.NumOverrides > 0 && PartIndex < Definition.Parts.Num(); ++PartIndex)
+	{
+		Overrides.Remove(GetOverrideKey(Instance, PartIndex));
+	}
+	for (const TPair<int32, FTruPrefabOverride>& Override : NewOverrides)
+	{
+		Overrides.Add(GetOverrideKey(Instance, Override.Key), Override.Value);
+	}
+	Closed.NumOverrides = (uint16)NewOverrides.Num();
+	UpdateSlot(Instance);
+	MarkDirty(Instance);
+}
+
+bool UTruPrefabLibrary::IsInstanceEmpty(int32 Instance) const
+{
+	if (!Instances.IsValidIndex(Instance) || OpenInstances.Contains(Instance))
+	{
+		return false;
+	}
+
+	const FTruPrefabInstance& Placed = Instances[Instance];
+	const FTruPrefabDefinition& Definition = Definitions[Placed.Definition];
+	if (Placed.NumOverrides < Definition.Parts.Num())
+	{
+		return false;
+	}
+	for (int32 PartIndex = 0; PartIndex < Definition.Parts.Num(); ++PartIndex)
+	{
+		const FTruPrefabOverride* Override = Overrides.Find(GetOverrideKey(Instance, PartIndex));
+		if (!Override || !Override->bRemoved)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool UTruPrefabLibrary::ApplyInstance(int32 Instance, FString* OutError)
+{
+	const FOpenInstance* Found = OpenInstances.Find(Instance);
+	if (!Found)
+	{
+		if (OutError)
+		{
+			*OutError = TEXT("The prefab instance is not open");
+		}
+		return false;
+	}
+
+	// Copied, as closing the prefab's other open instances below changes the map
+	const FOpenInstance Open = *Found;
+	const int32 DefinitionIndex = Instances[Instance].Definition;
+	const FTruPrefabDefinition& Definition = Definitions[DefinitionIndex];
+	UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(this);
+
+	// Objects attached to the parts since the instance was opened are captured with them
+	TArray<ATruGameObject*> PartObjects;
+	TMap<FTruObjectId, FName> PartNames;
+	for (int32 PartIndex = 0; PartIndex < Open.Parts.Num(); ++PartIndex)
+	{
+		ATruGameObject* GameObject = ObjectRegistry ? ObjectRegistry->Find(Open.Parts[PartIndex]) : nullptr;
+		if (GameObject && !GameObject->IsPooled())
+		{
+			PartObjects.Add(GameObject);
+			PartNames.Add(Open.Parts[PartIndex], Definition.Parts[PartIndex].Name);
+		}
+	}
+
+	TArray<FTruPrefabPart> Parts;
+	TArray<FTruObjectId> PartIds;
+	CaptureParts(PartObjects, Instances[Instance].GetTransform(), Parts, &PartIds);
+	if (Parts.IsEmpty() || Parts.Num() > MAX_uint16)
+	{
+		if (OutError)
+		{
+			*OutError = Parts.IsEmpty() ? TEXT("Nothing is left of the prefab") : TEXT("Too many objects for one prefab");
+		}
+		return false;
+	}
+
+	// Parts keep their names in the prefab, not the unique ones their objects were spawned with, so other
+	// instances' overrides still find them
+	for (int32 PartIndex = 0; PartIndex < Parts.Num(); ++PartIndex)
+	{
+		if (const FName* PartName = PartNames.Find(PartIds[PartIndex]))
+		{
+			Parts[PartIndex].Name = *PartName;
+		}
+	}
+
+	if (!SaveDefinition(Definition.Name, Parts, OutError))
+	{
+		return false;
+	}
+
+	// The definition now looks like this instance, so it has no overrides left; every other open instance of the
+	// prefab is closed first, as its objects are matched to the parts by index
+	CloseInstances(DefinitionIndex, Instance);
+	FTruPrefabInstance& Applied = Instances[Instance];
+	for (int32 PartIndex = 0; Applied.NumOverrides > 0 && PartIndex < Definition.Parts.Num(); ++PartIndex)
+	{
+		Overrides.Remove(GetOverrideKey(Instance, PartIndex));
+	}
+	Applied.NumOverrides = 0;
+
+	for (const FTruObjectId PartId : Open.Parts)
+	{
+		OpenParts.Remove(PartId);
+	}
+	OpenInstances.Remove(Instance);
+	for (const FTruObjectId PartId : PartIds)
+	{
+		if (ATruGameObject* GameObject = ObjectRegistry ? ObjectRegistry->Find(PartId) : nullptr)
+		{
+			UTruGameObjectPool::DestroyGameObject(GameObject);
+		}
+	}
+
+	SetParts(DefinitionIndex, MoveTemp(Parts));
+	return true;
+}
+
+int32 UTruPrefabLibrary::FindOpenInstance(const ATruGameObject* GameObject) const
+{
+	const int32* Instance = GameObject ? OpenParts.Find(GameObject->GetObjectId()) : nullptr;
+	return Instance ? *Instance : INDEX_NONE;
+}
+
+bool UTruPrefabLibrary::IsOpenPart(const ATruGameObject* GameObject) const
+{
+	return GameObject && OpenParts.Contains(GameObject->GetObjectId());
+}
+
+void UTruPrefabLibrary::GetOpenInstances(TArray<int32>& OutInstances) const
+{
+	OpenInstances.GetKeys(OutInstances);
+}
+
+bool UTruPrefabLibrary::FindOpenPart(const ATruGameObject* GameObject, FTruObjectId& OutInstanceId, FName& OutPartName) const
+{
+	const int32 Instance = FindOpenInstance(GameObject);
+	const int32 PartIndex = Instance != INDEX_NONE ? OpenInstances[Instance].Parts.IndexOfByKey(GameObject->GetObjectId()) : INDEX_NONE;
+	if (PartIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	OutInstanceId = InstanceIds[Instance];
+	OutPartName = Definitions[Instances[Instance].Definition].Parts[PartIndex].Name;
+	return true;
+}
+
+ATruGameObject* UTruPrefabLibrary::RestorePart(FTruObjectId InstanceId, FName PartName, const FTransform& Transform)
+{
+	const int32 Instance = FindInstanceById(InstanceId);
+	const int32 PartIndex = FindPart(Instance, PartName);
+	if (PartIndex == INDEX_NONE)
+	{
+		return nullptr;
+	}
+
+	const FTruPrefabPart& Part = Definitions[Instances[Instance].Definition].Parts[PartIndex];
+	if (FOpenInstance* Open = OpenInstances.Find(Instance))
+	{
+		if (ATruGameObject* Existing = FindPartObject(*Open, PartIndex))
+		{
+			return Existing;
+		}
+
+		ATruGameObject* GameObject = SpawnPart(Part, Transform);
+		if (!GameObject)
+		{
+			return nullptr;
+		}
+
+		OpenParts.Remove(Open->Parts[PartIndex]);
+		Open->Parts[PartIndex] = GameObject->GetObjectId();
+		OpenParts.Add(Open->Parts[PartIndex], Instance);
+		if (ATruGameObject* Parent = Part.ParentIndex != INDEX_NONE ? FindPartObject(*Open, Part.ParentIndex) : nullptr)
+		{
+			GameObject->SetParentGameObject(Parent);
+		}
+		return GameObject;
+	}
+
+	TArray<FTransform> PartTransforms;
+	TBitArray<> Visible;
+	GetPartTransforms(Instance, PartTransforms, Visible);
+	FTruPrefabOverride Override;
+	Override.Transform = Transform.GetRelativeTransform(Part.ParentIndex == INDEX_NONE ? Instances[Instance].GetTransform() : PartTransforms[Part.ParentIndex]);
+	SetOverride(Instance, PartIndex, Override);
+	return nullptr;
+}
+
+ATruGameObject* UTruPrefabLibrary::SetPartTransform(FTruObjectId InstanceId, FName PartName, const FTransform& Transform)
+{
+	const int32 Instance = FindInstanceById(InstanceId);
+	const int32 PartIndex = FindPart(Instance, PartName);
+	if (PartIndex == INDEX_NONE)
+	{
+		return nullptr;
+	}
+
+	if (const FOpenInstance* Open = OpenInstances.Find(Instance))
+	{
+		ATruGameObject* GameObject = FindPartObject(*Open, PartIndex);
+		if (GameObject)
+		{
+			GameObject->SetActorTransform(Transform);
+		}
+		return GameObject;
+	}
+
+	const FTruPrefabPart& Part = Definitions[Instances[Instance].Definition].Parts[PartIndex];
+	const FTruPrefabOverride* Previous = Instances[Instance].NumOverrides > 0 ? Overrides.Find(GetOverrideKey(Instance, PartIndex)) : nullptr;
+	TArray<FTransform> PartTransforms;
+	TBitArray<> Visible;
+	GetPartTransforms(Instance, PartTransforms, Visible);
+	FTruPrefabOverride Override;
+	Override.Transform = Transform.GetRelativeTransform(Part.ParentIndex == INDEX_NONE ? Instances[Instance].GetTransform() : PartTransforms[Part.ParentIndex]);
+	Override.bRemoved = Previous && Previous->bRemoved;
+	SetOverride(Instance, PartIndex, Override);
+	return nullptr;
+}
+
+bool UTruPrefabLibrary::RemovePart(FTruObjectId InstanceId, FName PartName)
+{
+	const int32 Instance = FindInstanceById(InstanceId);
+	const int32 PartIndex = FindPart(Instance, PartName);
+	if (PartIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	// An open instance finds its missing objects when it is closed
+	if (const FOpenInstance* Open = OpenInstances.Find(Instance))
+	{
+		if (ATruGameObject* GameObject = FindPartObject(*Open, PartIndex))
+		{
+			UTruGameObjectPool::DestroyGameObject(GameObject);
+		}
+		return true;
+	}
+
+	const FTruPrefabOverride* Previous = Instances[Instance].NumOverrides > 0 ? Overrides.Find(GetOverrideKey(Instance, PartIndex)) : nullptr;
+	FTruPrefabOverride Override;
+	Override.Transform = Previous ? Previous->Transform : Definitions[Instances[Instance].Definition].Parts[PartIndex].Transform;
+	Override.bRemoved = true;
+	SetOverride(Instance, PartIndex, Override);
+	return true;
+}
+
+void UTruPrefabLibrary::WriteInstances(FTruSceneFileWriter& Writer) const
+{
+	FTruPrefabInstanceState State;
+	for (auto It = Instances.CreateConstIterator(); It; ++It)
+	{
+		GetInstanceState(It.GetIndex(), State);
+		const FString PrefabName = State.Prefab.ToString();
+		const int32 ClassIndex = Writer.AddClass(PrefabName);
+		const int32 InstanceIndex = Writer.AddObject(PrefabName, ClassIndex, State.Transform, INDEX_NONE, InstanceIds[It.GetIndex()].Value, TruScene::PrefabInstance);
+		for (const TPair<FName, FTruPrefabOverride>& Override : State.Overrides)
+		{
+			Writer.AddObject(Override.Key.ToString(), ClassIndex, Override.Value.Transform, InstanceIndex, 0,
+				TruScene::PrefabOverride | (Override.Value.bRemoved ? TruScene::PrefabPartRemoved : 0));
+		}
+	}
+}
+
+int32 UTruPrefabLibrary::ReadInstances(const FTruSceneFileReader& Reader)
+{
+	// The reader has checked that every override names an instance record
+	TMap<int32, FTruPrefabInstanceState> States;
+	for (int32 ObjectIndex = 0; ObjectIndex < Reader.GetNumObjects(); ++ObjectIndex)
+	{
+		const FTruSceneObjectRecord& Record = Reader.GetObject(ObjectIndex);
+		if ((Record.Flags & TruScene::PrefabInstance) != 0)
+		{
+			const FUtf8StringView PrefabName = Reader.GetClassPath(Record.ClassIndex);
+			FTruPrefabInstanceState& State = States.FindOrAdd(ObjectIndex);
+			State.Prefab = FName(PrefabName.Len(), PrefabName.GetData());
+			State.Transform = Record.GetTransform();
+		}
+		else if ((Record.Flags & TruScene::PrefabOverride) != 0)
+		{
+			const FUtf8StringView PartName = Reader.GetObjectName(ObjectIndex);
+			FTruPrefabOverride Override;
+			Override.Transform = Record.GetTransform();
+			Override.bRemoved = (Record.Flags & TruScene::PrefabPartRemoved) != 0;
+			States.FindOrAdd(Record.ParentIndex).Overrides.Emplace(FName(PartName.Len(), PartName.GetData()), Override);
+		}
+	}
+
+	int32 NumPlaced = 0;
+	for (const TPair<int32, FTruPrefabInstanceState>& State : States)
+	{
+		FString Error;
+		if (AddInstance(State.Value, FTruObjectId(Reader.GetObject(State.Key).ObjectId), &Error) != INDEX_NONE)
+		{
+			++NumPlaced;
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Prefab instance of %s is skipped: %s"), *State.Value.Prefab.ToString(), *Error);
+		}
+	}
+	return NumPlaced;
+}
+
+void UTruPrefabLibrary::WritePlacements(FTruPlacementWriter& Writer) const
+{
+	TArray<FTransform> PartTransforms;
+	TBitArray<> Visible;
+	TArray<FString> RowNames;
+	for (auto It = Instances.CreateConstIterator(); It; ++It)
+	{
+		// The parts of an open instance are objects, and written as such
+		const int32 Instance = It.GetIndex();
+		if (OpenInstances.Contains(Instance))
+		{
+			continue;
+		}
+
+		const FTruPrefabDefinition& Definition = Definitions[It->Definition];
+		GetPartTransforms(Instance, PartTransforms, Visible);
+		RowNames.Reset();
+		for (int32 PartIndex = 0; PartIndex < Definition.Parts.Num(); ++PartIndex)
+		{
+			const FTruPrefabPart& Part = Definition.Parts[PartIndex];
+			FString& RowName = RowNames.AddDefaulted_GetRef();
+			if (!Visible[PartIndex] || !Part.Class)
+			{
+				continue;
+			}
+
+			// A removed parent leaves its children as roots, as deleting it from the open instance did
+			RowName = FString::Printf(TEXT("%s_%d_%s"), *Definition.Name.ToString(), Instance, *Part.Name.ToString());
+			const FString ParentName = Part.ParentIndex == INDEX_NONE ? FString() : RowNames[Part.ParentIndex];
+			Writer.WriteRow(Part.Class->GetPathName(), RowName, ParentName, PartTransforms[PartIndex]);
+		}
+	}
+}
+
+SIZE_T UTruPrefabLibrary::GetAllocatedSize() const
+{
+	SIZE_T Size = Definitions.GetAllocatedSize() + DefinitionIndices.GetAllocatedSize() + Instances.GetAllocatedSize()
+		+ Overrides.GetAllocatedSize() + OpenInstances.GetAllocatedSize() + OpenParts.GetAllocatedSize()
+		+ InstanceIds.GetAllocatedSize() + InstancesById.GetAllocatedSize() + BVH.GetAllocatedSize() + ProxyInstances.GetAllocatedSize();
+	for (const FTruPrefabDefinition& Definition : Definitions)
+	{
+		Size += Definition.Parts.GetAllocatedSize() + Definition.Instances.GetAllocatedSize();
+	}
+	return Size;
+}
+
+void UTruPrefabLibrary::Tick(float DeltaTime)
+{
+	for (FTruPrefabDefinition& Definition : Definitions)
+	{
+		if (!Definition.bRenderStateDirty)
+		{
+			continue;
+		}
+		for (const FTruPrefabBatch& Batch : Definition.Batches)
+		{
+			if (IsValid(Batch.Component))
+			{
+				Batch.Component->MarkRenderStateDirty();
+			}
+		}
+		Definition.bRenderStateDirty = false;
+	}
+}
+
+TStatId UTruPrefabLibrary::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTruPrefabLibrary, STATGROUP_Tickables);
+}
+
+void UTruPrefabLibrary::Deinitialize()
+{
+	Definitions.Reset();
+	DefinitionIndices.Reset();
+	Instances.Reset();
+	Overrides.Reset();
+	InstanceIds.Reset();
+	InstancesById.Reset();
+	OpenInstances.Reset();
+	OpenParts.Reset();
+	BVH.Reset();
+	ProxyInstances.Reset();
+	BatchHost = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UTruPrefabLibrary::CaptureParts(TConstArrayView<ATruGameObject*> GameObjects, const FTransform& Root, TArray<FTruPrefabPart>& OutParts, TArray<FTruObjectId>* OutIds)
+{
+	// Breadth first from the objects that have no captured ancestor, so every parent is captured before its children
+	TSet<const ATruGameObject*> Requested;
+	for (const ATruGameObject* GameObject : GameObjects)
+	{
+		if (IsValid(GameObject) && !GameObject->IsPooled())
+		{
+			Requested.Add(GameObject);
+		}
+	}
+
+	TArray<ATruGameObject*> Objects;
+	TMap<const ATruGameObject*, int32> ObjectIndices;
+	for (ATruGameObject* GameObject : GameObjects)
+	{
+		if (!Requested.Contains(GameObject) || ObjectIndices.Contains(GameObject))
+		{
+			continue;
+		}
+
+		bool bHasRequestedAncestor = false;
+		for (const ATruGameObject* Ancestor = GameObject->GetParentGameObject(); Ancestor && !bHasRequestedAncestor; Ancestor = Ancestor->GetParentGameObject())
+		{
+			bHasRequestedAncestor = Requested.Contains(Ancestor);
+		}
+		if (!bHasRequestedAncestor)
+		{
+			ObjectIndices.Add(GameObject, Objects.Add(GameObject));
+		}
+	}
+
+	TArray<AActor*> AttachedActors;
+	for (int32 Index = 0; Index < Objects.Num(); ++Index)
+	{
+		Objects[Index]->GetAttachedActors(AttachedActors);
+		for (AActor* AttachedActor : AttachedActors)
+		{
+			ATruGameObject* Child = Cast<ATruGameObject>(AttachedActor);
+			if (Child && !Child->IsPooled() && !ObjectIndices.Contains(Child))
+			{
+				ObjectIndices.Add(Child, Objects.Add(Child));
+			}
+		}
+	}
+
+	OutParts.Reset(Objects.Num());
+	if (OutIds)
+	{
+		OutIds->Reset(Objects.Num());
+	}
+	for (const ATruGameObject* GameObject : Objects)
+	{
+		const ATruGameObject* Parent = GameObject->GetParentGameObject();
+		const int32* ParentIndex = ObjectIndices.Find(Parent);
+		const UStaticMeshComponent* MeshComponent = GameObject->GetMeshComponent();
+
+		FTruPrefabPart& Part = OutParts.AddDefaulted_GetRef();
+		Part.Class = GameObject->GetClass();
+		Part.Mesh = MeshComponent ? MeshComponent->GetStaticMesh() : nullptr;
+		Part.Material = MeshComponent ? MeshComponent->GetMaterial(0) : nullptr;
+		Part.MeshRelativeTransform = MeshComponent ? MeshComponent->GetRelativeTransform() : FTransform::Identity;
+		Part.Name = GameObject->GetFName();
+		Part.Transform = GameObject->GetActorTransform().GetRelativeTransform(ParentIndex ? Parent->GetActorTransform() : Root);
+		Part.ParentIndex = ParentIndex ? *ParentIndex : INDEX_NONE;
+		if (OutIds)
+		{
+			OutIds->Add(GameObject->GetObjectId());
+		}
+	}
+}
+
+FTransform UTruPrefabLibrary::GetHiddenTransform()
+{
+	// Keeps the slot, so every part's instance indices stay lined up with the definition's slots
+	return FTransform(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+}
+
+ATruGameObject* UTruPrefabLibrary::SpawnPart(const FTruPrefabPart& Part, const FTransform& Transform)
+{
+	UWorld* World = GetWorld();
+	if (!World || !Part.Class)
+	{
+		return nullptr;
+	}
+
+	UTruNameRegistry* NameRegistry = UTruNameRegistry::Get(this);
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParams.NameMode = FActorSpawnParameters::ESpawnActorNameMode::Requested;
+	SpawnParams.Name = NameRegistry ? FName(*NameRegistry->MakeUniqueName(Part.Name.ToString())) : Part.Name;
+	ATruGameObject* GameObject = UTruGameObjectPool::SpawnGameObject(World, Part.Class, Transform, SpawnParams);
+	if (!GameObject)
+	{
+		return nullptr;
+	}
+
+	// The object comes with its class default mesh, as a promoted entity does
+	UStaticMeshComponent* MeshComponent = GameObject->GetMeshComponent();
+	if (MeshComponent->GetStaticMesh() != Part.Mesh || MeshComponent->GetMaterial(0) != Part.Material)
+	{
+		const bool bWasInstanced = GameObject->IsRenderInstanced();
+		GameObject->SetRenderInstanced(false);
+		MeshComponent->SetStaticMesh(Part.Mesh);
+		MeshComponent->SetMaterial(0, Part.Material);
+		GameObject->SetRenderInstanced(bWasInstanced);
+	}
+	return GameObject;
+}
+
+int32 UTruPrefabLibrary::FindPart(int32 Instance, FName PartName) const
+{
+	if (!Instances.IsValidIndex(Instance))
+	{
+		return INDEX_NONE;
+	}
+	return Definitions[Instances[Instance].Definition].Parts.IndexOfByPredicate([PartName](const FTruPrefabPart& Part) { return Part.Name == PartName; });
+}
+
+ATruGameObject* UTruPrefabLibrary::FindPartObject(const FOpenInstance& Open, int32 PartIndex) const
+{
+	UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(this);
+	ATruGameObject* GameObject = ObjectRegistry && Open.Parts[PartIndex].IsValid() ? ObjectRegistry->Find(Open.Parts[PartIndex]) : nullptr;
+	return GameObject && !GameObject->IsPooled() ? GameObject : nullptr;
+}
+
+void UTruPrefabLibrary::SetOverride(int32 Instance, int32 PartIndex, const FTruPrefabOverride& Override)
+{
+	FTruPrefabInstance& Placed = Instances[Instance];
+	const FTruPrefabPart& Part = Definitions[Placed.Definition].Parts[PartIndex];
+	const uint64 Key = GetOverrideKey(Instance, PartIndex);
+	const bool bHadOverride = Placed.NumOverrides > 0 && Overrides.Contains(Key);
+	if (Override.bRemoved || !Override.Transform.Equals(Part.Transform, OverrideTolerance))
+	{
+		Overrides.Add(Key, Override);
+		Placed.NumOverrides += bHadOverride ? 0 : 1;
+	}
+	else if (bHadOverride)
+	{
+		Overrides.Remove(Key);
+		--Placed.NumOverrides;
+	}
+	UpdateSlot(Instance);
+	MarkDirty(Instance);
+}
+
+void UTruPrefabLibrary::CaptureOverrides(int32 Instance, const FOpenInstance& Open, TArray<TPair<int32, FTruPrefabOverride>>& OutOverrides, TArray<ATruGameObject*>& OutPartObjects) const
+{
+	const FTruPrefabInstance& Placed = Instances[Instance];
+	const FTruPrefabDefinition& Definition = Definitions[Placed.Definition];
+	const FTransform InstanceTransform = Placed.GetTransform();
+	UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(this);
+
+	// Parts are compared with their parent part as the instance had it, whether or not they are still attached to it
+	TArray<FTransform> PartTransforms;
+	PartTransforms.SetNumUninitialized(Definition.Parts.Num());
+	for (int32 PartIndex = 0; PartIndex < Definition.Parts.Num(); ++PartIndex)
+	{
+		const FTruPrefabPart& Part = Definition.Parts[PartIndex];
+		const FTransform& ParentTransform = Part.ParentIndex == INDEX_NONE ? InstanceTransform : PartTransforms[Part.ParentIndex];
+		const FTruObjectId PartId = Open.Parts[PartIndex];
+
+		ATruGameObject* GameObject = ObjectRegistry && PartId.IsValid() ? ObjectRegistry->Find(PartId) : nullptr;
+		FTruPrefabOverride Override;
+		if (GameObject && !GameObject->IsPooled())
+		{
+			OutPartObjects.Add(GameObject);
+			PartTransforms[PartIndex] = GameObject->GetActorTransform();
+			Override.Transform = PartTransforms[PartIndex].GetRelativeTransform(ParentTransform);
+		}
+		else
+		{
+			const FTruPrefabOverride* Previous = Placed.NumOverrides > 0 ? Overrides.Find(GetOverrideKey(Instance, PartIndex)) : nullptr;
+			Override.Transform = Previous ? Previous->Transform : Part.Transform;
+			Override.bRemoved = true;
+			PartTransforms[PartIndex] = Override.Transform * ParentTransform;
+		}
+
+		if (Override.bRemoved || !Override.Transform.Equals(Part.Transform, OverrideTolerance))
+		{
+			OutOverrides.Emplace(PartIndex, Override);
+		}
+	}
+}
+
+int32 UTruPrefabLibrary::AddDefinition(FName PrefabName, FString* OutError)
+{
+	// Instances refer to their definition with 16 bits
+	if (Definitions.Num() > MAX_uint16)
+	{
+		if (OutError)
+		{
+			*OutError = TEXT("Too many prefabs");
+		}
+		return INDEX_NONE;
+	}
+
+	FTruPrefabDefinition& Definition = Definitions.AddDefaulted_GetRef();
+	Definition.Name = PrefabName;
+	DefinitionIndices.Add(PrefabName, Definitions.Num() - 1);
+	return Definitions.Num() - 1;
+}
+
+bool UTruPrefabLibrary::LoadParts(const FString& Filename, TArray<FTruPrefabPart>& OutParts, FString* OutError) const
+{
+	FTruSceneFileReader Reader;
+	if (!Reader.Open(Filename, OutError))
+	{
+		return false;
+	}
+
+	TArray<UClass*> Classes;
+	TArray<const UStaticMeshComponent*> DefaultMeshes;
+	for (int32 ClassIndex = 0; ClassIndex < Reader.GetNumClasses(); ++ClassIndex)
+	{
+		const FUtf8StringView ClassPath = Reader.GetClassPath(ClassIndex);
+		UClass* Class = FSoftClassPath(FString(ClassPath.Len(), ClassPath.GetData())).TryLoadClass<ATruGameObject>();
+		const ATruGameObject* DefaultObject = Class ? Class->GetDefaultObject<ATruGameObject>() : nullptr;
+		Classes.Add(Class);
+		DefaultMeshes.Add(DefaultObject ? DefaultObject->GetMeshComponent() : nullptr);
+	}
+
+	// A part whose class is gone is left out; its children move up to the nearest part that is still there
+	const int32 NumObjects = Reader.GetNumObjects();
+	TArray<FTransform> RootTransforms;
+	TArray<int32> PartIndices;
+	RootTransforms.SetNumUninitialized(NumObjects);
+	PartIndices.Init(INDEX_NONE, NumObjects);
+	OutParts.Reset(NumObjects);
+	for (int32 ObjectIndex = 0; ObjectIndex < NumObjects; ++ObjectIndex)
+	{
+		const FTruSceneObjectRecord& Record = Reader.GetObject(ObjectIndex);
+		const int32 RecordParent = Record.ParentIndex < ObjectIndex ? Record.ParentIndex : INDEX_NONE;
+		RootTransforms[ObjectIndex] = RecordParent == INDEX_NONE ? Record.GetTransform() : Record.GetTransform() * RootTransforms[RecordParent];
+
+		UClass* Class = Classes[Record.ClassIndex];
+		if (!Class)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s: unknown class %s"), *Filename, *FString(Reader.GetClassPath(Record.ClassIndex).Len(), Reader.GetClassPath(Record.ClassIndex).GetData()));
+			continue;
+		}
+
+		int32 ParentObject = RecordParent;
+		while (ParentObject != INDEX_NONE && !Classes[Reader.GetObject(ParentObject).ClassIndex])
+		{
+			ParentObject = Reader.GetObject(ParentObject).ParentIndex < ParentObject ? Reader.GetObject(ParentObject).ParentIndex : INDEX_NONE;
+		}
+
+		const FUtf8StringView Name = Reader.GetObjectName(ObjectIndex);
+		const UStaticMeshComponent* DefaultMesh = DefaultMeshes[Record.ClassIndex];
+
+		FTruPrefabPart& Part = OutParts.AddDefaulted_GetRef();
+		Part.Class = Class;
+		Part.Mesh = DefaultMesh ? DefaultMesh->GetStaticMesh() : nullptr;
+		Part.Material = DefaultMesh ? DefaultMesh->GetMaterial(0) : nullptr;
+		Part.MeshRelativeTransform = DefaultMesh ? DefaultMesh->GetRelativeTransform() : FTransform::Identity;
+		Part.Name = FName(Name.Len(), Name.GetData());
+		Part.Transform = ParentObject == INDEX_NONE ? RootTransforms[ObjectIndex] : RootTransforms[ObjectIndex].GetRelativeTransform(RootTransforms[ParentObject]);
+		Part.ParentIndex = ParentObject == INDEX_NONE ? INDEX_NONE : PartIndices[ParentObject];
+		PartIndices[ObjectIndex] = OutParts.Num() - 1;
+	}
+
+	if (OutParts.IsEmpty() || OutParts.Num() > MAX_uint16)
+	{
+		if (OutError)
+		{
+			*OutError = OutParts.IsEmpty() ? TEXT("The prefab has no objects of known classes") : TEXT("Too many objects for one prefab");
+		}
+		return false;
+	}
+	return true;
+}
+
+bool UTruPrefabLibrary::SaveDefinition(FName PrefabName, TConstArrayView<FTruPrefabPart> Parts, FString* OutError) const
+{
+	FTruSceneFileWriter Writer;
+	for (const FTruPrefabPart& Part : Parts)
+	{
+		Writer.AddObject(Part.Name.ToString(), Writer.AddClass(Part.Class->GetPathName()), Part.Transform, Part.ParentIndex);
+	}
+
+	const FString Filename = GetPrefabPath(PrefabName);
+	if (!Writer.SaveToFile(Filename))
+	{
+		if (OutError)
+		{
+			*OutError = FString::Printf(TEXT("Could not write %s"), *Filename);
+		}
+		return false;
+	}
+	return true;
+}
+
+void UTruPrefabLibrary::CloseInstances(int32 DefinitionIndex, int32 KeptInstance)
+{
+	TArray<int32> Open;
+	OpenInstances.GetKeys(Open);
+	for (const int32 Instance : Open)
+	{
+		if (Instance != KeptInstance && Instances[Instance].Definition == DefinitionIndex)
+		{
+			CloseInstance(Instance);
+		}
+	}
+}
+
+void UTruPrefabLibrary::SetParts(int32 DefinitionIndex, TArray<FTruPrefabPart>&& NewParts)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	FTruPrefabDefinition& Definition = Definitions[DefinitionIndex];
+	TArray<FTruPrefabPart> OldParts = MoveTemp(Definition.Parts);
+
+	// Overrides follow their part by name; those of parts that are gone are dropped
+	TArray<int32> PartRemap;
+	PartRemap.Init(INDEX_NONE, OldParts.Num());
+	for (int32 OldIndex = 0; OldIndex < OldParts.Num(); ++OldIndex)
+	{
+		PartRemap[OldIndex] = NewParts.IndexOfByPredicate([&OldParts, OldIndex](const FTruPrefabPart& Part) { return Part.Name == OldParts[OldIndex].Name; });
+	}
+
+	// Their overrides may be remapped or dropped, so autosave writes each of them again
+	TArray<TPair<int32, FTruPrefabOverride>> Moved;
+	for (const int32 Instance : Definition.Instances)
+	{
+		MarkDirty(Instance);
+		FTruPrefabInstance& Changed = Instances[Instance];
+		if (Changed.NumOverrides == 0)
+		{
+			continue;
+		}
+
+		Moved.Reset();
+		for (int32 OldIndex = 0; OldIndex < OldParts.Num(); ++OldIndex)
+		{
+			FTruPrefabOverride Override;
+			if (Overrides.RemoveAndCopyValue(GetOverrideKey(Instance, OldIndex), Override) && PartRemap[OldIndex] != INDEX_NONE)
+			{
+				Moved.Emplace(PartRemap[OldIndex], Override);
+			}
+		}
+		for (const TPair<int32, FTruPrefabOverride>& Override : Moved)
+		{
+			Overrides.Add(GetOverrideKey(Instance, Override.Key), Override.Value);
+		}
+		Changed.NumOverrides = (uint16)Moved.Num();
+	}
+
+	// One batch per mesh and material. Components of batches that are still there are reused, as they mostly are.
+	using FBatchKey = TPair<UStaticMesh*, UMaterialInterface*>;
+	TArray<FTruPrefabBatch> OldBatches = MoveTemp(Definition.Batches);
+	TMap<FBatchKey, UHierarchicalInstancedStaticMeshComponent*> OldComponents;
+	for (const FTruPrefabPart& OldPart : OldParts)
+	{
+		if (OldPart.Batch != INDEX_NONE && IsValid(OldBatches[OldPart.Batch].Component))
+		{
+			OldComponents.Add({ OldPart.Mesh, OldPart.Material }, OldBatches[OldPart.Batch].Component);
+		}
+	}
+
+	TMap<FBatchKey, int32> BatchIndices;
+	for (FTruPrefabPart& Part : NewParts)
+	{
+		Part.Batch = INDEX_NONE;
+		if (!Part.Mesh)
+		{
+			continue;
+		}
+
+		const FBatchKey Key(Part.Mesh, Part.Material);
+		if (const int32* BatchIndex = BatchIndices.Find(Key))
+		{
+			Part.Batch = *BatchIndex;
+		}
+		else
+		{
+			FTruPrefabBatch& Batch = Definition.Batches.AddDefaulted_GetRef();
+			UHierarchicalInstancedStaticMeshComponent* Reused = nullptr;
+			Batch.Component = OldComponents.RemoveAndCopyValue(Key, Reused) ? Reused : CreateComponent(Part.Mesh, Part.Material);
+			Part.Batch = BatchIndices.Add(Key, Definition.Batches.Num() - 1);
+		}
+		Part.BatchOffset = Definition.Batches[Part.Batch].NumParts++;
+	}
+	for (const TPair<FBatchKey, UHierarchicalInstancedStaticMeshComponent*>& OldComponent : OldComponents)
+	{
+		OldComponent.Value->DestroyComponent();
+	}
+
+	Definition.Parts = MoveTemp(NewParts);
+	Definition.LocalBounds = FBox(ForceInit);
+	for (FTruPrefabPart& Part : Definition.Parts)
+	{
+		Part.RootTransform = Part.ParentIndex == INDEX_NONE ? Part.Transform : Part.Transform * Definition.Parts[Part.ParentIndex].RootTransform;
+		Part.LocalBox = Part.Mesh ? Part.Mesh->GetBoundingBox() : FBox(ForceInit);
+		if (Part.LocalBox.IsValid)
+		{
+			Definition.LocalBounds += Part.LocalBox.TransformBy(Part.MeshRelativeTransform * Part.RootTransform);
+		}
+	}
+
+	// Every instance at once: one transform array per batch, filled in parallel, then one call per component
+	const int32 NumSlots = Definition.Instances.Num();
+	TArray<TArray<FTransform>> MeshTransforms;
+	MeshTransforms.SetNum(Definition.Batches.Num());
+	for (int32 BatchIndex = 0; BatchIndex < Definition.Batches.Num(); ++BatchIndex)
+	{
+		MeshTransforms[BatchIndex].SetNumUninitialized(NumSlots * Definition.Batches[BatchIndex].NumParts);
+	}
+
+	ParallelFor(NumSlots, [this, &Definition, &MeshTransforms](int32 Slot)
+	{
+		const int32 Instance = Definition.Instances[Slot];
+		const bool bOpen = OpenInstances.Contains(Instance);
+		TArray<FTransform> PartTransforms;
+		TBitArray<> Visible;
+		GetPartTransforms(Instance, PartTransforms, Visible);
+		for (int32 PartIndex = 0; PartIndex < Definition.Parts.Num(); ++PartIndex)
+		{
+			const FTruPrefabPart& Part = Definition.Parts[PartIndex];
+			if (Part.Batch != INDEX_NONE)
+			{
+				MeshTransforms[Part.Batch][Definition.Batches[Part.Batch].GetInstanceIndex(Slot, Part.BatchOffset)] = bOpen || !Visible[PartIndex]
+					? GetHiddenTransform()
+					: Part.MeshRelativeTransform * PartTransforms[PartIndex];
+			}
+		}
+	}, NumSlots < 256 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+
+	for (int32 BatchIndex = 0; BatchIndex < Definition.Batches.Num(); ++BatchIndex)
+	{
+		if (UHierarchicalInstancedStaticMeshComponent* Component = Definition.Batches[BatchIndex].Component)
+		{
+			Component->ClearInstances();
+			Component->AddInstances(MeshTransforms[BatchIndex], /*bShouldReturnIndices*/ false, /*bWorldSpace*/ true);
+		}
+	}
+
+	// The bounds may have changed, so the picking proxies are made again
+	for (const int32 Instance : Definition.Instances)
+	{
+		FTruPrefabInstance& Changed = Instances[Instance];
+		if (Changed.ProxyId != INDEX_NONE)
+		{
+			BVH.RemoveProxy(Changed.ProxyId);
+			Changed.ProxyId = INDEX_NONE;
+		}
+		if (Definition.LocalBounds.IsValid)
+		{
+			Changed.ProxyId = BVH.AddProxy(Definition.LocalBounds, Changed.GetTransform());
+			if (Changed.ProxyId >= ProxyInstances.Num())
+			{
+				ProxyInstances.SetNum(Changed.ProxyId + 1);
+			}
+			ProxyInstances[Changed.ProxyId] = Instance;
+		}
+	}
+
+	Definition.bRenderStateDirty = true;
+	LastUpdateMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+}
+
+UHierarchicalInstancedStaticMeshComponent* UTruPrefabLibrary::CreateComponent(UStaticMesh* Mesh, UMaterialInterface* Material)
+{
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return nullptr;
+	}
+
+	if (!BatchHost)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags |= RF_Transient;
+		BatchHost = World->SpawnActor<AActor>(SpawnParams);
+		if (!BatchHost)
+		{
+			return nullptr;
+		}
+
+		USceneComponent* HostRoot = NewObject<USceneComponent>(BatchHost, TEXT("Root"));
+		BatchHost->SetRootComponent(HostRoot);
+		HostRoot->RegisterComponent();
+	}
+
+	// Picking goes through the library's BVH, so the instances need no physics bodies
+	UHierarchicalInstancedStaticMeshComponent* Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(BatchHost);
+	Component->SetMobility(EComponentMobility::Movable);
+	Component->SetStaticMesh(Mesh);
+	Component->SetMaterial(0, Material);
+	Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Component->SetupAttachment(BatchHost->GetRootComponent());
+	Component->RegisterComponent();
+	BatchHost->AddInstanceComponent(Component);
+	return Component;
+}
+
+void UTruPrefabLibrary::GetPartTransforms(int32 Instance, TArray<FTransform>& OutTransforms, TBitArray<>& OutVisible) const
+{
+	const FTruPrefabInstance& Placed = Instances[Instance];
+	const FTruPrefabDefinition& Definition = Definitions[Placed.Definition];
+	const FTransform InstanceTransform = Placed.GetTransform();
+	const int32 NumParts = Definition.Parts.Num();
+
+	OutTransforms.SetNumUninitialized(NumParts, EAllowShrinking::No);
+	OutVisible.Init(true, NumParts);
+	for (int32 PartIndex = 0; PartIndex < NumParts; ++PartIndex)
+	{
+		const FTruPrefabPart& Part = Definition.Parts[PartIndex];
+
+		// Most instances have no overrides and skip the lookups
+		const FTruPrefabOverride* Override = Placed.NumOverrides > 0 ? Overrides.Find(GetOverrideKey(Instance, PartIndex)) : nullptr;
+		if (!Override)
+		{
+			OutTransforms[PartIndex] = Part.ParentIndex == INDEX_NONE || Placed.NumOverrides == 0
+				? Part.RootTransform * InstanceTransform
+				: Part.Transform * OutTransforms[Part.ParentIndex];
+			continue;
+		}
+
+		OutTransforms[PartIndex] = Override->Transform * (Part.ParentIndex == INDEX_NONE ? InstanceTransform : OutTransforms[Part.ParentIndex]);
+		OutVisible[PartIndex] = !Override->bRemoved;
+	}
+}
+
+void UTruPrefabLibrary::MarkDirty(int32 Instance) const
+{
+	if (UTruAutosave* Autosave = UTruAutosave::Get(this))
+	{
+		Autosave->MarkDirty(InstanceIds[Instance]);
+	}
+}
+
+void UTruPrefabLibrary::UpdateSlot(int32 Instance)
+{
+	const FTruPrefabInstance& Placed = Instances[Instance];
+	FTruPrefabDefinition& Definition = Definitions[Placed.Definition];
+	const bool bOpen = OpenInstances.Contains(Instance);
+
+	TArray<FTransform> PartTransforms;
+	TBitArray<> Visible;
+	GetPartTransforms(Instance, PartTransforms, Visible);
+	for (int32 PartIndex = 0; PartIndex < Definition.Parts.Num(); ++PartIndex)
+	{
+		const FTruPrefabPart& Part = Definition.Parts[PartIndex];
+		const FTruPrefabBatch* Batch = Part.Batch != INDEX_NONE ? &Definition.Batches[Part.Batch] : nullptr;
+		if (Batch && IsValid(Batch->Component))
+		{
+			const FTransform MeshTransform = bOpen || !Visible[PartIndex] ? GetHiddenTransform() : Part.MeshRelativeTransform * PartTransforms[PartIndex];
+			Batch->Component->UpdateInstanceTransform(Batch->GetInstanceIndex(Placed.Slot, Part.BatchOffset), MeshTransform, /*bWorldSpace*/ true, /*bMarkRenderStateDirty*/ false, /*bTeleport*/ true);
+		}
+	}
+	Definition.bRenderStateDirty = true;
+}
@@ -0,0 +1,262 @@
+// TruPrefab.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TruBVH.h"
+#include "TruObjectRegistry.h"
+#include "TruPrefab.generated.h"
+
+class ATruGameObject;
+class FTruPlacementWriter;
+class FTruSceneFileReader;
+class FTruSceneFileWriter;
+class UHierarchicalInstancedStaticMeshComponent;
+class UMaterialInterface;
+class UStaticMesh;
+struct FTruSceneHit;
+
+namespace TruPrefab
+{
+	/** Prefab files are scene files whose objects are the parts, stored relative to their parent or the prefab root. */
+	static constexpr TCHAR Extension[] = TEXT(".truprefab");
+}
+
+/** One object of a prefab. Every instance of the prefab draws it through the component of its batch. */
+USTRUCT()
+struct FTruPrefabPart
+{
+	GENERATED_BODY()
+
+	UPROPERTY() TObjectPtr<UClass> Class;
+	UPROPERTY() TObjectPtr<UStaticMesh> Mesh;
+	UPROPERTY() TObjectPtr<UMaterialInterface> Material;
+
+	FName Name;
+	/** Relative to the parent part, or to the prefab root for root parts. */
+	FTransform Transform;
+	int32 ParentIndex = INDEX_NONE;	// Parents come before their children
+
+	// Filled in whenever the definition changes
+	FTransform RootTransform;		// Relative to the prefab root
+	FTransform MeshRelativeTransform;
+	FBox LocalBox = FBox(ForceInit);
+	int32 Batch = INDEX_NONE;	// INDEX_NONE for parts without a mesh
+	int32 BatchOffset = 0;		// Which of the batch's parts this is
+};
+
+/** The HISM component drawing every part of a definition that has one mesh and material, for all of its instances. */
+USTRUCT()
+struct FTruPrefabBatch
+{
+	GENERATED_BODY()
+
+	UPROPERTY() TObjectPtr<UHierarchicalInstancedStaticMeshComponent> Component;
+
+	/** Each slot holds one component instance per part, in part order. */
+	int32 NumParts = 0;
+
+	int32 GetInstanceIndex(int32 Slot, int32 BatchOffset) const { return Slot * NumParts + BatchOffset; }
+};
+
+/** What every instance of a prefab shares. */
+USTRUCT()
+struct FTruPrefabDefinition
+{
+	GENERATED_BODY()
+
+	UPROPERTY() TArray<FTruPrefabPart> Parts;
+	UPROPERTY() TArray<FTruPrefabBatch> Batches;
+
+	FName Name;
+	/** All parts' meshes in prefab root space; the instances' picking proxies use it. */
+	FBox LocalBounds = FBox(ForceInit);
+	/** Instance handles by slot. Kept dense with remove-at-swap, so a slot also finds its instances in every batch's component. */
+	TArray<int32> Instances;
+	bool bRenderStateDirty = false;
+};
+
+/**
+ * A placed prefab: its root transform and which definition it shows. The record has the same size whatever the
+ * definition holds; parts that differ from the definition are kept in the library's override table.
+ */
+struct FTruPrefabInstance
+{
+	FQuat4f Rotation = FQuat4f::Identity;
+	FVector Location = FVector::ZeroVector;
+	FVector3f Scale = FVector3f::OneVector;
+	uint16 Definition = 0;
+	uint16 NumOverrides = 0;
+	int32 Slot = INDEX_NONE;
+	int32 ProxyId = INDEX_NONE;	// Picking proxy in the library's BVH
+
+	FTransform GetTransform() const { return FTransform(FQuat(Rotation), Location, FVector(Scale)); }
+};
+static_assert(sizeof(FTruPrefabInstance) == 64, "Prefab instances are meant to stay one cache line");
+
+/** One part of one instance that differs from the definition. */
+struct FTruPrefabOverride
+{
+	FTransform Transform;	// Relative to the parent part, like the definition's
+	bool bRemoved = false;
+};
+
+/** Everything needed to place an instance again; overrides go by part name, so they outlive changes to the definition. */
+struct FTruPrefabInstanceState
+{
+	FName Prefab;
+	FTransform Transform;
+	TArray<TPair<FName, FTruPrefabOverride>> Overrides;
+};
+
+/**
+ * Prefabs: groups of objects saved once and placed many times.
+ *
+ * A definition keeps the parts' classes, meshes and hierarchy, and draws all of its instances through one HISM component
+ * without collision per mesh and material. An instance is a 64-byte record plus one HISM instance per part; picking
+ * goes through the library's BVH over the instances' bounds and then the parts' boxes.
+ *
+ * Picking an instance opens it: the instance is hidden and its parts are spawned as ordinary objects that can be
+ * moved and deleted. Closing it keeps what differs from the definition as overrides of that instance; applying it
+ * makes the parts the new definition instead, which is saved and redrawn for every instance in one pass per part.
+ * Objects added to an open instance stay ordinary objects when it is closed, and an instance closed with none of its
+ * parts left stays as well, so that undo can bring the parts back into it.
+ *
+ * Every instance holds a reserved object id, so the undo history and saved scenes can refer to it the way they
+ * refer to objects.
+ */
+UCLASS()
+class TRUWORLD_API UTruPrefabLibrary : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UTruPrefabLibrary* Get(const UObject* WorldContextObject);
+
+	/** Saved/Prefabs under the project directory. */
+	static FString GetPrefabDirectory();
+	static FString GetPrefabPath(FName PrefabName);
+
+	/**
+	 * Captures GameObjects and everything attached to them relative to Root, and saves them as PrefabName. A loaded
+	 * prefab of that name is replaced, which updates all of its instances. Returns the definition, or INDEX_NONE.
+	 */
+	int32 CreateDefinition(FName PrefabName, TConstArrayView<ATruGameObject*> GameObjects, const FTransform& Root, FString* OutError = nullptr);
+	/** A loaded definition, or the one saved under PrefabName, loaded now. */
+	int32 FindOrLoadDefinition(FName PrefabName, FString* OutError = nullptr);
+	const FTruPrefabDefinition* GetDefinition(int32 DefinitionIndex) const;
+
+	/** Returns the instance handle. The instance gets RequestedId when it can be claimed, as objects do. */
+	int32 AddInstance(int32 DefinitionIndex, const FTransform& Transform, FTruObjectId RequestedId = FTruObjectId());
+	/** Places State's prefab, loading it if needed, with those of its overrides whose parts it still has. */
+	int32 AddInstance(const FTruPrefabInstanceState& State, FTruObjectId RequestedId = FTruObjectId(), FString* OutError = nullptr);
+	void RemoveInstance(int32 Instance);
+	/** Moves the whole instance, closing it first if it is open. */
+	void SetInstanceTransform(int32 Instance, const FTransform& Transform);
+	const FTruPrefabInstance* FindInstance(int32 Instance) const;
+	FTruObjectId GetInstanceId(int32 Instance) const;
+	int32 FindInstanceById(FTruObjectId Id) const;
+	/** What AddInstance needs to bring the instance back. An open instance is captured as its objects are now. */
+	bool GetInstanceState(int32 Instance, FTruPrefabInstanceState& OutState) const;
+
+	/** Closest part box of a closed instance entered by the segment; fills PrefabInstance and PrefabPart rather than GameObject. */
+	bool Raycast(const FVector& Start, const FVector& End, FTruSceneHit& OutHit) const;
+
+	/** Hides the instance and spawns its parts as objects, null for parts the instance removed. */
+	bool OpenInstance(int32 Instance, TArray<ATruGameObject*>& OutParts);
+	/** Destroys the open instance's objects and shows it again, with whatever differed from the definition as overrides. */
+	void CloseInstance(int32 Instance);
+	/** Closed, with every part removed. */
+	bool IsInstanceEmpty(int32 Instance) const;
+	/** Makes the open instance's objects the new definition, saves it, updates every instance of it and closes this one. */
+	bool ApplyInstance(int32 Instance, FString* OutError = nullptr);
+	/** The open instance GameObject is a part of, or INDEX_NONE. */
+	int32 FindOpenInstance(const ATruGameObject* GameObject) const;
+	bool IsOpenPart(const ATruGameObject* GameObject) const;
+	bool IsInstanceOpen(int32 Instance) const { return OpenInstances.Contains(Instance); }
+	void GetOpenInstances(TArray<int32>& OutInstances) const;
+	/** The id of the open instance GameObject is a part of, and which part it is. */
+	bool FindOpenPart(const ATruGameObject* GameObject, FTruObjectId& OutInstanceId, FName& OutPartName) const;
+
+	// A part by instance id and part name, which outlive its object, for undo. On an open instance they act on the
+	// part's object and return it; on a closed one they change the part's override and return null.
+	/** Spawns the part again at Transform, or clears its removal. */
+	ATruGameObject* RestorePart(FTruObjectId InstanceId, FName PartName, const FTransform& Transform);
+	ATruGameObject* SetPartTransform(FTruObjectId InstanceId, FName PartName, const FTransform& Transform);
+	/** Destroys the part's object, or marks the part removed. False if there is no such part. */
+	bool RemovePart(FTruObjectId InstanceId, FName PartName);
+
+	/** Adds every instance to Writer as a prefab record followed by its overrides; an open one as its objects are now. */
+	void WriteInstances(FTruSceneFileWriter& Writer) const;
+	/** Places the reader's prefab instances under their saved ids where those are free. Returns the number placed. */
+	int32 ReadInstances(const FTruSceneFileReader& Reader);
+	/** Writes the visible parts of every closed instance as plain rows, placement files having no way to refer to a prefab. */
+	void WritePlacements(FTruPlacementWriter& Writer) const;
+
+	int32 GetNumDefinitions() const { return Definitions.Num(); }
+	int32 GetNumInstances() const { return Instances.Num(); }
+	int32 GetNumOverrides() const { return Overrides.Num(); }
+	/** How long the last definition change took to reach all of its instances. */
+	double GetLastUpdateMs() const { return LastUpdateMs; }
+	/** Definitions, instance records, overrides and picking BVH; the HISM components are not included. */
+	SIZE_T GetAllocatedSize() const;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+private:
+	/** Object ids of an open instance's parts by part index, invalid for parts it had removed. */
+	struct FOpenInstance
+	{
+		TArray<FTruObjectId> Parts;
+	};
+
+	static uint64 GetOverrideKey(int32 Instance, int32 PartIndex) { return ((uint64)(uint32)Instance << 32) | (uint32)PartIndex; }
+
+	/** Captures parts relative to Root. Parents are written before their children, as the clipboard does. */
+	static void CaptureParts(TConstArrayView<ATruGameObject*> GameObjects, const FTransform& Root, TArray<FTruPrefabPart>& OutParts, TArray<FTruObjectId>* OutIds = nullptr);
+	static FTransform GetHiddenTransform();
+	ATruGameObject* SpawnPart(const FTruPrefabPart& Part, const FTransform& Transform);
+	int32 FindPart(int32 Instance, FName PartName) const;
+	/** The live object of an open instance's part. */
+	ATruGameObject* FindPartObject(const FOpenInstance& Open, int32 PartIndex) const;
+	/** Sets or clears a closed instance's override, whichever Override amounts to, and redraws the instance. */
+	void SetOverride(int32 Instance, int32 PartIndex, const FTruPrefabOverride& Override);
+	/** What differs between the open instance's objects and its definition, and the objects that are still there. */
+	void CaptureOverrides(int32 Instance, const FOpenInstance& Open, TArray<TPair<int32, FTruPrefabOverride>>& OutOverrides, TArray<ATruGameObject*>& OutPartObjects) const;
+
+	int32 AddDefinition(FName PrefabName, FString* OutError);
+	bool LoadParts(const FString& Filename, TArray<FTruPrefabPart>& OutParts, FString* OutError) const;
+	bool SaveDefinition(FName PrefabName, TConstArrayView<FTruPrefabPart> Parts, FString* OutError) const;
+	/** Closes the definition's open instances other than KeptInstance, before its parts change under them. */
+	void CloseInstances(int32 DefinitionIndex, int32 KeptInstance);
+	/** Replaces a definition's parts, keeps overrides of parts whose name is still there, and redraws every instance. */
+	void SetParts(int32 DefinitionIndex, TArray<FTruPrefabPart>&& NewParts);
+	UHierarchicalInstancedStaticMeshComponent* CreateComponent(UStaticMesh* Mesh, UMaterialInterface* Material);
+
+	/** World transforms of the instance's parts. Removed parts are false in OutVisible. */
+	void GetPartTransforms(int32 Instance, TArray<FTransform>& OutTransforms, TBitArray<>& OutVisible) const;
+	/** Writes the instance's parts into its slot of every component; an open instance is written hidden. */
+	void UpdateSlot(int32 Instance);
+	/** Has the next autosave write the instance again. */
+	void MarkDirty(int32 Instance) const;
+
+	UPROPERTY() TObjectPtr<AActor> BatchHost;
+	UPROPERTY() TArray<FTruPrefabDefinition> Definitions;
+	TMap<FName, int32> DefinitionIndices;
+
+	TSparseArray<FTruPrefabInstance> Instances;
+	TMap<uint64, FTruPrefabOverride> Overrides;
+	TArray<FTruObjectId> InstanceIds;	// By instance handle
+	TMap<FTruObjectId, int32> InstancesById;
+
+	TMap<int32, FOpenInstance> OpenInstances;
+	TMap<FTruObjectId, int32> OpenParts;	// Part object id -> open instance
+
+	FTruBVH BVH;
+	TArray<int32> ProxyInstances;	// Indexed by proxy id
+
+	double LastUpdateMs = 0.0;
+};
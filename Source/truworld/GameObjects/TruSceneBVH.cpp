@@ -0,0 +1,166 @@
+// TruSceneBVH.cpp
+
+#include "TruSceneBVH.h"
+
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "TruGameObject.h"
+
+static TAutoConsoleVariable<bool> CVarTruBVHTraces(
+	TEXT("tru.BVHTraces"),
+	true,
+	TEXT("Answer editor picking and placement traces from the editor BVH instead of the physics scene."));
+
+AActor* FTruSceneHit::GetActor() const
+{
+	return Component ? Component->GetOwner() : nullptr;
+}
+
+UTruSceneBVH* UTruSceneBVH::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UTruSceneBVH>() : nullptr;
+}
+
+bool UTruSceneBVH::IsEnabled()
+{
+	return CVarTruBVHTraces.GetValueOnGameThread();
+}
+
+void UTruSceneBVH::Register(ATruGameObject* GameObject)
+{
+	UStaticMeshComponent* MeshComponent = GameObject ? GameObject->GetMeshComponent() : nullptr;
+	if (!MeshComponent || !MeshComponent->GetStaticMesh() || GameObjectProxies.Contains(GameObject))
+	{
+		return;
+	}
+
+	const int32 ProxyId = BVH.AddProxy(MeshComponent->GetStaticMesh()->GetBoundingBox(), GameObject->GetMeshTransform());
+	SetProxyOwner(ProxyId, GameObject, MeshComponent);
+	GameObjectProxies.Add(GameObject, ProxyId);
+}
+
+void UTruSceneBVH::Unregister(ATruGameObject* GameObject)
+{
+	int32 ProxyId;
+	if (GameObjectProxies.RemoveAndCopyValue(GameObject, ProxyId))
+	{
+		BVH.RemoveProxy(ProxyId);
+		ProxyOwners[ProxyId] = FProxyOwner();
+	}
+}
+
+void UTruSceneBVH::MarkMoved(ATruGameObject* GameObject)
+{
+	if (const int32* ProxyId = GameObjectProxies.Find(GameObject))
+	{
+		BVH.MoveProxy(*ProxyId, GameObject->GetMeshTransform());
+	}
+}
+
+bool UTruSceneBVH::Raycast(const FVector& Start, const FVector& End, FTruSceneHit& OutHit, TConstArrayView<const AActor*> IgnoredActors)
+{
+	BVH.Refit();
+
+	FTruBVH::FHit Hit;
+	if (!BVH.Raycast(Start, End, Hit, [this, IgnoredActors](int32 ProxyId) { return ShouldIgnore(ProxyId, IgnoredActors); }))
+	{
+		return false;
+	}
+
+	FillHit(Hit, OutHit);
+	return true;
+}
+
+bool UTruSceneBVH::FindNearestSurface(const FVector& Point, double MaxDistance, FTruSceneHit& OutHit, TConstArrayView<const AActor*> IgnoredActors)
+{
+	BVH.Refit();
+
+	FTruBVH::FHit Hit;
+	if (!BVH.FindNearestSurface(Point, MaxDistance, Hit, [this, IgnoredActors](int32 ProxyId) { return ShouldIgnore(ProxyId, IgnoredActors); }))
+	{
+		return false;
+	}
+
+	FillHit(Hit, OutHit);
+	return true;
+}
+
+void UTruSceneBVH::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+	AddLevelGeometry(InWorld);
+}
+
+void UTruSceneBVH::Tick(float DeltaTime)
+{
+	BVH.Refit();
+}
+
+TStatId UTruSceneBVH::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTruSceneBVH, STATGROUP_Tickables);
+}
+
+void UTruSceneBVH::Deinitialize()
+{
+	BVH.Reset();
+	ProxyOwners.Reset();
+	GameObjectProxies.Reset();
+
+	Super::Deinitialize();
+}
+
+void UTruSceneBVH::AddLevelGeometry(UWorld& InWorld)
+{
+	// Only static geometry that a visibility trace would stop on; it never moves, so it is never refit
+	for (TActorIterator<AActor> It(&InWorld); It; ++It)
+	{
+		if (It->IsA<ATruGameObject>())
+		{
+			continue;
+		}
+
+		TInlineComponentArray<UStaticMeshComponent*> MeshComponents(*It);
+		for (UStaticMeshComponent* MeshComponent : MeshComponents)
+		{
+			if (MeshComponent->Mobility != EComponentMobility::Static || !MeshComponent->IsRegistered() || !MeshComponent->GetStaticMesh()
+				|| !MeshComponent->IsQueryCollisionEnabled() || MeshComponent->GetCollisionResponseToChannel(ECC_Visibility) != ECR_Block)
+			{
+				continue;
+			}
+
+			const int32 ProxyId = BVH.AddProxy(MeshComponent->GetStaticMesh()->GetBoundingBox(), MeshComponent->GetComponentTransform());
+			SetProxyOwner(ProxyId, nullptr, MeshComponent);
+		}
+	}
+}
+
+void UTruSceneBVH::SetProxyOwner(int32 ProxyId, ATruGameObject* GameObject, UPrimitiveComponent* Component)
+{
+	if (ProxyId >= ProxyOwners.Num())
+	{
+		ProxyOwners.SetNum(ProxyId + 1);
+	}
+	ProxyOwners[ProxyId] = { GameObject, Component };
+}
+
+bool UTruSceneBVH::ShouldIgnore(int32 ProxyId, TConstArrayView<const AActor*> IgnoredActors) const
+{
+	const FProxyOwner& Owner = ProxyOwners[ProxyId];
+	const UPrimitiveComponent* Component = Owner.Component.Get();
+	const AActor* Actor = Owner.GameObject ? Owner.GameObject : (Component ? Component->GetOwner() : nullptr);
+	return IgnoredActors.Contains(Actor);
+}
+
+void UTruSceneBVH::FillHit(const FTruBVH::FHit& Hit, FTruSceneHit& OutHit) const
+{
+	OutHit.GameObject = ProxyOwners[Hit.ProxyId].GameObject;
+	OutHit.Component = ProxyOwners[Hit.ProxyId].Component.Get();
+	OutHit.Distance = Hit.Distance;
+	OutHit.Location = Hit.Location;
+	OutHit.Normal = Hit.Normal;
+}
@@ -0,0 +1,78 @@
+// TruSceneBVH.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TruBVH.h"
+#include "TruObjectRegistry.h"
+#include "TruSceneBVH.generated.h"
+
+class ATruGameObject;
+class UPrimitiveComponent;
+
+struct FTruSceneHit
+{
+	/** Null when the hit is level geometry rather than a TruGameObject. */
+	ATruGameObject* GameObject = nullptr;
+	/** Set instead of GameObject when the hit is a UTruEntityStore record; promote it to get an object. */
+	FTruObjectId EntityId;
+	/** Set instead of GameObject when the hit is a part of a UTruPrefabLibrary instance; open it to get objects. */
+	int32 PrefabInstance = INDEX_NONE;
+	int32 PrefabPart = INDEX_NONE;
+	UPrimitiveComponent* Component = nullptr;
+	double Distance = 0.0;
+	FVector Location = FVector::ZeroVector;
+	FVector Normal = FVector::ZeroVector;
+
+	AActor* GetActor() const;
+};
+
+/**
+ * Editor-owned BVH over every TruGameObject plus the static level geometry that blocks the visibility channel.
+ *
+ * Answers the editor's picking and placement traces without going through the physics scene. Objects report
+ * their moves as they happen and the tree is refit once per frame (or before a query, whichever comes first).
+ * Level geometry is captured as the local bounding box of each static mesh, which is exact for the box-shaped
+ * floors and walls of the editor maps.
+ */
+UCLASS()
+class TRUWORLD_API UTruSceneBVH : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UTruSceneBVH* Get(const UObject* WorldContextObject);
+	/** tru.BVHTraces; when off, callers fall back to physics traces. */
+	static bool IsEnabled();
+
+	void Register(ATruGameObject* GameObject);
+	void Unregister(ATruGameObject* GameObject);
+	void MarkMoved(ATruGameObject* GameObject);
+
+	bool Raycast(const FVector& Start, const FVector& End, FTruSceneHit& OutHit, TConstArrayView<const AActor*> IgnoredActors = {});
+	bool FindNearestSurface(const FVector& Point, double MaxDistance, FTruSceneHit& OutHit, TConstArrayView<const AActor*> IgnoredActors = {});
+
+	int32 GetNumProxies() const { return BVH.GetNumProxies(); }
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+private:
+	struct FProxyOwner
+	{
+		ATruGameObject* GameObject = nullptr;
+		TWeakObjectPtr<UPrimitiveComponent> Component;
+	};
+
+	void AddLevelGeometry(UWorld& InWorld);
+	void SetProxyOwner(int32 ProxyId, ATruGameObject* GameObject, UPrimitiveComponent* Component);
+	bool ShouldIgnore(int32 ProxyId, TConstArrayView<const AActor*> IgnoredActors) const;
+	void FillHit(const FTruBVH::FHit& Hit, FTruSceneHit& OutHit) const;
+
+	FTruBVH BVH;
+	TArray<FProxyOwner> ProxyOwners;	// Indexed by proxy id
+	TMap<const ATruGameObject*, int32> GameObjectProxies;
+};
@@ -0,0 +1,239 @@
+// TruSpatialHash.cpp
+
+#include "TruSpatialHash.h"
+
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "TruGameObject.h"
+
+static TAutoConsoleVariable<float> CVarTruSnapHashCellSize(
+	TEXT("tru.SnapHashCellSize"),
+	1000.0f,
+	TEXT("Edge length of the spatial hash cells used to find snap candidates, in world units."));
+
+UTruSpatialHash* UTruSpatialHash::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UTruSpatialHash>() : nullptr;
+}
+
+void UTruSpatialHash::Register(ATruGameObject* GameObject)
+{
+	if (!GameObject || ObjectEntries.Contains(GameObject))
+	{
+		return;
+	}
+
+	if (CellSize <= 0.0)
+	{
+		CellSize = FMath::Max(1.0, (double)CVarTruSnapHashCellSize.GetValueOnGameThread());
+	}
+
+	const int32 EntryIndex = FreeEntries.Num() > 0 ? FreeEntries.Pop(EAllowShrinking::No) : Entries.AddDefaulted();
+	Entries[EntryIndex] = FEntry();
+	Entries[EntryIndex].GameObject = GameObject;
+	Entries[EntryIndex].Bounds = GameObject->GetGameObjectBounds();
+	ObjectEntries.Add(GameObject, EntryIndex);
+	Insert(EntryIndex);
+}
+
+void UTruSpatialHash::Unregister(ATruGameObject* GameObject)
+{
+	int32 EntryIndex;
+	if (ObjectEntries.RemoveAndCopyValue(GameObject, EntryIndex))
+	{
+		Remove(EntryIndex);
+		Entries[EntryIndex] = FEntry();
+		FreeEntries.Add(EntryIndex);
+		DirtyObjects.Remove(GameObject);
+	}
+}
+
+void UTruSpatialHash::MarkMoved(ATruGameObject* GameObject)
+{
+	if (ObjectEntries.Contains(GameObject))
+	{
+		DirtyObjects.Add(GameObject);
+	}
+}
+
+void UTruSpatialHash::Flush()
+{
+	const double WantedCellSize = FMath::Max(1.0, (double)CVarTruSnapHashCellSize.GetValueOnGameThread());
+	if (WantedCellSize != CellSize)
+	{
+		CellSize = WantedCellSize;
+		Rebuild();
+		return;
+	}
+
+	for (ATruGameObject* GameObject : DirtyObjects)
+	{
+		const int32 EntryIndex = ObjectEntries[GameObject];
+		FEntry& Entry = Entries[EntryIndex];
+		const FBox Bounds = GameObject->GetGameObjectBounds();
+		Entry.Bounds = Bounds;
+
+		// Small moves usually stay within the same cells; only the stored bounds change then
+		if (!Entry.bLarge && ToCell(Bounds.Min) == Entry.MinCell && ToCell(Bounds.Max) == Entry.MaxCell)
+		{
+			continue;
+		}
+		Remove(EntryIndex);
+		Insert(EntryIndex);
+	}
+	DirtyObjects.Reset();
+}
+
+void UTruSpatialHash::FindInBox(const FBox& Box, TArray<ATruGameObject*>& OutObjects, TArray<FBox>& OutBounds, const TSet<const ATruGameObject*>& Ignored)
+{
+	OutObjects.Reset();
+	OutBounds.Reset();
+	Flush();
+	if (!Box.IsValid)
+	{
+		return;
+	}
+
+	++QueryStamp;
+	auto Visit = [this, &Box, &OutObjects, &OutBounds, &Ignored](int32 EntryIndex)
+	{
+		FEntry& Entry = Entries[EntryIndex];
+		if (Entry.QueryStamp == QueryStamp)
+		{
+			return;
+		}
+		Entry.QueryStamp = QueryStamp;
+		if (Entry.Bounds.Intersect(Box) && !Ignored.Contains(Entry.GameObject))
+		{
+			OutObjects.Add(Entry.GameObject);
+			OutBounds.Add(Entry.Bounds);
+		}
+	};
+
+	const FIntVector MinCell = ToCell(Box.Min);
+	const FIntVector MaxCell = ToCell(Box.Max);
+	const FIntVector Span = MaxCell - MinCell + FIntVector(1);
+
+	// A box larger than the occupied part of the grid is cheaper to answer from the occupied cells
+	if ((int64)Span.X * Span.Y * Span.Z > Cells.Num())
+	{
+		for (const TPair<FIntVector, TArray<int32>>& Cell : Cells)
+		{
+			for (const int32 EntryIndex : Cell.Value)
+			{
+				Visit(EntryIndex);
+			}
+		}
+	}
+	else
+	{
+		for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+			{
+				for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+				{
+					if (const TArray<int32>* Cell = Cells.Find(FIntVector(X, Y, Z)))
+					{
+						for (const int32 EntryIndex : *Cell)
+						{
+							Visit(EntryIndex);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	for (const int32 EntryIndex : LargeEntries)
+	{
+		Visit(EntryIndex);
+	}
+}
+
+FIntVector UTruSpatialHash::ToCell(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt32(Location.X / CellSize),
+		FMath::FloorToInt32(Location.Y / CellSize),
+		FMath::FloorToInt32(Location.Z / CellSize));
+}
+
+void UTruSpatialHash::Insert(int32 EntryIndex)
+{
+	FEntry& Entry = Entries[EntryIndex];
+	Entry.MinCell = ToCell(Entry.Bounds.Min);
+	Entry.MaxCell = ToCell(Entry.Bounds.Max);
+
+	const FIntVector Span = Entry.MaxCell - Entry.MinCell + FIntVector(1);
+	Entry.bLarge = (int64)Span.X * Span.Y * Span.Z > MaxCellsPerObject;
+	if (Entry.bLarge)
+	{
+		LargeEntries.Add(EntryIndex);
+		return;
+	}
+
+	for (int32 X = Entry.MinCell.X; X <= Entry.MaxCell.X; ++X)
+	{
+		for (int32 Y = Entry.MinCell.Y; Y <= Entry.MaxCell.Y; ++Y)
+		{
+			for (int32 Z = Entry.MinCell.Z; Z <= Entry.MaxCell.Z; ++Z)
+			{
+				Cells.FindOrAdd(FIntVector(X, Y, Z)).Add(EntryIndex);
+			}
+		}
+	}
+}
+
+void UTruSpatialHash::Remove(int32 EntryIndex)
+{
+	const FEntry& Entry = Entries[EntryIndex];
+	if (Entry.bLarge)
+	{
+		LargeEntries.RemoveSingleSwap(EntryIndex, EAllowShrinking::No);
+		return;
+	}
+
+	for (int32 X = Entry.MinCell.X; X <= Entry.MaxCell.X; ++X)
+	{
+		for (int32 Y = Entry.MinCell.Y; Y <= Entry.MaxCell.Y; ++Y)
+		{
+			for (int32 Z = Entry.MinCell.Z; Z <= Entry.MaxCell.Z; ++Z)
+			{
+				const FIntVector CellCoord(X, Y, Z);
+				if (TArray<int32>* Cell = Cells.Find(CellCoord))
+				{
+					Cell->RemoveSingleSwap(EntryIndex, EAllowShrinking::No);
+					if (Cell->IsEmpty())
+					{
+						Cells.Remove(CellCoord);
+					}
+				}
+			}
+		}
+	}
+}
+
+void UTruSpatialHash::Rebuild()
+{
+	Cells.Reset();
+	LargeEntries.Reset();
+	for (const TPair<const ATruGameObject*, int32>& Pair : ObjectEntries)
+	{
+		Entries[Pair.Value].Bounds = Pair.Key->GetGameObjectBounds();
+		Insert(Pair.Value);
+	}
+	DirtyObjects.Reset();
+}
+
+void UTruSpatialHash::Deinitialize()
+{
+	Entries.Empty();
+	FreeEntries.Empty();
+	ObjectEntries.Empty();
+	Cells.Empty();
+	LargeEntries.Empty();
+	DirtyObjects.Empty();
+	Super::Deinitialize();
+}
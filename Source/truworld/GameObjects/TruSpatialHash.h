@@ -0,0 +1,69 @@
+// TruSpatialHash.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TruSpatialHash.generated.h"
+
+class ATruGameObject;
+
+/**
+ * Uniform grid of cubic cells over the world bounds of every live TruGameObject, hashed by cell coordinate.
+ *
+ * Built for the small, frequent lookups of editor snapping: a query visits only the cells its box touches, so
+ * its cost depends on the box size and the local density, never on how many objects the scene holds. An object
+ * is filed in every cell it overlaps; objects spanning more than MaxCellsPerObject cells are kept in a short
+ * list that every query scans instead. Moves are picked up the same way as the spatial index, through MarkMoved
+ * and a Flush before the next query.
+ */
+UCLASS()
+class TRUWORLD_API UTruSpatialHash : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static constexpr int32 MaxCellsPerObject = 64;
+
+	static UTruSpatialHash* Get(const UObject* WorldContextObject);
+
+	void Register(ATruGameObject* GameObject);
+	void Unregister(ATruGameObject* GameObject);
+	void MarkMoved(ATruGameObject* GameObject);
+	/** Re-files moved objects, and everything when tru.SnapHashCellSize changed. Every query calls it first. */
+	void Flush();
+
+	/** Objects whose bounds overlap Box, each once, with their bounds. Objects in Ignored are skipped. */
+	void FindInBox(const FBox& Box, TArray<ATruGameObject*>& OutObjects, TArray<FBox>& OutBounds, const TSet<const ATruGameObject*>& Ignored);
+
+	int32 Num() const { return ObjectEntries.Num(); }
+	int32 GetNumCells() const { return Cells.Num(); }
+	double GetCellSize() const { return CellSize; }
+
+	virtual void Deinitialize() override;
+
+private:
+	struct FEntry
+	{
+		ATruGameObject* GameObject = nullptr;
+		FBox Bounds = FBox(ForceInit);
+		FIntVector MinCell = FIntVector::ZeroValue;
+		FIntVector MaxCell = FIntVector::ZeroValue;
+		uint32 QueryStamp = 0;
+		bool bLarge = false;	// In LargeEntries rather than in cells
+	};
+
+	FIntVector ToCell(const FVector& Location) const;
+	void Insert(int32 EntryIndex);
+	void Remove(int32 EntryIndex);
+	void Rebuild();
+
+	double CellSize = 0.0;
+	TArray<FEntry> Entries;
+	TArray<int32> FreeEntries;
+	TMap<const ATruGameObject*, int32> ObjectEntries;
+	TMap<FIntVector, TArray<int32>> Cells;
+	TArray<int32> LargeEntries;
+	TSet<ATruGameObject*> DirtyObjects;
+	uint32 QueryStamp = 0;	// Stops an object that spans several cells being returned more than once
+};
@@ -0,0 +1,247 @@
+// TruSpatialIndex.cpp
+
+#include "TruSpatialIndex.h"
+
+#include "ConvexVolume.h"
+#include "Engine/GameViewportClient.h"
+#include "Engine/LocalPlayer.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Kismet/GameplayStatics.h"
+#include "SceneView.h"
+#include "TruGameObject.h"
+#include "TruGameObjectPool.h"
+
+UTruSpatialIndex* UTruSpatialIndex::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UTruSpatialIndex>() : nullptr;
+}
+
+void UTruSpatialIndex::Register(ATruGameObject* GameObject)
+{
+	if (!GameObject || ObjectElements.Contains(GameObject))
+	{
+		return;
+	}
+
+	const int32 ElementId = Octree.AddElement(GameObject->GetGameObjectBounds());
+	if (ElementId >= ElementObjects.Num())
+	{
+		ElementObjects.SetNumZeroed(ElementId + 1);
+	}
+	ElementObjects[ElementId] = GameObject;
+	ObjectElements.Add(GameObject, ElementId);
+}
+
+void UTruSpatialIndex::Unregister(ATruGameObject* GameObject)
+{
+	int32 ElementId;
+	if (ObjectElements.RemoveAndCopyValue(GameObject, ElementId))
+	{
+		Octree.RemoveElement(ElementId);
+		ElementObjects[ElementId] = nullptr;
+		DirtyObjects.Remove(GameObject);
+	}
+}
+
+void UTruSpatialIndex::MarkMoved(ATruGameObject* GameObject)
+{
+	if (ObjectElements.Contains(GameObject))
+	{
+		DirtyObjects.Add(GameObject);
+	}
+}
+
+void UTruSpatialIndex::Flush()
+{
+	for (ATruGameObject* GameObject : DirtyObjects)
+	{
+		Octree.UpdateElement(ObjectElements[GameObject], GameObject->GetGameObjectBounds());
+	}
+	DirtyObjects.Reset();
+}
+
+void UTruSpatialIndex::FindObjectsInBox(const FBox& Box, TArray<ATruGameObject*>& OutObjects)
+{
+	Flush();
+	Octree.FindInBox(Box, QueryElements);
+	ToObjects(QueryElements, OutObjects);
+}
+
+void UTruSpatialIndex::FindObjectsInSphere(const FVector& Center, float Radius, TArray<ATruGameObject*>& OutObjects)
+{
+	Flush();
+	Octree.FindInSphere(Center, Radius, QueryElements);
+	ToObjects(QueryElements, OutObjects);
+}
+
+void UTruSpatialIndex::FindObjectsInView(const APlayerController* PlayerController, TArray<ATruGameObject*>& OutObjects)
+{
+	OutObjects.Reset();
+
+	ULocalPlayer* LocalPlayer = PlayerController ? PlayerController->GetLocalPlayer() : nullptr;
+	FSceneViewProjectionData ProjectionData;
+	if (!LocalPlayer || !LocalPlayer->ViewportClient || !LocalPlayer->GetProjectionData(LocalPlayer->ViewportClient->Viewport, ProjectionData))
+	{
+		return;
+	}
+
+	FConvexVolume ViewFrustum;
+	GetViewFrustumBounds(ViewFrustum, ProjectionData.ComputeViewProjectionMatrix(), /*bUseNearPlane*/ true);
+	FindObjectsInFrustum(ViewFrustum, OutObjects);
+}
+
+void UTruSpatialIndex::FindObjectsInFrustum(const FConvexVolume& Frustum, TArray<ATruGameObject*>& OutObjects)
+{
+	Flush();
+	Octree.FindInFrustum(Frustum, QueryElements);
+	ToObjects(QueryElements, OutObjects);
+}
+
+void UTruSpatialIndex::FindNearestObjects(const FVector& Point, int32 K, float MaxDistance, TArray<ATruGameObject*>& OutObjects)
+{
+	Flush();
+	Octree.FindNearest(Point, K, MaxDistance > 0.f ? MaxDistance : UE_BIG_NUMBER, QueryElements);
+	ToObjects(QueryElements, OutObjects);
+}
+
+void UTruSpatialIndex::ToObjects(TConstArrayView<int32> ElementIds, TArray<ATruGameObject*>& OutObjects) const
+{
+	OutObjects.Reset(ElementIds.Num());
+	for (const int32 ElementId : ElementIds)
+	{
+		OutObjects.Add(ElementObjects[ElementId]);
+	}
+}
+
+void UTruSpatialIndex::RunBenchmark(int32 NumObjects, int32 NumQueries, FTruSpatialBenchmark& OutResult)
+{
+	UWorld* World = GetWorld();
+	OutResult = FTruSpatialBenchmark();
+	OutResult.NumObjects = NumObjects;
+	OutResult.NumQueries = NumQueries;
+	if (!World || NumObjects <= 0 || NumQueries <= 0)
+	{
+		return;
+	}
+
+	// Same density at every size: about one object per 10 m cube, far below the scene
+	const double RegionHalfSize = 500.0 * FMath::Pow((double)NumObjects, 1.0 / 3.0);
+	const FVector RegionCenter(0.0, 0.0, -1000000.0);
+	const double QueryRadius = 1500.0;
+	const int32 K = 8;
+	FRandomStream Random(NumObjects);
+	auto RandomPoint = [&Random, &RegionCenter, RegionHalfSize]()
+	{
+		return RegionCenter + FVector(Random.FRandRange(-1.0, 1.0), Random.FRandRange(-1.0, 1.0), Random.FRandRange(-1.0, 1.0)) * RegionHalfSize;
+	};
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	TArray<ATruGameObject*> Spawned;
+	Spawned.Reserve(NumObjects);
+	for (int32 Index = 0; Index < NumObjects; ++Index)
+	{
+		Spawned.Add(UTruGameObjectPool::SpawnGameObject(World, ATruGameObject::StaticClass(), FTransform(RandomPoint()), SpawnParams));
+	}
+
+	TArray<FVector> QueryPoints;
+	for (int32 Index = 0; Index < NumQueries; ++Index)
+	{
+		QueryPoints.Add(RandomPoint());
+	}
+
+	TArray<ATruGameObject*> Found;
+	double StartTime = FPlatformTime::Seconds();
+	for (const FVector& Point : QueryPoints)
+	{
+		FindObjectsInBox(FBox::BuildAABB(Point, FVector(QueryRadius)), Found);
+	}
+	OutResult.OctreeBoxMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	StartTime = FPlatformTime::Seconds();
+	for (const FVector& Point : QueryPoints)
+	{
+		FindObjectsInSphere(Point, QueryRadius, Found);
+	}
+	OutResult.OctreeSphereMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	StartTime = FPlatformTime::Seconds();
+	for (const FVector& Point : QueryPoints)
+	{
+		FindNearestObjects(Point, K, 0.f, Found);
+	}
+	OutResult.OctreeNearestMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	// The baseline: every query starts from the full actor list, the way Blueprint code usually does it
+	TArray<AActor*> Actors;
+	auto ScanActors = [&Actors, &Found, World](TFunctionRef<bool(const FBox&)> Filter)
+	{
+		UGameplayStatics::GetAllActorsOfClass(World, ATruGameObject::StaticClass(), Actors);
+		Found.Reset();
+		for (AActor* Actor : Actors)
+		{
+			ATruGameObject* GameObject = CastChecked<ATruGameObject>(Actor);
+			if (!GameObject->IsPooled() && Filter(GameObject->GetGameObjectBounds()))
+			{
+				Found.Add(GameObject);
+			}
+		}
+	};
+
+	StartTime = FPlatformTime::Seconds();
+	for (const FVector& Point : QueryPoints)
+	{
+		const FBox Box = FBox::BuildAABB(Point, FVector(QueryRadius));
+		ScanActors([&Box](const FBox& Bounds) { return Bounds.Intersect(Box); });
+	}
+	OutResult.ActorScanBoxMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	StartTime = FPlatformTime::Seconds();
+	for (const FVector& Point : QueryPoints)
+	{
+		ScanActors([&Point, QueryRadius](const FBox& Bounds) { return Bounds.ComputeSquaredDistanceToPoint(Point) <= FMath::Square(QueryRadius); });
+	}
+	OutResult.ActorScanSphereMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	StartTime = FPlatformTime::Seconds();
+	for (const FVector& Point : QueryPoints)
+	{
+		ScanActors([](const FBox&) { return true; });
+
+		typedef TPair<double, ATruGameObject*> FNearest;
+		auto FurthestFirst = [](const FNearest& A, const FNearest& B) { return A.Key > B.Key; };
+		TArray<FNearest, TInlineAllocator<8>> Nearest;
+		for (ATruGameObject* GameObject : Found)
+		{
+			const double DistanceSquared = GameObject->GetGameObjectBounds().ComputeSquaredDistanceToPoint(Point);
+			if (Nearest.Num() < K)
+			{
+				Nearest.HeapPush(FNearest(DistanceSquared, GameObject), FurthestFirst);
+			}
+			else if (DistanceSquared < Nearest.HeapTop().Key)
+			{
+				FNearest Evicted;
+				Nearest.HeapPop(Evicted, FurthestFirst, EAllowShrinking::No);
+				Nearest.HeapPush(FNearest(DistanceSquared, GameObject), FurthestFirst);
+			}
+		}
+	}
+	OutResult.ActorScanNearestMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	for (ATruGameObject* GameObject : Spawned)
+	{
+		UTruGameObjectPool::DestroyGameObject(GameObject);
+	}
+}
+
+void UTruSpatialIndex::Deinitialize()
+{
+	Octree.Reset();
+	ElementObjects.Empty();
+	ObjectElements.Empty();
+	DirtyObjects.Empty();
+
+	Super::Deinitialize();
+}
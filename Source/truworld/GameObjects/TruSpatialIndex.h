@@ -0,0 +1,81 @@
+// TruSpatialIndex.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TruOctree.h"
+#include "TruSpatialIndex.generated.h"
+
+class APlayerController;
+class ATruGameObject;
+
+/** Timings of one BenchmarkSpatialIndex run, in milliseconds for all queries of a kind together. */
+struct FTruSpatialBenchmark
+{
+	int32 NumObjects = 0;
+	int32 NumQueries = 0;
+	double OctreeBoxMs = 0.0;
+	double OctreeSphereMs = 0.0;
+	double OctreeNearestMs = 0.0;
+	double ActorScanBoxMs = 0.0;
+	double ActorScanSphereMs = 0.0;
+	double ActorScanNearestMs = 0.0;
+};
+
+/**
+ * "What is near here" queries over every live TruGameObject, answered by a loose octree over their world bounds.
+ *
+ * Objects register in BeginPlay and report moves (gizmo drags, placement drags, undo) through their root's
+ * TransformUpdated callback. Moved objects are re-filed once before the next query, and an object that stays
+ * inside its node's loose bounds does not move in the tree at all.
+ */
+UCLASS()
+class TRUWORLD_API UTruSpatialIndex : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UTruSpatialIndex* Get(const UObject* WorldContextObject);
+
+	void Register(ATruGameObject* GameObject);
+	void Unregister(ATruGameObject* GameObject);
+	void MarkMoved(ATruGameObject* GameObject);
+	/** Re-files moved objects. Every query calls it first. */
+	void Flush();
+
+	UFUNCTION(BlueprintCallable, Category = "Spatial Index")
+	void FindObjectsInBox(const FBox& Box, TArray<ATruGameObject*>& OutObjects);
+
+	UFUNCTION(BlueprintCallable, Category = "Spatial Index")
+	void FindObjectsInSphere(const FVector& Center, float Radius, TArray<ATruGameObject*>& OutObjects);
+
+	/** Objects at least partly inside the player's view. */
+	UFUNCTION(BlueprintCallable, Category = "Spatial Index")
+	void FindObjectsInView(const APlayerController* PlayerController, TArray<ATruGameObject*>& OutObjects);
+
+	/** Up to K objects whose bounds are closest to Point, nearest first. Only those within MaxDistance; 0 or less means no limit. */
+	UFUNCTION(BlueprintCallable, Category = "Spatial Index")
+	void FindNearestObjects(const FVector& Point, int32 K, float MaxDistance, TArray<ATruGameObject*>& OutObjects);
+
+	void FindObjectsInFrustum(const FConvexVolume& Frustum, TArray<ATruGameObject*>& OutObjects);
+
+	int32 Num() const { return Octree.GetNumElements(); }
+
+	/**
+	 * Spawns NumObjects objects far below the scene, runs NumQueries box, sphere and nearest queries through the octree
+	 * and through GetAllActorsOfClass plus a bounds filter, and deletes the objects again.
+	 */
+	void RunBenchmark(int32 NumObjects, int32 NumQueries, FTruSpatialBenchmark& OutResult);
+
+	virtual void Deinitialize() override;
+
+private:
+	void ToObjects(TConstArrayView<int32> ElementIds, TArray<ATruGameObject*>& OutObjects) const;
+
+	FTruOctree Octree;
+	TArray<ATruGameObject*> ElementObjects;	// Indexed by octree element id
+	TMap<const ATruGameObject*, int32> ObjectElements;
+	TSet<ATruGameObject*> DirtyObjects;
+	TArray<int32> QueryElements;
+};
@@ -0,0 +1,229 @@
+// TruSpawnQueue.cpp
+
+#include "TruSpawnQueue.h"
+
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "TruGameObject.h"
+#include "TruGameObjectPool.h"
+#include "TruNameRegistry.h"
+
+static TAutoConsoleVariable<float> CVarTruSpawnBudgetMs(
+	TEXT("tru.SpawnBudgetMs"),
+	5.0f,
+	TEXT("Game thread time in milliseconds the spawn queue may use per frame."));
+
+UTruSpawnQueue* UTruSpawnQueue::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UTruSpawnQueue>() : nullptr;
+}
+
+int32 UTruSpawnQueue::EnqueueBatch(TArray<FTruSpawnRequest>&& Requests, AActor* Owner, FOnBatchDone&& OnDone, ESpawnActorCollisionHandlingMethod CollisionHandling)
+{
+	TUniquePtr<FBatch> Batch = MakeUnique<FBatch>();
+	Batch->Id = NextBatchId++;
+	Batch->Requests = MoveTemp(Requests);
+	Batch->Spawned.SetNum(Batch->Requests.Num());
+	Batch->Owner = Owner;
+	Batch->OnDone = MoveTemp(OnDone);
+	Batch->CollisionHandling = CollisionHandling;
+
+	if (UTruNameRegistry* NameRegistry = UTruNameRegistry::Get(this))
+	{
+		for (const FTruSpawnRequest& Request : Batch->Requests)
+		{
+			// A name that is already taken is left to whoever has it; the spawn will get another
+			if (!Request.Name.IsNone() && !NameRegistry->IsNameTaken(Request.Name))
+			{
+				NameRegistry->ReserveSpawnName(Request.Name);
+				Batch->SpawnNames.Add(Request.Name);
+			}
+		}
+	}
+
+	TotalRequested += Batch->Requests.Num();
+
+	const int32 BatchId = Batch->Id;
+	Batches.Add(MoveTemp(Batch));
+	return BatchId;
+}
+
+void UTruSpawnQueue::CancelBatch(int32 BatchId)
+{
+	// Only flagged here; Tick finishes it so a batch is never torn down while it is spawning
+	for (const TUniquePtr<FBatch>& Batch : Batches)
+	{
+		if (Batch->Id == BatchId)
+		{
+			Batch->bCancelled = true;
+			return;
+		}
+	}
+}
+
+void UTruSpawnQueue::CancelAll()
+{
+	for (const TUniquePtr<FBatch>& Batch : Batches)
+	{
+		Batch->bCancelled = true;
+	}
+}
+
+int32 UTruSpawnQueue::GetNumPending() const
+{
+	int32 NumPending = 0;
+	for (const TUniquePtr<FBatch>& Batch : Batches)
+	{
+		NumPending += Batch->Requests.Num() - Batch->NextRequest;
+	}
+	return NumPending;
+}
+
+float UTruSpawnQueue::GetProgress() const
+{
+	return TotalRequested > 0 ? (float)TotalSpawned / TotalRequested : 1.f;
+}
+
+void UTruSpawnQueue::Tick(float DeltaTime)
+{
+	if (Batches.IsEmpty())
+	{
+		return;
+	}
+
+	const double Deadline = FPlatformTime::Seconds() + CVarTruSpawnBudgetMs.GetValueOnGameThread() / 1000.0;
+	while (Batches.Num() > 0)
+	{
+		FBatch& Batch = *Batches[0];
+
+		if (!Batch.bStarted && !Batch.bCancelled)
+		{
+			Batch.bStarted = true;
+			OnBatchStarted.Broadcast(Batch.Id);
+		}
+
+		// At least one object per frame so a tiny budget still makes progress
+		bool bOutOfBudget = false;
+		while (!Batch.bCancelled && Batch.NextRequest < Batch.Requests.Num())
+		{
+			SpawnNext(Batch);
+			if (FPlatformTime::Seconds() >= Deadline)
+			{
+				bOutOfBudget = true;
+				break;
+			}
+		}
+
+		if (!Batch.bCancelled && Batch.NextRequest < Batch.Requests.Num())
+		{
+			break;
+		}
+
+		// Finish callbacks may queue new batches, so take this one out of the array first
+		TUniquePtr<FBatch> Finished = MoveTemp(Batches[0]);
+		Batches.RemoveAt(0);
+		FinishBatch(*Finished, Finished->bCancelled);
+
+		if (bOutOfBudget)
+		{
+			break;
+		}
+	}
+
+	if (Batches.IsEmpty())
+	{
+		TotalRequested = 0;
+		TotalSpawned = 0;
+	}
+}
+
+void UTruSpawnQueue::SpawnNext(FBatch& Batch)
+{
+	const int32 RequestIndex = Batch.NextRequest++;
+	const FTruSpawnRequest& Request = Batch.Requests[RequestIndex];
+	++TotalSpawned;
+
+	UWorld* World = GetWorld();
+	if (!World || !Request.Class)
+	{
+		return;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Owner = Batch.Owner.Get();
+	SpawnParams.SpawnCollisionHandlingOverride = Batch.CollisionHandling;
+	if (!Request.Name.IsNone())
+	{
+		SpawnParams.NameMode = FActorSpawnParameters::ESpawnActorNameMode::Requested;
+		SpawnParams.Name = Request.Name;
+	}
+
+	if (ATruGameObject* GameObject = UTruGameObjectPool::SpawnGameObject(World, Request.Class, Request.Transform, SpawnParams, Request.ObjectId))
+	{
+		Batch.Spawned[RequestIndex].GameObject = GameObject;
+		Batch.Spawned[RequestIndex].PoolGeneration = GameObject->GetPoolGeneration();
+	}
+}
+
+ATruGameObject* UTruSpawnQueue::FSpawned::Get() const
+{
+	ATruGameObject* Live = GameObject.Get();
+	return IsValid(Live) && !Live->IsPooled() && Live->GetPoolGeneration() == PoolGeneration ? Live : nullptr;
+}
+
+void UTruSpawnQueue::FinishBatch(FBatch& Batch, bool bCancelled)
+{
+	TotalRequested -= Batch.Requests.Num() - Batch.NextRequest;
+
+	// Spawned objects already hold theirs as live names; the rest were cancelled or failed
+	if (UTruNameRegistry* NameRegistry = UTruNameRegistry::Get(this))
+	{
+		for (const FName Name : Batch.SpawnNames)
+		{
+			NameRegistry->ReleaseSpawnName(Name);
+		}
+	}
+
+	// Parents may have spawned in a later frame than their children, so the hierarchy is restored at the end
+	TArray<ATruGameObject*> Spawned;
+	Spawned.Reserve(Batch.NextRequest);
+	for (int32 RequestIndex = 0; RequestIndex < Batch.NextRequest; ++RequestIndex)
+	{
+		ATruGameObject* GameObject = Batch.Spawned[RequestIndex].Get();
+		if (!GameObject)
+		{
+			continue;
+		}
+
+		const int32 ParentIndex = Batch.Requests[RequestIndex].ParentIndex;
+		if (ATruGameObject* Parent = Batch.Spawned.IsValidIndex(ParentIndex) ? Batch.Spawned[ParentIndex].Get() : nullptr)
+		{
+			GameObject->SetParentGameObject(Parent);
+		}
+		Spawned.Add(GameObject);
+	}
+
+	if (Batch.bStarted)
+	{
+		OnBatchFinished.Broadcast(Batch.Id, Spawned, bCancelled);
+	}
+	if (Batch.OnDone)
+	{
+		Batch.OnDone(Spawned, bCancelled);
+	}
+}
+
+TStatId UTruSpawnQueue::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTruSpawnQueue, STATGROUP_Tickables);
+}
+
+void UTruSpawnQueue::Deinitialize()
+{
+	Batches.Reset();
+	TotalRequested = 0;
+	TotalSpawned = 0;
+
+	Super::Deinitialize();
+}
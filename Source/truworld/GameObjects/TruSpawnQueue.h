@@ -0,0 +1,94 @@
+// TruSpawnQueue.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TruObjectRegistry.h"
+#include "TruSpawnQueue.generated.h"
+
+class ATruGameObject;
+
+/** One object to spawn. ParentIndex refers to another request of the same batch. */
+struct FTruSpawnRequest
+{
+	TSubclassOf<ATruGameObject> Class;
+	FTransform Transform;
+	FName Name;
+	FTruObjectId ObjectId;	// Kept if no live object has it
+	int32 ParentIndex = INDEX_NONE;
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnTruSpawnBatchStarted, int32 /*BatchId*/);
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FOnTruSpawnBatchFinished, int32 /*BatchId*/, const TArray<ATruGameObject*>& /*Spawned*/, bool /*bCancelled*/);
+
+/**
+ * Spawns batches of TruGameObjects over several frames, never spending more than tru.SpawnBudgetMs per frame.
+ *
+ * Requested names are held in UTruNameRegistry from EnqueueBatch on, so a rename meanwhile cannot take them.
+ *
+ * Batches are processed in order. Listeners get OnBatchStarted before the first object of a batch spawns and
+ * OnBatchFinished once its last object exists (or it was cancelled), which is where per-object editor updates
+ * such as the outliner should be flushed.
+ */
+UCLASS()
+class TRUWORLD_API UTruSpawnQueue : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	typedef TFunction<void(const TArray<ATruGameObject*>& /*Spawned*/, bool /*bCancelled*/)> FOnBatchDone;
+
+	static UTruSpawnQueue* Get(const UObject* WorldContextObject);
+
+	/** Queues a batch and returns its id. OnDone runs after OnBatchFinished for this batch. */
+	int32 EnqueueBatch(TArray<FTruSpawnRequest>&& Requests, AActor* Owner = nullptr, FOnBatchDone&& OnDone = nullptr,
+		ESpawnActorCollisionHandlingMethod CollisionHandling = ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	void CancelBatch(int32 BatchId);
+	void CancelAll();
+
+	bool IsBusy() const { return Batches.Num() > 0; }
+	int32 GetNumPending() const;
+	/** Fraction of all queued objects that have been spawned, 1 when idle. */
+	UFUNCTION(BlueprintCallable, Category = "Spawning") float GetProgress() const;
+
+	FOnTruSpawnBatchStarted OnBatchStarted;
+	FOnTruSpawnBatchFinished OnBatchFinished;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+private:
+	/** Objects can be deleted, pooled and reused while their batch drains, so each is kept as it was when spawned. */
+	struct FSpawned
+	{
+		TWeakObjectPtr<ATruGameObject> GameObject;
+		uint32 PoolGeneration = 0;
+
+		/** Null once the object is gone, pooled or reused by another request. */
+		ATruGameObject* Get() const;
+	};
+
+	struct FBatch
+	{
+		int32 Id = 0;
+		TArray<FTruSpawnRequest> Requests;
+		TArray<FSpawned> Spawned;	// Same indices as Requests, null for failed spawns
+		TArray<FName> SpawnNames;	// Requested names held in the name registry until the batch finishes
+		int32 NextRequest = 0;
+		TWeakObjectPtr<AActor> Owner;
+		FOnBatchDone OnDone;
+		ESpawnActorCollisionHandlingMethod CollisionHandling = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		bool bStarted = false;
+		bool bCancelled = false;
+	};
+
+	void SpawnNext(FBatch& Batch);
+	void FinishBatch(FBatch& Batch, bool bCancelled);
+
+	TArray<TUniquePtr<FBatch>> Batches;
+	int32 NextBatchId = 1;
+	int32 TotalRequested = 0;
+	int32 TotalSpawned = 0;
+};
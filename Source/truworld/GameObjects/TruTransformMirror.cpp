@@ -0,0 +1,281 @@
+// TruTransformMirror.cpp
+
+#include "TruTransformMirror.h"
+
+#include "Async/ParallelFor.h"
+#include "ConvexVolume.h"
+#include "Engine/World.h"
+#include "TruGameObject.h"
+
+UTruTransformMirror* UTruTransformMirror::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UTruTransformMirror>() : nullptr;
+}
+
+void UTruTransformMirror::Register(ATruGameObject* GameObject)
+{
+	if (!GameObject || Rows.Contains(GameObject))
+	{
+		return;
+	}
+
+	const int32 Row = AddRow();
+	Objects[Row] = GameObject;
+	Rows.Add(GameObject, Row);
+	UpdateRow(Row);
+}
+
+void UTruTransformMirror::Unregister(ATruGameObject* GameObject)
+{
+	int32 Row;
+	if (Rows.RemoveAndCopyValue(GameObject, Row))
+	{
+		RemoveRow(Row);
+	}
+}
+
+void UTruTransformMirror::MarkMoved(ATruGameObject* GameObject)
+{
+	const int32* Row = Rows.Find(GameObject);
+	if (Row && !RowDirty[*Row])
+	{
+		RowDirty[*Row] = true;
+		DirtyObjects.Add(GameObject);
+	}
+}
+
+void UTruTransformMirror::Flush()
+{
+	if (DirtyObjects.IsEmpty())
+	{
+		return;
+	}
+
+	FlushRows.Reset();
+	for (const ATruGameObject* GameObject : DirtyObjects)
+	{
+		const int32* Row = Rows.Find(GameObject);
+		if (Row && RowDirty[*Row])
+		{
+			RowDirty[*Row] = false;
+			FlushRows.Add(*Row);
+		}
+	}
+	DirtyObjects.Reset();
+
+	// Actors are only read here on the game thread; the workers just split the copies into the columns
+	const int32 NumFlushed = FlushRows.Num();
+	FlushTransforms.SetNumUninitialized(NumFlushed, EAllowShrinking::No);
+	FlushBounds.SetNumUninitialized(NumFlushed, EAllowShrinking::No);
+	for (int32 Index = 0; Index < NumFlushed; ++Index)
+	{
+		const ATruGameObject* GameObject = Objects[FlushRows[Index]];
+		FlushTransforms[Index] = GameObject->GetActorTransform();
+		FlushBounds[Index] = GameObject->GetGameObjectBounds();
+	}
+
+	const EParallelForFlags Flags = NumFlushed < 1024 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None;
+	ParallelFor(NumFlushed, [this](int32 Index)
+	{
+		WriteRow(FlushRows[Index], FlushTransforms[Index], FlushBounds[Index]);
+	}, Flags);
+}
+
+int32 UTruTransformMirror::FindRow(const ATruGameObject* GameObject) const
+{
+	const int32* Row = Rows.Find(GameObject);
+	return Row ? *Row : INDEX_NONE;
+}
+
+FBox UTruTransformMirror::GetBounds(int32 Row) const
+{
+	const FVector Center(CenterX[Row], CenterY[Row], CenterZ[Row]);
+	const FVector Extent(ExtentX[Row], ExtentY[Row], ExtentZ[Row]);
+	return FBox(Center - Extent, Center + Extent);
+}
+
+void UTruTransformMirror::FindInBox(const FBox& Box, TArray<int32>& OutRows)
+{
+	Flush();
+
+	const FVector BoxCenter = Box.GetCenter();
+	const FVector BoxExtent = Box.GetExtent();
+	const int32 NumRows = Num();
+	QueryMask.SetNumUninitialized(NumRows, EAllowShrinking::No);
+
+	// Branch-free per row so the loop vectorizes
+	for (int32 Row = 0; Row < NumRows; ++Row)
+	{
+		const bool bOverlapX = FMath::Abs(CenterX[Row] - BoxCenter.X) <= ExtentX[Row] + BoxExtent.X;
+		const bool bOverlapY = FMath::Abs(CenterY[Row] - BoxCenter.Y) <= ExtentY[Row] + BoxExtent.Y;
+		const bool bOverlapZ = FMath::Abs(CenterZ[Row] - BoxCenter.Z) <= ExtentZ[Row] + BoxExtent.Z;
+		QueryMask[Row] = (uint8)(bOverlapX & bOverlapY & bOverlapZ);
+	}
+
+	CompactMask(OutRows);
+}
+
+void UTruTransformMirror::FindInFrustum(const FConvexVolume& Frustum, TArray<int32>& OutRows)
+{
+	Flush();
+
+	const int32 NumRows = Num();
+	QueryMask.SetNumUninitialized(NumRows, EAllowShrinking::No);
+	FMemory::Memset(QueryMask.GetData(), 1, NumRows);
+
+	// Same test as FConvexVolume::IntersectBox, one plane at a time over every row
+	for (const FPlane& Plane : Frustum.Planes)
+	{
+		const double AbsX = FMath::Abs(Plane.X);
+		const double AbsY = FMath::Abs(Plane.Y);
+		const double AbsZ = FMath::Abs(Plane.Z);
+		for (int32 Row = 0; Row < NumRows; ++Row)
+		{
+			const double Distance = CenterX[Row] * Plane.X + CenterY[Row] * Plane.Y + CenterZ[Row] * Plane.Z - Plane.W;
+			const double PushOut = ExtentX[Row] * AbsX + ExtentY[Row] * AbsY + ExtentZ[Row] * AbsZ;
+			QueryMask[Row] &= (uint8)(Distance <= PushOut);
+		}
+	}
+
+	CompactMask(OutRows);
+}
+
+void UTruTransformMirror::FindNearest(const FVector& Point, int32 K, TArray<int32>& OutRows, double MaxDistance)
+{
+	Flush();
+
+	OutRows.Reset();
+	const int32 NumRows = Num();
+	if (K <= 0 || NumRows == 0)
+	{
+		return;
+	}
+
+	QueryDistances.SetNumUninitialized(NumRows, EAllowShrinking::No);
+	for (int32 Row = 0; Row < NumRows; ++Row)
+	{
+		const double DX = LocationX[Row] - Point.X;
+		const double DY = LocationY[Row] - Point.Y;
+		const double DZ = LocationZ[Row] - Point.Z;
+		QueryDistances[Row] = DX * DX + DY * DY + DZ * DZ;
+	}
+
+	// Max-heap of the K best so far; its top is the one to evict
+	const double MaxDistanceSquared = FMath::Square(MaxDistance);
+	auto IsCloser = [this](int32 A, int32 B) { return QueryDistances[A] > QueryDistances[B]; };
+	OutRows.Reserve(K);
+	for (int32 Row = 0; Row < NumRows; ++Row)
+	{
+		const double DistanceSquared = QueryDistances[Row];
+		if (DistanceSquared > MaxDistanceSquared)
+		{
+			continue;
+		}
+		if (OutRows.Num() < K)
+		{
+			OutRows.HeapPush(Row, IsCloser);
+		}
+		else if (DistanceSquared < QueryDistances[OutRows.HeapTop()])
+		{
+			int32 Evicted;
+			OutRows.HeapPop(Evicted, IsCloser, EAllowShrinking::No);
+			OutRows.HeapPush(Row, IsCloser);
+		}
+	}
+
+	OutRows.Sort([this](int32 A, int32 B) { return QueryDistances[A] < QueryDistances[B]; });
+}
+
+void UTruTransformMirror::Deinitialize()
+{
+	Objects.Empty();
+	ObjectIds.Empty();
+	Rows.Empty();
+	LocationX.Empty(); LocationY.Empty(); LocationZ.Empty();
+	Rotations.Empty();
+	Scales.Empty();
+	CenterX.Empty(); CenterY.Empty(); CenterZ.Empty();
+	ExtentX.Empty(); ExtentY.Empty(); ExtentZ.Empty();
+	DirtyObjects.Empty();
+	RowDirty.Empty();
+	FlushRows.Empty();
+	FlushTransforms.Empty();
+	FlushBounds.Empty();
+
+	Super::Deinitialize();
+}
+
+int32 UTruTransformMirror::AddRow()
+{
+	Objects.AddUninitialized();
+	ObjectIds.AddDefaulted();
+	LocationX.AddUninitialized(); LocationY.AddUninitialized(); LocationZ.AddUninitialized();
+	Rotations.AddUninitialized();
+	Scales.AddUninitialized();
+	CenterX.AddUninitialized(); CenterY.AddUninitialized(); CenterZ.AddUninitialized();
+	ExtentX.AddUninitialized(); ExtentY.AddUninitialized(); ExtentZ.AddUninitialized();
+	return RowDirty.Add(false);
+}
+
+void UTruTransformMirror::RemoveRow(int32 Row)
+{
+	const int32 LastRow = Objects.Num() - 1;
+	if (Row != LastRow)
+	{
+		Rows[Objects[LastRow]] = Row;
+	}
+
+	Objects.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+	ObjectIds.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+	LocationX.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+	LocationY.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+	LocationZ.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+	Rotations.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+	Scales.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+	CenterX.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+	CenterY.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+	CenterZ.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+	ExtentX.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+	ExtentY.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+	ExtentZ.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+	RowDirty.RemoveAtSwap(Row, 1, EAllowShrinking::No);
+}
+
+void UTruTransformMirror::UpdateRow(int32 Row)
+{
+	const ATruGameObject* GameObject = Objects[Row];
+	ObjectIds[Row] = GameObject->GetObjectId();
+	WriteRow(Row, GameObject->GetActorTransform(), GameObject->GetGameObjectBounds());
+}
+
+void UTruTransformMirror::WriteRow(int32 Row, const FTransform& Transform, const FBox& Bounds)
+{
+	const FVector Location = Transform.GetLocation();
+	const FVector Center = Bounds.GetCenter();
+	const FVector Extent = Bounds.GetExtent();
+
+	LocationX[Row] = Location.X;
+	LocationY[Row] = Location.Y;
+	LocationZ[Row] = Location.Z;
+	Rotations[Row] = FQuat4f(Transform.GetRotation());
+	Scales[Row] = FVector3f(Transform.GetScale3D());
+	CenterX[Row] = Center.X;
+	CenterY[Row] = Center.Y;
+	CenterZ[Row] = Center.Z;
+	ExtentX[Row] = Extent.X;
+	ExtentY[Row] = Extent.Y;
+	ExtentZ[Row] = Extent.Z;
+}
+
+void UTruTransformMirror::CompactMask(TArray<int32>& OutRows) const
+{
+	OutRows.Reset();
+	for (int32 Row = 0; Row < QueryMask.Num(); ++Row)
+	{
+		if (QueryMask[Row])
+		{
+			OutRows.Add(Row);
+		}
+	}
+}
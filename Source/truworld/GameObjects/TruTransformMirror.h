@@ -0,0 +1,98 @@
+// TruTransformMirror.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TruObjectRegistry.h"
+#include "TruTransformMirror.generated.h"
+
+class ATruGameObject;
+struct FConvexVolume;
+
+/**
+ * Structure-of-arrays copy of every live TruGameObject's transform and world bounds.
+ *
+ * Each component sits in its own contiguous array, so bulk queries are straight loops over doubles that the compiler
+ * can vectorize, and tools can read positions or bounds without touching a UObject. Objects report moves through
+ * their root's TransformUpdated callback. Before the next query their transforms and bounds are read on the game
+ * thread and written into the columns in one parallel pass.
+ *
+ * Rows are dense and removal swaps the last row into the gap, so a row index is only valid until the next
+ * Register/Unregister. Queries return row indices; GetGameObject() and GetObjectId() map them back.
+ */
+UCLASS()
+class TRUWORLD_API UTruTransformMirror : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UTruTransformMirror* Get(const UObject* WorldContextObject);
+
+	void Register(ATruGameObject* GameObject);
+	void Unregister(ATruGameObject* GameObject);
+	void MarkMoved(ATruGameObject* GameObject);
+
+	/** Recomputes the rows of moved objects. Queries call it; call it before reading rows or columns directly. */
+	void Flush();
+
+	int32 Num() const { return Objects.Num(); }
+	int32 FindRow(const ATruGameObject* GameObject) const;
+	ATruGameObject* GetGameObject(int32 Row) const { return Objects[Row]; }
+	FTruObjectId GetObjectId(int32 Row) const { return ObjectIds[Row]; }
+
+	FVector GetLocation(int32 Row) const { return FVector(LocationX[Row], LocationY[Row], LocationZ[Row]); }
+	FQuat4f GetRotation(int32 Row) const { return Rotations[Row]; }
+	FVector3f GetScale(int32 Row) const { return Scales[Row]; }
+	FBox GetBounds(int32 Row) const;
+
+	// Raw columns for tools that run their own loops. Call Flush() first.
+	TConstArrayView<double> GetLocationsX() const { return LocationX; }
+	TConstArrayView<double> GetLocationsY() const { return LocationY; }
+	TConstArrayView<double> GetLocationsZ() const { return LocationZ; }
+	TConstArrayView<double> GetBoundsCentersX() const { return CenterX; }
+	TConstArrayView<double> GetBoundsCentersY() const { return CenterY; }
+	TConstArrayView<double> GetBoundsCentersZ() const { return CenterZ; }
+	TConstArrayView<double> GetBoundsExtentsX() const { return ExtentX; }
+	TConstArrayView<double> GetBoundsExtentsY() const { return ExtentY; }
+	TConstArrayView<double> GetBoundsExtentsZ() const { return ExtentZ; }
+
+	/** Rows whose world bounds overlap Box. */
+	void FindInBox(const FBox& Box, TArray<int32>& OutRows);
+	/** Rows whose world bounds are at least partly inside Frustum, e.g. a view frustum from GetViewFrustumBounds. */
+	void FindInFrustum(const FConvexVolume& Frustum, TArray<int32>& OutRows);
+	/** Up to K rows whose locations are closest to Point and within MaxDistance, nearest first. */
+	void FindNearest(const FVector& Point, int32 K, TArray<int32>& OutRows, double MaxDistance = UE_BIG_NUMBER);
+
+	virtual void Deinitialize() override;
+
+private:
+	int32 AddRow();
+	void RemoveRow(int32 Row);
+	/** Reads the object's id, transform and bounds into its row. Game thread only. */
+	void UpdateRow(int32 Row);
+	/** Fills the row's columns from a transform and bounds already read from the actor; safe on any thread. */
+	void WriteRow(int32 Row, const FTransform& Transform, const FBox& Bounds);
+	void CompactMask(TArray<int32>& OutRows) const;
+
+	TArray<ATruGameObject*> Objects;
+	TArray<FTruObjectId> ObjectIds;
+	TMap<const ATruGameObject*, int32> Rows;
+
+	TArray<double> LocationX, LocationY, LocationZ;
+	TArray<FQuat4f> Rotations;
+	TArray<FVector3f> Scales;
+	TArray<double> CenterX, CenterY, CenterZ;
+	TArray<double> ExtentX, ExtentY, ExtentZ;
+
+	/** Moved objects by pointer, so rows can be swapped around before the flush. Unregistered ones are skipped. */
+	TArray<const ATruGameObject*> DirtyObjects;
+	TArray<bool> RowDirty;
+	TArray<int32> FlushRows;
+	TArray<FTransform> FlushTransforms;
+	TArray<FBox> FlushBounds;
+
+	/** Per-row scratch for the filters, kept between queries to avoid reallocating. */
+	TArray<uint8> QueryMask;
+	TArray<double> QueryDistances;
+};
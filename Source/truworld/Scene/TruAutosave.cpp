@@ -0,0 +1,592 @@
+// TruAutosave.cpp
+
+#include "TruAutosave.h"
+
+#include "Async/Async.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "truworld/GameObjects/TruEntityStore.h"
+#include "truworld/GameObjects/TruGameObject.h"
+#include "truworld/GameObjects/TruPrefab.h"
+
+static TAutoConsoleVariable<float> CVarTruAutosaveInterval(
+	TEXT("tru.AutosaveInterval"),
+	60.0f,
+	TEXT("Seconds between incremental autosaves of changed TruGameObjects. 0 turns autosave off."));
+
+static TAutoConsoleVariable<int32> CVarTruAutosaveCompactEvery(
+	TEXT("tru.AutosaveCompactEvery"),
+	20,
+	TEXT("Journal entries after which an autosave writes a full snapshot and starts a new journal."));
+
+namespace
+{
+	void AppendString(TArray<UTF8CHAR>& Strings, const FString& String, FTruSceneStringRef& OutRef)
+	{
+		FTCHARToUTF8 Utf8(*String, String.Len());
+		OutRef.Offset = Strings.Num();
+		OutRef.Length = Utf8.Length();
+		Strings.Append(reinterpret_cast<const UTF8CHAR*>(Utf8.Get()), Utf8.Length());
+	}
+
+	FString ToString(FUtf8StringView View)
+	{
+		return FString(View.Len(), View.GetData());
+	}
+
+	bool WriteSnapshot(const FTruAutosaveState& State, const FString& Filename)
+	{
+		FTruSceneFileWriter Writer;
+		State.WriteTo(Writer);
+
+		// Written next to the old snapshot and moved over it, so a crash meanwhile leaves the old one intact
+		const FString TempFilename = Filename + TEXT(".tmp");
+		return Writer.SaveToFile(TempFilename) && IFileManager::Get().Move(*Filename, *TempFilename, /*bReplace*/ true);
+	}
+}
+
+FTransform FTruJournalRecord::GetTransform() const
+{
+	return FTransform(
+		FQuat(Rotation[0], Rotation[1], Rotation[2], Rotation[3]),
+		FVector(Location[0], Location[1], Location[2]),
+		FVector(Scale[0], Scale[1], Scale[2]));
+}
+
+void FTruJournalRecord::SetTransform(const FTransform& Transform)
+{
+	const FVector T = Transform.GetLocation();
+	const FQuat R = Transform.GetRotation();
+	const FVector S = Transform.GetScale3D();
+
+	Location[0] = T.X; Location[1] = T.Y; Location[2] = T.Z;
+	Rotation[0] = R.X; Rotation[1] = R.Y; Rotation[2] = R.Z; Rotation[3] = R.W;
+	Scale[0] = S.X; Scale[1] = S.Y; Scale[2] = S.Z;
+}
+
+// --- State ---
+
+bool FTruAutosaveState::Load(const FString& SnapshotFilename, const FString& JournalFilename, FString* OutError)
+{
+	Objects.Reset();
+
+	IFileManager& FileManager = IFileManager::Get();
+	if (FileManager.FileExists(*SnapshotFilename))
+	{
+		FTruSceneFileReader Reader;
+		if (!Reader.Open(SnapshotFilename, OutError))
+		{
+			return false;
+		}
+
+		TArray<int32> ReaderClasses;
+		for (int32 ClassIndex = 0; ClassIndex < Reader.GetNumClasses(); ++ClassIndex)
+		{
+			ReaderClasses.Add(FindOrAddClass(ToString(Reader.GetClassPath(ClassIndex))));
+		}
+
+		Objects.Reserve(Reader.GetNumObjects());
+		for (int32 ObjectIndex = 0; ObjectIndex < Reader.GetNumObjects(); ++ObjectIndex)
+		{
+			const FTruSceneObjectRecord& Record = Reader.GetObject(ObjectIndex);
+			if (Record.ObjectId == 0 || (Record.Flags & TruScene::PrefabOverride) != 0)
+			{
+				continue;
+			}
+
+			FObject& Object = Objects.Add(Record.ObjectId);
+			Object.Transform = Record.GetTransform();
+			Object.Name = ToString(Reader.GetObjectName(ObjectIndex));
+			Object.ClassIndex = ReaderClasses[Record.ClassIndex];
+			Object.ParentId = Record.ParentIndex != INDEX_NONE ? Reader.GetObject(Record.ParentIndex).ObjectId : 0;
+			Object.bPrefabInstance = (Record.Flags & TruScene::PrefabInstance) != 0;
+		}
+
+		// Overrides have no id of their own and may come before their instance; the reader has checked their parents
+		for (int32 ObjectIndex = 0; ObjectIndex < Reader.GetNumObjects(); ++ObjectIndex)
+		{
+			const FTruSceneObjectRecord& Record = Reader.GetObject(ObjectIndex);
+			if ((Record.Flags & TruScene::PrefabOverride) == 0)
+			{
+				continue;
+			}
+			if (FObject* Instance = Objects.Find(Reader.GetObject(Record.ParentIndex).ObjectId))
+			{
+				const FUtf8StringView PartName = Reader.GetObjectName(ObjectIndex);
+				FTruPrefabOverride Override;
+				Override.Transform = Record.GetTransform();
+				Override.bRemoved = (Record.Flags & TruScene::PrefabPartRemoved) != 0;
+				Instance->PrefabOverrides.Emplace(FName(PartName.Len(), PartName.GetData()), Override);
+			}
+		}
+	}
+
+	TArray<uint8> Journal;
+	if (FileManager.FileExists(*JournalFilename) && FFileHelper::LoadFileToArray(Journal, *JournalFilename))
+	{
+		const int64 Replayed = ReplayJournal(Journal.GetData(), Journal.Num());
+		if (Replayed < Journal.Num())
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Ignored the last %lld bytes of %s, which do not hold a complete entry"), Journal.Num() - Replayed, *JournalFilename);
+		}
+	}
+	return true;
+}
+
+int64 FTruAutosaveState::ReplayJournal(const uint8* Data, int64 Size)
+{
+	int64 Offset = 0;
+	while (Offset + (int64)sizeof(FTruJournalEntryHeader) <= Size)
+	{
+		const FTruJournalEntryHeader* Header = reinterpret_cast<const FTruJournalEntryHeader*>(Data + Offset);
+		const int64 RecordsOffset = Offset + sizeof(FTruJournalEntryHeader);
+		const int64 StringsOffset = RecordsOffset + (int64)Header->NumRecords * sizeof(FTruJournalRecord);
+		const int64 EntryEnd = StringsOffset + Align((int64)Header->StringTableSize, 8);
+		// Later versions only added record flags, so older entries replay as they are
+		if (Header->Magic != TruJournal::Magic || Header->Version == 0 || Header->Version > TruJournal::Version || EntryEnd > Size)
+		{
+			break;
+		}
+
+		const FTruJournalRecord* Records = reinterpret_cast<const FTruJournalRecord*>(Data + RecordsOffset);
+		const UTF8CHAR* Strings = reinterpret_cast<const UTF8CHAR*>(Data + StringsOffset);
+		auto IsValidString = [Header](const FTruSceneStringRef& Ref)
+		{
+			return (uint64)Ref.Offset + Ref.Length <= Header->StringTableSize;
+		};
+
+		for (uint32 RecordIndex = 0; RecordIndex < Header->NumRecords; ++RecordIndex)
+		{
+			const FTruJournalRecord& Record = Records[RecordIndex];
+			if (Record.Flags & FTruJournalRecord::Removed)
+			{
+				Objects.Remove(Record.ObjectId);
+				continue;
+			}
+			if (!IsValidString(Record.Name) || !IsValidString(Record.ClassPath))
+			{
+				return Offset;
+			}
+
+			// Overrides follow their instance's record in the same entry
+			if (Record.Flags & FTruJournalRecord::PrefabOverride)
+			{
+				if (FObject* Instance = Objects.Find(Record.ObjectId))
+				{
+					FTruPrefabOverride Override;
+					Override.Transform = Record.GetTransform();
+					Override.bRemoved = (Record.Flags & FTruJournalRecord::PrefabPartRemoved) != 0;
+					Instance->PrefabOverrides.Emplace(FName(Record.Name.Length, Strings + Record.Name.Offset), Override);
+				}
+				continue;
+			}
+
+			FObject& Object = Objects.FindOrAdd(Record.ObjectId);
+			Object.Transform = Record.GetTransform();
+			Object.Name = ToString(FUtf8StringView(Strings + Record.Name.Offset, Record.Name.Length));
+			Object.ClassIndex = FindOrAddClass(ToString(FUtf8StringView(Strings + Record.ClassPath.Offset, Record.ClassPath.Length)));
+			Object.ParentId = Record.ParentId;
+			Object.bPrefabInstance = (Record.Flags & FTruJournalRecord::PrefabInstance) != 0;
+			Object.PrefabOverrides.Reset();
+		}
+		Offset = EntryEnd;
+	}
+	return Offset;
+}
+
+void FTruAutosaveState::ApplyBatch(const FTruAutosaveBatch& Batch, TArray<uint8>* OutJournalEntry)
+{
+	for (const FString& ClassPath : Batch.NewClassPaths)
+	{
+		BatchClasses.Add(FindOrAddClass(ClassPath));
+	}
+
+	TArray<FTruJournalRecord> Records;
+	TArray<UTF8CHAR> Strings;
+	TMap<int32, FTruSceneStringRef> ClassStrings;
+	if (OutJournalEntry)
+	{
+		Records.Reserve(Batch.Objects.Num());
+	}
+
+	for (const FTruAutosaveObject& BatchObject : Batch.Objects)
+	{
+		FTruJournalRecord* Record = OutJournalEntry ? &Records.AddZeroed_GetRef() : nullptr;
+		if (Record)
+		{
+			Record->ObjectId = BatchObject.Id.Value;
+		}
+
+		if (BatchObject.ClassIndex == INDEX_NONE)
+		{
+			Objects.Remove(BatchObject.Id.Value);
+			if (Record)
+			{
+				Record->Flags = FTruJournalRecord::Removed;
+			}
+			continue;
+		}
+
+		FObject& Object = Objects.FindOrAdd(BatchObject.Id.Value);
+		Object.Transform = BatchObject.Transform;
+		Object.Name = BatchObject.Name.ToString();
+		Object.ClassIndex = BatchClasses[BatchObject.ClassIndex];
+		Object.ParentId = BatchObject.ParentId.Value;
+		Object.bPrefabInstance = BatchObject.bPrefabInstance;
+		Object.PrefabOverrides = BatchObject.PrefabOverrides;
+
+		if (Record)
+		{
+			Record->SetTransform(Object.Transform);
+			Record->ParentId = Object.ParentId;
+			AppendString(Strings, Object.Name, Record->Name);
+			if (const FTruSceneStringRef* ClassString = ClassStrings.Find(Object.ClassIndex))
+			{
+				Record->ClassPath = *ClassString;
+			}
+			else
+			{
+				AppendString(Strings, ClassPaths[Object.ClassIndex], Record->ClassPath);
+				ClassStrings.Add(Object.ClassIndex, Record->ClassPath);
+			}
+		}
+
+		if (Record && Object.bPrefabInstance)
+		{
+			Record->Flags = FTruJournalRecord::PrefabInstance;
+			// Adding records may move Record
+			const FTruSceneStringRef PrefabName = Record->ClassPath;
+			for (const TPair<FName, FTruPrefabOverride>& Override : Object.PrefabOverrides)
+			{
+				FTruJournalRecord& OverrideRecord = Records.AddZeroed_GetRef();
+				OverrideRecord.SetTransform(Override.Value.Transform);
+				AppendString(Strings, Override.Key.ToString(), OverrideRecord.Name);
+				OverrideRecord.ClassPath = PrefabName;
+				OverrideRecord.Flags = FTruJournalRecord::PrefabOverride | (Override.Value.bRemoved ? FTruJournalRecord::PrefabPartRemoved : 0);
+				OverrideRecord.ObjectId = BatchObject.Id.Value;
+			}
+		}
+	}
+
+	if (OutJournalEntry)
+	{
+		FTruJournalEntryHeader Header;
+		Header.NumRecords = Records.Num();
+		Header.StringTableSize = Strings.Num();
+
+		const int64 RecordsSize = Records.Num() * sizeof(FTruJournalRecord);
+		OutJournalEntry->Reset();
+		OutJournalEntry->AddZeroed(sizeof(Header) + RecordsSize + Align(Strings.Num(), 8));
+		FMemory::Memcpy(OutJournalEntry->GetData(), &Header, sizeof(Header));
+		FMemory::Memcpy(OutJournalEntry->GetData() + sizeof(Header), Records.GetData(), RecordsSize);
+		FMemory::Memcpy(OutJournalEntry->GetData() + sizeof(Header) + RecordsSize, Strings.GetData(), Strings.Num());
+	}
+}
+
+void FTruAutosaveState::WriteTo(FTruSceneFileWriter& Writer) const
+{
+	// Parents may come after their children in the table; the loader restores the hierarchy once everything exists.
+	// Prefab instances, each followed by its overrides, go after all objects so their indices are known up front.
+	TMap<uint64, int32> ObjectIndices;
+	ObjectIndices.Reserve(Objects.Num());
+	for (const TPair<uint64, FObject>& Pair : Objects)
+	{
+		if (!Pair.Value.bPrefabInstance)
+		{
+			ObjectIndices.Add(Pair.Key, ObjectIndices.Num());
+		}
+	}
+
+	TArray<int32> WriterClasses;
+	WriterClasses.Init(INDEX_NONE, ClassPaths.Num());
+	auto GetWriterClass = [this, &Writer, &WriterClasses](int32 ClassIndex)
+	{
+		int32& WriterClass = WriterClasses[ClassIndex];
+		if (WriterClass == INDEX_NONE)
+		{
+			WriterClass = Writer.AddClass(ClassPaths[ClassIndex]);
+		}
+		return WriterClass;
+	};
+
+	for (const TPair<uint64, FObject>& Pair : Objects)
+	{
+		const FObject& Object = Pair.Value;
+		if (!Object.bPrefabInstance)
+		{
+			const int32* ParentIndex = Object.ParentId ? ObjectIndices.Find(Object.ParentId) : nullptr;
+			Writer.AddObject(Object.Name, GetWriterClass(Object.ClassIndex), Object.Transform, ParentIndex ? *ParentIndex : INDEX_NONE, Pair.Key);
+		}
+	}
+
+	for (const TPair<uint64, FObject>& Pair : Objects)
+	{
+		const FObject& Object = Pair.Value;
+		if (!Object.bPrefabInstance)
+		{
+			continue;
+		}
+
+		const int32 ClassIndex = GetWriterClass(Object.ClassIndex);
+		const int32 InstanceIndex = Writer.AddObject(Object.Name, ClassIndex, Object.Transform, INDEX_NONE, Pair.Key, TruScene::PrefabInstance);
+		for (const TPair<FName, FTruPrefabOverride>& Override : Object.PrefabOverrides)
+		{
+			Writer.AddObject(Override.Key.ToString(), ClassIndex, Override.Value.Transform, InstanceIndex, 0,
+				TruScene::PrefabOverride | (Override.Value.bRemoved ? TruScene::PrefabPartRemoved : 0));
+		}
+	}
+}
+
+int32 FTruAutosaveState::FindOrAddClass(const FString& ClassPath)
+{
+	if (const int32* Existing = ClassIndices.Find(ClassPath))
+	{
+		return *Existing;
+	}
+
+	const int32 ClassIndex = ClassPaths.Add(ClassPath);
+	ClassIndices.Add(ClassPath, ClassIndex);
+	return ClassIndex;
+}
+
+// --- Subsystem ---
+
+UTruAutosave* UTruAutosave::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UTruAutosave>() : nullptr;
+}
+
+FString UTruAutosave::GetSnapshotPath()
+{
+	return FTruSceneFile::ResolveScenePath(TEXT("Autosave"));
+}
+
+FString UTruAutosave::GetJournalPath()
+{
+	return FPaths::Combine(FTruSceneFile::GetSceneDirectory(), FString(TEXT("Autosave")) + TruJournal::Extension);
+}
+
+FString UTruAutosave::GetBackupPath()
+{
+	return FTruSceneFile::ResolveScenePath(TEXT("AutosaveBackup"));
+}
+
+bool UTruAutosave::AutosaveNow()
+{
+	WaitForPending();
+	if (DirtyIds.Num() == 0)
+	{
+		return false;
+	}
+
+	StartAutosave();
+	return true;
+}
+
+void UTruAutosave::StartAutosave()
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	UTruObjectRegistry* ObjectRegistry = UTruObjectRegistry::Get(this);
+	const UTruEntityStore* EntityStore = UTruEntityStore::Get(this);
+	const UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(this);
+
+	FTruAutosaveBatch Batch;
+	auto GetClassIndex = [this, &Batch](const UClass* Class)
+	{
+		if (const int32* Existing = ClassIndices.Find(Class))
+		{
+			return *Existing;
+		}
+		Batch.NewClassPaths.Add(Class->GetPathName());
+		return ClassIndices.Add(Class, ClassIndices.Num() + PrefabIndices.Num());
+	};
+	auto GetPrefabIndex = [this, &Batch](FName Prefab)
+	{
+		if (const int32* Existing = PrefabIndices.Find(Prefab))
+		{
+			return *Existing;
+		}
+		Batch.NewClassPaths.Add(Prefab.ToString());
+		return PrefabIndices.Add(Prefab, ClassIndices.Num() + PrefabIndices.Num());
+	};
+
+	// Edits to an open instance's parts, removing them included, are only saved through the instance
+	if (PrefabLibrary)
+	{
+		TArray<int32> OpenInstances;
+		PrefabLibrary->GetOpenInstances(OpenInstances);
+		for (const int32 Instance : OpenInstances)
+		{
+			MarkDirty(PrefabLibrary->GetInstanceId(Instance));
+		}
+	}
+
+	Batch.Objects.Reserve(DirtyIds.Num());
+	FTruPrefabInstanceState PrefabState;
+	for (const FTruObjectId Id : DirtyIds)
+	{
+		FTruAutosaveObject& Object = Batch.Objects.AddDefaulted_GetRef();
+		Object.Id = Id;
+
+		const FTruEntityBatch* EntityBatch = nullptr;
+		int32 PrefabInstance = INDEX_NONE;
+		FTruObjectId OpenInstanceId;
+		FName OpenPartName;
+		if (ATruGameObject* GameObject = ObjectRegistry ? ObjectRegistry->Find(Id) : nullptr)
+		{
+			// An open part is left out, as if it were gone
+			if (PrefabLibrary && PrefabLibrary->FindOpenPart(GameObject, OpenInstanceId, OpenPartName))
+			{
+				continue;
+			}
+
+			Object.Transform = GameObject->GetActorTransform();
+			Object.Name = GameObject->GetFName();
+			Object.ClassIndex = GetClassIndex(GameObject->GetClass());
+			if (const ATruGameObject* Parent = GameObject->GetParentGameObject())
+			{
+				Object.ParentId = Parent->GetObjectId();
+			}
+		}
+		// Demoted objects have no actor but are still part of the scene
+		else if (const FTruEntity* Entity = EntityStore ? EntityStore->FindEntity(Id, &EntityBatch) : nullptr; Entity && EntityBatch->Class)
+		{
+			Object.Transform = Entity->GetTransform();
+			Object.Name = Entity->Name;
+			Object.ClassIndex = GetClassIndex(EntityBatch->Class);
+		}
+		else if (PrefabLibrary && (PrefabInstance = PrefabLibrary->FindInstanceById(Id)) != INDEX_NONE && PrefabLibrary->GetInstanceState(PrefabInstance, PrefabState))
+		{
+			Object.Transform = PrefabState.Transform;
+			Object.Name = PrefabState.Prefab;
+			Object.ClassIndex = GetPrefabIndex(PrefabState.Prefab);
+			Object.bPrefabInstance = true;
+			Object.PrefabOverrides = MoveTemp(PrefabState.Overrides);
+		}
+	}
+	DirtyIds.Reset();
+
+	Batch.bBackupPrevious = !bHasSnapshot;
+	Batch.bCompact = !bHasSnapshot || NumJournalEntries >= CVarTruAutosaveCompactEvery.GetValueOnGameThread();
+	NumJournalEntries = Batch.bCompact ? 0 : NumJournalEntries + 1;
+	bHasSnapshot = true;
+
+	LastNumObjects = Batch.Objects.Num();
+	Pending = Async(EAsyncExecution::ThreadPool, [SharedState = State, Batch = MoveTemp(Batch), SnapshotPath = GetSnapshotPath(), JournalPath = GetJournalPath(), BackupPath = GetBackupPath()]()
+	{
+		const double WorkerStartTime = FPlatformTime::Seconds();
+
+		FTruAutosaveResult Result;
+		Result.NumObjects = Batch.Objects.Num();
+		Result.bCompacted = Batch.bCompact;
+
+		if (Batch.bBackupPrevious)
+		{
+			FTruAutosaveState Previous;
+			if (Previous.Load(SnapshotPath, JournalPath) && Previous.Num() > 0)
+			{
+				WriteSnapshot(Previous, BackupPath);
+			}
+		}
+
+		if (Batch.bCompact)
+		{
+			SharedState->ApplyBatch(Batch);
+			Result.bSucceeded = WriteSnapshot(*SharedState, SnapshotPath);
+			// The snapshot already holds everything the journal did
+			IFileManager::Get().Delete(*JournalPath, /*bRequireExists*/ false, /*bEvenReadOnly*/ true);
+		}
+		else
+		{
+			TArray<uint8> Entry;
+			SharedState->ApplyBatch(Batch, &Entry);
+			Result.bSucceeded = FFileHelper::SaveArrayToFile(Entry, *JournalPath, &IFileManager::Get(), FILEWRITE_Append);
+		}
+
+		Result.NumSavedObjects = SharedState->Num();
+		Result.WorkerMs = (FPlatformTime::Seconds() - WorkerStartTime) * 1000.0;
+		return Result;
+	});
+
+	TimeSinceAutosave = 0.0f;
+	LastSnapshotMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+}
+
+void UTruAutosave::WaitForPending()
+{
+	if (Pending.IsValid())
+	{
+		ReportResult(Pending.Get());
+		Pending.Reset();
+	}
+}
+
+void UTruAutosave::ReportResult(const FTruAutosaveResult& Result) const
+{
+	if (!Result.bSucceeded)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Autosave of %d objects could not be written to %s"), Result.NumObjects, *FTruSceneFile::GetSceneDirectory());
+		return;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Autosaved %d changed objects (%s, %d in total): %.3f ms on the game thread, %.2f ms on the worker"),
+		Result.NumObjects, Result.bCompacted ? TEXT("snapshot") : TEXT("journal"), Result.NumSavedObjects, LastSnapshotMs, Result.WorkerMs);
+}
+
+bool UTruAutosave::LoadAutosave(FTruSceneFileReader& OutReader, FString* OutError)
+{
+	WaitForPending();
+
+	FTruAutosaveState Saved;
+	if (!Saved.Load(GetSnapshotPath(), GetJournalPath(), OutError))
+	{
+		return false;
+	}
+
+	FTruSceneFileWriter Writer;
+	Saved.WriteTo(Writer);
+	TArray<uint8> Bytes;
+	Writer.WriteTo(Bytes);
+	return OutReader.OpenFromMemory(MoveTemp(Bytes), OutError);
+}
+
+void UTruAutosave::Tick(float DeltaTime)
+{
+	if (Pending.IsValid() && Pending.IsReady())
+	{
+		WaitForPending();
+	}
+
+	const float Interval = CVarTruAutosaveInterval.GetValueOnGameThread();
+	if (Interval <= 0.0f)
+	{
+		return;
+	}
+
+	TimeSinceAutosave += DeltaTime;
+	if (TimeSinceAutosave >= Interval && !Pending.IsValid() && DirtyIds.Num() > 0)
+	{
+		StartAutosave();
+	}
+}
+
+TStatId UTruAutosave::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTruAutosave, STATGROUP_Tickables);
+}
+
+void UTruAutosave::Deinitialize()
+{
+	// The worker holds its own reference to the state, but the files must be complete before anyone reads them
+	WaitForPending();
+	DirtyIds.Reset();
+	ClassIndices.Reset();
+	PrefabIndices.Reset();
+
+	Super::Deinitialize();
+}
@@ -0,0 +1,205 @@
+// TruAutosave.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TruSceneFile.h"
+#include "truworld/GameObjects/TruObjectRegistry.h"
+#include "truworld/GameObjects/TruPrefab.h"
+#include "TruAutosave.generated.h"
+
+class ATruGameObject;
+
+/**
+ * On-disk layout of the autosave journal (.trujournal, little endian), a sequence of entries:
+ *
+ *   FTruJournalEntryHeader
+ *   FTruJournalRecord[NumRecords]
+ *   UTF-8 string table, padded to 8 bytes      object names and class paths
+ *
+ * A record holds an object's complete saved state, so replaying an entry twice changes nothing. An entry cut short
+ * by a crash is ignored along with anything after it.
+ *
+ * A prefab instance is saved by reference, as in scene files: a PrefabInstance record whose class path is the prefab
+ * name, followed by a PrefabOverride record, carrying the instance's id, for each part it overrides. Version 1
+ * journals have no prefab records and are still read.
+ */
+namespace TruJournal
+{
+	static constexpr uint32 Magic = 0x4A555254; // "TRUJ"
+	static constexpr uint32 Version = 2;
+	static constexpr TCHAR Extension[] = TEXT(".trujournal");
+}
+
+struct FTruJournalEntryHeader
+{
+	uint32 Magic = TruJournal::Magic;
+	uint32 Version = TruJournal::Version;
+	uint32 NumRecords = 0;
+	uint32 StringTableSize = 0;
+};
+static_assert(sizeof(FTruJournalEntryHeader) == 16, "FTruJournalEntryHeader is part of the file format");
+
+struct FTruJournalRecord
+{
+	static constexpr uint32 Removed = 1 << 0;
+	static constexpr uint32 PrefabInstance = 1 << 1;
+	static constexpr uint32 PrefabOverride = 1 << 2;	// Name is the part; ObjectId is the instance
+	static constexpr uint32 PrefabPartRemoved = 1 << 3;
+
+	double Location[3];
+	float Rotation[4];	// Quaternion X, Y, Z, W
+	float Scale[3];
+	FTruSceneStringRef Name;
+	FTruSceneStringRef ClassPath;
+	uint32 Flags;		// Removed: the object is gone and the other fields are unused
+	uint64 ObjectId;	// FTruObjectId::Value
+	uint64 ParentId;	// 0 for roots
+
+	FTransform GetTransform() const;
+	void SetTransform(const FTransform& Transform);
+};
+static_assert(sizeof(FTruJournalRecord) == 88, "FTruJournalRecord is part of the file format");
+
+/** One dirty object as the game thread saw it at the autosave. */
+struct FTruAutosaveObject
+{
+	FTruObjectId Id;
+	FTruObjectId ParentId;
+	FTransform Transform;
+	FName Name;
+	int32 ClassIndex = INDEX_NONE;	// Into the classes of all batches so far; INDEX_NONE when the object is gone
+	/** The object is a prefab instance: ClassIndex names its prefab instead of a class. */
+	bool bPrefabInstance = false;
+	TArray<TPair<FName, FTruPrefabOverride>> PrefabOverrides;
+};
+
+/** Everything one autosave hands to the worker. Built on the game thread and never changed afterwards. */
+struct FTruAutosaveBatch
+{
+	TArray<FTruAutosaveObject> Objects;
+	/** Class paths and prefab names first used by this batch. Their indices follow on from those of earlier batches. */
+	TArray<FString> NewClassPaths;
+	/** Write a full snapshot and start a new journal instead of appending to it. */
+	bool bCompact = false;
+	/** Keep whatever the previous session autosaved as a plain scene before overwriting it. */
+	bool bBackupPrevious = false;
+};
+
+/** What the worker did with a batch, reported back on the game thread. */
+struct FTruAutosaveResult
+{
+	bool bSucceeded = false;
+	bool bCompacted = false;
+	int32 NumObjects = 0;		// Objects in the batch
+	int32 NumSavedObjects = 0;	// Objects in the autosave as a whole
+	double WorkerMs = 0.0;
+};
+
+/**
+ * The autosaved scene as seen by the worker: the last snapshot with every journal entry since applied to it.
+ * Only the autosave task in flight (there is never more than one) or a recovery touches it.
+ */
+class TRUWORLD_API FTruAutosaveState
+{
+public:
+	/** Reads SnapshotFilename, if it exists, and replays JournalFilename onto it. */
+	bool Load(const FString& SnapshotFilename, const FString& JournalFilename, FString* OutError = nullptr);
+
+	/** Applies Batch and, when OutJournalEntry is given, serializes it as a journal entry. */
+	void ApplyBatch(const FTruAutosaveBatch& Batch, TArray<uint8>* OutJournalEntry = nullptr);
+
+	void WriteTo(FTruSceneFileWriter& Writer) const;
+	int32 Num() const { return Objects.Num(); }
+
+private:
+	struct FObject
+	{
+		FTransform Transform;
+		FString Name;
+		int32 ClassIndex = INDEX_NONE;
+		uint64 ParentId = 0;
+		bool bPrefabInstance = false;
+		TArray<TPair<FName, FTruPrefabOverride>> PrefabOverrides;
+	};
+
+	int32 FindOrAddClass(const FString& ClassPath);
+	/** Returns the number of bytes of Data that held complete entries. */
+	int64 ReplayJournal(const uint8* Data, int64 Size);
+
+	TMap<uint64, FObject> Objects;
+	TArray<FString> ClassPaths;
+	TMap<FString, int32> ClassIndices;
+	/** Batch class index to index into ClassPaths. */
+	TArray<int32> BatchClasses;
+};
+
+/**
+ * Incremental background autosave, every tru.AutosaveInterval seconds.
+ *
+ * Objects report changes to their transform, name and hierarchy, and their registration, as dirty ids; so does the
+ * prefab library for its instances, which are saved by reference. Open prefab instances are saved as they are being
+ * edited, and their parts only as part of them. An autosave copies just the dirty objects into an FTruAutosaveBatch
+ * on the game thread and hands it to a worker. The worker applies it to its FTruAutosaveState and appends it to
+ * Autosave.trujournal. Every tru.AutosaveCompactEvery autosaves, and on the first one of a session, it writes the
+ * whole state to Autosave.truscene and starts a new journal. The first autosave also keeps the previous session's
+ * autosave as AutosaveBackup.truscene.
+ *
+ * One write is in flight at a time. Changes made meanwhile stay dirty until the next autosave.
+ */
+UCLASS()
+class TRUWORLD_API UTruAutosave : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UTruAutosave* Get(const UObject* WorldContextObject);
+
+	static FString GetSnapshotPath();
+	static FString GetJournalPath();
+	static FString GetBackupPath();
+
+	void MarkDirty(FTruObjectId Id)
+	{
+		if (Id.IsValid())
+		{
+			DirtyIds.Add(Id);
+		}
+	}
+	int32 NumDirty() const { return DirtyIds.Num(); }
+
+	/** Starts an autosave now, first waiting for the one in flight. Returns false when nothing is dirty. */
+	bool AutosaveNow();
+	/** Game thread time the last autosave took to snapshot the dirty objects and hand them off. */
+	double GetLastSnapshotMs() const { return LastSnapshotMs; }
+	int32 GetLastNumObjects() const { return LastNumObjects; }
+
+	/** Waits for the write in flight, then reads the snapshot and journal back into a scene. */
+	bool LoadAutosave(FTruSceneFileReader& OutReader, FString* OutError = nullptr);
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+private:
+	void StartAutosave();
+	void WaitForPending();
+	void ReportResult(const FTruAutosaveResult& Result) const;
+
+	TSet<FTruObjectId> DirtyIds;
+
+	// Class paths and prefab names already handed to the worker, by the index the batches refer to them with
+	TMap<const UClass*, int32> ClassIndices;
+	TMap<FName, int32> PrefabIndices;
+
+	TSharedRef<FTruAutosaveState, ESPMode::ThreadSafe> State = MakeShared<FTruAutosaveState, ESPMode::ThreadSafe>();
+	TFuture<FTruAutosaveResult> Pending;
+	int32 NumJournalEntries = 0;
+	bool bHasSnapshot = false;
+
+	float TimeSinceAutosave = 0.0f;
+	double LastSnapshotMs = 0.0;
+	int32 LastNumObjects = 0;
+};
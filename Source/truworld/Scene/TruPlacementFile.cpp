@@ -0,0 +1,1232 @@
+// TruPlacementFile.cpp
+
+#include "TruPlacementFile.h"
+
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+#include "truworld/GameObjects/TruEntityStore.h"
+#include "truworld/GameObjects/TruGameObject.h"
+#include "truworld/GameObjects/TruNameRegistry.h"
+#include "truworld/GameObjects/TruPrefab.h"
+#include "truworld/GameObjects/TruSpawnQueue.h"
+
+static TAutoConsoleVariable<int32> CVarTruPlacementImportBatchSize(
+	TEXT("tru.PlacementImportBatchSize"),
+	4096,
+	TEXT("Rows of a placement file read and handed to the spawn queue at a time."));
+
+namespace
+{
+	// Errors beyond this many are only counted
+	static constexpr int32 MaxListedErrors = 10;
+
+	FUtf8StringView MakeView(const ANSICHAR* Start, const ANSICHAR* Stop)
+	{
+		return FUtf8StringView(reinterpret_cast<const UTF8CHAR*>(Start), UE_PTRDIFF_TO_INT32(Stop - Start));
+	}
+
+	bool IsKey(FUtf8StringView Key, FAnsiStringView Literal)
+	{
+		return Key.Len() == Literal.Len() && FMemory::Memcmp(Key.GetData(), Literal.GetData(), Key.Len()) == 0;
+	}
+
+	void SkipSpace(const ANSICHAR*& P, const ANSICHAR* E)
+	{
+		while (P < E && (*P == ' ' || *P == '\t'))
+		{
+			++P;
+		}
+	}
+
+	bool IsDigit(ANSICHAR Char)
+	{
+		return Char >= '0' && Char <= '9';
+	}
+
+	/**
+	 * Parses a decimal number that has to end before E: a sign, digits with an optional fraction and an optional
+	 * exponent. Not left to strtod, which also takes nan, inf and hex and reads the decimal point from the locale.
+	 * A mantissa a double holds exactly with a small exponent comes out correctly rounded, anything else to within a
+	 * few ulps, which is far below what a placement can tell apart.
+	 */
+	bool ParseNumber(const ANSICHAR*& P, const ANSICHAR* E, double& OutValue)
+	{
+		static constexpr double PowersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+		static constexpr int32 MaxMantissaDigits = 19;
+		static constexpr int32 MaxExponent = 100000;
+		static constexpr uint64 MaxExactMantissa = 1ull << 53;
+
+		const ANSICHAR* Q = P;
+		const bool bNegative = Q < E && *Q == '-';
+		if (Q < E && (*Q == '-' || *Q == '+'))
+		{
+			++Q;
+		}
+
+		// Digits past what the mantissa holds only shift the exponent
+		uint64 Mantissa = 0;
+		int32 NumSignificant = 0;
+		int32 Exponent = 0;
+		bool bHasDigits = false;
+		bool bFraction = false;
+		for (; Q < E; ++Q)
+		{
+			if (*Q == '.' && !bFraction)
+			{
+				bFraction = true;
+				continue;
+			}
+			if (!IsDigit(*Q))
+			{
+				break;
+			}
+
+			bHasDigits = true;
+			if (NumSignificant < MaxMantissaDigits)
+			{
+				NumSignificant += Mantissa != 0 || *Q != '0' ? 1 : 0;
+				Mantissa = Mantissa * 10 + (*Q - '0');
+				Exponent -= bFraction ? 1 : 0;
+			}
+			else
+			{
+				Exponent += bFraction ? 0 : 1;
+			}
+		}
+		if (!bHasDigits)
+		{
+			return false;
+		}
+
+		if (Q < E && (*Q == 'e' || *Q == 'E'))
+		{
+			++Q;
+			const bool bNegativeExponent = Q < E && *Q == '-';
+			if (Q < E && (*Q == '-' || *Q == '+'))
+			{
+				++Q;
+			}
+			if (Q >= E || !IsDigit(*Q))
+			{
+				return false;
+			}
+
+			int32 WrittenExponent = 0;
+			for (; Q < E && IsDigit(*Q); ++Q)
+			{
+				WrittenExponent = FMath::Min(WrittenExponent * 10 + (*Q - '0'), MaxExponent);
+			}
+			Exponent += bNegativeExponent ? -WrittenExponent : WrittenExponent;
+		}
+
+		double Value = (double)Mantissa;
+		if (Mantissa != 0 && Exponent != 0)
+		{
+			if (Mantissa <= MaxExactMantissa && FMath::Abs(Exponent) < (int32)UE_ARRAY_COUNT(PowersOf10))
+			{
+				Value = Exponent < 0 ? Value / PowersOf10[-Exponent] : Value * PowersOf10[Exponent];
+			}
+			else
+			{
+				// In two steps, so a long mantissa with a large negative exponent does not go through a denormal
+				const int32 HalfExponent = Exponent / 2;
+				Value = Value * FMath::Pow(10.0, (double)HalfExponent) * FMath::Pow(10.0, (double)(Exponent - HalfExponent));
+			}
+		}
+		if (!FMath::IsFinite(Value))
+		{
+			return false;
+		}
+
+		OutValue = bNegative ? -Value : Value;
+		P = Q;
+		return true;
+	}
+
+	/** A JSON string, returned without its quotes and with any escapes left in place. */
+	bool ParseJsonString(const ANSICHAR*& P, const ANSICHAR* E, FUtf8StringView& OutView, bool& bOutEscaped)
+	{
+		if (P >= E || *P != '"')
+		{
+			return false;
+		}
+
+		const ANSICHAR* Start = ++P;
+		bOutEscaped = false;
+		while (P < E && *P != '"')
+		{
+			if (*P == '\\')
+			{
+				bOutEscaped = true;
+				++P;
+			}
+			++P;
+		}
+		if (P >= E)
+		{
+			return false;
+		}
+
+		OutView = MakeView(Start, P++);
+		return true;
+	}
+
+	bool ParseJsonStringOrNull(const ANSICHAR*& P, const ANSICHAR* E, FUtf8StringView& OutView, bool& bOutEscaped)
+	{
+		if (E - P >= 4 && FCStringAnsi::Strncmp(P, "null", 4) == 0)
+		{
+			P += 4;
+			OutView = FUtf8StringView();
+			return true;
+		}
+		return ParseJsonString(P, E, OutView, bOutEscaped);
+	}
+
+	bool ParseJsonNumbers(const ANSICHAR*& P, const ANSICHAR* E, double* OutValues, int32 MaxValues, int32& OutNum)
+	{
+		if (P >= E || *P != '[')
+		{
+			return false;
+		}
+		++P;
+
+		OutNum = 0;
+		for (;;)
+		{
+			SkipSpace(P, E);
+			if (P < E && *P == ']' && OutNum == 0)
+			{
+				++P;
+				return true;
+			}
+			if (OutNum == MaxValues || !ParseNumber(P, E, OutValues[OutNum++]))
+			{
+				return false;
+			}
+
+			SkipSpace(P, E);
+			if (P < E && *P == ',')
+			{
+				++P;
+			}
+			else if (P < E && *P == ']')
+			{
+				++P;
+				return true;
+			}
+			else
+			{
+				return false;
+			}
+		}
+	}
+
+	/** Skips a value of a key the format does not know, including nested arrays and objects. */
+	bool SkipJsonValue(const ANSICHAR*& P, const ANSICHAR* E)
+	{
+		int32 Depth = 0;
+		while (P < E)
+		{
+			if (*P == '"')
+			{
+				FUtf8StringView Ignored;
+				bool bIgnored = false;
+				if (!ParseJsonString(P, E, Ignored, bIgnored))
+				{
+					return false;
+				}
+				continue;
+			}
+			if (*P == '[' || *P == '{')
+			{
+				++Depth;
+			}
+			else if (*P == ']' || *P == '}')
+			{
+				if (Depth == 0)
+				{
+					return true;
+				}
+				--Depth;
+			}
+			else if (*P == ',' && Depth == 0)
+			{
+				return true;
+			}
+			++P;
+		}
+		return Depth == 0;
+	}
+
+	struct FCsvField
+	{
+		FUtf8StringView View;
+		bool bEscaped = false;
+	};
+
+	/** Splits a CSV line in place. Quoted fields come back without their quotes. */
+	void SplitCsvLine(FUtf8StringView Line, TArray<FCsvField, TInlineAllocator<16>>& OutFields)
+	{
+		const ANSICHAR* P = reinterpret_cast<const ANSICHAR*>(Line.GetData());
+		const ANSICHAR* E = P + Line.Len();
+
+		OutFields.Reset();
+		for (;;)
+		{
+			FCsvField& Field = OutFields.AddDefaulted_GetRef();
+			SkipSpace(P, E);
+			if (P < E && *P == '"')
+			{
+				const ANSICHAR* Start = ++P;
+				while (P < E && (*P != '"' || (P + 1 < E && P[1] == '"')))
+				{
+					if (*P == '"')
+					{
+						Field.bEscaped = true;
+						++P;
+					}
+					++P;
+				}
+				Field.View = MakeView(Start, P);
+				while (P < E && *P != ',')
+				{
+					++P;
+				}
+			}
+			else
+			{
+				const ANSICHAR* Start = P;
+				while (P < E && *P != ',')
+				{
+					++P;
+				}
+				Field.View = MakeView(Start, P).TrimEnd();
+			}
+
+			if (P >= E)
+			{
+				return;
+			}
+			++P;
+		}
+	}
+
+	FString Unescape(FUtf8StringView View, bool bEscaped, ETruPlacementFormat Format)
+	{
+		const FString Raw(View.Len(), View.GetData());
+		if (!bEscaped)
+		{
+			return Raw;
+		}
+		if (Format == ETruPlacementFormat::Csv)
+		{
+			return Raw.Replace(TEXT("\"\""), TEXT("\""));
+		}
+
+		FString Result;
+		Result.Reserve(Raw.Len());
+		for (int32 Index = 0; Index < Raw.Len(); ++Index)
+		{
+			if (Raw[Index] != TEXT('\\') || Index + 1 == Raw.Len())
+			{
+				Result.AppendChar(Raw[Index]);
+				continue;
+			}
+
+			const TCHAR Escaped = Raw[++Index];
+			switch (Escaped)
+			{
+			case TEXT('b'): Result.AppendChar(TEXT('\b')); break;
+			case TEXT('f'): Result.AppendChar(TEXT('\f')); break;
+			case TEXT('n'): Result.AppendChar(TEXT('\n')); break;
+			case TEXT('r'): Result.AppendChar(TEXT('\r')); break;
+			case TEXT('t'): Result.AppendChar(TEXT('\t')); break;
+			case TEXT('u'):
+				if (Index + 4 < Raw.Len())
+				{
+					Result.AppendChar((TCHAR)FParse::HexNumber(*Raw.Mid(Index + 1, 4)));
+					Index += 4;
+				}
+				break;
+			default: Result.AppendChar(Escaped); break;
+			}
+		}
+		return Result;
+	}
+
+	FName ToName(FUtf8StringView View, bool bEscaped, ETruPlacementFormat Format)
+	{
+		if (View.IsEmpty())
+		{
+			return NAME_None;
+		}
+		return bEscaped ? FName(*Unescape(View, bEscaped, Format)) : FName(View.Len(), View.GetData());
+	}
+}
+
+bool TruPlacement::GetFormat(const FString& Filename, ETruPlacementFormat& OutFormat)
+{
+	const FString Extension = FPaths::GetExtension(Filename);
+	if (Extension == TEXT("jsonl"))
+	{
+		OutFormat = ETruPlacementFormat::JsonLines;
+		return true;
+	}
+	if (Extension == TEXT("csv"))
+	{
+		OutFormat = ETruPlacementFormat::Csv;
+		return true;
+	}
+	return false;
+}
+
+FString FTruPlacementRow::GetClass() const
+{
+	return Unescape(Class, bClassEscaped, Format);
+}
+
+FName FTruPlacementRow::GetName() const
+{
+	return ToName(Name, bNameEscaped, Format);
+}
+
+FName FTruPlacementRow::GetParent() const
+{
+	return ToName(Parent, bParentEscaped, Format);
+}
+
+// --- Reader ---
+
+FTruPlacementReader::FTruPlacementReader() = default;
+
+FTruPlacementReader::~FTruPlacementReader()
+{
+	Close();
+}
+
+bool FTruPlacementReader::Open(const FString& Filename, FString* OutError, int32 ChunkSize)
+{
+	Close();
+
+	if (!TruPlacement::GetFormat(Filename, Format))
+	{
+		if (OutError)
+		{
+			*OutError = TEXT("Placement files have to be .jsonl or .csv");
+		}
+		return false;
+	}
+
+	File.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Filename));
+	if (!File)
+	{
+		if (OutError)
+		{
+			*OutError = TEXT("Could not open the file");
+		}
+		return false;
+	}
+
+	Buffer.SetNumUninitialized(FMath::Max(ChunkSize, 1024) + 1);
+	Fill();
+
+	// A byte order mark some tools put in front of UTF-8
+	if (End >= 3 && (uint8)Buffer[0] == 0xEF && (uint8)Buffer[1] == 0xBB && (uint8)Buffer[2] == 0xBF)
+	{
+		Begin = 3;
+	}
+	return true;
+}
+
+void FTruPlacementReader::Close()
+{
+	File.Reset();
+	Buffer.Empty();
+	Begin = 0;
+	End = 0;
+	bEndOfFile = false;
+	LineNumber = 0;
+	Columns.Reset();
+	bHasHeader = false;
+	bQuaternionColumns = false;
+	NumErrors = 0;
+	Errors.Reset();
+}
+
+void FTruPlacementReader::Fill()
+{
+	const int64 Remaining = File->Size() - File->Tell();
+	const int64 BytesToRead = FMath::Min<int64>(Buffer.Num() - 1 - End, Remaining);
+	if (BytesToRead > 0)
+	{
+		if (!File->Read(reinterpret_cast<uint8*>(Buffer.GetData() + End), BytesToRead))
+		{
+			AddError(LineNumber + 1, TEXT("Could not read the file"));
+			bEndOfFile = true;
+			Buffer[End] = (UTF8CHAR)0;
+			return;
+		}
+		End += BytesToRead;
+	}
+	bEndOfFile = BytesToRead == Remaining;
+	Buffer[End] = (UTF8CHAR)0;
+}
+
+int64 FTruPlacementReader::FindLineEnd(int64 From) const
+{
+	// A quoted CSV field may span lines; JSON strings cannot hold a raw line break
+	bool bInQuotes = false;
+	for (int64 Index = From; Index < End; ++Index)
+	{
+		const ANSICHAR Char = (ANSICHAR)Buffer[Index];
+		if (Char == '"' && Format == ETruPlacementFormat::Csv)
+		{
+			bInQuotes = !bInQuotes;
+		}
+		else if (Char == '\n' && !bInQuotes)
+		{
+			return Index;
+		}
+	}
+	return INDEX_NONE;
+}
+
+int32 FTruPlacementReader::ReadRows(int32 MaxRows, TArray<FTruPlacementRow>& OutRows)
+{
+	OutRows.Reset();
+	if (!File)
+	{
+		return 0;
+	}
+
+	// Rows handed out by the previous call are done with, so the unparsed tail can move to the front
+	if (Begin > 0)
+	{
+		FMemory::Memmove(Buffer.GetData(), Buffer.GetData() + Begin, End - Begin);
+		End -= Begin;
+		Begin = 0;
+		Buffer[End] = (UTF8CHAR)0;
+	}
+	if (!bEndOfFile)
+	{
+		Fill();
+	}
+
+	while (OutRows.Num() < MaxRows && Begin < End)
+	{
+		int64 LineEnd = FindLineEnd(Begin);
+		if (LineEnd == INDEX_NONE)
+		{
+			if (!bEndOfFile)
+			{
+				// A line longer than the whole buffer. Nothing has been parsed out of the buffer yet, so it may grow.
+				if (Begin == 0 && End == Buffer.Num() - 1)
+				{
+					Buffer.SetNumUninitialized((Buffer.Num() - 1) * 2 + 1);
+					Fill();
+					continue;
+				}
+				break;
+			}
+			LineEnd = End;
+		}
+
+		const FUtf8StringView Line = FUtf8StringView(Buffer.GetData() + Begin, UE_PTRDIFF_TO_INT32(LineEnd - Begin)).TrimStartAndEnd();
+
+		// A row is reported at the line it starts on; line breaks inside quoted CSV fields still count towards the next
+		++LineNumber;
+		const int32 RowLine = LineNumber;
+		if (Format == ETruPlacementFormat::Csv)
+		{
+			for (int64 Index = Begin; Index < LineEnd; ++Index)
+			{
+				LineNumber += Buffer[Index] == (UTF8CHAR)'\n' ? 1 : 0;
+			}
+		}
+		Begin = FMath::Min(LineEnd + 1, End);
+		if (Line.IsEmpty())
+		{
+			continue;
+		}
+
+		const TCHAR* Error = nullptr;
+		if (Format == ETruPlacementFormat::Csv && !bHasHeader)
+		{
+			bHasHeader = true;
+			if (!ParseCsvHeader(Line, Error))
+			{
+				// Without columns no row can be read
+				AddError(RowLine, Error);
+				bEndOfFile = true;
+				Begin = End;
+			}
+			continue;
+		}
+
+		FTruPlacementRow& Row = OutRows.AddDefaulted_GetRef();
+		Row.Line = RowLine;
+		Row.Format = Format;
+		const bool bParsed = Format == ETruPlacementFormat::JsonLines ? ParseJsonLine(Line, Row, Error) : ParseCsvLine(Line, Row, Error);
+		if (!bParsed)
+		{
+			OutRows.Pop(EAllowShrinking::No);
+			AddError(RowLine, Error);
+		}
+	}
+	return OutRows.Num();
+}
+
+bool FTruPlacementReader::ParseJsonLine(FUtf8StringView Line, FTruPlacementRow& OutRow, const TCHAR*& OutError) const
+{
+	const ANSICHAR* P = reinterpret_cast<const ANSICHAR*>(Line.GetData());
+	const ANSICHAR* E = P + Line.Len();
+
+	auto Fail = [&OutError](const TCHAR* Reason)
+	{
+		OutError = Reason;
+		return false;
+	};
+
+	SkipSpace(P, E);
+	if (P >= E || *P != '{')
+	{
+		return Fail(TEXT("Expected a JSON object"));
+	}
+	++P;
+
+	FVector Location = FVector::ZeroVector;
+	FQuat Rotation = FQuat::Identity;
+	FVector Scale = FVector::OneVector;
+	for (;;)
+	{
+		SkipSpace(P, E);
+		if (P < E && *P == '}')
+		{
+			break;
+		}
+
+		FUtf8StringView Key;
+		bool bKeyEscaped = false;
+		if (!ParseJsonString(P, E, Key, bKeyEscaped))
+		{
+			return Fail(TEXT("Expected a key"));
+		}
+		SkipSpace(P, E);
+		if (P >= E || *P != ':')
+		{
+			return Fail(TEXT("Expected ':' after a key"));
+		}
+		++P;
+		SkipSpace(P, E);
+
+		double Values[4];
+		int32 NumValues = 0;
+		if (IsKey(Key, "class"))
+		{
+			if (!ParseJsonStringOrNull(P, E, OutRow.Class, OutRow.bClassEscaped))
+			{
+				return Fail(TEXT("\"class\" has to be a string"));
+			}
+		}
+		else if (IsKey(Key, "name"))
+		{
+			if (!ParseJsonStringOrNull(P, E, OutRow.Name, OutRow.bNameEscaped))
+			{
+				return Fail(TEXT("\"name\" has to be a string"));
+			}
+		}
+		else if (IsKey(Key, "parent"))
+		{
+			if (!ParseJsonStringOrNull(P, E, OutRow.Parent, OutRow.bParentEscaped))
+			{
+				return Fail(TEXT("\"parent\" has to be a string"));
+			}
+		}
+		else if (IsKey(Key, "location") || IsKey(Key, "scale"))
+		{
+			if (!ParseJsonNumbers(P, E, Values, 3, NumValues) || NumValues != 3)
+			{
+				return Fail(TEXT("\"location\" and \"scale\" have to be arrays of three numbers"));
+			}
+			(IsKey(Key, "location") ? Location : Scale) = FVector(Values[0], Values[1], Values[2]);
+		}
+		else if (IsKey(Key, "rotation"))
+		{
+			if (!ParseJsonNumbers(P, E, Values, 4, NumValues) || NumValues < 3)
+			{
+				return Fail(TEXT("\"rotation\" has to be a quaternion or pitch, yaw and roll"));
+			}
+			Rotation = NumValues == 4 ? FQuat(Values[0], Values[1], Values[2], Values[3]).GetNormalized() : FRotator(Values[0], Values[1], Values[2]).Quaternion();
+		}
+		else if (!SkipJsonValue(P, E))
+		{
+			return Fail(TEXT("Malformed value"));
+		}
+
+		SkipSpace(P, E);
+		if (P < E && *P == ',')
+		{
+			++P;
+		}
+		else if (P >= E || *P != '}')
+		{
+			return Fail(TEXT("Expected ',' or '}'"));
+		}
+	}
+
+	if (OutRow.Class.IsEmpty())
+	{
+		return Fail(TEXT("No class"));
+	}
+	OutRow.Transform = FTransform(Rotation, Location, Scale);
+	return true;
+}
+
+bool FTruPlacementReader::ParseCsvHeader(FUtf8StringView Line, const TCHAR*& OutError)
+{
+	static const TPair<const TCHAR*, EColumn> ColumnNames[] =
+	{
+		{ TEXT("class"), EColumn::Class }, { TEXT("name"), EColumn::Name }, { TEXT("parent"), EColumn::Parent },
+		{ TEXT("x"), EColumn::X }, { TEXT("y"), EColumn::Y }, { TEXT("z"), EColumn::Z },
+		{ TEXT("pitch"), EColumn::Pitch }, { TEXT("yaw"), EColumn::Yaw }, { TEXT("roll"), EColumn::Roll },
+		{ TEXT("qx"), EColumn::QX }, { TEXT("qy"), EColumn::QY }, { TEXT("qz"), EColumn::QZ }, { TEXT("qw"), EColumn::QW },
+		{ TEXT("sx"), EColumn::SX }, { TEXT("sy"), EColumn::SY }, { TEXT("sz"), EColumn::SZ }
+	};
+
+	TArray<FCsvField, TInlineAllocator<16>> Fields;
+	SplitCsvLine(Line, Fields);
+
+	Columns.Reset();
+	for (const FCsvField& Field : Fields)
+	{
+		const FString Name = Unescape(Field.View, Field.bEscaped, ETruPlacementFormat::Csv).TrimStartAndEnd();
+		EColumn& Column = Columns.Add_GetRef(EColumn::Ignored);
+		for (const TPair<const TCHAR*, EColumn>& ColumnName : ColumnNames)
+		{
+			if (Name.Equals(ColumnName.Key, ESearchCase::IgnoreCase))
+			{
+				Column = ColumnName.Value;
+				break;
+			}
+		}
+		bQuaternionColumns |= Column >= EColumn::QX && Column <= EColumn::QW;
+	}
+
+	if (!Columns.Contains(EColumn::Class))
+	{
+		OutError = TEXT("The header row has no class column");
+		return false;
+	}
+	return true;
+}
+
+bool FTruPlacementReader::ParseCsvLine(FUtf8StringView Line, FTruPlacementRow& OutRow, const TCHAR*& OutError) const
+{
+	TArray<FCsvField, TInlineAllocator<16>> Fields;
+	SplitCsvLine(Line, Fields);
+
+	// Indexed by EColumn; missing columns keep the identity transform
+	double Values[(int32)EColumn::SZ + 1] = {};
+	Values[(int32)EColumn::QW] = 1.0;
+	Values[(int32)EColumn::SX] = Values[(int32)EColumn::SY] = Values[(int32)EColumn::SZ] = 1.0;
+
+	for (int32 FieldIndex = 0; FieldIndex < FMath::Min(Fields.Num(), Columns.Num()); ++FieldIndex)
+	{
+		const FCsvField& Field = Fields[FieldIndex];
+		switch (Columns[FieldIndex])
+		{
+		case EColumn::Ignored:
+			break;
+		case EColumn::Class:
+			OutRow.Class = Field.View;
+			OutRow.bClassEscaped = Field.bEscaped;
+			break;
+		case EColumn::Name:
+			OutRow.Name = Field.View;
+			OutRow.bNameEscaped = Field.bEscaped;
+			break;
+		case EColumn::Parent:
+			OutRow.Parent = Field.View;
+			OutRow.bParentEscaped = Field.bEscaped;
+			break;
+		default:
+			if (!Field.View.IsEmpty())
+			{
+				const ANSICHAR* P = reinterpret_cast<const ANSICHAR*>(Field.View.GetData());
+				const ANSICHAR* E = P + Field.View.Len();
+				if (!ParseNumber(P, E, Values[(int32)Columns[FieldIndex]]) || P != E)
+				{
+					OutError = TEXT("Transform columns have to be numbers");
+					return false;
+				}
+			}
+			break;
+		}
+	}
+
+	if (OutRow.Class.IsEmpty())
+	{
+		OutError = TEXT("No class");
+		return false;
+	}
+
+	auto Value = [&Values](EColumn Column) { return Values[(int32)Column]; };
+	const FQuat Rotation = bQuaternionColumns
+		? FQuat(Value(EColumn::QX), Value(EColumn::QY), Value(EColumn::QZ), Value(EColumn::QW)).GetNormalized()
+		: FRotator(Value(EColumn::Pitch), Value(EColumn::Yaw), Value(EColumn::Roll)).Quaternion();
+	OutRow.Transform = FTransform(
+		Rotation,
+		FVector(Value(EColumn::X), Value(EColumn::Y), Value(EColumn::Z)),
+		FVector(Value(EColumn::SX), Value(EColumn::SY), Value(EColumn::SZ)));
+	return true;
+}
+
+void FTruPlacementReader::AddError(int32 Line, const TCHAR* Reason)
+{
+	++NumErrors;
+	if (Errors.Num() < MaxListedErrors)
+	{
+		Errors.Add(FString::Printf(TEXT("Line %d: %s"), Line, Reason));
+	}
+}
+
+// --- Writer ---
+
+FTruPlacementWriter::~FTruPlacementWriter()
+{
+	Close();
+}
+
+bool FTruPlacementWriter::Open(const FString& Filename, FString* OutError)
+{
+	Close();
+
+	if (!TruPlacement::GetFormat(Filename, Format))
+	{
+		if (OutError)
+		{
+			*OutError = TEXT("Placement files have to be .jsonl or .csv");
+		}
+		return false;
+	}
+
+	Archive.Reset(IFileManager::Get().CreateFileWriter(*Filename));
+	if (!Archive)
+	{
+		if (OutError)
+		{
+			*OutError = TEXT("Could not create the file");
+		}
+		return false;
+	}
+
+	NumRows = 0;
+	if (Format == ETruPlacementFormat::Csv)
+	{
+		Text << TEXT("class,name,parent,x,y,z,qx,qy,qz,qw,sx,sy,sz\n");
+	}
+	return true;
+}
+
+void FTruPlacementWriter::WriteRow(const FString& Class, const FString& Name, const FString& Parent, const FTransform& Transform)
+{
+	if (!Archive)
+	{
+		return;
+	}
+
+	const FVector T = Transform.GetLocation();
+	const FQuat R = Transform.GetRotation();
+	const FVector S = Transform.GetScale3D();
+
+	// Locations keep double precision; rotation and scale are single precision everywhere else too
+	if (Format == ETruPlacementFormat::JsonLines)
+	{
+		Text << TEXT("{\"class\":");
+		AppendString(Class);
+		Text << TEXT(",\"name\":");
+		AppendString(Name);
+		if (!Parent.IsEmpty())
+		{
+			Text << TEXT(",\"parent\":");
+			AppendString(Parent);
+		}
+		Text.Appendf(TEXT(",\"location\":[%.17g,%.17g,%.17g],\"rotation\":[%.9g,%.9g,%.9g,%.9g],\"scale\":[%.9g,%.9g,%.9g]}\n"),
+			T.X, T.Y, T.Z, R.X, R.Y, R.Z, R.W, S.X, S.Y, S.Z);
+	}
+	else
+	{
+		AppendString(Class);
+		Text << TEXT(',');
+		AppendString(Name);
+		Text << TEXT(',');
+		AppendString(Parent);
+		Text.Appendf(TEXT(",%.17g,%.17g,%.17g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g\n"),
+			T.X, T.Y, T.Z, R.X, R.Y, R.Z, R.W, S.X, S.Y, S.Z);
+	}
+
+	++NumRows;
+	if (Text.Len() > 12 * 1024)
+	{
+		Flush();
+	}
+}
+
+bool FTruPlacementWriter::Close()
+{
+	if (!Archive)
+	{
+		return true;
+	}
+
+	Flush();
+	const bool bSucceeded = Archive->Close();
+	Archive.Reset();
+	return bSucceeded;
+}
+
+void FTruPlacementWriter::AppendString(const FString& String)
+{
+	if (Format == ETruPlacementFormat::Csv)
+	{
+		int32 Unused = 0;
+		if (!String.FindChar(TEXT(','), Unused) && !String.FindChar(TEXT('"'), Unused) && !String.FindChar(TEXT('\n'), Unused) && !String.FindChar(TEXT('\r'), Unused))
+		{
+			Text << String;
+			return;
+		}
+		Text << TEXT('"') << String.Replace(TEXT("\""), TEXT("\"\"")) << TEXT('"');
+		return;
+	}
+
+	Text << TEXT('"');
+	for (const TCHAR Char : String)
+	{
+		switch (Char)
+		{
+		case TEXT('"'): Text << TEXT("\\\""); break;
+		case TEXT('\\'): Text << TEXT("\\\\"); break;
+		case TEXT('\n'): Text << TEXT("\\n"); break;
+		case TEXT('\r'): Text << TEXT("\\r"); break;
+		case TEXT('\t'): Text << TEXT("\\t"); break;
+		default:
+			if (Char < 0x20)
+			{
+				Text.Appendf(TEXT("\\u%04x"), (uint32)Char);
+			}
+			else
+			{
+				Text.AppendChar(Char);
+			}
+			break;
+		}
+	}
+	Text << TEXT('"');
+}
+
+void FTruPlacementWriter::Flush()
+{
+	if (Archive && Text.Len() > 0)
+	{
+		FTCHARToUTF8 Utf8(Text.GetData(), Text.Len());
+		Archive->Serialize(const_cast<UTF8CHAR*>(reinterpret_cast<const UTF8CHAR*>(Utf8.Get())), Utf8.Length());
+	}
+	Text.Reset();
+}
+
+// --- Import and export ---
+
+bool FTruPlacementImport::Start(UWorld* InWorld, const FString& Filename, AActor* InOwner, FOnFinished&& InOnFinished, FString* OutError)
+{
+	if (!UTruSpawnQueue::Get(InWorld))
+	{
+		if (OutError)
+		{
+			*OutError = TEXT("The world has no spawn queue");
+		}
+		return false;
+	}
+
+	TSharedRef<FTruPlacementImport> Import = MakeShared<FTruPlacementImport>();
+	if (!Import->Reader.Open(Filename, OutError))
+	{
+		return false;
+	}
+
+	Import->World = InWorld;
+	Import->Owner = InOwner;
+	Import->OnFinished = MoveTemp(InOnFinished);
+	Import->StartTime = FPlatformTime::Seconds();
+	Import->EnqueueNextBatch();
+	return true;
+}
+
+void FTruPlacementImport::EnqueueNextBatch()
+{
+	UWorld* ImportWorld = World.Get();
+	UTruSpawnQueue* SpawnQueue = UTruSpawnQueue::Get(ImportWorld);
+	UTruNameRegistry* NameRegistry = UTruNameRegistry::Get(ImportWorld);
+	if (!SpawnQueue || !NameRegistry)
+	{
+		Finish();
+		return;
+	}
+
+	const int32 BatchSize = FMath::Max(CVarTruPlacementImportBatchSize.GetValueOnGameThread(), 1);
+	TArray<FTruSpawnRequest> Requests;
+	TArray<FName> Names;		// Spawn name per request
+	TArray<FName> ParentNames;	// File name of a parent outside the batch per request, None otherwise
+	TMap<FName, int32> BatchIndices;
+	Requests.Reserve(BatchSize);
+	Names.Reserve(BatchSize);
+	ParentNames.Reserve(BatchSize);
+
+	while (Requests.Num() < BatchSize && !Reader.IsAtEnd())
+	{
+		Reader.ReadRows(BatchSize - Requests.Num(), Rows);
+		for (const FTruPlacementRow& Row : Rows)
+		{
+			++Stats.NumRows;
+			UClass* Class = ResolveClass(Row);
+			if (!Class)
+			{
+				++Stats.NumUnknownClasses;
+				continue;
+			}
+
+			// Requested names that are taken would silently become something else; pick that name here instead
+			const FName FileName = Row.GetName();
+			FName SpawnName = FileName;
+			if (FileName.IsNone())
+			{
+				SpawnName = FName(*NameRegistry->MakeUniqueName(Class->GetName()));
+			}
+			else if (NameRegistry->IsNameTaken(FileName) || BatchIndices.Contains(FileName) || StaticFindObjectFast(nullptr, ImportWorld->PersistentLevel, FileName))
+			{
+				SpawnName = FName(*NameRegistry->MakeUniqueName(FileName.ToString()));
+				Renamed.Add(FileName, SpawnName);
+				++Stats.NumRenamed;
+			}
+
+			FTruSpawnRequest& Request = Requests.AddDefaulted_GetRef();
+			Request.Class = Class;
+			Request.Transform = Row.Transform;
+			Request.Name = SpawnName;
+
+			const FName ParentName = Row.GetParent();
+			const int32* ParentIndex = ParentName.IsNone() ? nullptr : BatchIndices.Find(ParentName);
+			Request.ParentIndex = ParentIndex ? *ParentIndex : INDEX_NONE;
+			ParentNames.Add(ParentIndex ? NAME_None : ParentName);
+			Names.Add(SpawnName);
+
+			if (!FileName.IsNone())
+			{
+				BatchIndices.Add(FileName, Requests.Num() - 1);
+			}
+		}
+	}
+
+	if (Requests.IsEmpty())
+	{
+		Finish();
+		return;
+	}
+
+	SpawnQueue->EnqueueBatch(MoveTemp(Requests), Owner.Get(), [This = AsShared(), BatchNames = MoveTemp(Names), BatchParentNames = MoveTemp(ParentNames)](const TArray<ATruGameObject*>& Spawned, bool bCancelled)
+	{
+		This->Stats.NumSpawned += Spawned.Num();
+		This->OnBatchDone(bCancelled, BatchNames, BatchParentNames);
+	});
+}
+
+void FTruPlacementImport::OnBatchDone(bool bCancelled, const TArray<FName>& Names, const TArray<FName>& ParentNames)
+{
+	for (int32 Index = 0; Index < Names.Num(); ++Index)
+	{
+		if (ParentNames[Index].IsNone())
+		{
+			continue;
+		}
+
+		ATruGameObject* Child = FindSpawned(Names[Index]);
+		if (!Child)
+		{
+			continue;
+		}
+		if (ATruGameObject* Parent = FindSpawned(GetSpawnName(ParentNames[Index])))
+		{
+			Child->SetParentGameObject(Parent);
+		}
+		else
+		{
+			PendingChildren.Add({ Names[Index], ParentNames[Index] });
+		}
+	}
+
+	if (bCancelled)
+	{
+		Stats.bCancelled = true;
+		Finish();
+	}
+	else if (Reader.IsAtEnd())
+	{
+		Finish();
+	}
+	else
+	{
+		// Queued from the spawn queue's own callback, so it carries on in the same frame if there is budget left
+		EnqueueNextBatch();
+	}
+}
+
+void FTruPlacementImport::Finish()
+{
+	for (const FPendingChild& Pending : PendingChildren)
+	{
+		ATruGameObject* Child = FindSpawned(Pending.Child);
+		ATruGameObject* Parent = FindSpawned(GetSpawnName(Pending.Parent));
+		if (Child && Parent)
+		{
+			Child->SetParentGameObject(Parent);
+		}
+		else
+		{
+			++Stats.NumMissingParents;
+		}
+	}
+	PendingChildren.Reset();
+
+	Stats.NumParseErrors = Reader.GetNumErrors();
+	for (const FString& Error : Reader.GetErrors())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Placement import: %s"), *Error);
+	}
+	Reader.Close();
+
+	Stats.Seconds = FPlatformTime::Seconds() - StartTime;
+	if (OnFinished)
+	{
+		OnFinished(Stats);
+	}
+}
+
+UClass* FTruPlacementImport::ResolveClass(const FTruPlacementRow& Row)
+{
+	if (!Row.bClassEscaped && Row.Class.Len() == LastClassPath.Num() && FMemory::Memcmp(Row.Class.GetData(), LastClassPath.GetData(), LastClassPath.Num()) == 0)
+	{
+		return LastClass;
+	}
+
+	const FString ClassPath = Row.GetClass();
+	UClass* Class = nullptr;
+	if (UClass** Found = Classes.Find(ClassPath))
+	{
+		Class = *Found;
+	}
+	else
+	{
+		// Tools may name a loaded class instead of spelling out its path
+		Class = ClassPath.Contains(TEXT("/")) ? FSoftClassPath(ClassPath).TryLoadClass<ATruGameObject>() : FindFirstObject<UClass>(*ClassPath, EFindFirstObjectOptions::NativeFirst);
+		if (Class && !Class->IsChildOf<ATruGameObject>())
+		{
+			Class = nullptr;
+		}
+		if (!Class)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Placement class %s is not a TruGameObject, its rows are skipped"), *ClassPath);
+		}
+		Classes.Add(ClassPath, Class);
+	}
+
+	LastClassPath.Reset();
+	if (!Row.bClassEscaped)
+	{
+		LastClassPath.Append(Row.Class.GetData(), Row.Class.Len());
+	}
+	LastClass = Class;
+	return Class;
+}
+
+FName FTruPlacementImport::GetSpawnName(FName FileName) const
+{
+	const FName* SpawnName = Renamed.Find(FileName);
+	return SpawnName ? *SpawnName : FileName;
+}
+
+ATruGameObject* FTruPlacementImport::FindSpawned(FName SpawnName) const
+{
+	UWorld* ImportWorld = World.Get();
+	if (!ImportWorld || SpawnName.IsNone())
+	{
+		return nullptr;
+	}
+
+	ATruGameObject* GameObject = Cast<ATruGameObject>(StaticFindObjectFast(ATruGameObject::StaticClass(), ImportWorld->PersistentLevel, SpawnName));
+	return IsValid(GameObject) && !GameObject->IsPooled() ? GameObject : nullptr;
+}
+
+int32 FTruPlacementImport::Export(UWorld* ExportWorld, const FString& Filename, FString* OutError)
+{
+	FTruPlacementWriter Writer;
+	if (!ExportWorld || !Writer.Open(Filename, OutError))
+	{
+		return INDEX_NONE;
+	}
+
+	TMap<const UClass*, FString> ClassPaths;
+	auto GetClassPath = [&ClassPaths](const UClass* Class) -> const FString&
+	{
+		if (const FString* Existing = ClassPaths.Find(Class))
+		{
+			return *Existing;
+		}
+		return ClassPaths.Add(Class, Class->GetPathName());
+	};
+
+	for (TActorIterator<ATruGameObject> It(ExportWorld); It; ++It)
+	{
+		if (It->IsPooled())
+		{
+			continue;
+		}
+		const ATruGameObject* Parent = It->GetParentGameObject();
+		Writer.WriteRow(GetClassPath(It->GetClass()), It->GetName(), Parent ? Parent->GetName() : FString(), It->GetActorTransform());
+	}
+
+	// Entities are always roots
+	if (const UTruEntityStore* EntityStore = UTruEntityStore::Get(ExportWorld))
+	{
+		for (const FTruEntityBatch& Batch : EntityStore->GetBatches())
+		{
+			if (!Batch.Class)
+			{
+				continue;
+			}
+			const FString& ClassPath = GetClassPath(Batch.Class);
+			for (const FTruEntity& Entity : Batch.Entities)
+			{
+				Writer.WriteRow(ClassPath, Entity.Name.ToString(), FString(), Entity.GetTransform());
+			}
+		}
+	}
+
+	if (const UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(ExportWorld))
+	{
+		PrefabLibrary->WritePlacements(Writer);
+	}
+
+	const int32 NumRows = Writer.GetNumRows();
+	if (!Writer.Close())
+	{
+		if (OutError)
+		{
+			*OutError = TEXT("Could not write the file");
+		}
+		return INDEX_NONE;
+	}
+	return NumRows;
+}
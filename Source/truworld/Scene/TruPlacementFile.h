@@ -0,0 +1,201 @@
+// TruPlacementFile.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class ATruGameObject;
+class FArchive;
+class IFileHandle;
+class UWorld;
+
+/**
+ * Object placements exchanged with external tools, one object per row: class, name, parent name and world transform.
+ *
+ * JSON Lines (.jsonl), one flat object per line:
+ *   {"class":"/Script/truworld.TruGameObject","name":"Rock","parent":"Cliff","location":[0,0,0],"rotation":[0,0,0,1],"scale":[1,1,1]}
+ * "rotation" is a quaternion (X, Y, Z, W) or pitch, yaw and roll in degrees. Only "class" is required.
+ *
+ * CSV (.csv) with a header row naming the columns, in any order:
+ *   class,name,parent,x,y,z,qx,qy,qz,qw,sx,sy,sz      (pitch,yaw,roll may replace the quaternion columns)
+ *
+ * A class is a class path, or the name of a loaded class such as TruGameObject. A parent refers to another row by name,
+ * earlier or later in the file, or to an object already in the world.
+ */
+enum class ETruPlacementFormat : uint8
+{
+	JsonLines,
+	Csv
+};
+
+namespace TruPlacement
+{
+	/** Format from the file extension; false for anything but .jsonl and .csv. */
+	TRUWORLD_API bool GetFormat(const FString& Filename, ETruPlacementFormat& OutFormat);
+}
+
+/** One parsed row. The views point into the reader's buffer and are only valid until its next ReadRows. */
+struct FTruPlacementRow
+{
+	FUtf8StringView Class;
+	FUtf8StringView Name;
+	FUtf8StringView Parent;
+	FTransform Transform;
+	int32 Line = 0;
+
+	// Views still holding JSON escapes or doubled CSV quotes; the getters below undo them
+	bool bClassEscaped = false;
+	bool bNameEscaped = false;
+	bool bParentEscaped = false;
+	ETruPlacementFormat Format = ETruPlacementFormat::JsonLines;
+
+	FString GetClass() const;
+	FName GetName() const;
+	FName GetParent() const;
+};
+
+/**
+ * Streams rows out of a placement file. The file is read a chunk at a time into one buffer that rows are parsed in
+ * place from, so memory stays at the chunk size (or the longest line, if that is longer) whatever the file size.
+ */
+class TRUWORLD_API FTruPlacementReader
+{
+public:
+	static constexpr int32 DefaultChunkSize = 1 << 20;
+
+	FTruPlacementReader();
+	~FTruPlacementReader();
+
+	bool Open(const FString& Filename, FString* OutError = nullptr, int32 ChunkSize = DefaultChunkSize);
+	void Close();
+
+	/**
+	 * Parses up to MaxRows rows from what is buffered, reading the next chunk first if there is room. May return fewer
+	 * rows, or none, before the end of the file; keep calling until IsAtEnd(). Rows that fail to parse are skipped
+	 * and counted.
+	 */
+	int32 ReadRows(int32 MaxRows, TArray<FTruPlacementRow>& OutRows);
+
+	bool IsAtEnd() const { return !File.IsValid() || (bEndOfFile && Begin == End); }
+	int32 GetNumErrors() const { return NumErrors; }
+	/** Line number and reason of the first few rows that failed. */
+	const TArray<FString>& GetErrors() const { return Errors; }
+
+private:
+	enum class EColumn : uint8
+	{
+		Ignored, Class, Name, Parent, X, Y, Z, Pitch, Yaw, Roll, QX, QY, QZ, QW, SX, SY, SZ
+	};
+
+	void Fill();
+	int64 FindLineEnd(int64 From) const;
+	bool ParseJsonLine(FUtf8StringView Line, FTruPlacementRow& OutRow, const TCHAR*& OutError) const;
+	bool ParseCsvHeader(FUtf8StringView Line, const TCHAR*& OutError);
+	bool ParseCsvLine(FUtf8StringView Line, FTruPlacementRow& OutRow, const TCHAR*& OutError) const;
+	void AddError(int32 Line, const TCHAR* Reason);
+
+	TUniquePtr<IFileHandle> File;
+	ETruPlacementFormat Format = ETruPlacementFormat::JsonLines;
+
+	// Unparsed bytes are [Begin, End); Buffer[End] is always 0, so the data can be read as a C string
+	TArray<UTF8CHAR> Buffer;
+	int64 Begin = 0;
+	int64 End = 0;
+	bool bEndOfFile = false;
+	int32 LineNumber = 0;
+
+	TArray<EColumn> Columns;	// CSV columns, from the header row
+	bool bHasHeader = false;
+	bool bQuaternionColumns = false;
+
+	int32 NumErrors = 0;
+	TArray<FString> Errors;
+};
+
+/** Writes placement rows through a small buffer, so an export never holds more than a few kilobytes of text. */
+class TRUWORLD_API FTruPlacementWriter
+{
+public:
+	~FTruPlacementWriter();
+
+	bool Open(const FString& Filename, FString* OutError = nullptr);
+	void WriteRow(const FString& Class, const FString& Name, const FString& Parent, const FTransform& Transform);
+	/** Flushes and closes the file. Returns false if anything could not be written. */
+	bool Close();
+
+	int32 GetNumRows() const { return NumRows; }
+
+private:
+	void AppendString(const FString& String);
+	void Flush();
+
+	TUniquePtr<FArchive> Archive;
+	ETruPlacementFormat Format = ETruPlacementFormat::JsonLines;
+	TStringBuilder<16384> Text;
+	int32 NumRows = 0;
+};
+
+/** Result of an import, reported once its last batch has spawned. */
+struct FTruPlacementImportStats
+{
+	int32 NumRows = 0;
+	int32 NumSpawned = 0;
+	int32 NumRenamed = 0;			// Names already taken in the world or earlier in the file
+	int32 NumUnknownClasses = 0;
+	int32 NumMissingParents = 0;
+	int32 NumParseErrors = 0;
+	bool bCancelled = false;
+	double Seconds = 0.0;
+};
+
+/**
+ * Feeds a placement file to UTruSpawnQueue one batch of tru.PlacementImportBatchSize rows at a time. The next batch is
+ * read when the previous one has spawned, so only one batch of requests exists at any time.
+ *
+ * A parent in the same batch is attached by the spawn queue. One spawned earlier, or already in the world, is found
+ * by name when the batch is done; one further down the file is attached at the end of the import. Rows whose name
+ * is taken get a unique name, which is what their children are attached to.
+ */
+class TRUWORLD_API FTruPlacementImport : public TSharedFromThis<FTruPlacementImport>
+{
+public:
+	typedef TFunction<void(const FTruPlacementImportStats&)> FOnFinished;
+
+	/** Opens Filename and queues its first batch. Returns false (and queues nothing) if the file cannot be read. */
+	static bool Start(UWorld* InWorld, const FString& Filename, AActor* InOwner, FOnFinished&& InOnFinished, FString* OutError = nullptr);
+
+	/** Writes every live object, entity and prefab instance part of ExportWorld. Returns the number of rows, or INDEX_NONE if the file could not be written. */
+	static int32 Export(UWorld* ExportWorld, const FString& Filename, FString* OutError = nullptr);
+
+private:
+	struct FPendingChild
+	{
+		FName Child;	// Name it was spawned with
+		FName Parent;	// Name in the file
+	};
+
+	void EnqueueNextBatch();
+	void OnBatchDone(bool bCancelled, const TArray<FName>& Names, const TArray<FName>& ParentNames);
+	void Finish();
+
+	UClass* ResolveClass(const FTruPlacementRow& Row);
+	FName GetSpawnName(FName FileName) const;
+	ATruGameObject* FindSpawned(FName SpawnName) const;
+
+	TWeakObjectPtr<UWorld> World;
+	TWeakObjectPtr<AActor> Owner;
+	FTruPlacementReader Reader;
+	FOnFinished OnFinished;
+	FTruPlacementImportStats Stats;
+	double StartTime = 0.0;
+
+	TMap<FString, UClass*> Classes;
+	// Rows tend to come in runs of one class, so the last one is checked before converting the path for the map
+	TArray<UTF8CHAR> LastClassPath;
+	UClass* LastClass = nullptr;
+	/** File names that were spawned under another name. Usually empty. */
+	TMap<FName, FName> Renamed;
+	/** Children whose parent comes later in the file. */
+	TArray<FPendingChild> PendingChildren;
+	TArray<FTruPlacementRow> Rows;
+};
@@ -0,0 +1,795 @@
+// TruSceneCommandlet.cpp
+
+#include "TruSceneCommandlet.h"
+
+#include "Async/ParallelFor.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "TruAutosave.h"
+#include "TruPlacementFile.h"
+#include "TruSceneFile.h"
+#include "truworld/GameObjects/TruGameObject.h"
+
+namespace
+{
+	enum class ESceneOperation : uint8
+	{
+		None		= 0,
+		Stats		= 1 << 0,
+		Validate	= 1 << 1,
+		Convert		= 1 << 2
+	};
+	ENUM_CLASS_FLAGS(ESceneOperation);
+
+	namespace ExitCode
+	{
+		static constexpr int32 Success = 0;
+		static constexpr int32 ValidationFailed = 1;
+		static constexpr int32 Error = 2;
+	}
+
+	// Placement rows parsed per ReadRows call. Rows are rarely shorter than 64 bytes, so this is about a chunk's worth.
+	static constexpr int32 RowsPerRead = FTruPlacementReader::DefaultChunkSize / 64;
+
+	const TCHAR* const Usage = TEXT("Usage: -run=TruScene -op=<stats,validate,convert> -in=<file or directory> [-out=<directory>] [-format=<truscene,jsonl,csv>] [-placements] [-report=<file>] [-overlaptolerance=<units>] [-maxissues=<count>]");
+
+	struct FCommandletSettings
+	{
+		ESceneOperation Operations = ESceneOperation::None;
+		FString InputDirectory;		// Converted files keep their path relative to this
+		FString OutputDirectory;
+		FString Format = TEXT("truscene");
+		double OverlapTolerance = 1.0;
+		int32 MaxIssues = 100;
+		bool bPlacements = false;	// Whether directory scans pick up .jsonl and .csv files
+	};
+
+	/** Resolved on the game thread before the workers start, which only read it. */
+	struct FClassInfo
+	{
+		UClass* Class = nullptr;
+		FBox LocalBounds = FBox(ForceInit);	// Mesh bounds in actor space, invalid when the class has no mesh
+	};
+
+	struct FSceneInput
+	{
+		FString Filename;
+		FTruSceneFileReader Reader;
+		int64 FileSize = 0;
+		double OpenMs = 0.0;
+		TArray<FString> ClassPaths;
+
+		TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+		FString Error;
+		int32 NumIssues = 0;
+		// Placement rows that could not be read or whose parent is not in the file
+		int32 NumReadErrors = 0;
+		TArray<FString> ReadErrors;
+	};
+
+	/** Issues of one file, of which only the first MaxIssues are listed. */
+	struct FIssueList
+	{
+		int32 MaxIssues = 0;
+		int32 Num = 0;
+		TArray<TSharedPtr<FJsonValue>> Listed;
+
+		void Add(const TCHAR* Type, int32 ObjectIndex, const FString& Detail = FString(), int32 OtherIndex = INDEX_NONE)
+		{
+			++Num;
+			if (Listed.Num() >= MaxIssues)
+			{
+				return;
+			}
+
+			TSharedRef<FJsonObject> Issue = MakeShared<FJsonObject>();
+			Issue->SetStringField(TEXT("type"), Type);
+			Issue->SetNumberField(TEXT("object"), ObjectIndex);
+			if (OtherIndex != INDEX_NONE)
+			{
+				Issue->SetNumberField(TEXT("other"), OtherIndex);
+			}
+			if (!Detail.IsEmpty())
+			{
+				Issue->SetStringField(TEXT("detail"), Detail);
+			}
+			Listed.Add(MakeShared<FJsonValueObject>(Issue));
+		}
+	};
+
+	FString ToString(FUtf8StringView View)
+	{
+		return FString(View.Len(), View.GetData());
+	}
+
+	TArray<TSharedPtr<FJsonValue>> ToJson(const FVector& Vector)
+	{
+		return { MakeShared<FJsonValueNumber>(Vector.X), MakeShared<FJsonValueNumber>(Vector.Y), MakeShared<FJsonValueNumber>(Vector.Z) };
+	}
+
+	bool ParseOperations(const FString& List, ESceneOperation& OutOperations)
+	{
+		TArray<FString> Names;
+		List.ParseIntoArray(Names, TEXT(","));
+		for (const FString& Name : Names)
+		{
+			if (Name == TEXT("stats"))
+			{
+				OutOperations |= ESceneOperation::Stats;
+			}
+			else if (Name == TEXT("validate"))
+			{
+				OutOperations |= ESceneOperation::Validate;
+			}
+			else if (Name == TEXT("convert"))
+			{
+				OutOperations |= ESceneOperation::Convert;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		return OutOperations != ESceneOperation::None;
+	}
+
+	void FindInputs(const FString& Input, FCommandletSettings& Settings, TArray<FString>& OutFilenames)
+	{
+		IFileManager& FileManager = IFileManager::Get();
+		if (!FileManager.DirectoryExists(*Input))
+		{
+			Settings.InputDirectory = FPaths::GetPath(Input);
+			OutFilenames.Add(Input);
+			return;
+		}
+
+		Settings.InputDirectory = Input;
+		TArray<FString> Scenes;
+		TArray<FString> Journals;
+		FileManager.FindFilesRecursive(Scenes, *Input, *(FString(TEXT("*")) + TruScene::Extension), /*Files*/ true, /*Directories*/ false);
+		FileManager.FindFilesRecursive(Journals, *Input, *(FString(TEXT("*")) + TruJournal::Extension), /*Files*/ true, /*Directories*/ false);
+
+		// An autosave snapshot on its own is out of date; its journal brings it up to date
+		TSet<FString> Snapshots;
+		for (const FString& Journal : Journals)
+		{
+			Snapshots.Add(FPaths::ChangeExtension(Journal, TruScene::Extension));
+		}
+		for (const FString& Scene : Scenes)
+		{
+			if (!Snapshots.Contains(Scene))
+			{
+				OutFilenames.Add(Scene);
+			}
+		}
+		OutFilenames.Append(Journals);
+
+		if (Settings.bPlacements)
+		{
+			FileManager.FindFilesRecursive(OutFilenames, *Input, TEXT("*.jsonl"), /*Files*/ true, /*Directories*/ false, /*bClearFileNames*/ false);
+			FileManager.FindFilesRecursive(OutFilenames, *Input, TEXT("*.csv"), /*Files*/ true, /*Directories*/ false, /*bClearFileNames*/ false);
+		}
+		OutFilenames.Sort();
+	}
+
+	/** Builds a scene from a placement file. Parents are matched by name once every row has been read. */
+	bool ReadPlacements(FSceneInput& Input)
+	{
+		FTruPlacementReader Reader;
+		if (!Reader.Open(Input.Filename, &Input.Error))
+		{
+			return false;
+		}
+
+		FTruSceneFileWriter Writer;
+		TMap<FName, int32> Indices;
+		TArray<TPair<int32, FName>> Parents;
+		TArray<int32> Lines;
+		TArray<FTruPlacementRow> Rows;
+		while (!Reader.IsAtEnd())
+		{
+			Reader.ReadRows(RowsPerRead, Rows);
+			for (const FTruPlacementRow& Row : Rows)
+			{
+				const FName Name = Row.GetName();
+				const int32 ObjectIndex = Writer.AddObject(Name.IsNone() ? FString() : Name.ToString(), Writer.AddClass(Row.GetClass()), Row.Transform, INDEX_NONE);
+				Indices.FindOrAdd(Name, ObjectIndex);
+				Lines.Add(Row.Line);
+
+				const FName Parent = Row.GetParent();
+				if (!Parent.IsNone())
+				{
+					Parents.Emplace(ObjectIndex, Parent);
+				}
+			}
+		}
+
+		Input.NumReadErrors = Reader.GetNumErrors();
+		Input.ReadErrors = Reader.GetErrors();
+		for (const TPair<int32, FName>& Parent : Parents)
+		{
+			if (const int32* ParentIndex = Indices.Find(Parent.Value))
+			{
+				Writer.SetParent(Parent.Key, *ParentIndex);
+			}
+			else
+			{
+				++Input.NumReadErrors;
+				Input.ReadErrors.Add(FString::Printf(TEXT("Line %d: Unknown parent %s"), Lines[Parent.Key], *Parent.Value.ToString()));
+			}
+		}
+
+		TArray<uint8> Bytes;
+		Writer.WriteTo(Bytes);
+		return Input.Reader.OpenFromMemory(MoveTemp(Bytes), &Input.Error);
+	}
+
+	void OpenInput(FSceneInput& Input)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		Input.FileSize = IFileManager::Get().FileSize(*Input.Filename);
+
+		ETruPlacementFormat PlacementFormat;
+		if (TruPlacement::GetFormat(Input.Filename, PlacementFormat))
+		{
+			ReadPlacements(Input);
+		}
+		else if (FPaths::GetExtension(Input.Filename, /*bIncludeDot*/ true) == TruJournal::Extension)
+		{
+			FTruAutosaveState State;
+			if (State.Load(FPaths::ChangeExtension(Input.Filename, TruScene::Extension), Input.Filename, &Input.Error))
+			{
+				FTruSceneFileWriter Writer;
+				State.WriteTo(Writer);
+				TArray<uint8> Bytes;
+				Writer.WriteTo(Bytes);
+				Input.Reader.OpenFromMemory(MoveTemp(Bytes), &Input.Error);
+			}
+		}
+		else
+		{
+			Input.Reader.Open(Input.Filename, &Input.Error);
+		}
+
+		Input.OpenMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+	}
+
+	/**
+	 * Class paths of one input, read ahead of the main pass so their classes can be loaded on the game thread. A scene
+	 * file is closed again as soon as its class table has been read, so no more than one per worker is open at a time.
+	 */
+	void ReadClassPaths(FSceneInput& Input)
+	{
+		ETruPlacementFormat PlacementFormat;
+		if (TruPlacement::GetFormat(Input.Filename, PlacementFormat))
+		{
+			// Rows are only scanned for their class here; parents and read errors are left to the main pass
+			FTruPlacementReader Reader;
+			if (!Reader.Open(Input.Filename, &Input.Error))
+			{
+				return;
+			}
+
+			TSet<FString> ClassPaths;
+			TArray<FTruPlacementRow> Rows;
+			while (!Reader.IsAtEnd())
+			{
+				Reader.ReadRows(RowsPerRead, Rows);
+				for (const FTruPlacementRow& Row : Rows)
+				{
+					ClassPaths.Add(Row.GetClass());
+				}
+			}
+			Input.ClassPaths = ClassPaths.Array();
+			return;
+		}
+
+		// Class entries that only prefab records use are prefab names
+		OpenInput(Input);
+		TBitArray<> UsedByObjects(false, Input.Reader.GetNumClasses());
+		for (int32 ObjectIndex = 0; ObjectIndex < Input.Reader.GetNumObjects(); ++ObjectIndex)
+		{
+			const FTruSceneObjectRecord& Record = Input.Reader.GetObject(ObjectIndex);
+			UsedByObjects[Record.ClassIndex] |= !Record.IsPrefabRecord();
+		}
+		for (int32 ClassIndex = 0; ClassIndex < Input.Reader.GetNumClasses(); ++ClassIndex)
+		{
+			if (UsedByObjects[ClassIndex])
+			{
+				Input.ClassPaths.Add(ToString(Input.Reader.GetClassPath(ClassIndex)));
+			}
+		}
+		Input.Reader.Close();
+	}
+
+	FClassInfo ResolveClass(const FString& ClassPath)
+	{
+		FClassInfo Info;
+		// Placement files may name a class instead of spelling out its path
+		Info.Class = ClassPath.Contains(TEXT("/")) ? FSoftClassPath(ClassPath).TryLoadClass<ATruGameObject>() : FindFirstObject<UClass>(*ClassPath, EFindFirstObjectOptions::NativeFirst);
+		if (Info.Class && !Info.Class->IsChildOf<ATruGameObject>())
+		{
+			Info.Class = nullptr;
+		}
+		if (!Info.Class)
+		{
+			return Info;
+		}
+
+		const ATruGameObject* DefaultObject = Info.Class->GetDefaultObject<ATruGameObject>();
+		const UStaticMeshComponent* MeshComponent = DefaultObject ? DefaultObject->GetMeshComponent() : nullptr;
+		if (const UStaticMesh* Mesh = MeshComponent ? MeshComponent->GetStaticMesh() : nullptr)
+		{
+			Info.LocalBounds = Mesh->GetBoundingBox().TransformBy(MeshComponent->GetRelativeTransform());
+		}
+		return Info;
+	}
+
+	/**
+	 * Hierarchy depth of every object, 0 for roots. Objects in a parent cycle, or below one, get INDEX_NONE
+	 * and each cycle is reported once.
+	 */
+	int32 ComputeDepths(const FTruSceneFileReader& Reader, TArray<int32>& OutDepths, FIssueList& Issues)
+	{
+		static constexpr int32 Unvisited = -2;
+		static constexpr int32 Visiting = -3;
+
+		const int32 NumObjects = Reader.GetNumObjects();
+		OutDepths.Init(Unvisited, NumObjects);
+
+		int32 MaxDepth = 0;
+		TArray<int32> Chain;
+		for (int32 StartIndex = 0; StartIndex < NumObjects; ++StartIndex)
+		{
+			Chain.Reset();
+			int32 Index = StartIndex;
+			while (Index != INDEX_NONE && OutDepths[Index] == Unvisited)
+			{
+				OutDepths[Index] = Visiting;
+				Chain.Add(Index);
+				Index = Reader.GetObject(Index).ParentIndex;
+			}
+
+			// The walk ended above a root, at an object resolved by an earlier walk, or back on its own chain
+			int32 Depth = INDEX_NONE;
+			if (Index != INDEX_NONE && OutDepths[Index] == Visiting)
+			{
+				Issues.Add(TEXT("ParentCycle"), Index);
+			}
+			else if (Index == INDEX_NONE || OutDepths[Index] != INDEX_NONE)
+			{
+				Depth = Index == INDEX_NONE ? 0 : OutDepths[Index] + 1;
+			}
+
+			for (int32 ChainIndex = Chain.Num() - 1; ChainIndex >= 0; --ChainIndex)
+			{
+				OutDepths[Chain[ChainIndex]] = Depth;
+				if (Depth != INDEX_NONE)
+				{
+					MaxDepth = FMath::Max(MaxDepth, Depth++);
+				}
+			}
+		}
+		return MaxDepth;
+	}
+
+	/**
+	 * Sweep along X over the world bounds: each box is only tested against the boxes whose X range it reaches into.
+	 * A parent and its direct child are expected to touch and are not reported.
+	 */
+	void FindOverlaps(const FTruSceneFileReader& Reader, TConstArrayView<FBox> Bounds, double Tolerance, FIssueList& Issues)
+	{
+		TArray<int32> Order;
+		Order.Reserve(Bounds.Num());
+		for (int32 Index = 0; Index < Bounds.Num(); ++Index)
+		{
+			if (Bounds[Index].IsValid)
+			{
+				Order.Add(Index);
+			}
+		}
+		Order.Sort([&Bounds](int32 A, int32 B) { return Bounds[A].Min.X < Bounds[B].Min.X; });
+
+		auto Overlaps = [Tolerance](const FBox& A, const FBox& B, int32 Axis)
+		{
+			return FMath::Min(A.Max[Axis], B.Max[Axis]) - FMath::Max(A.Min[Axis], B.Min[Axis]) > Tolerance;
+		};
+
+		TArray<int32> Active;
+		for (const int32 Index : Order)
+		{
+			const FBox& Box = Bounds[Index];
+			for (int32 ActiveIndex = Active.Num() - 1; ActiveIndex >= 0; --ActiveIndex)
+			{
+				const int32 Other = Active[ActiveIndex];
+				if (!Overlaps(Box, Bounds[Other], 0))
+				{
+					// Later boxes start further along X, so they cannot reach this one either
+					if (Bounds[Other].Max.X - Box.Min.X <= Tolerance)
+					{
+						Active.RemoveAtSwap(ActiveIndex, 1, EAllowShrinking::No);
+					}
+					continue;
+				}
+				if (Overlaps(Box, Bounds[Other], 1) && Overlaps(Box, Bounds[Other], 2)
+					&& Reader.GetObject(Index).ParentIndex != Other && Reader.GetObject(Other).ParentIndex != Index)
+				{
+					Issues.Add(TEXT("Overlap"), FMath::Min(Index, Other), FString(), FMath::Max(Index, Other));
+				}
+			}
+			Active.Add(Index);
+		}
+	}
+
+	void Analyze(FSceneInput& Input, const TMap<FString, FClassInfo>& ClassInfos, const FCommandletSettings& Settings)
+	{
+		const FTruSceneFileReader& Reader = Input.Reader;
+		const int32 NumObjects = Reader.GetNumObjects();
+
+		TArray<const FClassInfo*> Classes;
+		for (int32 ClassIndex = 0; ClassIndex < Reader.GetNumClasses(); ++ClassIndex)
+		{
+			Classes.Add(ClassInfos.Find(ToString(Reader.GetClassPath(ClassIndex))));
+		}
+
+		FIssueList Issues;
+		Issues.MaxIssues = Settings.MaxIssues;
+
+		TArray<int32> Depths;
+		const int32 MaxDepth = ComputeDepths(Reader, Depths, Issues);
+
+		TArray<int32> ClassCounts;
+		ClassCounts.SetNumZeroed(Classes.Num());
+		TArray<FBox> Bounds;
+		Bounds.Init(FBox(ForceInit), NumObjects);
+		FBox SceneBounds(ForceInit);
+		int32 NumRoots = 0;
+		int32 NumPrefabInstances = 0;
+
+		TMap<FName, int32> Names;
+		TMap<uint64, int32> Ids;
+		const bool bValidate = EnumHasAnyFlags(Settings.Operations, ESceneOperation::Validate);
+		if (bValidate)
+		{
+			Names.Reserve(NumObjects);
+			Ids.Reserve(NumObjects);
+		}
+
+		for (int32 ObjectIndex = 0; ObjectIndex < NumObjects; ++ObjectIndex)
+		{
+			const FTruSceneObjectRecord& Record = Reader.GetObject(ObjectIndex);
+			const FTransform Transform = Record.GetTransform();
+			const FClassInfo* Class = Classes[Record.ClassIndex];
+
+			// Prefab instances only show as their count; their parts are in the prefab files, which are not read here
+			if (Record.IsPrefabRecord())
+			{
+				NumPrefabInstances += (Record.Flags & TruScene::PrefabInstance) != 0 ? 1 : 0;
+				continue;
+			}
+
+			++ClassCounts[Record.ClassIndex];
+			NumRoots += Record.ParentIndex == INDEX_NONE ? 1 : 0;
+			if (Class && Class->LocalBounds.IsValid)
+			{
+				Bounds[ObjectIndex] = Class->LocalBounds.TransformBy(Transform);
+				SceneBounds += Bounds[ObjectIndex];
+			}
+			else
+			{
+				SceneBounds += Transform.GetLocation();
+			}
+
+			if (!bValidate)
+			{
+				continue;
+			}
+
+			const FString Name = ToString(Reader.GetObjectName(ObjectIndex));
+			if (Name.IsEmpty())
+			{
+				Issues.Add(TEXT("EmptyName"), ObjectIndex);
+			}
+			else if (!FName::IsValidXName(Name, INVALID_OBJECTNAME_CHARACTERS))
+			{
+				Issues.Add(TEXT("InvalidName"), ObjectIndex, Name);
+			}
+			else if (const int32* Other = Names.Find(FName(*Name)))
+			{
+				Issues.Add(TEXT("DuplicateName"), ObjectIndex, Name, *Other);
+			}
+			else
+			{
+				Names.Add(FName(*Name), ObjectIndex);
+			}
+
+			if (Record.ObjectId == 0)
+			{
+				Issues.Add(TEXT("MissingId"), ObjectIndex);
+			}
+			else if (const int32* Other = Ids.Find(Record.ObjectId))
+			{
+				Issues.Add(TEXT("DuplicateId"), ObjectIndex, LexToString(Record.ObjectId), *Other);
+			}
+			else
+			{
+				Ids.Add(Record.ObjectId, ObjectIndex);
+			}
+
+			if (!Class || !Class->Class)
+			{
+				Issues.Add(TEXT("UnknownClass"), ObjectIndex, ToString(Reader.GetClassPath(Record.ClassIndex)));
+			}
+			if (Transform.ContainsNaN() || Transform.GetScale3D().GetAbsMin() < UE_KINDA_SMALL_NUMBER)
+			{
+				Issues.Add(TEXT("InvalidTransform"), ObjectIndex, Transform.ToString());
+			}
+		}
+
+		if (bValidate)
+		{
+			FindOverlaps(Reader, Bounds, Settings.OverlapTolerance, Issues);
+		}
+
+		FJsonObject& Result = *Input.Result;
+		Result.SetNumberField(TEXT("objects"), NumObjects);
+		if (EnumHasAnyFlags(Settings.Operations, ESceneOperation::Stats))
+		{
+			Result.SetNumberField(TEXT("version"), Reader.GetVersion());
+			Result.SetNumberField(TEXT("bytes"), Input.FileSize);
+			Result.SetNumberField(TEXT("openMs"), Input.OpenMs);
+			Result.SetNumberField(TEXT("roots"), NumRoots);
+			Result.SetNumberField(TEXT("maxDepth"), MaxDepth);
+			Result.SetNumberField(TEXT("prefabInstances"), NumPrefabInstances);
+
+			TArray<TSharedPtr<FJsonValue>> ClassStats;
+			for (int32 ClassIndex = 0; ClassIndex < Classes.Num(); ++ClassIndex)
+			{
+				// Prefab names, used by prefab records only
+				if (ClassCounts[ClassIndex] == 0 && !Classes[ClassIndex])
+				{
+					continue;
+				}
+
+				TSharedRef<FJsonObject> ClassStat = MakeShared<FJsonObject>();
+				ClassStat->SetStringField(TEXT("path"), ToString(Reader.GetClassPath(ClassIndex)));
+				ClassStat->SetNumberField(TEXT("objects"), ClassCounts[ClassIndex]);
+				ClassStat->SetBoolField(TEXT("resolved"), Classes[ClassIndex] && Classes[ClassIndex]->Class);
+				ClassStats.Add(MakeShared<FJsonValueObject>(ClassStat));
+			}
+			Result.SetArrayField(TEXT("classes"), ClassStats);
+
+			if (SceneBounds.IsValid)
+			{
+				TSharedRef<FJsonObject> BoundsObject = MakeShared<FJsonObject>();
+				BoundsObject->SetArrayField(TEXT("min"), ToJson(SceneBounds.Min));
+				BoundsObject->SetArrayField(TEXT("max"), ToJson(SceneBounds.Max));
+				Result.SetObjectField(TEXT("bounds"), BoundsObject);
+			}
+		}
+		if (bValidate)
+		{
+			Result.SetNumberField(TEXT("numIssues"), Issues.Num);
+			Result.SetArrayField(TEXT("issues"), Issues.Listed);
+			Input.NumIssues = Issues.Num;
+		}
+		if (Input.NumReadErrors > 0)
+		{
+			TArray<TSharedPtr<FJsonValue>> ReadErrors;
+			for (const FString& ReadError : Input.ReadErrors)
+			{
+				ReadErrors.Add(MakeShared<FJsonValueString>(ReadError));
+			}
+			Result.SetNumberField(TEXT("numReadErrors"), Input.NumReadErrors);
+			Result.SetArrayField(TEXT("readErrors"), ReadErrors);
+			Input.NumIssues += bValidate ? Input.NumReadErrors : 0;
+		}
+	}
+
+	bool WritePlacements(const FTruSceneFileReader& Reader, const FString& Filename)
+	{
+		FTruPlacementWriter Writer;
+		if (!Writer.Open(Filename))
+		{
+			return false;
+		}
+
+		TArray<FString> ClassPaths;
+		for (int32 ClassIndex = 0; ClassIndex < Reader.GetNumClasses(); ++ClassIndex)
+		{
+			ClassPaths.Add(ToString(Reader.GetClassPath(ClassIndex)));
+		}
+		// Placement rows have no way to refer to a prefab, so instances are left out
+		for (int32 ObjectIndex = 0; ObjectIndex < Reader.GetNumObjects(); ++ObjectIndex)
+		{
+			const FTruSceneObjectRecord& Record = Reader.GetObject(ObjectIndex);
+			if (Record.IsPrefabRecord())
+			{
+				continue;
+			}
+			const FString Parent = Record.ParentIndex == INDEX_NONE ? FString() : ToString(Reader.GetObjectName(Record.ParentIndex));
+			Writer.WriteRow(ClassPaths[Record.ClassIndex], ToString(Reader.GetObjectName(ObjectIndex)), Parent, Record.GetTransform());
+		}
+		return Writer.Close();
+	}
+
+	bool WriteScene(const FTruSceneFileReader& Reader, const FString& Filename)
+	{
+		FTruSceneFileWriter Writer;
+		TArray<int32> WriterClasses;
+		for (int32 ClassIndex = 0; ClassIndex < Reader.GetNumClasses(); ++ClassIndex)
+		{
+			WriterClasses.Add(Writer.AddClass(ToString(Reader.GetClassPath(ClassIndex))));
+		}
+		for (int32 ObjectIndex = 0; ObjectIndex < Reader.GetNumObjects(); ++ObjectIndex)
+		{
+			const FTruSceneObjectRecord& Record = Reader.GetObject(ObjectIndex);
+			Writer.AddObject(ToString(Reader.GetObjectName(ObjectIndex)), WriterClasses[Record.ClassIndex], Record.GetTransform(), Record.ParentIndex, Record.ObjectId, Record.Flags);
+		}
+		return Writer.SaveToFile(Filename);
+	}
+
+	void Convert(FSceneInput& Input, const FCommandletSettings& Settings)
+	{
+		FString RelativePath = Input.Filename;
+		FPaths::MakePathRelativeTo(RelativePath, *(Settings.InputDirectory / TEXT("")));
+		const FString OutputFilename = FPaths::Combine(Settings.OutputDirectory, FPaths::ChangeExtension(RelativePath, Settings.Format));
+
+		// The input may be the output and still be mapped, so the new file is moved over it rather than written into it.
+		// The temporary file keeps the extension, which is what placement writers take the format from.
+		// Placement files do not keep object ids, so converting to them and back gives the objects new ones.
+		const FString TempFilename = FPaths::ChangeExtension(OutputFilename, TEXT("tmp.") + Settings.Format);
+		const bool bWritten = Settings.Format == TEXT("truscene") ? WriteScene(Input.Reader, TempFilename) : WritePlacements(Input.Reader, TempFilename);
+		if (!bWritten || !IFileManager::Get().Move(*OutputFilename, *TempFilename, /*bReplace*/ true))
+		{
+			Input.Error = FString::Printf(TEXT("Could not write %s"), *OutputFilename);
+			return;
+		}
+		Input.Result->SetStringField(TEXT("output"), OutputFilename);
+	}
+}
+
+UTruSceneCommandlet::UTruSceneCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	// Stdout carries the JSON report and nothing else; the log still gets everything
+	LogToConsole = false;
+	ShowErrorCount = false;
+}
+
+int32 UTruSceneCommandlet::Main(const FString& Params)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	FCommandletSettings Settings;
+	FString OperationList;
+	FString Input;
+	FString ReportFilename;
+	FParse::Value(*Params, TEXT("op="), OperationList);
+	FParse::Value(*Params, TEXT("in="), Input);
+	FParse::Value(*Params, TEXT("out="), Settings.OutputDirectory);
+	FParse::Value(*Params, TEXT("format="), Settings.Format);
+	FParse::Value(*Params, TEXT("report="), ReportFilename);
+	FParse::Value(*Params, TEXT("overlaptolerance="), Settings.OverlapTolerance);
+	FParse::Value(*Params, TEXT("maxissues="), Settings.MaxIssues);
+	Settings.bPlacements = FParse::Param(*Params, TEXT("placements"));
+
+	const bool bConvert = OperationList.Contains(TEXT("convert"));
+	if (!ParseOperations(OperationList, Settings.Operations) || Input.IsEmpty()
+		|| (bConvert && (Settings.OutputDirectory.IsEmpty() || (Settings.Format != TEXT("truscene") && Settings.Format != TEXT("jsonl") && Settings.Format != TEXT("csv")))))
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s"), Usage);
+		return ExitCode::Error;
+	}
+
+	FPaths::NormalizeFilename(Input);
+	FPaths::NormalizeDirectoryName(Settings.OutputDirectory);
+
+	TArray<FString> Filenames;
+	FindInputs(Input, Settings, Filenames);
+
+	TArray<TUniquePtr<FSceneInput>> Inputs;
+	for (const FString& Filename : Filenames)
+	{
+		TUniquePtr<FSceneInput>& SceneInput = Inputs.Add_GetRef(MakeUnique<FSceneInput>());
+		SceneInput->Filename = Filename;
+	}
+
+	ParallelFor(Inputs.Num(), [&Inputs](int32 Index)
+	{
+		ReadClassPaths(*Inputs[Index]);
+	});
+
+	// Loading classes has to happen here on the game thread; the workers only look them up
+	TMap<FString, FClassInfo> ClassInfos;
+	for (const TUniquePtr<FSceneInput>& SceneInput : Inputs)
+	{
+		for (const FString& ClassPath : SceneInput->ClassPaths)
+		{
+			if (!ClassInfos.Contains(ClassPath))
+			{
+				ClassInfos.Add(ClassPath, ResolveClass(ClassPath));
+			}
+		}
+		SceneInput->ClassPaths.Empty();
+	}
+
+	// Each file is opened, processed and closed by one task, so only as many are open as there are workers
+	ParallelFor(Inputs.Num(), [&Inputs, &ClassInfos, &Settings](int32 Index)
+	{
+		FSceneInput& SceneInput = *Inputs[Index];
+		if (!SceneInput.Error.IsEmpty())
+		{
+			return;
+		}
+
+		OpenInput(SceneInput);
+		if (!SceneInput.Reader.IsOpen())
+		{
+			return;
+		}
+
+		if (EnumHasAnyFlags(Settings.Operations, ESceneOperation::Stats | ESceneOperation::Validate))
+		{
+			Analyze(SceneInput, ClassInfos, Settings);
+		}
+		if (EnumHasAnyFlags(Settings.Operations, ESceneOperation::Convert))
+		{
+			Convert(SceneInput, Settings);
+		}
+
+		SceneInput.Reader.Close();
+	});
+
+	int32 NumFailed = 0;
+	int32 NumInvalid = 0;
+	TArray<TSharedPtr<FJsonValue>> FileResults;
+	for (const TUniquePtr<FSceneInput>& SceneInput : Inputs)
+	{
+		SceneInput->Result->SetStringField(TEXT("file"), SceneInput->Filename);
+		if (!SceneInput->Error.IsEmpty())
+		{
+			SceneInput->Result->SetStringField(TEXT("error"), SceneInput->Error);
+			UE_LOG(LogTemp, Warning, TEXT("%s: %s"), *SceneInput->Filename, *SceneInput->Error);
+			++NumFailed;
+		}
+		NumInvalid += SceneInput->NumIssues > 0 ? 1 : 0;
+		FileResults.Add(MakeShared<FJsonValueObject>(SceneInput->Result));
+	}
+
+	const int32 Code = NumFailed > 0 || Inputs.Num() == 0 ? ExitCode::Error : NumInvalid > 0 ? ExitCode::ValidationFailed : ExitCode::Success;
+
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetStringField(TEXT("operations"), OperationList);
+	Report->SetNumberField(TEXT("exitCode"), Code);
+	Report->SetNumberField(TEXT("files"), Inputs.Num());
+	Report->SetNumberField(TEXT("failed"), NumFailed);
+	Report->SetNumberField(TEXT("invalid"), NumInvalid);
+	Report->SetNumberField(TEXT("seconds"), FPlatformTime::Seconds() - StartTime);
+	Report->SetArrayField(TEXT("results"), FileResults);
+
+	FString Json;
+	const TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> JsonWriter = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Json);
+	FJsonSerializer::Serialize(Report, JsonWriter);
+
+	if (ReportFilename.IsEmpty())
+	{
+		FPlatformMisc::LocalPrint(*(Json + TEXT("\n")));
+	}
+	else if (!FFileHelper::SaveStringToFile(Json, *ReportFilename, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not write report %s"), *ReportFilename);
+		return ExitCode::Error;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("%d scene files, %d could not be processed, %d failed validation, in %.2f s"),
+		Inputs.Num(), NumFailed, NumInvalid, FPlatformTime::Seconds() - StartTime);
+	return Code;
+}
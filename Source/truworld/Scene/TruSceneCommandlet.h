@@ -0,0 +1,40 @@
+// TruSceneCommandlet.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "TruSceneCommandlet.generated.h"
+
+/**
+ * Batch operations on scene files for build agents, without the editor map or a renderer:
+ *
+ *   UnrealEditor-Cmd truworld.uproject -run=TruScene -nullrhi -op=<stats,validate,convert> -in=<file or directory>
+ *       [-out=<directory>] [-format=<truscene,jsonl,csv>] [-placements] [-report=<file>] [-overlaptolerance=<units>]
+ *       [-maxissues=<count>]
+ *
+ * -op takes one operation or a comma separated list:
+ *  - stats: object, root, class and prefab instance counts, hierarchy depth and bounds.
+ *  - validate: empty, invalid and duplicate names, missing and duplicate ids, unknown classes, parent cycles, broken
+ *    transforms, and objects whose bounds overlap by more than -overlaptolerance on every axis. Prefab instances are
+ *    not checked, as their parts are only known from the prefab files.
+ *  - convert: writes each scene to -out in -format, keeping its path relative to -in. Placement files cannot refer to a
+ *    prefab, so prefab instances are left out of them.
+ *
+ * Inputs are .truscene files, autosave journals, which are replayed onto the snapshot next to them, and placement files
+ * (.jsonl and .csv, see TruPlacementFile.h). A directory is searched recursively, for placement files only with
+ * -placements, and a snapshot with a journal next to it is only read through the journal. Files are processed
+ * in parallel. The results are one JSON document, written to -report or printed to stdout, which carries nothing else;
+ * log output only goes to the log file. The exit code is 0 when every file passed, 1 when any failed validation and 2
+ * when the arguments were wrong or a file could not be read or written.
+ */
+UCLASS()
+class TRUWORLD_API UTruSceneCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UTruSceneCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
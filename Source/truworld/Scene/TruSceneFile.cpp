@@ -0,0 +1,478 @@
+// TruSceneFile.cpp
+
+#include "TruSceneFile.h"
+
+#include "Async/MappedFileHandle.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "truworld/GameObjects/TruEntityStore.h"
+#include "truworld/GameObjects/TruGameObject.h"
+#include "truworld/GameObjects/TruGameObjectPool.h"
+#include "truworld/GameObjects/TruPrefab.h"
+#include "truworld/GameObjects/TruSpawnQueue.h"
+
+FTransform FTruSceneObjectRecord::GetTransform() const
+{
+	return FTransform(
+		FQuat(Rotation[0], Rotation[1], Rotation[2], Rotation[3]),
+		FVector(Location[0], Location[1], Location[2]),
+		FVector(Scale[0], Scale[1], Scale[2]));
+}
+
+void FTruSceneObjectRecord::SetTransform(const FTransform& Transform)
+{
+	const FVector T = Transform.GetLocation();
+	const FQuat R = Transform.GetRotation();
+	const FVector S = Transform.GetScale3D();
+
+	Location[0] = T.X; Location[1] = T.Y; Location[2] = T.Z;
+	Rotation[0] = R.X; Rotation[1] = R.Y; Rotation[2] = R.Z; Rotation[3] = R.W;
+	Scale[0] = S.X; Scale[1] = S.Y; Scale[2] = S.Z;
+}
+
+// --- Writer ---
+
+int32 FTruSceneFileWriter::AddClass(const FString& ClassPath)
+{
+	if (const int32* Existing = ClassIndices.Find(ClassPath))
+	{
+		return *Existing;
+	}
+
+	const int32 ClassIndex = Classes.Add(AddString(ClassPath));
+	ClassIndices.Add(ClassPath, ClassIndex);
+	return ClassIndex;
+}
+
+int32 FTruSceneFileWriter::AddObject(const FString& Name, int32 ClassIndex, const FTransform& Transform, int32 ParentIndex, uint64 ObjectId, uint32 Flags)
+{
+	check(Classes.IsValidIndex(ClassIndex));
+
+	FTruSceneObjectRecord& Record = Objects.AddZeroed_GetRef();
+	Record.SetTransform(Transform);
+	Record.Name = AddString(Name);
+	Record.ClassIndex = ClassIndex;
+	Record.ParentIndex = ParentIndex;
+	Record.Flags = Flags;
+	Record.ObjectId = ObjectId;
+	return Objects.Num() - 1;
+}
+
+FTruSceneStringRef FTruSceneFileWriter::AddString(const FString& String)
+{
+	FTCHARToUTF8 Utf8(*String, String.Len());
+
+	FTruSceneStringRef Ref;
+	Ref.Offset = Strings.Num();
+	Ref.Length = Utf8.Length();
+	Strings.Append(reinterpret_cast<const UTF8CHAR*>(Utf8.Get()), Utf8.Length());
+	return Ref;
+}
+
+void FTruSceneFileWriter::WriteTo(TArray<uint8>& OutBytes) const
+{
+	FTruSceneHeader Header;
+	Header.NumClasses = Classes.Num();
+	Header.NumObjects = Objects.Num();
+	Header.ClassTableOffset = Align(sizeof(FTruSceneHeader), 8);
+	Header.ObjectTableOffset = Align(Header.ClassTableOffset + Classes.Num() * sizeof(FTruSceneStringRef), 8);
+	Header.StringTableOffset = Align(Header.ObjectTableOffset + Objects.Num() * sizeof(FTruSceneObjectRecord), 8);
+	Header.StringTableSize = Strings.Num();
+
+	OutBytes.Reset();
+	OutBytes.AddZeroed(Header.StringTableOffset + Header.StringTableSize);
+
+	FMemory::Memcpy(OutBytes.GetData(), &Header, sizeof(Header));
+	FMemory::Memcpy(OutBytes.GetData() + Header.ClassTableOffset, Classes.GetData(), Classes.Num() * sizeof(FTruSceneStringRef));
+	FMemory::Memcpy(OutBytes.GetData() + Header.ObjectTableOffset, Objects.GetData(), Objects.Num() * sizeof(FTruSceneObjectRecord));
+	FMemory::Memcpy(OutBytes.GetData() + Header.StringTableOffset, Strings.GetData(), Strings.Num());
+}
+
+bool FTruSceneFileWriter::SaveToFile(const FString& Filename) const
+{
+	TArray<uint8> Bytes;
+	WriteTo(Bytes);
+	return FFileHelper::SaveArrayToFile(Bytes, *Filename);
+}
+
+// --- Reader ---
+
+FTruSceneFileReader::FTruSceneFileReader() = default;
+
+FTruSceneFileReader::~FTruSceneFileReader()
+{
+	Close();
+}
+
+bool FTruSceneFileReader::Open(const FString& Filename, FString* OutError)
+{
+	Close();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	MappedFile.Reset(PlatformFile.OpenMapped(*Filename));
+	if (MappedFile)
+	{
+		MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	}
+
+	if (MappedRegion)
+	{
+		Data = MappedRegion->GetMappedPtr();
+		Size = MappedRegion->GetMappedSize();
+	}
+	else
+	{
+		// Platforms without mapped file support read the file in one go instead
+		MappedFile.Reset();
+		if (!FFileHelper::LoadFileToArray(OwnedBytes, *Filename, FILEREAD_Silent))
+		{
+			if (OutError)
+			{
+				*OutError = FString::Printf(TEXT("Could not open %s"), *Filename);
+			}
+			return false;
+		}
+		Data = OwnedBytes.GetData();
+		Size = OwnedBytes.Num();
+	}
+
+	return Validate(OutError);
+}
+
+bool FTruSceneFileReader::OpenFromMemory(TArray<uint8>&& Bytes, FString* OutError)
+{
+	Close();
+
+	OwnedBytes = MoveTemp(Bytes);
+	Data = OwnedBytes.GetData();
+	Size = OwnedBytes.Num();
+	return Validate(OutError);
+}
+
+void FTruSceneFileReader::Close()
+{
+	// The region has to go before the handle it was mapped from
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	OwnedBytes.Empty();
+	UpgradedObjects.Empty();
+
+	Data = nullptr;
+	Size = 0;
+	Header = nullptr;
+	Classes = nullptr;
+	Objects = nullptr;
+	Strings = nullptr;
+}
+
+FUtf8StringView FTruSceneFileReader::GetString(const FTruSceneStringRef& Ref) const
+{
+	return FUtf8StringView(Strings + Ref.Offset, Ref.Length);
+}
+
+bool FTruSceneFileReader::Validate(FString* OutError)
+{
+	auto Fail = [this, OutError](const TCHAR* Reason)
+	{
+		if (OutError)
+		{
+			*OutError = Reason;
+		}
+		Close();
+		return false;
+	};
+
+	if (Size < (int64)sizeof(FTruSceneHeader))
+	{
+		return Fail(TEXT("File is too small to be a scene"));
+	}
+
+	const FTruSceneHeader* FileHeader = reinterpret_cast<const FTruSceneHeader*>(Data);
+	if (FileHeader->Magic != TruScene::Magic)
+	{
+		return Fail(TEXT("Not a scene file"));
+	}
+	if (FileHeader->Version < 1 || FileHeader->Version > TruScene::Version)
+	{
+		return Fail(TEXT("Unsupported scene file version"));
+	}
+
+	// Version 1 records are version 2 records without the trailing ObjectId
+	const uint64 RecordSize = FileHeader->Version == 1 ? offsetof(FTruSceneObjectRecord, ObjectId) : sizeof(FTruSceneObjectRecord);
+
+	// Offsets are checked against the size before a table size is added, so a crafted one cannot wrap back into range
+	auto FitsInFile = [this](uint64 Offset, uint64 TableSize)
+	{
+		return Offset <= (uint64)Size && TableSize <= (uint64)Size - Offset;
+	};
+	if (!FitsInFile(FileHeader->ClassTableOffset, (uint64)FileHeader->NumClasses * sizeof(FTruSceneStringRef))
+		|| !FitsInFile(FileHeader->ObjectTableOffset, (uint64)FileHeader->NumObjects * RecordSize)
+		|| !FitsInFile(FileHeader->StringTableOffset, FileHeader->StringTableSize)
+		|| !IsAligned(FileHeader->ClassTableOffset, 8) || !IsAligned(FileHeader->ObjectTableOffset, 8))
+	{
+		return Fail(TEXT("Scene tables are out of bounds"));
+	}
+
+	const FTruSceneStringRef* FileClasses = reinterpret_cast<const FTruSceneStringRef*>(Data + FileHeader->ClassTableOffset);
+	const FTruSceneObjectRecord* FileObjects = reinterpret_cast<const FTruSceneObjectRecord*>(Data + FileHeader->ObjectTableOffset);
+	if (FileHeader->Version == 1)
+	{
+		UpgradedObjects.SetNumZeroed(FileHeader->NumObjects);
+		for (uint32 ObjectIndex = 0; ObjectIndex < FileHeader->NumObjects; ++ObjectIndex)
+		{
+			FMemory::Memcpy(&UpgradedObjects[ObjectIndex], Data + FileHeader->ObjectTableOffset + ObjectIndex * RecordSize, RecordSize);
+		}
+		FileObjects = UpgradedObjects.GetData();
+	}
+
+	auto IsValidString = [FileHeader](const FTruSceneStringRef& Ref)
+	{
+		return (uint64)Ref.Offset + Ref.Length <= FileHeader->StringTableSize;
+	};
+
+	for (uint32 ClassIndex = 0; ClassIndex < FileHeader->NumClasses; ++ClassIndex)
+	{
+		if (!IsValidString(FileClasses[ClassIndex]))
+		{
+			return Fail(TEXT("Class path is out of bounds"));
+		}
+	}
+
+	// One pass up front so that readers never have to bounds check a record, or look for the instance of an override
+	for (uint32 ObjectIndex = 0; ObjectIndex < FileHeader->NumObjects; ++ObjectIndex)
+	{
+		const FTruSceneObjectRecord& Record = FileObjects[ObjectIndex];
+		if (!IsValidString(Record.Name) || Record.ClassIndex >= FileHeader->NumClasses
+			|| Record.ParentIndex < INDEX_NONE || Record.ParentIndex >= (int32)FileHeader->NumObjects)
+		{
+			return Fail(TEXT("Object record is corrupt"));
+		}
+		if ((Record.Flags & TruScene::PrefabOverride) != 0
+			&& (Record.ParentIndex == INDEX_NONE || (FileObjects[Record.ParentIndex].Flags & TruScene::PrefabInstance) == 0))
+		{
+			return Fail(TEXT("Prefab override has no instance"));
+		}
+	}
+
+	Header = FileHeader;
+	Classes = FileClasses;
+	Objects = FileObjects;
+	Strings = reinterpret_cast<const UTF8CHAR*>(Data + FileHeader->StringTableOffset);
+	return true;
+}
+
+// --- World ---
+
+FString FTruSceneFile::GetSceneDirectory()
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Scenes"));
+}
+
+FString FTruSceneFile::ResolveScenePath(const FString& SceneName)
+{
+	FString Path = SceneName;
+	if (FPaths::GetExtension(Path).IsEmpty())
+	{
+		Path += TruScene::Extension;
+	}
+	if (FPaths::IsRelative(Path))
+	{
+		Path = FPaths::Combine(GetSceneDirectory(), Path);
+	}
+	return Path;
+}
+
+void FTruSceneFile::WriteWorld(UWorld* World, FTruSceneFileWriter& Writer)
+{
+	if (!World)
+	{
+		return;
+	}
+
+	// Parts of open prefab instances are saved with their instance below
+	const UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(World);
+	TArray<ATruGameObject*> GameObjects;
+	TMap<ATruGameObject*, int32> ObjectIndices;
+	for (TActorIterator<ATruGameObject> It(World); It; ++It)
+	{
+		if (It->IsPooled() || (PrefabLibrary && PrefabLibrary->IsOpenPart(*It)))
+		{
+			continue;
+		}
+		ObjectIndices.Add(*It, GameObjects.Add(*It));
+	}
+
+	for (ATruGameObject* GameObject : GameObjects)
+	{
+		const int32* ParentIndex = ObjectIndices.Find(GameObject->GetParentGameObject());
+		Writer.AddObject(
+			GameObject->GetName(),
+			Writer.AddClass(GameObject->GetClass()->GetPathName()),
+			GameObject->GetActorTransform(),
+			ParentIndex ? *ParentIndex : INDEX_NONE,
+			GameObject->GetObjectId().Value);
+	}
+
+	// Entities are always roots; demotion skips anything with a parent or children
+	if (const UTruEntityStore* EntityStore = UTruEntityStore::Get(World))
+	{
+		for (const FTruEntityBatch& Batch : EntityStore->GetBatches())
+		{
+			if (!Batch.Class)
+			{
+				continue;
+			}
+			const int32 ClassIndex = Writer.AddClass(Batch.Class->GetPathName());
+			for (const FTruEntity& Entity : Batch.Entities)
+			{
+				Writer.AddObject(Entity.Name.ToString(), ClassIndex, Entity.GetTransform(), INDEX_NONE, Entity.Id.Value);
+			}
+		}
+	}
+
+	if (PrefabLibrary)
+	{
+		PrefabLibrary->WriteInstances(Writer);
+	}
+}
+
+bool FTruSceneFile::SaveWorld(UWorld* World, const FString& Filename)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	FTruSceneFileWriter Writer;
+	WriteWorld(World, Writer);
+	if (!Writer.SaveToFile(Filename))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not write scene %s"), *Filename);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Saved %d objects to %s in %.2f ms"), Writer.GetNumObjects(), *Filename, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	return true;
+}
+
+int32 FTruSceneFile::SpawnIntoWorld(UWorld* World, const FTruSceneFileReader& Reader, AActor* Owner)
+{
+	if (!World || !Reader.IsOpen())
+	{
+		return 0;
+	}
+
+	const TArray<UClass*> ResolvedClasses = ResolveClasses(Reader);
+
+	// Prefab records resolve to no class and are skipped below
+	int32 NumSpawned = 0;
+	if (UTruPrefabLibrary* PrefabLibrary = UTruPrefabLibrary::Get(World))
+	{
+		NumSpawned += PrefabLibrary->ReadInstances(Reader);
+	}
+
+	TArray<ATruGameObject*> Spawned;
+	Spawned.SetNumZeroed(Reader.GetNumObjects());
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Owner = Owner;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParams.NameMode = FActorSpawnParameters::ESpawnActorNameMode::Requested;
+
+	for (int32 ObjectIndex = 0; ObjectIndex < Reader.GetNumObjects(); ++ObjectIndex)
+	{
+		const FTruSceneObjectRecord& Record = Reader.GetObject(ObjectIndex);
+		UClass* Class = Record.IsPrefabRecord() ? nullptr : ResolvedClasses[Record.ClassIndex];
+		if (!Class)
+		{
+			continue;
+		}
+
+		const FUtf8StringView Name = Reader.GetObjectName(ObjectIndex);
+		SpawnParams.Name = FName(Name.Len(), Name.GetData());
+
+		Spawned[ObjectIndex] = UTruGameObjectPool::SpawnGameObject(World, Class, Record.GetTransform(), SpawnParams, FTruObjectId(Record.ObjectId));
+		NumSpawned += Spawned[ObjectIndex] ? 1 : 0;
+	}
+
+	// Parents can come after their children in the table, so the hierarchy is restored in a second pass
+	for (int32 ObjectIndex = 0; ObjectIndex < Reader.GetNumObjects(); ++ObjectIndex)
+	{
+		const int32 ParentIndex = Reader.GetObject(ObjectIndex).ParentIndex;
+		if (Spawned[ObjectIndex] && ParentIndex != INDEX_NONE && Spawned[ParentIndex])
+		{
+			Spawned[ObjectIndex]->SetParentGameObject(Spawned[ParentIndex]);
+		}
+	}
+
+	return NumSpawned;
+}
+
+int32 FTruSceneFile::LoadIntoWorld(UWorld* World, const FString& Filename, AActor* Owner)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	FTruSceneFileReader Reader;
+	FString Error;
+	if (!Reader.Open(Filename, &Error))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not load scene %s: %s"), *Filename, *Error);
+		return 0;
+	}
+
+	const int32 NumSpawned = SpawnIntoWorld(World, Reader, Owner);
+	UE_LOG(LogTemp, Log, TEXT("Loaded %d objects from %s in %.2f ms"), NumSpawned, *Filename, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	return NumSpawned;
+}
+
+void FTruSceneFile::MakeSpawnRequests(const FTruSceneFileReader& Reader, TArray<FTruSpawnRequest>& OutRequests)
+{
+	const TArray<UClass*> ResolvedClasses = ResolveClasses(Reader);
+
+	OutRequests.Reset(Reader.GetNumObjects());
+	for (int32 ObjectIndex = 0; ObjectIndex < Reader.GetNumObjects(); ++ObjectIndex)
+	{
+		const FTruSceneObjectRecord& Record = Reader.GetObject(ObjectIndex);
+		const FUtf8StringView Name = Reader.GetObjectName(ObjectIndex);
+
+		FTruSpawnRequest& Request = OutRequests.AddDefaulted_GetRef();
+		Request.Class = Record.IsPrefabRecord() ? nullptr : ResolvedClasses[Record.ClassIndex];
+		Request.Transform = Record.GetTransform();
+		Request.Name = FName(Name.Len(), Name.GetData());
+		Request.ObjectId = FTruObjectId(Record.ObjectId);
+		Request.ParentIndex = Record.ParentIndex;
+	}
+}
+
+TArray<UClass*> FTruSceneFile::ResolveClasses(const FTruSceneFileReader& Reader)
+{
+	// Entries only prefab records use are prefab names, not classes
+	TBitArray<> UsedByObjects(false, Reader.GetNumClasses());
+	for (int32 ObjectIndex = 0; ObjectIndex < Reader.GetNumObjects(); ++ObjectIndex)
+	{
+		const FTruSceneObjectRecord& Record = Reader.GetObject(ObjectIndex);
+		if (!Record.IsPrefabRecord())
+		{
+			UsedByObjects[Record.ClassIndex] = true;
+		}
+	}
+
+	TArray<UClass*> ResolvedClasses;
+	ResolvedClasses.SetNumZeroed(Reader.GetNumClasses());
+	for (int32 ClassIndex = 0; ClassIndex < Reader.GetNumClasses(); ++ClassIndex)
+	{
+		if (!UsedByObjects[ClassIndex])
+		{
+			continue;
+		}
+
+		const FSoftClassPath ClassPath(FString(Reader.GetClassPath(ClassIndex)));
+		UClass* Class = ClassPath.TryLoadClass<ATruGameObject>();
+		if (!Class)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Scene class %s is not a TruGameObject, its objects are skipped"), *ClassPath.ToString());
+		}
+		ResolvedClasses[ClassIndex] = Class;
+	}
+	return ResolvedClasses;
+}
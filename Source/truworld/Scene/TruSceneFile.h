@@ -0,0 +1,162 @@
+// TruSceneFile.h
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FTruSpawnRequest;
+class IMappedFileHandle;
+class IMappedFileRegion;
+class UWorld;
+
+/**
+ * On-disk layout of a .truscene file (little endian, every table 8-byte aligned):
+ *
+ *   FTruSceneHeader
+ *   FTruSceneStringRef[NumClasses]        class paths
+ *   FTruSceneObjectRecord[NumObjects]     flat transform/class table
+ *   UTF-8 string table                    object names and class paths, not null terminated
+ *
+ * Records are plain old data so a reader can use them straight out of a memory mapped file.
+ * Version 1 records had no ObjectId; they are upgraded into a copy of the table when opened.
+ * Version 3 added prefab records (see the flags below); version 2 files never set any flag, so they read as they are.
+ */
+namespace TruScene
+{
+	static constexpr uint32 Magic = 0x53555254; // "TRUS"
+	static constexpr uint32 Version = 3;
+	static constexpr TCHAR Extension[] = TEXT(".truscene");
+
+	// FTruSceneObjectRecord::Flags
+	/** A placed prefab rather than an object: the class entry is the prefab's name and ObjectId the instance's id. */
+	static constexpr uint32 PrefabInstance = 1 << 0;
+	/** One part of the prefab instance at ParentIndex that differs from the prefab. Name is the part's name in the prefab and the transform is relative to its parent part. */
+	static constexpr uint32 PrefabOverride = 1 << 1;
+	/** With PrefabOverride: the part was deleted from the instance. */
+	static constexpr uint32 PrefabPartRemoved = 1 << 2;
+}
+
+struct FTruSceneHeader
+{
+	uint32 Magic = TruScene::Magic;
+	uint32 Version = TruScene::Version;
+	uint32 NumClasses = 0;
+	uint32 NumObjects = 0;
+	uint64 ClassTableOffset = 0;
+	uint64 ObjectTableOffset = 0;
+	uint64 StringTableOffset = 0;
+	uint64 StringTableSize = 0;
+};
+static_assert(sizeof(FTruSceneHeader) == 48, "FTruSceneHeader is part of the file format");
+
+struct FTruSceneStringRef
+{
+	uint32 Offset = 0;
+	uint32 Length = 0;
+};
+static_assert(sizeof(FTruSceneStringRef) == 8, "FTruSceneStringRef is part of the file format");
+
+struct FTruSceneObjectRecord
+{
+	double Location[3];
+	float Rotation[4];	// Quaternion X, Y, Z, W
+	float Scale[3];
+	FTruSceneStringRef Name;
+	uint32 ClassIndex;
+	int32 ParentIndex;	// Index into the object table, INDEX_NONE for roots
+	uint32 Flags;		// TruScene::PrefabInstance and friends, 0 for objects (added in version 3)
+	uint64 ObjectId;	// FTruObjectId::Value, 0 when the object had none (added in version 2)
+
+	/** Prefab records are placed through the prefab library; everything that spawns objects skips them. */
+	bool IsPrefabRecord() const { return (Flags & (TruScene::PrefabInstance | TruScene::PrefabOverride)) != 0; }
+	FTransform GetTransform() const;
+	void SetTransform(const FTransform& Transform);
+};
+static_assert(sizeof(FTruSceneObjectRecord) == 80, "FTruSceneObjectRecord is part of the file format");
+
+/** Builds a scene file in memory. Class paths are deduplicated; all strings share one table. */
+class TRUWORLD_API FTruSceneFileWriter
+{
+public:
+	int32 AddClass(const FString& ClassPath);
+	int32 AddObject(const FString& Name, int32 ClassIndex, const FTransform& Transform, int32 ParentIndex, uint64 ObjectId = 0, uint32 Flags = 0);
+	/** For sources that name parents, which may come after their children. */
+	void SetParent(int32 ObjectIndex, int32 ParentIndex) { Objects[ObjectIndex].ParentIndex = ParentIndex; }
+
+	int32 GetNumObjects() const { return Objects.Num(); }
+
+	void WriteTo(TArray<uint8>& OutBytes) const;
+	bool SaveToFile(const FString& Filename) const;
+
+private:
+	FTruSceneStringRef AddString(const FString& String);
+
+	TArray<FTruSceneStringRef> Classes;
+	TMap<FString, int32> ClassIndices;
+	TArray<FTruSceneObjectRecord> Objects;
+	TArray<UTF8CHAR> Strings;
+};
+
+/**
+ * Read-only view of a scene file. The file is memory mapped when the platform supports it, so opening
+ * costs one validation pass over the tables and reading a record is a pointer offset.
+ */
+class TRUWORLD_API FTruSceneFileReader
+{
+public:
+	FTruSceneFileReader();
+	~FTruSceneFileReader();
+
+	bool Open(const FString& Filename, FString* OutError = nullptr);
+	bool OpenFromMemory(TArray<uint8>&& Bytes, FString* OutError = nullptr);
+	void Close();
+
+	bool IsOpen() const { return Header != nullptr; }
+	int32 GetNumObjects() const { return Header ? Header->NumObjects : 0; }
+	int32 GetNumClasses() const { return Header ? Header->NumClasses : 0; }
+	/** Version the file was written with; older tables are already upgraded in memory. */
+	uint32 GetVersion() const { return Header ? Header->Version : 0; }
+
+	const FTruSceneObjectRecord& GetObject(int32 Index) const { return Objects[Index]; }
+	FUtf8StringView GetString(const FTruSceneStringRef& Ref) const;
+	FUtf8StringView GetObjectName(int32 Index) const { return GetString(Objects[Index].Name); }
+	FUtf8StringView GetClassPath(int32 ClassIndex) const { return GetString(Classes[ClassIndex]); }
+
+private:
+	bool Validate(FString* OutError);
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	TArray<uint8> OwnedBytes;
+	TArray<FTruSceneObjectRecord> UpgradedObjects;	// Object table of an older version, converted on open
+
+	const uint8* Data = nullptr;
+	int64 Size = 0;
+	const FTruSceneHeader* Header = nullptr;
+	const FTruSceneStringRef* Classes = nullptr;
+	const FTruSceneObjectRecord* Objects = nullptr;
+	const UTF8CHAR* Strings = nullptr;
+};
+
+/** Saving and loading the TruGameObjects of a world. */
+struct TRUWORLD_API FTruSceneFile
+{
+	/** Saved/Scenes under the project directory. */
+	static FString GetSceneDirectory();
+	/** Bare scene names go to the scene directory and get the .truscene extension. */
+	static FString ResolveScenePath(const FString& SceneName);
+
+	static void WriteWorld(UWorld* World, FTruSceneFileWriter& Writer);
+	static bool SaveWorld(UWorld* World, const FString& Filename);
+
+	/** Spawns every object in the reader into World, restores the hierarchy and places its prefab instances. Returns the number spawned and placed. */
+	static int32 SpawnIntoWorld(UWorld* World, const FTruSceneFileReader& Reader, AActor* Owner = nullptr);
+	static int32 LoadIntoWorld(UWorld* World, const FString& Filename, AActor* Owner = nullptr);
+
+	/** Converts the reader's records into requests for UTruSpawnQueue, for loads that must not block a frame. Prefab records become requests without a class, which keeps the indices lined up with the records. */
+	static void MakeSpawnRequests(const FTruSceneFileReader& Reader, TArray<FTruSpawnRequest>& OutRequests);
+
+private:
+	/** Class paths are resolved once per file, not once per object. Unknown classes, and the prefab names of prefab records, come back null. */
+	static TArray<UClass*> ResolveClasses(const FTruSceneFileReader& Reader);
+};